@@ -9,11 +9,9 @@
 
 #define INITIAL_PROGRAM_MEMORY_SIZE MB(5)
 
-// You might want to increase this if you get a log warning saying the temporary storage was overflown.
-// In many cases, overflowing the temporary storage should be fine since it just wraps back around and
-// allocations made way earlier in the frame are likely not used anymore.
-// This might however not always be the case, so it's probably a good idea to make sure you always have
-// enough temporary storage for your game.
+// Initial size of the temporary storage. It grows if a frame needs more, so this doesn't need to be
+// exact, but growing costs a bit. Check get_temporary_storage_stats().highest_peak to see how much
+// your game actually uses per frame.
 #define TEMPORARY_STORAGE_SIZE MB(2)
 
 // Enable VERY_DEBUG if you are having memory bugs to detect things like heap corruption earlier.
@@ -0,0 +1,19 @@
+
+///
+// Headless build, no window, graphics or audio. This is what builds on linux for now
+// (see oogabooga/os_impl_linux.c), and it runs the tests that don't need a gpu.
+// Build with build_headless.sh.
+
+#define INITIAL_PROGRAM_MEMORY_SIZE MB(5)
+#define TEMPORARY_STORAGE_SIZE MB(2)
+
+#define OOGABOOGA_HEADLESS 1
+#define RUN_TESTS 1
+
+#define ENTRY_PROC entry
+
+#include "oogabooga/oogabooga.c"
+
+int entry(int argc, char **argv) {
+	return 0;
+}
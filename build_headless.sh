@@ -0,0 +1,18 @@
+#!/bin/sh
+
+# Builds build_headless.c for linux. Run from the project root since the tests load files
+# relative to it:
+#   ./build_headless.sh && ./build/headless
+
+CC=${CC:-gcc}
+CFLAGS="-g -O2 -std=gnu11 -msse4.1
+        -Wno-incompatible-pointer-types -Wno-builtin-declaration-mismatch
+        -fno-builtin-printf -fno-builtin-sprintf -fno-builtin-fprintf
+        -lm -lpthread -ldl"
+SRC=../build_headless.c
+EXENAME=headless
+
+mkdir -p build
+cd build
+$CC $SRC -o $EXENAME $CFLAGS
+cd ..
@@ -283,12 +283,14 @@ int entry(int argc, char **argv) {
     assert(font, "Failed loading arial.ttf");
     const u32 font_height = 48;
 
-    sprites[0] = (Sprite){.image = load_image_from_disk(fixed_string("res/sprites/missing.png"), get_heap_allocator())};
-    sprites[SPRITE_player] = (Sprite){.image = load_image_from_disk(fixed_string("res/sprites/player.png"), get_heap_allocator())};
-    sprites[SPRITE_tree_pine] = (Sprite){.image = load_image_from_disk(fixed_string("res/sprites/tree_pine.png"), get_heap_allocator())};
-    sprites[SPRITE_rock_0] = (Sprite){.image = load_image_from_disk(fixed_string("res/sprites/rock_0.png"), get_heap_allocator())};
-    sprites[SPRITE_item_pine_wood] = (Sprite){.image = load_image_from_disk(fixed_string("res/sprites/item_pinewood.png"), get_heap_allocator())};
-    sprites[SPRITE_item_rock] = (Sprite){.image = load_image_from_disk(fixed_string("res/sprites/item_rock.png"), get_heap_allocator())};
+    // All sprites share one atlas page so they draw in a single batch
+    Gfx_Atlas *sprite_atlas = make_atlas(1024, 1024, get_heap_allocator());
+    sprites[0] = (Sprite){.image = atlas_load_image_from_disk(sprite_atlas, fixed_string("res/sprites/missing.png"))};
+    sprites[SPRITE_player] = (Sprite){.image = atlas_load_image_from_disk(sprite_atlas, fixed_string("res/sprites/player.png"))};
+    sprites[SPRITE_tree_pine] = (Sprite){.image = atlas_load_image_from_disk(sprite_atlas, fixed_string("res/sprites/tree_pine.png"))};
+    sprites[SPRITE_rock_0] = (Sprite){.image = atlas_load_image_from_disk(sprite_atlas, fixed_string("res/sprites/rock_0.png"))};
+    sprites[SPRITE_item_pine_wood] = (Sprite){.image = atlas_load_image_from_disk(sprite_atlas, fixed_string("res/sprites/item_pinewood.png"))};
+    sprites[SPRITE_item_rock] = (Sprite){.image = atlas_load_image_from_disk(sprite_atlas, fixed_string("res/sprites/item_rock.png"))};
 
     // :init
     // test item inventory
@@ -317,6 +319,12 @@ int entry(int argc, char **argv) {
     float zoom = 6.0;
     Vector2 camera_pos = v2(0, 0);
 
+    Draw_List *tile_list = alloc(get_heap_allocator(), sizeof(Draw_List));
+    draw_list_init(tile_list);
+    int tile_list_x = 0;
+    int tile_list_y = 0;
+    bool has_tile_list = false;
+
     bool is_inventory_open = false;
     // === Game Loop
     float64 last_time = os_get_elapsed_seconds();
@@ -369,21 +377,33 @@ int entry(int argc, char **argv) {
         }
 
         // :tile rendering
+        // The checkerboard is recorded once around the player and replayed, and only recorded
+        // again when the player walks far enough for the recorded area to run out.
         {
             int player_tile_x = world_pos_to_tile_pos(player_en->pos.x);
             int player_tile_y = world_pos_to_tile_pos(player_en->pos.y);
             int tile_radius_x = 40;
             int tile_radius_y = 30;
-            for (int x = player_tile_x - tile_radius_x; x < player_tile_x + tile_radius_x; x++) {
-                for (int y = player_tile_y - tile_radius_y; y < player_tile_y + tile_radius_y; y++) {
-                    if ((x + (y % 2 == 0)) % 2 == 0) {
-                        Vector4 col = v4(0.2, 0.2, 0.2, 0.2);
-                        float x_pos = x * tile_width;
-                        float y_pos = y * tile_width;
-                        draw_rect(v2(x_pos + tile_width * -0.5, y_pos + tile_width * -0.5), v2(tile_width, tile_width), col);
+            int tile_record_padding = 20;
+            if (!has_tile_list || abs(player_tile_x - tile_list_x) > tile_record_padding || abs(player_tile_y - tile_list_y) > tile_record_padding) {
+                tile_list_x = player_tile_x;
+                tile_list_y = player_tile_y;
+                has_tile_list = true;
+
+                Draw_Frame *tiles = draw_list_begin(tile_list);
+                for (int x = tile_list_x - tile_radius_x - tile_record_padding; x < tile_list_x + tile_radius_x + tile_record_padding; x++) {
+                    for (int y = tile_list_y - tile_radius_y - tile_record_padding; y < tile_list_y + tile_radius_y + tile_record_padding; y++) {
+                        if ((x + (y % 2 == 0)) % 2 == 0) {
+                            Vector4 col = v4(0.2, 0.2, 0.2, 0.2);
+                            float x_pos = x * tile_width;
+                            float y_pos = y * tile_width;
+                            draw_rect_in_frame(v2(x_pos + tile_width * -0.5, y_pos + tile_width * -0.5), v2(tile_width, tile_width), col, tiles);
+                        }
                     }
                 }
+                draw_list_end(tile_list);
             }
+            draw_list_submit(tile_list);
         }
 
         // :update entities
@@ -114,6 +114,12 @@ alloc_uninitialized(Allocator allocator, u64 size);
 ogb_instance void 
 dealloc(Allocator allocator, void *p);
 
+// Resizes the allocation in place if the allocator can, otherwise it falls back to
+// alloc + copy + dealloc. old_size is needed for that copy and to zero initialize
+// the new bytes.
+ogb_instance void* 
+reallocate(Allocator allocator, void *p, u64 old_size, u64 new_size);
+
 ogb_instance void 
 push_context(Context c);
 
@@ -151,6 +157,26 @@ dealloc(Allocator allocator, void *p) {
 	allocator.proc(0, p, ALLOCATOR_DEALLOCATE, allocator.data);
 }
 
+// Allocators return 0 on ALLOCATOR_REALLOCATE if they can't reallocate
+void* 
+reallocate(Allocator allocator, void *p, u64 old_size, u64 new_size) {
+	assert(new_size > 0, "You requested an allocation of zero bytes. I'm not sure what you want with that.");
+	if (!p) return alloc(allocator, new_size);
+	
+	void *new = allocator.proc(new_size, p, ALLOCATOR_REALLOCATE, allocator.data);
+	
+	if (!new) {
+		new = allocator.proc(new_size, 0, ALLOCATOR_ALLOCATE, allocator.data);
+		memcpy(new, p, old_size < new_size ? old_size : new_size);
+		allocator.proc(0, p, ALLOCATOR_DEALLOCATE, allocator.data);
+	}
+	
+#if DO_ZERO_INITIALIZATION
+	if (new_size > old_size) memset((u8*)new+old_size, 0, new_size-old_size);
+#endif
+	return new;
+}
+
 void 
 push_context(Context c) {
 	assert(num_contexts < CONTEXT_STACK_MAX, "Context stack overflow");
@@ -10,6 +10,14 @@ inline bool compare_and_swap_32(volatile uint32_t *a, uint32_t b, uint32_t old);
 inline bool compare_and_swap_64(volatile uint64_t *a, uint64_t b, uint64_t old);
 inline bool compare_and_swap_bool(volatile bool *a, bool b, bool old);
 
+// Returns the value before the increment
+inline u64 atomic_increment_64(volatile u64 *a) {
+	while (true) {
+		u64 old = *a;
+		if (compare_and_swap_64(a, old+1, old)) return old;
+	}
+}
+
 ///
 // Spinlock "primitive"
 // Like a mutex but it eats up the entire core while waiting.
@@ -57,6 +65,52 @@ mutex_acquire_or_wait(Mutex *m);
 void ogb_instance
 mutex_release(Mutex *m);
 
+///
+// Parallel for
+// Splits [0, count) into range_count ranges of about equal size and runs proc on each
+// range. The ranges are picked up by a pool of worker threads (started the first time
+// it's needed) and by the calling thread, and parallel_for returns when all ranges are
+// done. Give each range its own output so they don't need to sync.
+// If called from a worker, or while another thread is in a parallel_for, all ranges are
+// just run on the calling thread.
+//
+// Example:
+//
+//     void add_one(u64 first, u64 end, u64 range_index, void *data) {
+//         int *numbers = (int*)data;
+//         for (u64 i = first; i < end; i++) numbers[i] += 1;
+//     }
+//
+//     parallel_for(number_count, parallel_for_get_thread_count(), add_one, numbers);
+//
+#define PARALLEL_FOR_MAX_WORKERS 15
+
+typedef void(*Parallel_For_Proc)(u64 first, u64 end, u64 range_index, void *data);
+
+typedef struct Parallel_For_Job {
+	Parallel_For_Proc proc;
+	void *data;
+	u64 count;
+	u64 range_count;
+	volatile u64 next_range;
+	// Workers which were woken up and are done with this job
+	volatile u64 finished_worker_count;
+} Parallel_For_Job;
+
+// #Global
+ogb_instance Thread parallel_for_workers[PARALLEL_FOR_MAX_WORKERS];
+ogb_instance Binary_Semaphore parallel_for_wake_semaphores[PARALLEL_FOR_MAX_WORKERS];
+ogb_instance u64 parallel_for_worker_count;
+ogb_instance volatile bool parallel_for_busy;
+ogb_instance Parallel_For_Job parallel_for_job;
+
+void ogb_instance
+parallel_for(u64 count, u64 range_count, Parallel_For_Proc proc, void *data);
+
+// Calling thread + workers
+u64 ogb_instance
+parallel_for_get_thread_count();
+
 
 #if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
 
@@ -131,4 +185,87 @@ void mutex_release(Mutex *m) {
 	}
 }
 
-#endif
\ No newline at end of file
+
+///
+// Parallel for
+
+Thread parallel_for_workers[PARALLEL_FOR_MAX_WORKERS];
+Binary_Semaphore parallel_for_wake_semaphores[PARALLEL_FOR_MAX_WORKERS];
+u64 parallel_for_worker_count = 0;
+volatile bool parallel_for_busy = false;
+Parallel_For_Job parallel_for_job;
+bool parallel_for_initted = false;
+thread_local bool parallel_for_is_worker = false;
+
+void parallel_for_run_ranges(Parallel_For_Job *job) {
+	while (true) {
+		u64 range = atomic_increment_64(&job->next_range);
+		if (range >= job->range_count) break;
+		
+		u64 first = (job->count*range)/job->range_count;
+		u64 end = (job->count*(range+1))/job->range_count;
+		job->proc(first, end, range, job->data);
+	}
+}
+void parallel_for_worker_proc(Thread *t) {
+	parallel_for_is_worker = true;
+	Binary_Semaphore *wake = &parallel_for_wake_semaphores[(u64)t->data];
+	while (true) {
+		os_binary_semaphore_wait(wake);
+		parallel_for_run_ranges(&parallel_for_job);
+		atomic_increment_64(&parallel_for_job.finished_worker_count);
+	}
+}
+
+u64 parallel_for_get_thread_count() {
+	u64 processors = os_get_number_of_logical_processors();
+	return min(max(processors, 1), PARALLEL_FOR_MAX_WORKERS+1);
+}
+
+void parallel_for(u64 count, u64 range_count, Parallel_For_Proc proc, void *data) {
+	range_count = min(range_count, count);
+	
+	if (range_count <= 1 || parallel_for_is_worker || !compare_and_swap_bool(&parallel_for_busy, true, false)) {
+		for (u64 range = 0; range < range_count; range++) {
+			proc((count*range)/range_count, (count*(range+1))/range_count, range, data);
+		}
+		return;
+	}
+	
+	if (!parallel_for_initted) {
+		parallel_for_initted = true;
+		parallel_for_worker_count = parallel_for_get_thread_count()-1;
+		for (u64 i = 0; i < parallel_for_worker_count; i++) {
+			os_binary_semaphore_init(&parallel_for_wake_semaphores[i], false);
+			os_thread_init(&parallel_for_workers[i], parallel_for_worker_proc);
+			parallel_for_workers[i].data = (void*)i;
+			os_thread_start(&parallel_for_workers[i]);
+		}
+	}
+	
+	parallel_for_job.proc = proc;
+	parallel_for_job.data = data;
+	parallel_for_job.count = count;
+	parallel_for_job.range_count = range_count;
+	parallel_for_job.next_range = 0;
+	parallel_for_job.finished_worker_count = 0;
+	MEMORY_BARRIER;
+	
+	u64 wake_count = min(parallel_for_worker_count, range_count-1);
+	for (u64 i = 0; i < wake_count; i++) {
+		os_binary_semaphore_signal(&parallel_for_wake_semaphores[i]);
+	}
+	
+	parallel_for_run_ranges(&parallel_for_job);
+	
+	// Workers might still be working on the last ranges, and we can't touch the job
+	// until all woken workers are out of it.
+	while (parallel_for_job.finished_worker_count < wake_count) {
+		os_yield_thread();
+	}
+	
+	bool released = compare_and_swap_bool(&parallel_for_busy, false, true);
+	assert(released, "Internal parallel_for error");
+}
+
+#endif
@@ -107,6 +107,34 @@ typedef struct Cpu_Capabilities {
 	
 	#define MEMORY_BARRIER _ReadWriteBarrier()
 	
+	#pragma intrinsic(_BitScanReverse64)
+	
+	// Index of the highest set bit. x must not be 0.
+	inline u64
+	bit_scan_reverse_64(u64 x) {
+		unsigned long index;
+		_BitScanReverse64(&index, x);
+		return (u64)index;
+	}
+	// Index of the lowest set bit. x must not be 0.
+	inline u64
+	bit_scan_forward_64(u64 x) {
+		unsigned long index;
+		_BitScanForward64(&index, x);
+		return (u64)index;
+	}
+	
+	// Full 64x64 -> 128 bit multiply, returns the low half
+	inline u64
+	multiply_u64_full(u64 a, u64 b, u64 *high) {
+		return _umul128(a, b, high);
+	}
+	
+	// Lets a single function use AVX2 without compiling everything for it. Only call
+	// these if query_cpu_capabilities() says the cpu has avx2.
+	#define TARGET_AVX2
+	#define COMPILER_CAN_TARGET_AVX2 1
+	
 	#define thread_local __declspec(thread)
 	
 	#define SHARED_EXPORT __declspec(dllexport)
@@ -227,6 +255,30 @@ typedef struct Cpu_Capabilities {
 	
 	#define MEMORY_BARRIER {__asm__ __volatile__("" ::: "memory");__sync_synchronize();}
 	
+	// Index of the highest set bit. x must not be 0.
+	inline u64
+	bit_scan_reverse_64(u64 x) {
+		return 63 - (u64)__builtin_clzll(x);
+	}
+	// Index of the lowest set bit. x must not be 0.
+	inline u64
+	bit_scan_forward_64(u64 x) {
+		return (u64)__builtin_ctzll(x);
+	}
+	
+	// Full 64x64 -> 128 bit multiply, returns the low half
+	inline u64
+	multiply_u64_full(u64 a, u64 b, u64 *high) {
+		unsigned __int128 r = (unsigned __int128)a * b;
+		*high = (u64)(r >> 64);
+		return (u64)r;
+	}
+	
+	// Lets a single function use AVX2 without compiling everything for it. Only call
+	// these if query_cpu_capabilities() says the cpu has avx2.
+	#define TARGET_AVX2 __attribute__((target("avx2")))
+	#define COMPILER_CAN_TARGET_AVX2 1
+	
 	#define thread_local __thread
 	
 #if TARGET_OS == WINDOWS
@@ -253,6 +305,34 @@ typedef struct Cpu_Capabilities {
     
     #define MEMORY_BARRIER
     
+    inline u64
+    bit_scan_reverse_64(u64 x) {
+    	u64 index = 0;
+    	while (x >>= 1) index += 1;
+    	return index;
+    }
+    inline u64
+    bit_scan_forward_64(u64 x) {
+    	u64 index = 0;
+    	while (!(x & 1)) { x >>= 1; index += 1; }
+    	return index;
+    }
+    inline u64
+    multiply_u64_full(u64 a, u64 b, u64 *high) {
+    	u64 a_lo = a & 0xFFFFFFFF, a_hi = a >> 32;
+    	u64 b_lo = b & 0xFFFFFFFF, b_hi = b >> 32;
+    	u64 lo_lo = a_lo*b_lo;
+    	u64 hi_lo = a_hi*b_lo;
+    	u64 lo_hi = a_lo*b_hi;
+    	u64 hi_hi = a_hi*b_hi;
+    	u64 cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFF) + lo_hi;
+    	*high = hi_hi + (hi_lo >> 32) + (cross >> 32);
+    	return (cross << 32) | (lo_lo & 0xFFFFFFFF);
+    }
+    
+    #define TARGET_AVX2
+    #define COMPILER_CAN_TARGET_AVX2 0
+    
     #warning "Compiler is not explicitly supported, some things will probably not work as expected"
 #endif
 
@@ -3,6 +3,7 @@
 
 	NOTES: 
 		- For creating, loading, managing Gfx_Image's see gfx_interface.c.
+		- For packing many small images into shared textures so they batch together, see gfx_atlas.c.
 		- For clearing and rendering a draw_frame to offscreen render target or to
 			the window, see gfx_render_draw_frame and gfx_render_draw_frame_to_window
 			in gfx_interface.c.
@@ -44,6 +45,19 @@
 			Draw_Quad *draw_image_xform(Gfx_Image *image, Matrix4 xform, Vector2 size, Vector4 color);
 			
 			void draw_line(Vector2 p0, Vector2 p1, float line_width, Vector4 color);
+			
+			u64 draw_images_xform_batch(Draw_Image_Xform *items, u64 count);
+			
+			u64 draw_list_submit(Draw_List *list);
+			
+			u64 draw_tilemap(Tilemap *map);
+			
+			- draw_tilemap draws the visible chunks of a Tilemap, see tilemap.c.
+			
+			- draw_images_xform_batch draws many images at once, which is a lot faster than calling
+				draw_image_xform for each of them. It returns the number of images that weren't culled.
+				There are no quads to modify retroactively, so set image, xform, size and color in
+				each Draw_Image_Xform.
 		
 		- Drawing text:
 			
@@ -93,6 +107,9 @@
 			The projection and xform gets applied directly in each draw_xxx call. So, you need to set
 			the camera stuff just before drawing stuff to a specific camera.
 			
+			projection * inverse(camera_xform) is cached in the frame and only recomputed when projection
+			or camera_xform changes. You can get it with draw_frame_get_world_to_clip(frame).
+			
 			The cbuffer is for passing a constant buffer to the custom shader. For more info on custom
 			shading, see examples/custom_shader.c.
 				
@@ -117,7 +134,45 @@
 				out.	
 				
 			- A practical example for using Draw_Frame's can be found in examples/threaded_drawing.c	
+			
+		- Quad storage layout:
+		
+			void draw_frame_set_quad_layout(Draw_Frame *frame, Draw_Quad_Layout layout);
+			u64  draw_frame_get_quad_count(Draw_Frame *frame);
+			
+			- By default (DRAW_QUAD_LAYOUT_AOS) every quad is stored as one fat Draw_Quad in
+				Draw_Frame.quad_buffer.
+			- With DRAW_QUAD_LAYOUT_SOA quads are stored in Draw_Frame.quad_streams, with one stream
+				per attribute (positions, colors, uvs, images, flags, z and optional userdata). Sorting
+				then only reads the z stream and the renderer only reads the streams it needs. Userdata
+				is only stored for quads that actually set it.
+			- The layout can only be changed while the frame is empty. It is kept through draw_frame_reset.
+			- Retroactively modifying quads works the same in both layouts. In SoA the returned Draw_Quad*
+				points to a pending quad which is committed to the streams on the next draw or when the
+				frame is rendered.
+			- Renderers get the streams with draw_frame_get_pack_input(frame) and turn them into 64 byte
+				quad instances or vertices with gfx_pack.c. AoS frames are copied into the streams first,
+				so SoA skips a copy.
+
+		- Retained draw lists:
 		
+			void draw_list_init(Draw_List *list);
+			void draw_list_deinit(Draw_List *list);
+			Draw_Frame *draw_list_begin(Draw_List *list);
+			void draw_list_end(Draw_List *list);
+			u64 draw_list_submit_in_frame(Draw_List *list, Draw_Frame *frame);
+			
+			- For stuff that doesn't change between frames, like a tile grid. Record it once in world
+				space by drawing to the frame returned by draw_list_begin, and then submit it each frame.
+			- Submitting applies the camera of the frame it's submitted to. While the camera only pans
+				less than Draw_List.recull_margin pixels from where the list was last culled, submitting
+				just offsets cached corners, so it skips everything draw_xxx normally does per quad.
+				Zooming, rotating or panning further culls the list again.
+			- Call draw_list_begin again to record something else. Recording is not free, so only do
+				that when the content actually changes.
+			- Atlas images are resolved to their page when the frame is rendered, so lists don't need to
+				be recorded again when an atlas is repacked.
+
 		- The rest of the advanced API, similar to EZ mode:
 		
 			Draw_Quad *draw_quad_projected_in_frame(Draw_Quad quad, Matrix4 world_to_clip, Draw_Frame *frame);
@@ -135,6 +190,10 @@
 				
 			void draw_line_in_frame(Vector2 p0, Vector2 p1, float line_width, Vector4 color, Draw_Frame *frame);
 			
+			u64 draw_images_xform_batch_in_frame(Draw_Image_Xform *items, u64 count, Draw_Frame *frame);
+			
+			u64 draw_tilemap_in_frame(Tilemap *map, Draw_Frame *frame);
+			
 			void draw_text_xform_in_frame(Gfx_Font *font, string text, u32 raster_height, Matrix4 xform, Vector2 scale, Vector4 color, Draw_Frame *frame);
 			void draw_text_in_frame(Gfx_Font *font, string text, u32 raster_height, Vector2 position, Vector2 scale, Vector4 color, Draw_Frame *frame);
 			Gfx_Text_Metrics draw_text_and_measure_in_frame(Gfx_Font *font, string text, u32 raster_height, Vector2 position, Vector2 scale, Vector4 color, Draw_Frame *frame);
@@ -155,14 +214,13 @@
 											sampled.
 			- s32             Draw_Quad.z: A value used for sorting. To enable this you must set 
 										   draw_frame.enable_z_sorting to true each frame.
+										   Sorting is nearly free if quads are drawn in z order,
+										   and cheap with up to GFX_PACK_MAX_Z_LAYERS distinct z's.
 			- Gfx_Filter_Mode Draw_Quad.image_min_filter
 			- Gfx_Filter_Mode Draw_Quad.image_mag_filter
 				
 */
 
-// We use radix sort so the exact bit count is of importance
-#define MAX_Z_BITS 21
-#define MAX_Z ((1 << MAX_Z_BITS)/2)
 #define Z_STACK_MAX 4096
 #define SCISSOR_STACK_MAX 4096
 #define MAX_BOUND_IMAGES 16
@@ -186,6 +244,40 @@ typedef struct Draw_Quad {
 	
 } Draw_Quad;
 
+typedef enum Draw_Quad_Layout {
+	DRAW_QUAD_LAYOUT_AOS = 0,
+	DRAW_QUAD_LAYOUT_SOA,
+} Draw_Quad_Layout;
+
+// Flags are DRAW_QUAD_FLAG_* in gfx_pack.c
+typedef struct Draw_Quad_Streams {
+	u64 count;
+	u64 capacity;
+	
+	// 4 per quad; bottom_left, top_left, top_right, bottom_right. BEWARE !! These are in ndc
+	Vector2 *positions;
+	Vector4 *colors;
+	// Only written for quads with an image
+	Vector4 *uvs;
+	Gfx_Image **images;
+	u32 *flags;
+	s32 *z;
+	// Only written for quads with DRAW_QUAD_FLAG_HAS_SCISSOR
+	Vector4 *scissors;
+	// VERTEX_USER_DATA_COUNT per quad. Stays null until a quad has non-zero userdata, and is
+	// only written for quads with DRAW_QUAD_FLAG_HAS_USERDATA.
+	Vector4 *userdata;
+	
+	// Distinct z's of the quads so far, so z sorting can skip or shortcut the sort.
+	// Anything that writes to z must keep this up to date.
+	Gfx_Pack_Z_Layers z_layers;
+	
+	// Some quads have atlas images which still need to be resolved to their page,
+	// see draw_quad_streams_resolve_atlas_images.
+	bool has_atlas_images;
+	
+} Draw_Quad_Streams;
+
 typedef struct Draw_Frame {
 	Matrix4 projection;
 	// #Cleanup
@@ -201,10 +293,27 @@ typedef struct Draw_Frame {
 	
 	Draw_Quad *quad_buffer;
 	
+	Draw_Quad_Layout quad_layout;
+	Draw_Quad_Streams quad_streams;
+	// SoA only: the last drawn quad lives here until the next draw so it can still be
+	// modified retroactively.
+	Draw_Quad pending_quad;
+	bool has_pending_quad;
+	
+	// projection * inverse(camera_xform), see draw_frame_get_world_to_clip
+	Matrix4 world_to_clip;
+	Matrix4 world_to_clip_projection;
+	Matrix4 world_to_clip_camera_xform;
+	bool has_world_to_clip;
+	
 	u64 z_count;
 	s32 z_stack[Z_STACK_MAX];
 	bool enable_z_sorting;
 	
+	// Set on Draw_List.record. Quads stay in world space and are not culled or snapped until the
+	// list is submitted.
+	bool is_draw_list;
+	
 	Gfx_Shader_Extension shader_extension;
 	
 	Gfx_Image *bound_images[MAX_BOUND_IMAGES];
@@ -233,10 +342,18 @@ void draw_frame_reset(Draw_Frame *frame) {
 
 	Draw_Quad *quad_buffer = frame->quad_buffer;
 	if (quad_buffer) growing_array_clear((void**)&quad_buffer);
+	
+	Draw_Quad_Layout quad_layout = frame->quad_layout;
+	Draw_Quad_Streams quad_streams = frame->quad_streams;
+	quad_streams.count = 0;
+	quad_streams.z_layers = ZERO(Gfx_Pack_Z_Layers);
+	quad_streams.has_atlas_images = false;
 
 	*frame = (Draw_Frame){0};
 	
 	frame->quad_buffer = quad_buffer;
+	frame->quad_layout = quad_layout;
+	frame->quad_streams = quad_streams;
 	
 	frame->projection 
 		= m4_make_orthographic_projection(-window.width/2, window.width/2, -window.height/2, window.height/2, -1, 10);
@@ -245,6 +362,279 @@ void draw_frame_reset(Draw_Frame *frame) {
 	frame->highest_bound_slot_index = -1;
 }
 
+void draw_quad_streams_reserve(Draw_Quad_Streams *streams, u64 capacity) {
+	if (capacity <= streams->capacity) return;
+	
+	Allocator heap = get_heap_allocator();
+	u64 old = streams->capacity;
+	
+	streams->positions = reallocate(heap, streams->positions, old*sizeof(Vector2)*4, capacity*sizeof(Vector2)*4);
+	streams->colors    = reallocate(heap, streams->colors,    old*sizeof(Vector4),   capacity*sizeof(Vector4));
+	streams->uvs       = reallocate(heap, streams->uvs,       old*sizeof(Vector4),   capacity*sizeof(Vector4));
+	streams->images    = reallocate(heap, streams->images,    old*sizeof(Gfx_Image*), capacity*sizeof(Gfx_Image*));
+	streams->flags     = reallocate(heap, streams->flags,     old*sizeof(u32),       capacity*sizeof(u32));
+	streams->z         = reallocate(heap, streams->z,         old*sizeof(s32),       capacity*sizeof(s32));
+	streams->scissors  = reallocate(heap, streams->scissors,  old*sizeof(Vector4),   capacity*sizeof(Vector4));
+	if (streams->userdata) {
+		streams->userdata = reallocate(heap, streams->userdata, old*sizeof(Vector4)*VERTEX_USER_DATA_COUNT, capacity*sizeof(Vector4)*VERTEX_USER_DATA_COUNT);
+	}
+	
+	streams->capacity = capacity;
+}
+void draw_quad_streams_free(Draw_Quad_Streams *streams) {
+	if (!streams->capacity) return;
+	
+	Allocator heap = get_heap_allocator();
+	dealloc(heap, streams->positions);
+	dealloc(heap, streams->colors);
+	dealloc(heap, streams->uvs);
+	dealloc(heap, streams->images);
+	dealloc(heap, streams->flags);
+	dealloc(heap, streams->z);
+	dealloc(heap, streams->scissors);
+	if (streams->userdata) dealloc(heap, streams->userdata);
+	
+	*streams = ZERO(Draw_Quad_Streams);
+}
+
+// Most programs never set userdata, so we don't store it unless we have to
+bool draw_quad_has_userdata(const Draw_Quad *q) {
+	for (u64 j = 0; j < VERTEX_USER_DATA_COUNT; j++) {
+		Vector4 u = q->userdata[j];
+		if (u.x != 0 || u.y != 0 || u.z != 0 || u.w != 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Writes the quad at index i, which must be below streams->capacity.
+// streams->userdata must be allocated if has_userdata.
+void draw_quad_streams_write(Draw_Quad_Streams *streams, u64 i, const Draw_Quad *q, bool has_userdata) {
+	// #Volatile the four corners are laid out next to each other in Draw_Quad
+	memcpy(&streams->positions[i*4], &q->bottom_left, sizeof(Vector2)*4);
+	streams->colors[i] = q->color;
+	streams->images[i] = q->image;
+	streams->z[i]      = q->z;
+	
+	u32 flags = (u32)q->type << DRAW_QUAD_FLAG_TYPE_SHIFT;
+	
+	if (q->image) {
+		streams->uvs[i] = q->uv;
+		if (q->image_min_filter == GFX_FILTER_MODE_LINEAR) flags |= DRAW_QUAD_FLAG_MIN_FILTER_LINEAR;
+		if (q->image_mag_filter == GFX_FILTER_MODE_LINEAR) flags |= DRAW_QUAD_FLAG_MAG_FILTER_LINEAR;
+	}
+	if (q->has_scissor) {
+		streams->scissors[i] = q->scissor;
+		flags |= DRAW_QUAD_FLAG_HAS_SCISSOR;
+	}
+	if (has_userdata) {
+		memcpy(&streams->userdata[i*VERTEX_USER_DATA_COUNT], q->userdata, sizeof(q->userdata));
+		flags |= DRAW_QUAD_FLAG_HAS_USERDATA;
+	}
+	
+	streams->flags[i] = flags;
+}
+
+// Opposite of draw_quad_streams_write.
+// Atlas images that were already resolved come back as their page with remapped uv's.
+void draw_quad_streams_read(const Draw_Quad_Streams *streams, u64 i, Draw_Quad *q) {
+	*q = ZERO(Draw_Quad);
+	
+	memcpy(&q->bottom_left, &streams->positions[i*4], sizeof(Vector2)*4);
+	q->color = streams->colors[i];
+	q->image = streams->images[i];
+	q->z     = streams->z[i];
+	
+	u32 flags = streams->flags[i];
+	q->type = (u8)(flags >> DRAW_QUAD_FLAG_TYPE_SHIFT);
+	
+	if (q->image) {
+		q->uv = streams->uvs[i];
+		if (flags & DRAW_QUAD_FLAG_MIN_FILTER_LINEAR) q->image_min_filter = GFX_FILTER_MODE_LINEAR;
+		if (flags & DRAW_QUAD_FLAG_MAG_FILTER_LINEAR) q->image_mag_filter = GFX_FILTER_MODE_LINEAR;
+	}
+	if (flags & DRAW_QUAD_FLAG_HAS_SCISSOR) {
+		q->scissor = streams->scissors[i];
+		q->has_scissor = true;
+	}
+	if (flags & DRAW_QUAD_FLAG_HAS_USERDATA) {
+		memcpy(q->userdata, &streams->userdata[i*VERTEX_USER_DATA_COUNT], sizeof(q->userdata));
+	}
+}
+
+// Atlas images draw from their page so they can share a batch, see gfx_atlas.c.
+// This is done when the frame is packed rather than when the quad is drawn, since adding,
+// removing and repacking moves images around (and can delete pages) while retained draw lists
+// and SoA frames still have them. A page isn't an atlas image itself, so resolving twice is fine.
+void draw_quad_streams_resolve_atlas_images(Draw_Quad_Streams *streams, u64 first, u64 end) {
+	for (u64 i = first; i < end; i++) {
+		Gfx_Image *image = streams->images[i];
+		if (!image || !image->atlas_page) continue;
+		
+		Vector4 r = image->atlas_uv;
+		Vector4 uv = streams->uvs[i];
+		streams->images[i] = image->atlas_page;
+		streams->uvs[i] = v4(
+			r.x + uv.x*(r.z-r.x),
+			r.y + uv.y*(r.w-r.y),
+			r.x + uv.z*(r.z-r.x),
+			r.y + uv.w*(r.w-r.y)
+		);
+	}
+}
+
+void draw_quad_streams_push(Draw_Quad_Streams *streams, const Draw_Quad *q) {
+	if (streams->count >= streams->capacity) {
+		draw_quad_streams_reserve(streams, max(streams->capacity*2, 1024));
+	}
+	
+	bool has_userdata = draw_quad_has_userdata(q);
+	if (has_userdata && !streams->userdata) {
+		// #Memory #Heapalloc
+		streams->userdata = alloc(get_heap_allocator(), streams->capacity*sizeof(Vector4)*VERTEX_USER_DATA_COUNT);
+	}
+	
+	draw_quad_streams_write(streams, streams->count, q, has_userdata);
+	gfx_pack_z_layers_add(&streams->z_layers, q->z);
+	if (q->image && q->image->atlas_page) streams->has_atlas_images = true;
+	
+	streams->count += 1;
+}
+
+// Commits the pending quad of a SoA frame to its streams.
+// Renderers call this before reading Draw_Frame.quad_streams.
+void draw_frame_flush_pending_quad(Draw_Frame *frame) {
+	if (!frame->has_pending_quad) return;
+	
+	draw_quad_streams_push(&frame->quad_streams, &frame->pending_quad);
+	frame->has_pending_quad = false;
+}
+
+u64 draw_frame_get_quad_count(Draw_Frame *frame) {
+	if (frame->quad_layout == DRAW_QUAD_LAYOUT_SOA) {
+		return frame->quad_streams.count + (frame->has_pending_quad ? 1 : 0);
+	}
+	return frame->quad_buffer ? growing_array_get_valid_count(frame->quad_buffer) : 0;
+}
+
+void draw_frame_set_quad_layout(Draw_Frame *frame, Draw_Quad_Layout layout) {
+	assert(draw_frame_get_quad_count(frame) == 0, "The quad layout can only be changed while the draw frame is empty");
+	
+	if (layout == DRAW_QUAD_LAYOUT_AOS) draw_quad_streams_free(&frame->quad_streams);
+	
+	frame->quad_layout = layout;
+}
+
+typedef struct Draw_Frame_Aos_Job {
+	Draw_Frame *frame;
+	// Per range, it had quads with userdata but there was no userdata stream to write it to
+	bool *missed_userdata;
+} Draw_Frame_Aos_Job;
+
+void draw_frame_write_aos_streams_range(u64 first, u64 end, u64 range_index, void *data) {
+	Draw_Frame_Aos_Job *job = (Draw_Frame_Aos_Job*)data;
+	Draw_Quad_Streams *streams = &job->frame->quad_streams;
+	bool can_write_userdata = streams->userdata != 0;
+	
+	for (u64 i = first; i < end; i++) {
+		const Draw_Quad *q = &job->frame->quad_buffer[i];
+		bool has_userdata = draw_quad_has_userdata(q);
+		if (has_userdata && !can_write_userdata) {
+			job->missed_userdata[range_index] = true;
+			has_userdata = false;
+		}
+		draw_quad_streams_write(streams, i, q, has_userdata);
+	}
+	draw_quad_streams_resolve_atlas_images(streams, first, end);
+}
+
+// What the renderer hands to gfx_pack_quads. The result points into the frame, so it's
+// valid until the frame is drawn to or reset.
+// AoS frames are first copied into Draw_Frame.quad_streams since that's what the packing reads.
+Gfx_Pack_Input draw_frame_get_pack_input(Draw_Frame *frame) {
+	draw_frame_flush_pending_quad(frame);
+	
+	// Glyphs rasterized while drawing text need to be in the atlases before they're sampled
+	font_upload_dirty_atlases();
+	
+	Draw_Quad_Streams *streams = &frame->quad_streams;
+	
+	if (frame->quad_layout == DRAW_QUAD_LAYOUT_AOS) {
+		u64 number_of_quads = draw_frame_get_quad_count(frame);
+		
+		draw_quad_streams_reserve(streams, number_of_quads);
+		
+		u64 range_count = clamp(number_of_quads/GFX_PACK_MIN_QUADS_PER_RANGE, 1, parallel_for_get_thread_count());
+		Draw_Frame_Aos_Job job = ZERO(Draw_Frame_Aos_Job);
+		job.frame = frame;
+		job.missed_userdata = alloc(get_temporary_allocator(), range_count*sizeof(bool));
+		memset(job.missed_userdata, 0, range_count*sizeof(bool));
+		parallel_for(number_of_quads, range_count, draw_frame_write_aos_streams_range, &job);
+		
+		bool missed_userdata = false;
+		for (u64 i = 0; i < range_count; i++) missed_userdata |= job.missed_userdata[i];
+		if (missed_userdata) {
+			// Most programs never get here. Once the stream exists the ranges write userdata
+			// themselves, so this only happens the first time a quad has userdata.
+			// #Memory #Heapalloc
+			streams->userdata = alloc(get_heap_allocator(), streams->capacity*sizeof(Vector4)*VERTEX_USER_DATA_COUNT);
+			for (u64 i = 0; i < number_of_quads; i++) {
+				const Draw_Quad *q = &frame->quad_buffer[i];
+				if (!draw_quad_has_userdata(q)) continue;
+				memcpy(&streams->userdata[i*VERTEX_USER_DATA_COUNT], q->userdata, sizeof(q->userdata));
+				streams->flags[i] |= DRAW_QUAD_FLAG_HAS_USERDATA;
+			}
+		}
+		
+		streams->count = number_of_quads;
+		
+		// AoS quads can be changed until now, so their z's are only counted here
+		streams->z_layers = ZERO(Gfx_Pack_Z_Layers);
+		if (frame->enable_z_sorting) {
+			for (u64 i = 0; i < number_of_quads; i++) gfx_pack_z_layers_add(&streams->z_layers, streams->z[i]);
+		}
+	} else if (streams->has_atlas_images) {
+		draw_quad_streams_resolve_atlas_images(streams, 0, streams->count);
+		streams->has_atlas_images = false;
+	}
+	
+	Gfx_Pack_Input input = ZERO(Gfx_Pack_Input);
+	input.quad_count = streams->count;
+	input.positions  = streams->positions;
+	input.colors     = streams->colors;
+	input.uvs        = streams->uvs;
+	// #Volatile Gfx_Image starts like Gfx_Pack_Image
+	input.images     = (Gfx_Pack_Image *const *)streams->images;
+	input.flags      = streams->flags;
+	input.z          = streams->z;
+	input.scissors   = streams->scissors;
+	input.userdata   = streams->userdata;
+	
+	input.enable_z_sorting = frame->enable_z_sorting;
+	input.z_layers         = &streams->z_layers;
+	
+	input.window_width        = window.width;
+	input.window_height       = window.height;
+	input.window_pixel_height = window.pixel_height;
+	
+	return input;
+}
+
+// Recomputed only when projection or camera_xform changed since last time.
+// Comparing two matrices is a lot cheaper than m4_inverse.
+Matrix4 draw_frame_get_world_to_clip(Draw_Frame *frame) {
+	if (!frame->has_world_to_clip
+			|| memcmp(&frame->world_to_clip_projection, &frame->projection, sizeof(Matrix4)) != 0
+			|| memcmp(&frame->world_to_clip_camera_xform, &frame->camera_xform, sizeof(Matrix4)) != 0) {
+		frame->world_to_clip = m4_mul(frame->projection, m4_inverse(frame->camera_xform));
+		frame->world_to_clip_projection = frame->projection;
+		frame->world_to_clip_camera_xform = frame->camera_xform;
+		frame->has_world_to_clip = true;
+	}
+	return frame->world_to_clip;
+}
+
 void draw_frame_bind_image_to_shader(Draw_Frame *frame, Gfx_Image *image, int slot_index) {
 	if (slot_index >= MAX_BOUND_IMAGES) {
 		log_error("The highest bind image slot is %i, you tried to bind to %i", MAX_BOUND_IMAGES-1, slot_index);
@@ -262,23 +652,86 @@ ogb_instance Draw_Frame draw_frame;
 Draw_Frame draw_frame;
 #endif // NOT OOGABOOGA_LINK_EXTERNAL_INSTANCE
 
+// Quad corners are passed around as the x of bottom_left, top_left, top_right, bottom_right
+// followed by their y, so the simd helpers can do all four corners at once.
+
+// rows is the first two rows of a Matrix4. Same as m4_transform with z = 0 and w = 1.
+inline void draw_transform_corners(const float32 *rows, float32 *corners) {
+	float32 x[8], y[8], m0[8], m1[8], m3[8];
+	memcpy(x,   corners,   sizeof(float32)*4);
+	memcpy(x+4, corners,   sizeof(float32)*4);
+	memcpy(y,   corners+4, sizeof(float32)*4);
+	memcpy(y+4, corners+4, sizeof(float32)*4);
+	for (int i = 0; i < 4; i++) {
+		m0[i] = rows[0]; m0[i+4] = rows[4];
+		m1[i] = rows[1]; m1[i+4] = rows[5];
+		m3[i] = rows[3]; m3[i+4] = rows[7];
+	}
+	simd_mul_float32_256(m0, x, x);
+	simd_mul_float32_256(m1, y, y);
+	simd_add_float32_256(x, y, corners);
+	simd_add_float32_256(corners, m3, corners);
+}
+
+// Corners are in ndc. True if the quad is completely outside of the ndc box grown by extent_x
+// and extent_y from the center, which is 1, 1 for the visible area.
+inline bool draw_corners_are_outside(const float32 *corners, float32 extent_x, float32 extent_y) {
+	float32 min_x = corners[0], max_x = corners[0];
+	float32 min_y = corners[4], max_y = corners[4];
+	for (int i = 1; i < 4; i++) {
+		min_x = min(min_x, corners[i]);
+		max_x = max(max_x, corners[i]);
+		min_y = min(min_y, corners[i+4]);
+		max_y = max(max_y, corners[i+4]);
+	}
+	
+	return max_x < -extent_x || min_x > extent_x || max_y < -extent_y || min_y > extent_y;
+}
+
+// Corners are in ndc. Returns false if the quad is completely outside and should be culled,
+// otherwise the corners are snapped to pixels.
+inline bool draw_cull_and_snap_corners(float32 *corners) {
+	if (draw_corners_are_outside(corners, 1, 1)) return false;
+	
+	// This is meant to fix the annoying artifacts that shows up when sampling from a large atlas
+    // presumably for floating point precision issues or something.
+
+    // #Incomplete
+    // If we want to animate text with small movements then it will look wonky.
+    // This should be optional probably.
+
+	float32 pixel_width = 2.0/(float)window.width;
+	float32 pixel_height = 2.0/(float)window.height;
+	float32 pixel_size[8] = {
+		pixel_width,  pixel_width,  pixel_width,  pixel_width,
+		pixel_height, pixel_height, pixel_height, pixel_height,
+	};
+	simd_div_float32_256(corners, pixel_size, corners);
+	simd_round_float32_256(corners, corners);
+	simd_mul_float32_256(corners, pixel_size, corners);
+	
+	return true;
+}
+
 Draw_Quad _nil_quad = {0};
 Draw_Quad *draw_quad_projected_in_frame(Draw_Quad quad, Matrix4 world_to_clip, Draw_Frame *frame) {
-	quad.bottom_left  = m4_transform(world_to_clip, v4(v2_expand(quad.bottom_left), 0, 1)).xy;
-	quad.top_left     = m4_transform(world_to_clip, v4(v2_expand(quad.top_left), 0, 1)).xy;
-	quad.top_right    = m4_transform(world_to_clip, v4(v2_expand(quad.top_right), 0, 1)).xy;
-	quad.bottom_right = m4_transform(world_to_clip, v4(v2_expand(quad.bottom_right), 0, 1)).xy;
-	
-	bool should_cull = 
-	    (quad.bottom_left.x < -1 && quad.top_left.x < -1 && quad.top_right.x < -1 && quad.bottom_right.x < -1) ||
-	    (quad.bottom_left.x > 1 && quad.top_left.x > 1 && quad.top_right.x > 1 && quad.bottom_right.x > 1) ||
-	    (quad.bottom_left.y < -1 && quad.top_left.y < -1 && quad.top_right.y < -1 && quad.bottom_right.y < -1) ||
-	    (quad.bottom_left.y > 1 && quad.top_left.y > 1 && quad.top_right.y > 1 && quad.bottom_right.y > 1);
-
-	if (should_cull) {
+	float32 corners[8] = {
+		quad.bottom_left.x, quad.top_left.x, quad.top_right.x, quad.bottom_right.x,
+		quad.bottom_left.y, quad.top_left.y, quad.top_right.y, quad.bottom_right.y,
+	};
+	
+	draw_transform_corners(world_to_clip.data, corners);
+
+	// Draw lists are culled and snapped when they're submitted
+	if (!frame->is_draw_list && !draw_cull_and_snap_corners(corners)) {
 		return &_nil_quad;
 	}
 	
+	quad.bottom_left  = v2(corners[0], corners[4]);
+	quad.top_left     = v2(corners[1], corners[5]);
+	quad.top_right    = v2(corners[2], corners[6]);
+	quad.bottom_right = v2(corners[3], corners[7]);
+	
 	quad.image_min_filter = GFX_FILTER_MODE_NEAREST;
 	quad.image_mag_filter = GFX_FILTER_MODE_NEAREST;
 	
@@ -294,42 +747,27 @@ Draw_Quad *draw_quad_projected_in_frame(Draw_Quad quad, Matrix4 world_to_clip, D
 	
 	memset(quad.userdata, 0, sizeof(quad.userdata));
 	
-	Draw_Quad **target_buffer = &frame->quad_buffer;
-	
-	growing_array_add((void**)target_buffer, &quad);
-	
-	Draw_Quad *q = &(*target_buffer)[growing_array_get_valid_count(*target_buffer)-1];
-	
-	// This is meant to fix the annoying artifacts that shows up when sampling from a large atlas
-    // presumably for floating point precision issues or something.
-
-    // #Incomplete
-    // If we want to animate text with small movements then it will look wonky.
-    // This should be optional probably.
-
-	float pixel_width = 2.0/(float)window.width;
-	float pixel_height = 2.0/(float)window.height;
-	
-	q->bottom_left.x  = round(q->bottom_left.x  / pixel_width)  * pixel_width;
-    q->bottom_left.y  = round(q->bottom_left.y  / pixel_height) * pixel_height;
-    q->top_left.x     = round(q->top_left.x     / pixel_width)  * pixel_width;
-    q->top_left.y     = round(q->top_left.y     / pixel_height) * pixel_height;
-    q->top_right.x    = round(q->top_right.x    / pixel_width)  * pixel_width;
-    q->top_right.y    = round(q->top_right.y    / pixel_height) * pixel_height;
-    q->bottom_right.x = round(q->bottom_right.x / pixel_width)  * pixel_width;
-    q->bottom_right.y = round(q->bottom_right.y / pixel_height) * pixel_height;
-	
-	return q;
+	if (frame->quad_layout == DRAW_QUAD_LAYOUT_SOA) {
+		draw_frame_flush_pending_quad(frame);
+		
+		frame->pending_quad = quad;
+		frame->has_pending_quad = true;
+		
+		return &frame->pending_quad;
+	} else {
+		Draw_Quad **target_buffer = &frame->quad_buffer;
+		
+		growing_array_add((void**)target_buffer, &quad);
+		
+		return &(*target_buffer)[growing_array_get_valid_count(*target_buffer)-1];
+	}
 }
 Draw_Quad *draw_quad_in_frame(Draw_Quad quad, Draw_Frame *frame) {
-	return draw_quad_projected_in_frame(quad, m4_mul(frame->projection, m4_inverse(frame->camera_xform)), frame);
+	return draw_quad_projected_in_frame(quad, draw_frame_get_world_to_clip(frame), frame);
 }
 
 Draw_Quad *draw_quad_xform_in_frame(Draw_Quad quad, Matrix4 xform, Draw_Frame *frame) {
-	Matrix4 world_to_clip = m4_scalar(1.0);
-	world_to_clip         = m4_mul(world_to_clip, frame->projection);
-	world_to_clip         = m4_mul(world_to_clip, m4_inverse(frame->camera_xform));
-	world_to_clip         = m4_mul(world_to_clip, xform);
+	Matrix4 world_to_clip = m4_mul(draw_frame_get_world_to_clip(frame), xform);
 	return draw_quad_projected_in_frame(quad, world_to_clip, frame);
 }
 
@@ -412,6 +850,349 @@ Draw_Quad *draw_image_xform_in_frame(Gfx_Image *image, Matrix4 xform, Vector2 si
 	return q;
 }
 
+typedef struct Draw_Image_Xform {
+	Gfx_Image *image;
+	Matrix4 xform;
+	Vector2 size;
+	Vector4 color;
+} Draw_Image_Xform;
+
+// Does the same as draw_image_xform_in_frame for each item, but the camera matrix, z and scissor
+// are only looked up once and only the two rows of world_to_clip*xform that a 2D quad needs are
+// computed, with the simd helpers.
+u64 draw_images_xform_batch_in_frame(Draw_Image_Xform *items, u64 count, Draw_Frame *frame) {
+	Matrix4 world_to_clip = draw_frame_get_world_to_clip(frame);
+	
+	// Column k of the first two rows of world_to_clip, broadcast to multiply with row k of xform
+	float32 columns[4][8];
+	for (int k = 0; k < 4; k++) {
+		for (int i = 0; i < 4; i++) {
+			columns[k][i]   = world_to_clip.m[0][k];
+			columns[k][i+4] = world_to_clip.m[1][k];
+		}
+	}
+	
+	Draw_Quad quad = ZERO(Draw_Quad);
+	quad.type = QUAD_TYPE_REGULAR;
+	quad.uv = v4(0, 0, 1, 1);
+	quad.image_min_filter = GFX_FILTER_MODE_NEAREST;
+	quad.image_mag_filter = GFX_FILTER_MODE_NEAREST;
+	if (frame->z_count > 0)  quad.z = frame->z_stack[frame->z_count-1];
+	if (frame->scissor_count > 0) {
+		quad.scissor = frame->scissor_stack[frame->scissor_count-1];
+		quad.has_scissor = true;
+	}
+	
+	if (frame->quad_layout == DRAW_QUAD_LAYOUT_SOA) {
+		draw_frame_flush_pending_quad(frame);
+	}
+	
+	u64 drawn_count = 0;
+	for (u64 i = 0; i < count; i++) {
+		Draw_Image_Xform *item = &items[i];
+		
+		// Rows 0 and 1 of world_to_clip*xform, summed in the same order as m4_mul
+		float32 rows[8], row[8], product[8];
+		for (int k = 0; k < 4; k++) {
+			memcpy(row,   item->xform.m[k], sizeof(float32)*4);
+			memcpy(row+4, item->xform.m[k], sizeof(float32)*4);
+			if (k == 0) {
+				simd_mul_float32_256(columns[k], row, rows);
+			} else {
+				simd_mul_float32_256(columns[k], row, product);
+				simd_add_float32_256(rows, product, rows);
+			}
+		}
+		
+		// #Copypaste #Volatile corners of draw_rect_xform_in_frame
+		float32 corners[8] = {
+			0, 0,            item->size.x, item->size.x,
+			0, item->size.y, item->size.y, 0,
+		};
+		
+		draw_transform_corners(rows, corners);
+		
+		if (!frame->is_draw_list && !draw_cull_and_snap_corners(corners)) continue;
+		
+		quad.bottom_left  = v2(corners[0], corners[4]);
+		quad.top_left     = v2(corners[1], corners[5]);
+		quad.top_right    = v2(corners[2], corners[6]);
+		quad.bottom_right = v2(corners[3], corners[7]);
+		quad.image = item->image;
+		quad.color = item->color;
+		
+		if (frame->quad_layout == DRAW_QUAD_LAYOUT_SOA) {
+			draw_quad_streams_push(&frame->quad_streams, &quad);
+		} else {
+			growing_array_add((void**)&frame->quad_buffer, &quad);
+		}
+		
+		drawn_count += 1;
+	}
+	
+	return drawn_count;
+}
+
+///
+// Retained draw lists
+
+typedef struct Draw_List {
+	// Quads are recorded into this frame in world space, between draw_list_begin and draw_list_end
+	Draw_Frame record;
+	
+	// How far in pixels the camera can pan before the list is culled again. Quads within this
+	// distance of the view are kept in the cache.
+	float32 recull_margin;
+	
+	// Recorded quads that were within recull_margin of the view for cache_world_to_clip, and their
+	// corners in ndc, unsnapped, 8 floats per quad like draw_transform_corners.
+	u32 *visible_indices;
+	float32 *visible_corners;
+	u64 visible_count;
+	u64 visible_capacity;
+	Matrix4 cache_world_to_clip;
+	bool has_cache;
+	
+	u64 cull_count;
+} Draw_List;
+
+void draw_list_init(Draw_List *list) {
+	*list = ZERO(Draw_List);
+	
+	draw_frame_init(&list->record);
+	list->recull_margin = 128;
+}
+void draw_list_deinit(Draw_List *list) {
+	growing_array_deinit((void**)&list->record.quad_buffer);
+	draw_quad_streams_free(&list->record.quad_streams);
+	dealloc(get_heap_allocator(), list->visible_indices);
+	dealloc(get_heap_allocator(), list->visible_corners);
+	*list = ZERO(Draw_List);
+}
+
+// Clears the list and returns the frame to record into. Draw to it with the regular
+// draw_xxx_in_frame functions, in world space. camera_xform and projection of the returned
+// frame are identity, but z layers and scissors work like in any frame.
+Draw_Frame *draw_list_begin(Draw_List *list) {
+	Draw_Frame *record = &list->record;
+	draw_frame_reset(record);
+	record->quad_layout = DRAW_QUAD_LAYOUT_SOA;
+	record->projection = m4_scalar(1.0);
+	record->is_draw_list = true;
+	
+	list->has_cache = false;
+	
+	return record;
+}
+void draw_list_end(Draw_List *list) {
+	draw_frame_flush_pending_quad(&list->record);
+}
+
+void draw_list_cull(Draw_List *list, Matrix4 world_to_clip) {
+	Draw_Quad_Streams *streams = &list->record.quad_streams;
+	
+	if (streams->count > list->visible_capacity) {
+		Allocator heap = get_heap_allocator();
+		u64 old = list->visible_capacity;
+		list->visible_indices = reallocate(heap, list->visible_indices, old*sizeof(u32),       streams->count*sizeof(u32));
+		list->visible_corners = reallocate(heap, list->visible_corners, old*sizeof(float32)*8, streams->count*sizeof(float32)*8);
+		list->visible_capacity = streams->count;
+	}
+	
+	float32 extent_x = 1.0 + list->recull_margin*2.0/(float32)window.width;
+	float32 extent_y = 1.0 + list->recull_margin*2.0/(float32)window.height;
+	
+	u64 visible_count = 0;
+	for (u64 i = 0; i < streams->count; i++) {
+		const Vector2 *p = &streams->positions[i*4];
+		float32 *corners = &list->visible_corners[visible_count*8];
+		corners[0] = p[0].x; corners[1] = p[1].x; corners[2] = p[2].x; corners[3] = p[3].x;
+		corners[4] = p[0].y; corners[5] = p[1].y; corners[6] = p[2].y; corners[7] = p[3].y;
+		
+		draw_transform_corners(world_to_clip.data, corners);
+		
+		if (draw_corners_are_outside(corners, extent_x, extent_y)) continue;
+		
+		list->visible_indices[visible_count] = (u32)i;
+		visible_count += 1;
+	}
+	
+	list->visible_count = visible_count;
+	list->cache_world_to_clip = world_to_clip;
+	list->has_cache = true;
+	list->cull_count += 1;
+}
+
+// Draws the recorded quads with the camera of the frame. Returns the number of quads that
+// weren't culled.
+// As long as the camera only pans and stays within recull_margin pixels of where the list was
+// last culled, the cached ndc corners are just offset and snapped; nothing is transformed
+// or culled again and the recorded quads don't need to be rebuilt.
+// z and scissor are what they were when recorded.
+u64 draw_list_submit_in_frame(Draw_List *list, Draw_Frame *frame) {
+	assert(!frame->is_draw_list, "Draw lists can't be submitted to other draw lists");
+	
+	draw_list_end(list);
+	Draw_Quad_Streams *src = &list->record.quad_streams;
+	
+	Matrix4 world_to_clip = draw_frame_get_world_to_clip(frame);
+	Matrix4 cached = list->cache_world_to_clip;
+	
+	float32 offset_x = 0;
+	float32 offset_y = 0;
+	bool recull = !list->has_cache;
+	if (!recull) {
+		// Anything but a pan changes the shape of the quads in ndc
+		recull = world_to_clip.m[0][0] != cached.m[0][0] || world_to_clip.m[0][1] != cached.m[0][1]
+			  || world_to_clip.m[1][0] != cached.m[1][0] || world_to_clip.m[1][1] != cached.m[1][1];
+		
+		offset_x = world_to_clip.m[0][3] - cached.m[0][3];
+		offset_y = world_to_clip.m[1][3] - cached.m[1][3];
+		float32 pixels_x = fabs(offset_x)*(float32)window.width/2.0;
+		float32 pixels_y = fabs(offset_y)*(float32)window.height/2.0;
+		if (pixels_x > list->recull_margin || pixels_y > list->recull_margin) recull = true;
+	}
+	if (recull) {
+		draw_list_cull(list, world_to_clip);
+		offset_x = 0;
+		offset_y = 0;
+	}
+	
+	float32 offset[8] = {
+		offset_x, offset_x, offset_x, offset_x,
+		offset_y, offset_y, offset_y, offset_y,
+	};
+	
+	bool soa = frame->quad_layout == DRAW_QUAD_LAYOUT_SOA;
+	Draw_Quad_Streams *dst = &frame->quad_streams;
+	if (soa) {
+		draw_frame_flush_pending_quad(frame);
+		draw_quad_streams_reserve(dst, dst->count + list->visible_count);
+		if (src->has_atlas_images) dst->has_atlas_images = true;
+		if (src->userdata && !dst->userdata) {
+			// #Memory #Heapalloc
+			dst->userdata = alloc(get_heap_allocator(), dst->capacity*sizeof(Vector4)*VERTEX_USER_DATA_COUNT);
+		}
+	} else {
+		growing_array_reserve((void**)&frame->quad_buffer, growing_array_get_valid_count(frame->quad_buffer) + list->visible_count);
+	}
+	
+	u64 drawn_count = 0;
+	for (u64 v = 0; v < list->visible_count; v++) {
+		float32 corners[8];
+		simd_add_float32_256(&list->visible_corners[v*8], offset, corners);
+		
+		if (!draw_cull_and_snap_corners(corners)) continue;
+		
+		u32 i = list->visible_indices[v];
+		Vector2 positions[4] = {
+			v2(corners[0], corners[4]),
+			v2(corners[1], corners[5]),
+			v2(corners[2], corners[6]),
+			v2(corners[3], corners[7]),
+		};
+		
+		if (soa) {
+			// Already in stream form, so copy instead of going through a Draw_Quad
+			u64 n = dst->count;
+			u32 flags = src->flags[i];
+			memcpy(&dst->positions[n*4], positions, sizeof(positions));
+			dst->colors[n] = src->colors[i];
+			dst->images[n] = src->images[i];
+			dst->z[n]      = src->z[i];
+			dst->flags[n]  = flags;
+			gfx_pack_z_layers_add(&dst->z_layers, src->z[i]);
+			if (src->images[i]) dst->uvs[n] = src->uvs[i];
+			if (flags & DRAW_QUAD_FLAG_HAS_SCISSOR) dst->scissors[n] = src->scissors[i];
+			if (flags & DRAW_QUAD_FLAG_HAS_USERDATA) {
+				memcpy(&dst->userdata[n*VERTEX_USER_DATA_COUNT], &src->userdata[i*VERTEX_USER_DATA_COUNT], sizeof(Vector4)*VERTEX_USER_DATA_COUNT);
+			}
+			dst->count += 1;
+		} else {
+			Draw_Quad quad;
+			draw_quad_streams_read(src, i, &quad);
+			memcpy(&quad.bottom_left, positions, sizeof(positions));
+			growing_array_add((void**)&frame->quad_buffer, &quad);
+		}
+		
+		drawn_count += 1;
+	}
+	
+	return drawn_count;
+}
+
+///
+// Tilemaps, see tilemap.c
+
+// Draws the tiles of the chunks that the camera of the frame can see, with the current z layer
+// and scissor of the frame. Returns the number of tiles that weren't culled.
+u64 draw_tilemap_in_frame(Tilemap *map, Draw_Frame *frame) {
+	Matrix4 world_to_clip = draw_frame_get_world_to_clip(frame);
+	
+	// The world space box that the camera sees
+	Matrix4 clip_to_world = m4_inverse(world_to_clip);
+	Vector2 view_min = v2(INFINITY, INFINITY);
+	Vector2 view_max = v2(-INFINITY, -INFINITY);
+	for (int i = 0; i < 4; i++) {
+		Vector4 p = m4_transform(clip_to_world, v4(i % 2 ? 1 : -1, i / 2 ? 1 : -1, 0, 1));
+		view_min = v2(min(view_min.x, p.x), min(view_min.y, p.y));
+		view_max = v2(max(view_max.x, p.x), max(view_max.y, p.y));
+	}
+	
+	u64 chunk_count = tilemap_update_visible_chunks(map, view_min, view_max);
+	
+	// #Copypaste #Volatile draw_images_xform_batch_in_frame
+	Draw_Quad quad = ZERO(Draw_Quad);
+	quad.type = QUAD_TYPE_REGULAR;
+	quad.image_min_filter = GFX_FILTER_MODE_NEAREST;
+	quad.image_mag_filter = GFX_FILTER_MODE_NEAREST;
+	if (frame->z_count > 0)  quad.z = frame->z_stack[frame->z_count-1];
+	if (frame->scissor_count > 0) {
+		quad.scissor = frame->scissor_stack[frame->scissor_count-1];
+		quad.has_scissor = true;
+	}
+	
+	if (frame->quad_layout == DRAW_QUAD_LAYOUT_SOA) {
+		draw_frame_flush_pending_quad(frame);
+	}
+	
+	u64 drawn_count = 0;
+	for (u64 c = 0; c < chunk_count; c++) {
+		Tilemap_Visible_Chunk *visible = &map->visible_chunks[c];
+		Tilemap_Chunk *chunk = &map->chunks[visible->chunk_index];
+		
+		for (u32 i = visible->first_quad; i < visible->end_quad; i++) {
+			const Vector2 *p = &chunk->positions[i*4];
+			float32 corners[8] = {
+				p[0].x, p[1].x, p[2].x, p[3].x,
+				p[0].y, p[1].y, p[2].y, p[3].y,
+			};
+			
+			draw_transform_corners(world_to_clip.data, corners);
+			
+			if (!frame->is_draw_list && !draw_cull_and_snap_corners(corners)) continue;
+			
+			quad.bottom_left  = v2(corners[0], corners[4]);
+			quad.top_left     = v2(corners[1], corners[5]);
+			quad.top_right    = v2(corners[2], corners[6]);
+			quad.bottom_right = v2(corners[3], corners[7]);
+			quad.color = chunk->colors[i];
+			quad.image = chunk->images[i];
+			quad.uv    = chunk->uvs[i];
+			
+			if (frame->quad_layout == DRAW_QUAD_LAYOUT_SOA) {
+				draw_quad_streams_push(&frame->quad_streams, &quad);
+			} else {
+				growing_array_add((void**)&frame->quad_buffer, &quad);
+			}
+			
+			drawn_count += 1;
+		}
+	}
+	
+	return drawn_count;
+}
+
 typedef struct {
 	Gfx_Font *font;
 	string text;
@@ -427,13 +1208,16 @@ bool draw_text_callback(Gfx_Glyph glyph, Gfx_Font_Atlas *atlas, float glyph_x, f
 
 	Draw_Text_Callback_Params *params = (Draw_Text_Callback_Params*)ud;
 	
+	// Nothing to draw for glyphs like space
+	if (!atlas) return true;
+	
 	Vector2 size = v2(glyph.width*params->scale.x, glyph.height*params->scale.y);
 	
 	Matrix4 glyph_xform = m4_translate(params->xform, v3(glyph_x, glyph_y, 0));
 	
 	Draw_Quad *q = draw_image_xform_in_frame(atlas->image, glyph_xform, size, params->color, params->frame);
 	q->uv = glyph.uv;
-	q->type = QUAD_TYPE_TEXT;
+	q->type = params->font->sdf_reference_height ? QUAD_TYPE_TEXT_SDF : QUAD_TYPE_TEXT;
 	q->image_min_filter = GFX_FILTER_MODE_LINEAR;
 	q->image_mag_filter = GFX_FILTER_MODE_LINEAR;
 	
@@ -451,7 +1235,15 @@ void draw_text_xform_in_frame(Gfx_Font *font, string text, u32 raster_height, Ma
 	p.color = color;
 	p.frame = frame;
 	
-	walk_glyphs((Walk_Glyphs_Spec){font, text, raster_height, scale, true, &p}, draw_text_callback);
+	Text_Layout *layout = get_text_layout(font, text, raster_height, scale);
+	if (layout) {
+		for (u64 i = 0; i < layout->glyph_count; i++) {
+			Text_Layout_Glyph *g = &layout->glyphs[i];
+			draw_text_callback(g->glyph, &font->atlases[g->glyph.atlas_index], g->x, g->y, &p);
+		}
+	} else {
+		walk_glyphs((Walk_Glyphs_Spec){font, text, raster_height, scale, true, &p, 0}, draw_text_callback);
+	}
 }
 void draw_text_in_frame(Gfx_Font *font, string text, u32 raster_height, Vector2 position, Vector2 scale, Vector4 color, Draw_Frame *frame) {
 	Matrix4 xform = m4_scalar(1.0);
@@ -562,6 +1354,17 @@ void draw_line(Vector2 p0, Vector2 p1, float line_width, Vector4 color) {
 	draw_line_in_frame(p0, p1, line_width, color, &draw_frame);
 }
 
+inline
+u64 draw_images_xform_batch(Draw_Image_Xform *items, u64 count) {
+	return draw_images_xform_batch_in_frame(items, count, &draw_frame);
+}
+u64 draw_list_submit(Draw_List *list) {
+	return draw_list_submit_in_frame(list, &draw_frame);
+}
+u64 draw_tilemap(Tilemap *map) {
+	return draw_tilemap_in_frame(map, &draw_frame);
+}
+
 inline
 void push_z_layer(s32 z) { push_z_layer_in_frame(z, &draw_frame); }
 inline
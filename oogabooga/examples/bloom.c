@@ -63,9 +63,8 @@ int not_entry(int argc, char **argv) {
 	// postprocess shader where the bloom happens. It samples from the generated bloom_map.
 	Gfx_Shader_Extension postprocess_bloom_shader = load_shader(STR("oogabooga/examples/bloom.hlsl"), sizeof(Scene_Cbuffer));
 	
-	Gfx_Image *bloom_map = 0;
-	Gfx_Image *game_image = 0;
-	Gfx_Image *final_image = 0;
+	// Hands out the render targets each frame and deletes the ones of old window sizes
+	Render_Target_Pool *target_pool = make_render_target_pool(2, get_heap_allocator());
 	
 	View_Mode view = VIEW_GAME_AFTER_POSTPROCESS;
 	
@@ -83,18 +82,14 @@ int not_entry(int argc, char **argv) {
 		
 		
 		///
-		// Create bloom map and game image when window size changes (or first time)
-		local_persist Os_Window last_window;
-		if ((last_window.width != window.width || last_window.height != window.height || !game_image) && window.width > 0 && window.height > 0) {
-			if (bloom_map)   delete_image(bloom_map);
-			if (game_image)  delete_image(game_image);
-			if (final_image) delete_image(final_image);
-			
-			bloom_map  = make_image_render_target(window.width, window.height, 4, 0, get_heap_allocator());
-			game_image = make_image_render_target(window.width, window.height, 4, 0, get_heap_allocator());
-			final_image = make_image_render_target(window.width, window.height, 4, 0, get_heap_allocator());
-		}
-		last_window = window;
+		// Get the bloom map and game images for this frame. They're recycled at the end of the frame,
+		// and the ones of the old size are deleted a couple frames after the window resizes.
+		// Window size is 0 when minimized.
+		u32 target_width  = max(window.width, 1);
+		u32 target_height = max(window.height, 1);
+		Gfx_Image *bloom_map   = render_target_pool_get(target_pool, target_width, target_height, 4);
+		Gfx_Image *game_image  = render_target_pool_get(target_pool, target_width, target_height, 4);
+		Gfx_Image *final_image = render_target_pool_get(target_pool, target_width, target_height, 4);
 		
 		// Set stuff in cbuffer which we need to pass to shaders
 		scene_cbuffer.mouse_pos_screen = v2(input_frame.mouse_x, window.height-input_frame.mouse_y);
@@ -182,6 +177,9 @@ int not_entry(int argc, char **argv) {
 		
 		os_update(); 
 		gfx_update();
+		
+		// final_image was drawn to the window in gfx_update, so only now are the targets free
+		render_target_pool_end_frame(target_pool);
 	}
 
 	return 0;
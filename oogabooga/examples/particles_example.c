@@ -30,8 +30,8 @@ int entry(int argc, char **argv) {
 	growing_array_init((void**)&emission_stack, sizeof(Emission_Handle), get_heap_allocator());
 	
 	// Particles spawn in contiguously meaning vbo will initially grow a little bit at a time
-	// as we start drawing more quads, so let's just reserve a lot of bytes now instead.
-	gfx_reserve_vbo_bytes(MB(16));
+	// as we start drawing more quads, so let's just reserve a lot of quads now instead.
+	gfx_reserve_quad_instances(50000);
 	
 	float64 last_time = os_get_elapsed_seconds();
 	while (!window.should_close) {
@@ -31,9 +31,9 @@ int entry(int argc, char **argv) {
 	Gfx_Font *font = load_font_from_disk(STR("C:/windows/fonts/arial.ttf"), get_heap_allocator());
 	assert(font, "Failed loading arial.ttf, %d", GetLastError());
 	
-	// This makes sure atlas is rendered for ascii.
-	// You might want to do this if your game lags the first time you render text because it renders
-	// the atlas on the fly.
+	// This makes sure glyphs are rasterized for ascii.
+	// You might want to do this if your game lags the first time you render text because glyphs
+	// are rasterized on the fly.
 	render_atlas_if_not_yet_rendered(font, 32, 'A'); 
 	
 	seed_for_random = rdtsc();
@@ -79,6 +79,16 @@ int entry(int argc, char **argv) {
 		camera_xform = m4_translate(camera_xform, v3(v2_expand(cam_move), 0));
 		draw_frame.camera_xform = camera_xform;
 
+		// Toggle between fat Draw_Quad's and structure-of-arrays quad storage
+		if (is_key_just_released('L')) {
+			if (draw_frame.quad_layout == DRAW_QUAD_LAYOUT_AOS) {
+				draw_frame_set_quad_layout(&draw_frame, DRAW_QUAD_LAYOUT_SOA);
+			} else {
+				draw_frame_set_quad_layout(&draw_frame, DRAW_QUAD_LAYOUT_AOS);
+			}
+		}
+		draw_frame.enable_z_sorting = is_key_down('Z');
+
 		seed_for_random = 69;
 		for (u64 i = 0; i < 150000; i++) {
 			float32 aspect = (float32)window.width/(float32)window.height;
@@ -96,6 +106,15 @@ int entry(int argc, char **argv) {
 		if (is_key_just_released('E')) {
 			log("FPS: %.2f", 1.0 / delta);
 			log("ms: %.2f", delta*1000.0);
+			log("Quad layout: %cs", draw_frame.quad_layout == DRAW_QUAD_LAYOUT_SOA ? "SoA" : "AoS");
+			
+			Gfx_Quad_Upload_Stats stats = gfx_get_quad_upload_stats();
+			log("Last frame uploaded %llu quads in %llu draw calls: %.2f MB, would be %.2f MB as 4 vertices per quad (%.1fx)", 
+				stats.quad_count, 
+				stats.draw_call_count, 
+				(float64)stats.bytes/(1024.0*1024.0), 
+				(float64)stats.vertex_bytes/(1024.0*1024.0), 
+				stats.bytes ? (float64)stats.vertex_bytes/(float64)stats.bytes : 0.0);
 		}
 		
 		gfx_update();
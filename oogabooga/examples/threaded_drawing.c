@@ -17,9 +17,9 @@
 	If your computer has at lest 5-6 logical processors, that seems to split the time it takes to draw in
 	about 1/3 (at least on my computer).
 	
-	Unfortunately, since the backend is using d3d11, the copying of vertices to gpu is very slow and can't
-	really be mutlithreaded so that's really where the bottleneck is in this case. But offloading the Draw_Frame
-	computations to separate threads definitely proved non-trivial.
+	Turning the quads into gpu instances (gfx_pack.c) is split over the parallel_for workers for big frames,
+	so what's left on the main thread is mostly waiting for that and the draw calls.
+	But offloading the Draw_Frame computations to separate threads definitely proved non-trivial.
 	
 */
 
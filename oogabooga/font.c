@@ -16,14 +16,81 @@
 		...
 	}
 
+	Glyphs are rasterized the first time they're used, and packed into atlas pages that all
+	heights of a font share. The pixels are kept on the CPU too, and what was added since last
+	time is uploaded once when a draw frame is rendered (one gfx_set_image_data per changed
+	page). get_font_atlas_stats tells how full the pages are.
+
+	SDF fonts:
+	
+	Gfx_Font *font = load_font_from_disk(STR("C:/windows/fonts/arial.ttf"), get_heap_allocator());
+	font_enable_sdf(font, FONT_SDF_DEFAULT_REFERENCE_HEIGHT);
+	
+	Glyphs of an SDF font are rasterized once as signed distance fields at the reference height,
+	and any raster_height is drawn from those by scaling them, so text at many sizes or text
+	that's being zoomed doesn't rasterize anything new. The edges are sharp when scaled up, but
+	small text looks a bit softer than a normally rasterized font.
+	
+	render_atlas_if_not_yet_rendered and font_rasterize_glyphs make the glyphs on
+	parallel_for threads.
+
+	Background baking:
+	
+	font_enable_background_baking(font);
+	
+	New glyphs are rasterized on the font baker thread instead of when they're first drawn.
+	Until a glyph is done, text is laid out as if it was there but the glyph is not drawn.
+	
+	Baked fonts:
+	
+	// When making the build, after the glyphs the game uses are rasterized
+	save_baked_font(font, STR("res/fonts/arial.ogbfont"));
+	
+	// In the game
+	Gfx_Font *font = load_font_from_disk(STR("res/fonts/arial.ogbfont"), get_heap_allocator());
+	
+	A baked font file has the font file, the atlas pages and the glyphs at every height that was
+	rasterized. load_font_from_disk knows it from its header and loads the pages as they are, so
+	none of those glyphs are rasterized again. Glyphs that are not in the file are rasterized
+	like in any other font.
+
+	Text layouts:
+	
+	draw_text and measure_text keep the glyphs & positions they walk in text_layout_cache,
+	keyed by font, raster height, scale and text. Drawing or measuring the same text again,
+	like the same label every frame, then skips walk_glyphs and goes straight to the quads.
+	The least recently used layout is thrown out when the cache is full, and layouts of a font
+	are thrown out when it's destroyed. Text longer than TEXT_LAYOUT_MAX_CACHED_LENGTH bytes is
+	not cached.
+
 */
 
-// #Memory #Speed
-// This is terruble  and huge waste of video memory. We should have a constant codepoint range
-// with arbitrary atlas sizes instead.
-#define FONT_ATLAS_WIDTH  2048
-#define FONT_ATLAS_HEIGHT 2048
+// Glyphs of all heights of a font go in pages of this size
+#define FONT_ATLAS_WIDTH  1024
+#define FONT_ATLAS_HEIGHT 1024
+// Empty pixels around each glyph so linear filtering doesn't pick up the neighbours
+#define FONT_GLYPH_PADDING 1
 #define MAX_FONT_HEIGHT 512
+// Codepoints below this are looked up in an array instead of the hash table
+#define FONT_DIRECT_GLYPH_COUNT 256
+
+// #Volatile bump when the baked font file layout changes, see save_baked_font
+#define BAKED_FONT_VERSION 1
+#define BAKED_FONT_MAGIC 0x46424F4F // "OOBF"
+
+// Marks pairs in Gfx_Font.latin_kerning that aren't looked up yet
+#define FONT_KERNING_UNKNOWN ((s16)-32768)
+
+#define TEXT_LAYOUT_CACHE_CAPACITY 512
+#define TEXT_LAYOUT_MAX_CACHED_LENGTH 1024
+
+#define FONT_SDF_DEFAULT_REFERENCE_HEIGHT 48
+// Texels of distance field outside of each glyph's outline
+#define FONT_SDF_PADDING 4
+// #Volatile the outline is at 128/255 in the 2D batch shader and the software renderer
+#define FONT_SDF_ON_EDGE 128
+// Distance field value change per texel
+#define FONT_SDF_DISTANCE_PER_TEXEL ((float32)FONT_SDF_ON_EDGE/(float32)FONT_SDF_PADDING)
 
 typedef struct Gfx_Font Gfx_Font;
 typedef struct Gfx_Text_Metrics {
@@ -93,28 +160,151 @@ typedef struct Gfx_Glyph {
 	float advance;
 	float width, height;
 	Vector4 uv;
+	// Index into Gfx_Font.atlases. Glyphs without pixels (like space) aren't in any atlas.
+	u32 atlas_index;
+	bool has_pixels;
+	// Being rasterized in the background, see font_enable_background_baking. Metrics are
+	// right but there are no pixels to draw yet.
+	bool is_pending;
 } Gfx_Glyph;
+// One page of glyphs
 typedef struct Gfx_Font_Atlas {
 	Gfx_Image *image;
-	u32 first_codepoint;
-	Gfx_Glyph *glyphs; // first_codepoint + index == the codepoint
+	// CPU copy of the page, 1 byte per pixel, which the dirty rectangle is uploaded from
+	u8 *pixels;
+	Rect_Packer packer;
+	// Pixels written since the last upload. Clean if dirty_x1 == dirty_x2.
+	u32 dirty_x1, dirty_y1, dirty_x2, dirty_y2;
+	u32 glyph_count;
+	// Taken by glyphs, padding included
+	u64 used_pixels;
 } Gfx_Font_Atlas;
 typedef struct Gfx_Font_Variation {
 	Gfx_Font *font;
 	u32 height;
 	Gfx_Font_Metrics metrics;
 	float scale;
-	u32 codepoint_range_per_atlas;
-	Hash_Table atlases; // u32 atlas_index, Gfx_Font_Atlas
+	// Rasterized glyphs. Codepoints below FONT_DIRECT_GLYPH_COUNT are in direct_glyphs, the
+	// rest in the hash table.
+	Gfx_Glyph *direct_glyphs;
+	u64 direct_glyph_mask[FONT_DIRECT_GLYPH_COUNT/64];
+	Hash_Table glyphs; // u32 codepoint, Gfx_Glyph
 	bool initted;
 } Gfx_Font_Variation;
 typedef struct Gfx_Font {
 	stbtt_fontinfo stbtt_handle;
 	string raw_font_data;
 	Gfx_Font_Variation variations[MAX_FONT_HEIGHT]; // Variation per font height
+	Gfx_Font_Atlas *atlases; // Growing array, shared by all variations
+	// Height SDF glyphs are rasterized at, 0 if the font is not SDF. See font_enable_sdf.
+	u32 sdf_reference_height;
+	// Kerning in font units, filled in as pairs are used, see font_get_kerning.
+	// Pairs of codepoints below FONT_DIRECT_GLYPH_COUNT are in the dense table.
+	bool has_kerning;
+	s16 *latin_kerning; // [first*FONT_DIRECT_GLYPH_COUNT + second]
+	Hash_Table kerning; // u64 (first << 32 | second), s16
+	// Glyphs are rasterized on the font baker thread, see font_enable_background_baking
+	bool bake_in_background;
+	bool has_dirty_atlases;
+	u64 upload_count;
+	u64 uploaded_pixels;
 	Allocator allocator;
 } Gfx_Font;
 
+typedef struct Gfx_Font_Atlas_Stats {
+	u64 atlas_count;
+	u64 glyph_count;
+	// Pixels taken by glyphs (padding included) and pixels in all atlases
+	u64 used_pixels;
+	u64 total_pixels;
+	float32 occupancy;
+	// gfx_set_image_data calls for glyphs so far, and how many pixels they uploaded
+	u64 upload_count;
+	u64 uploaded_pixels;
+} Gfx_Font_Atlas_Stats;
+
+// A glyph with pixels, where walk_glyphs put it
+typedef struct Text_Layout_Glyph {
+	Gfx_Glyph glyph;
+	float32 x, y;
+} Text_Layout_Glyph;
+typedef struct Text_Layout {
+	u64 key;
+	Gfx_Font *font;
+	u32 raster_height;
+	Vector2 scale;
+	string text; // Copy, in the same allocation as the layout
+	
+	Text_Layout_Glyph *glyphs;
+	u64 glyph_count;
+	Gfx_Text_Metrics metrics;
+	// Glyphs that were being baked in the background are missing, so it's made again next time
+	bool has_pending_glyphs;
+	
+	// Least recently used list
+	struct Text_Layout *prev;
+	struct Text_Layout *next;
+} Text_Layout;
+typedef struct Text_Layout_Cache {
+	Hash_Table layouts; // u64 key, Text_Layout*
+	Text_Layout *most_recent;
+	Text_Layout *least_recent;
+	u64 count;
+	bool initted;
+	
+	u64 hit_count;
+	u64 miss_count;
+	u64 eviction_count;
+} Text_Layout_Cache;
+
+// A glyph rasterized but not yet in an atlas
+typedef struct Font_Glyph_Bitmap {
+	u32 codepoint;
+	Gfx_Glyph glyph;
+	// Top-down, allocated with allocator. Null for glyphs without pixels.
+	u8 *pixels;
+	u32 width, height;
+} Font_Glyph_Bitmap;
+typedef struct Font_Bake_Request {
+	Gfx_Font *font;
+	Gfx_Font_Variation *variation;
+	u32 codepoint;
+} Font_Bake_Request;
+typedef struct Font_Bake_Result {
+	Gfx_Font *font;
+	Gfx_Font_Variation *variation;
+	Font_Glyph_Bitmap bitmap;
+} Font_Bake_Result;
+// One thread rasterizing glyphs for fonts with bake_in_background
+typedef struct Font_Baker {
+	Thread thread;
+	Binary_Semaphore wake;
+	Mutex mutex;
+	// Growing arrays, under mutex
+	Font_Bake_Request *requests;
+	Font_Bake_Result *results;
+	// Font of the glyph the thread is on right now, under mutex
+	Gfx_Font *baking_font;
+	bool initted;
+} Font_Baker;
+
+// Fonts with glyphs that are not uploaded yet, see font_upload_dirty_atlases
+ogb_instance Gfx_Font **fonts_with_dirty_atlases;
+ogb_instance Text_Layout_Cache text_layout_cache;
+ogb_instance Font_Baker font_baker;
+
+#if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
+// #Global
+Gfx_Font **fonts_with_dirty_atlases = 0;
+Text_Layout_Cache text_layout_cache = ZERO(Text_Layout_Cache);
+Font_Baker font_baker = ZERO(Font_Baker);
+#endif // NOT OOGABOOGA_LINK_EXTERNAL_INSTANCE
+
+void text_layout_cache_remove_font(Gfx_Font *font);
+void font_baker_cancel_font(Gfx_Font *font);
+void font_baker_push(Gfx_Font *font, Gfx_Font_Variation *variation, u32 codepoint);
+Gfx_Font *load_baked_font(string file, Allocator allocator);
+
 Gfx_Font *load_font_from_disk(string path, Allocator allocator) {
 	
 	string font_data;
@@ -122,6 +312,10 @@ Gfx_Font *load_font_from_disk(string path, Allocator allocator) {
 	
 	if (!read_ok) return 0;
 	
+	if (font_data.count >= sizeof(u32) && *(u32*)font_data.data == BAKED_FONT_MAGIC) {
+		return load_baked_font(font_data, allocator);
+	}
+	
 	third_party_allocator = allocator;
 	
 	stbtt_fontinfo stbtt_handle;
@@ -134,6 +328,10 @@ Gfx_Font *load_font_from_disk(string path, Allocator allocator) {
 	font->stbtt_handle = stbtt_handle;
 	font->raw_font_data = font_data;
 	font->allocator = allocator;
+	growing_array_init((void**)&font->atlases, sizeof(Gfx_Font_Atlas), allocator);
+	
+	// stbtt_GetGlyphKernAdvance uses GPOS if it's there, else kern
+	font->has_kerning = stbtt_handle.kern != 0 || stbtt_handle.gpos != 0;
 	
 	third_party_allocator = ZERO(Allocator);
 	
@@ -141,20 +339,34 @@ Gfx_Font *load_font_from_disk(string path, Allocator allocator) {
 }
 void destroy_font(Gfx_Font *font) {
 
+	font_baker_cancel_font(font);
+
 	third_party_allocator = font->allocator;
 
 	for (u64 i = 0; i < MAX_FONT_HEIGHT; i++) {
 		Gfx_Font_Variation *variation = &font->variations[i];
 		if (!variation->initted) continue;
 		
-		for (u64 j = 0; j < variation->atlases.count; j++) {
-			Gfx_Font_Atlas *atlas = (Gfx_Font_Atlas*)hash_table_get_nth_value(&variation->atlases, j);
-			delete_image(atlas->image);
-			dealloc(font->allocator, atlas->glyphs);
-		}
-		
-		hash_table_destroy(&variation->atlases);
-		
+		dealloc(font->allocator, variation->direct_glyphs);
+		hash_table_destroy(&variation->glyphs);
+	}
+	
+	for (u64 i = 0; i < growing_array_get_valid_count(font->atlases); i++) {
+		Gfx_Font_Atlas *atlas = &font->atlases[i];
+		delete_image(atlas->image);
+		dealloc(font->allocator, atlas->pixels);
+		rect_packer_deinit(&atlas->packer);
+	}
+	growing_array_deinit((void**)&font->atlases);
+	
+	if (font->has_dirty_atlases) {
+		growing_array_unordered_remove_one_by_value((void**)&fonts_with_dirty_atlases, &font);
+	}
+	text_layout_cache_remove_font(font);
+	
+	if (font->latin_kerning) {
+		dealloc(font->allocator, font->latin_kerning);
+		hash_table_destroy(&font->kerning);
 	}
 
 	dealloc_string(font->allocator, font->raw_font_data);
@@ -168,12 +380,9 @@ void font_variation_init(Gfx_Font_Variation *variation, Gfx_Font *font, u32 font
 	variation->font = font;
 	variation->height = font_height;
 	
-	u32 x_range = FONT_ATLAS_WIDTH / font_height;
-	u32 y_range = FONT_ATLAS_HEIGHT / font_height;
-	
-	variation->codepoint_range_per_atlas = x_range*y_range;
-	
-	variation->atlases = make_hash_table(u32, Gfx_Font_Atlas, font->allocator);
+	variation->direct_glyphs = alloc(font->allocator, FONT_DIRECT_GLYPH_COUNT*sizeof(Gfx_Glyph));
+	memset(variation->direct_glyph_mask, 0, sizeof(variation->direct_glyph_mask));
+	variation->glyphs = make_hash_table(u32, Gfx_Glyph, font->allocator);
 	
 	variation->scale = stbtt_ScaleForPixelHeight(&font->stbtt_handle, (float)font_height);
 	
@@ -213,77 +422,707 @@ void font_variation_init(Gfx_Font_Variation *variation, Gfx_Font *font, u32 font
 	variation->initted = true;
 }
 
-void font_atlas_init(Gfx_Font_Atlas *atlas, Gfx_Font_Variation *variation, u32 first_codepoint) {
-	stbtt_fontinfo stbtt_handle = variation->font->stbtt_handle;
-	atlas->first_codepoint = first_codepoint;
+Gfx_Font_Atlas *font_push_atlas(Gfx_Font *font) {
+	Gfx_Font_Atlas *atlas = growing_array_add_empty((void**)&font->atlases);
+	*atlas = ZERO(Gfx_Font_Atlas);
 	
-	atlas->image = make_image(FONT_ATLAS_WIDTH, FONT_ATLAS_HEIGHT, 1, 0, variation->font->allocator);
-	atlas->glyphs = alloc(variation->font->allocator, variation->codepoint_range_per_atlas*sizeof(Gfx_Glyph));
+	// #Memory
+	atlas->pixels = alloc(font->allocator, FONT_ATLAS_WIDTH*FONT_ATLAS_HEIGHT);
+	memset(atlas->pixels, 0, FONT_ATLAS_WIDTH*FONT_ATLAS_HEIGHT);
+	atlas->image = make_image(FONT_ATLAS_WIDTH, FONT_ATLAS_HEIGHT, 1, atlas->pixels, font->allocator);
+	rect_packer_init(&atlas->packer, FONT_ATLAS_WIDTH, FONT_ATLAS_HEIGHT, font->allocator);
 	
-	u32 cursor_x = 0;
-	u32 cursor_y = 0;
+	log_verbose("Font atlas %d created", growing_array_get_valid_count(font->atlases)-1);
 	
-	third_party_allocator = variation->font->allocator;
-	// Used for flipping bitmaps
-	u8 *temp_row = (u8 *)talloc(variation->height);
-	for (u32 c = first_codepoint; c < first_codepoint + variation->codepoint_range_per_atlas; c++) {
-		u32 i = c-first_codepoint;
-		Gfx_Glyph *glyph = &atlas->glyphs[i];
-		glyph->codepoint = c;
-		
-		int w, h, x, y;
-		void *bitmap = stbtt_GetCodepointBitmap(&stbtt_handle, variation->scale, variation->scale, (int)c, &w, &h, &x, &y);
+	return atlas;
+}
+
+// Finds room for a w*h glyph in one of the atlases, or a new one. x and y are where the glyph
+// goes, padding not included.
+u32 font_pack_glyph(Gfx_Font *font, u32 w, u32 h, u32 *x, u32 *y) {
+	u32 padded_w = w + FONT_GLYPH_PADDING*2;
+	u32 padded_h = h + FONT_GLYPH_PADDING*2;
+	
+	u32 atlas_count = growing_array_get_valid_count(font->atlases);
+	for (u32 i = 0; i < atlas_count; i++) {
+		if (rect_packer_insert(&font->atlases[i].packer, padded_w, padded_h, x, y)) {
+			*x += FONT_GLYPH_PADDING;
+			*y += FONT_GLYPH_PADDING;
+			font->atlases[i].used_pixels += (u64)padded_w*padded_h;
+			return i;
+		}
+	}
+	
+	Gfx_Font_Atlas *atlas = font_push_atlas(font);
+	bool ok = rect_packer_insert(&atlas->packer, padded_w, padded_h, x, y);
+	assert(ok, "Glyph of %dx%d does not fit in a font atlas", w, h);
+	*x += FONT_GLYPH_PADDING;
+	*y += FONT_GLYPH_PADDING;
+	atlas->used_pixels += (u64)padded_w*padded_h;
+	return atlas_count;
+}
+
+
+// Everything but the pixels, which is cheap
+Gfx_Glyph font_make_glyph_metrics(Gfx_Font_Variation *variation, u32 codepoint) {
+	Gfx_Font *font = variation->font;
+	stbtt_fontinfo *stbtt_handle = &font->stbtt_handle;
+	
+	Gfx_Glyph glyph = ZERO(Gfx_Glyph);
+	glyph.codepoint = codepoint;
+	
+	int advance, left_side_bearing;
+	stbtt_GetCodepointHMetrics(stbtt_handle, codepoint, &advance, &left_side_bearing);
+	glyph.advance = (float)advance*variation->scale;
+	
+	int x0, y0, x1, y1;
+	stbtt_GetCodepointBitmapBox(stbtt_handle, (int)codepoint, variation->scale, variation->scale, &x0, &y0, &x1, &y1);
+	if (x1 <= x0 || y1 <= y0) {
+		x0 = y0 = x1 = y1 = 0;
+	} else if (font->sdf_reference_height) {
+		// Like stbtt_GetCodepointSDF, padding is included in the offsets and size
+		x0 -= FONT_SDF_PADDING;
+		y0 -= FONT_SDF_PADDING;
+		x1 += FONT_SDF_PADDING;
+		y1 += FONT_SDF_PADDING;
+	}
+	float w = (float)(x1-x0);
+	float h = (float)(y1-y0);
+	
+	glyph.xoffset = (float)x0;
+	glyph.yoffset = variation->height - (float)y0 - h - variation->metrics.max_ascent+variation->metrics.max_descent;  // Adjusted yoffset for bottom-up rendering
+	glyph.width   = w;
+	glyph.height  = h;
+	
+	return glyph;
+}
+
+// Only reads the font, so different threads can do this at the same time
+void font_make_glyph_bitmap(Gfx_Font_Variation *variation, u32 codepoint, Font_Glyph_Bitmap *bitmap, Allocator allocator) {
+	Gfx_Font *font = variation->font;
+	stbtt_fontinfo *stbtt_handle = &font->stbtt_handle;
+	
+	*bitmap = ZERO(Font_Glyph_Bitmap);
+	bitmap->codepoint = codepoint;
+	bitmap->glyph = font_make_glyph_metrics(variation, codepoint);
+	
+	int w = (int)bitmap->glyph.width;
+	int h = (int)bitmap->glyph.height;
+	if (w == 0 || h == 0) return;
+	
+	third_party_allocator = allocator;
+	if (font->sdf_reference_height) {
+		int sdf_w, sdf_h, sdf_x0, sdf_y0;
+		bitmap->pixels = stbtt_GetCodepointSDF(stbtt_handle, variation->scale, (int)codepoint, FONT_SDF_PADDING, FONT_SDF_ON_EDGE, FONT_SDF_DISTANCE_PER_TEXEL, &sdf_w, &sdf_h, &sdf_x0, &sdf_y0);
+		assert(!bitmap->pixels || (sdf_w == w && sdf_h == h), "SDF glyph size is not what the metrics say");
+	} else {
+		bitmap->pixels = alloc(allocator, w*h);
+		stbtt_MakeCodepointBitmap(stbtt_handle, bitmap->pixels, w, h, w, variation->scale, variation->scale, (int)codepoint);
+	}
+	third_party_allocator = ZERO(Allocator);
+	
+	bitmap->width  = (u32)w;
+	bitmap->height = (u32)h;
+}
+
+// Packs the bitmap into an atlas and marks it for upload
+void font_place_glyph_bitmap(Gfx_Font *font, Font_Glyph_Bitmap *bitmap) {
+	Gfx_Glyph *glyph = &bitmap->glyph;
+	u32 w = bitmap->width;
+	u32 h = bitmap->height;
+	
+	if (!bitmap->pixels) return;
+	
+	u32 x, y;
+	glyph->atlas_index = font_pack_glyph(font, w, h, &x, &y);
+	glyph->has_pixels = true;
+	Gfx_Font_Atlas *atlas = &font->atlases[glyph->atlas_index];
+	atlas->glyph_count += 1;
+	
+	// stbtt is top-down, images are bottom-up
+	for (u32 row = 0; row < h; row++) {
+		memcpy(atlas->pixels + (y + h-1-row)*FONT_ATLAS_WIDTH + x, bitmap->pixels + row*w, w);
+	}
+	
+	if (atlas->dirty_x1 == atlas->dirty_x2) {
+		atlas->dirty_x1 = x;
+		atlas->dirty_y1 = y;
+		atlas->dirty_x2 = x + w;
+		atlas->dirty_y2 = y + h;
+	} else {
+		atlas->dirty_x1 = min(atlas->dirty_x1, x);
+		atlas->dirty_y1 = min(atlas->dirty_y1, y);
+		atlas->dirty_x2 = max(atlas->dirty_x2, x + w);
+		atlas->dirty_y2 = max(atlas->dirty_y2, y + h);
+	}
+	if (!font->has_dirty_atlases) {
+		if (!fonts_with_dirty_atlases) growing_array_init((void**)&fonts_with_dirty_atlases, sizeof(Gfx_Font*), get_heap_allocator());
+		growing_array_add((void**)&fonts_with_dirty_atlases, &font);
+		font->has_dirty_atlases = true;
+	}
+	
+	glyph->uv.x1 = ((float)x)/(float)FONT_ATLAS_WIDTH;
+	glyph->uv.y1 = ((float)y)/(float)FONT_ATLAS_HEIGHT;
+	glyph->uv.x2 = ((float)x+glyph->width)/(float)FONT_ATLAS_WIDTH;
+	glyph->uv.y2 = ((float)y+glyph->height)/(float)FONT_ATLAS_HEIGHT;
+}
+
+// SDF fonts only have glyphs at the reference height
+Gfx_Font_Variation *font_get_glyph_variation(Gfx_Font *font, u32 font_height) {
+	if (font->sdf_reference_height) font_height = font->sdf_reference_height;
+	
+	assert(font_height < MAX_FONT_HEIGHT, "Font height too large; maximum of %d is allowed.", MAX_FONT_HEIGHT-1);
+	Gfx_Font_Variation *variation = &font->variations[font_height];
+	
+	if (!variation->initted) {
+		font_variation_init(variation, font, font_height);
+	}
+	return variation;
+}
+
+// Null if the glyph is not rasterized yet
+Gfx_Glyph *font_find_glyph(Gfx_Font_Variation *variation, u32 codepoint) {
+	if (codepoint < FONT_DIRECT_GLYPH_COUNT) {
+		if (!(variation->direct_glyph_mask[codepoint/64] & (1ULL << (codepoint%64)))) return 0;
+		return &variation->direct_glyphs[codepoint];
+	}
+	return (Gfx_Glyph*)hash_table_find(&variation->glyphs, codepoint);
+}
+
+Gfx_Glyph *font_add_glyph(Gfx_Font_Variation *variation, Gfx_Glyph glyph) {
+	u32 codepoint = glyph.codepoint;
+	if (codepoint < FONT_DIRECT_GLYPH_COUNT) {
+		variation->direct_glyphs[codepoint] = glyph;
+		variation->direct_glyph_mask[codepoint/64] |= 1ULL << (codepoint%64);
+		return &variation->direct_glyphs[codepoint];
+	}
+	hash_table_add(&variation->glyphs, codepoint, glyph);
+	return (Gfx_Glyph*)hash_table_find(&variation->glyphs, codepoint);
+}
+
+// Rasterizes the glyph if this is the first time it's used at this height.
+// For SDF fonts, this is the glyph at the reference height whatever font_height is.
+// The pointer is only valid until the next glyph is rasterized.
+Gfx_Glyph *font_get_glyph(Gfx_Font *font, u32 font_height, u32 codepoint) {
+	Gfx_Font_Variation *variation = font_get_glyph_variation(font, font_height);
+	
+	Gfx_Glyph *glyph = font_find_glyph(variation, codepoint);
+	if (glyph) return glyph;
+	
+	if (font->bake_in_background) {
+		Gfx_Glyph pending = font_make_glyph_metrics(variation, codepoint);
+		if (pending.width > 0 && pending.height > 0) {
+			pending.is_pending = true;
+			font_baker_push(font, variation, codepoint);
+		}
+		return font_add_glyph(variation, pending);
+	}
+	
+	Font_Glyph_Bitmap bitmap;
+	font_make_glyph_bitmap(variation, codepoint, &bitmap, get_heap_allocator());
+	font_place_glyph_bitmap(font, &bitmap);
+	if (bitmap.pixels) dealloc(get_heap_allocator(), bitmap.pixels);
+	
+	return font_add_glyph(variation, bitmap.glyph);
+}
+
+typedef struct Font_Rasterize_Job {
+	Gfx_Font_Variation *variation;
+	Font_Glyph_Bitmap *bitmaps;
+} Font_Rasterize_Job;
+
+void font_rasterize_glyphs_range(u64 first, u64 end, u64 range_index, void *data) {
+	Font_Rasterize_Job *job = (Font_Rasterize_Job*)data;
+	for (u64 i = first; i < end; i++) {
+		font_make_glyph_bitmap(job->variation, job->bitmaps[i].codepoint, &job->bitmaps[i], get_heap_allocator());
+	}
+}
+
+// Rasterizes the glyphs that aren't yet, on parallel_for threads. Packing them into the
+// atlases is done after, in order, on this thread.
+void font_rasterize_glyphs(Gfx_Font *font, u32 font_height, u32 *codepoints, u64 codepoint_count) {
+	Gfx_Font_Variation *variation = font_get_glyph_variation(font, font_height);
+	
+	Font_Glyph_Bitmap *bitmaps = alloc(get_heap_allocator(), codepoint_count*sizeof(Font_Glyph_Bitmap));
+	u64 count = 0;
+	for (u64 i = 0; i < codepoint_count; i++) {
+		if (font_find_glyph(variation, codepoints[i])) continue;
 		
-		if (cursor_x+w > FONT_ATLAS_WIDTH) {
-			cursor_x = 0;
-			cursor_y += variation->height;
+		bool duplicate = false;
+		for (u64 j = 0; j < count; j++) {
+			if (bitmaps[j].codepoint == codepoints[i]) { duplicate = true; break; }
 		}
+		if (duplicate) continue;
+		
+		bitmaps[count].codepoint = codepoints[i];
+		count += 1;
+	}
+	
+	if (count > 0) {
+		Font_Rasterize_Job job = { variation, bitmaps };
+		u64 range_count = min(count, parallel_for_get_thread_count()*4);
+		parallel_for(count, range_count, font_rasterize_glyphs_range, &job);
 		
-		if (bitmap) {
-			// #Speed #Loadtimes
-			for (int row = 0; row < h; ++row) {
-                gfx_set_image_data(atlas->image, cursor_x, cursor_y + (h - 1 - row), w, 1, bitmap + (row * w));
-            }
-			stbtt_FreeBitmap(bitmap, 0);
+		for (u64 i = 0; i < count; i++) {
+			font_place_glyph_bitmap(font, &bitmaps[i]);
+			font_add_glyph(variation, bitmaps[i].glyph);
+			if (bitmaps[i].pixels) dealloc(get_heap_allocator(), bitmaps[i].pixels);
 		}
+	}
+	
+	dealloc(get_heap_allocator(), bitmaps);
+}
+
+// Makes the font an SDF font, see the top of this file. Call before any text is drawn or
+// measured with it.
+void font_enable_sdf(Gfx_Font *font, u32 reference_height) {
+	assert(growing_array_get_valid_count(font->atlases) == 0, "font_enable_sdf must be called before glyphs are rasterized");
+	assert(reference_height > 0 && reference_height < MAX_FONT_HEIGHT, "Bad SDF reference height %d", reference_height);
+	font->sdf_reference_height = reference_height;
+}
+
+// Makes the glyphs of the font rasterize on the font baker thread. Until one is done, it has
+// its metrics but no pixels, so text lays out the same but the glyph is not drawn. Finished
+// glyphs are put in the atlases when a draw frame is rendered.
+void font_enable_background_baking(Gfx_Font *font) {
+	font->bake_in_background = true;
+}
+
+void font_baker_proc(Thread *t) {
+	while (true) {
+		os_binary_semaphore_wait(&font_baker.wake);
 		
-		glyph->xoffset = (float)x;
-		glyph->yoffset = variation->height - (float)y - (float)h - variation->metrics.max_ascent+variation->metrics.max_descent;  // Adjusted yoffset for bottom-up rendering
-		glyph->width   = (float)w;
-		glyph->height  = (float)h;
+		while (true) {
+			mutex_acquire_or_wait(&font_baker.mutex);
+			u64 count = growing_array_get_valid_count(font_baker.requests);
+			if (count == 0) {
+				mutex_release(&font_baker.mutex);
+				break;
+			}
+			// Newest first, it's probably what's on screen
+			Font_Bake_Request request = font_baker.requests[count-1];
+			growing_array_pop((void**)&font_baker.requests);
+			font_baker.baking_font = request.font;
+			mutex_release(&font_baker.mutex);
+			
+			Font_Bake_Result result;
+			result.font = request.font;
+			result.variation = request.variation;
+			font_make_glyph_bitmap(request.variation, request.codepoint, &result.bitmap, get_heap_allocator());
+			
+			mutex_acquire_or_wait(&font_baker.mutex);
+			growing_array_add((void**)&font_baker.results, &result);
+			font_baker.baking_font = 0;
+			mutex_release(&font_baker.mutex);
+		}
+	}
+}
+
+void font_baker_push(Gfx_Font *font, Gfx_Font_Variation *variation, u32 codepoint) {
+	if (!font_baker.initted) {
+		font_baker.initted = true;
+		mutex_init(&font_baker.mutex);
+		os_binary_semaphore_init(&font_baker.wake, false);
+		growing_array_init((void**)&font_baker.requests, sizeof(Font_Bake_Request), get_heap_allocator());
+		growing_array_init((void**)&font_baker.results, sizeof(Font_Bake_Result), get_heap_allocator());
+		os_thread_init(&font_baker.thread, font_baker_proc);
+		os_thread_start(&font_baker.thread);
+	}
+	
+	Font_Bake_Request request = { font, variation, codepoint };
+	mutex_acquire_or_wait(&font_baker.mutex);
+	growing_array_add((void**)&font_baker.requests, &request);
+	mutex_release(&font_baker.mutex);
+	os_binary_semaphore_signal(&font_baker.wake);
+}
+
+// Puts glyphs the font baker is done with in the atlases
+void font_finish_background_glyphs() {
+	if (!font_baker.initted) return;
+	
+	mutex_acquire_or_wait(&font_baker.mutex);
+	u64 count = growing_array_get_valid_count(font_baker.results);
+	Font_Bake_Result *results = 0;
+	if (count > 0) {
+		results = talloc(count*sizeof(Font_Bake_Result));
+		memcpy(results, font_baker.results, count*sizeof(Font_Bake_Result));
+		growing_array_clear((void**)&font_baker.results);
+	}
+	mutex_release(&font_baker.mutex);
+	
+	for (u64 i = 0; i < count; i++) {
+		Font_Bake_Result *result = &results[i];
+		font_place_glyph_bitmap(result->font, &result->bitmap);
+		Gfx_Glyph *glyph = font_find_glyph(result->variation, result->bitmap.codepoint);
+		assert(glyph && glyph->is_pending, "Font baker made a glyph nobody was waiting for");
+		*glyph = result->bitmap.glyph;
+		if (result->bitmap.pixels) dealloc(get_heap_allocator(), result->bitmap.pixels);
+	}
+}
+
+// Drops what's queued for the font and waits if the baker is on one of its glyphs
+void font_baker_cancel_font(Gfx_Font *font) {
+	if (!font_baker.initted) return;
+	
+	mutex_acquire_or_wait(&font_baker.mutex);
+	while (font_baker.baking_font == font) {
+		mutex_release(&font_baker.mutex);
+		os_yield_thread();
+		mutex_acquire_or_wait(&font_baker.mutex);
+	}
+	for (u64 i = 0; i < growing_array_get_valid_count(font_baker.requests); ) {
+		if (font_baker.requests[i].font == font) growing_array_unordered_remove_by_index((void**)&font_baker.requests, i);
+		else i += 1;
+	}
+	for (u64 i = 0; i < growing_array_get_valid_count(font_baker.results); ) {
+		Font_Bake_Result *result = &font_baker.results[i];
+		if (result->font == font) {
+			if (result->bitmap.pixels) dealloc(get_heap_allocator(), result->bitmap.pixels);
+			growing_array_unordered_remove_by_index((void**)&font_baker.results, i);
+		} else {
+			i += 1;
+		}
+	}
+	mutex_release(&font_baker.mutex);
+}
+
+// Blocks until none of the font's glyphs are pending
+void font_wait_for_background_glyphs(Gfx_Font *font) {
+	if (!font_baker.initted) return;
+	
+	while (true) {
+		font_finish_background_glyphs();
 		
-		int advance, left_side_bearing;
-		stbtt_GetCodepointHMetrics(&stbtt_handle, c, &advance, &left_side_bearing);
+		bool waiting = false;
+		mutex_acquire_or_wait(&font_baker.mutex);
+		waiting = font_baker.baking_font == font || growing_array_get_valid_count(font_baker.results) > 0;
+		for (u64 i = 0; !waiting && i < growing_array_get_valid_count(font_baker.requests); i++) {
+			if (font_baker.requests[i].font == font) waiting = true;
+		}
+		mutex_release(&font_baker.mutex);
 		
-		glyph->advance = (float)advance*variation->scale;
-		//glyph->xoffset += (float)left_side_bearing*variation->scale;
+		if (!waiting) break;
+		os_yield_thread();
+	}
+}
+
+// Uploads the glyphs rasterized since last time, one gfx_set_image_data per changed atlas.
+// Called when a draw frame is rendered, so there's no need to call it yourself.
+void font_upload_dirty_atlases() {
+	font_finish_background_glyphs();
+	
+	if (!fonts_with_dirty_atlases) return;
+	
+	for (u64 i = 0; i < growing_array_get_valid_count(fonts_with_dirty_atlases); i++) {
+		Gfx_Font *font = fonts_with_dirty_atlases[i];
 		
-		glyph->uv.x1 = ((float)cursor_x)/(float)FONT_ATLAS_WIDTH;
-		glyph->uv.y1 = ((float)cursor_y)/(float)FONT_ATLAS_HEIGHT;
-		glyph->uv.x2 = ((float)cursor_x+glyph->width)/(float)FONT_ATLAS_WIDTH;
-		glyph->uv.y2 = ((float)cursor_y+glyph->height)/(float)FONT_ATLAS_HEIGHT;
+		for (u64 j = 0; j < growing_array_get_valid_count(font->atlases); j++) {
+			Gfx_Font_Atlas *atlas = &font->atlases[j];
+			if (atlas->dirty_x1 == atlas->dirty_x2) continue;
+			
+			u32 w = atlas->dirty_x2 - atlas->dirty_x1;
+			u32 h = atlas->dirty_y2 - atlas->dirty_y1;
+			
+			u8 *rect = talloc(w*h);
+			for (u32 row = 0; row < h; row++) {
+				memcpy(rect + row*w, atlas->pixels + (atlas->dirty_y1+row)*FONT_ATLAS_WIDTH + atlas->dirty_x1, w);
+			}
+			gfx_set_image_data(atlas->image, atlas->dirty_x1, atlas->dirty_y1, w, h, rect);
+			
+			font->upload_count += 1;
+			font->uploaded_pixels += (u64)w*h;
+			atlas->dirty_x1 = atlas->dirty_x2 = 0;
+			atlas->dirty_y1 = atlas->dirty_y2 = 0;
+		}
 		
-		cursor_x += w;
+		font->has_dirty_atlases = false;
 	}
 	
-	third_party_allocator = ZERO(Allocator);
+	growing_array_clear((void**)&fonts_with_dirty_atlases);
 }
 
+// Rasterizes printable ascii and the codepoint at this height ahead of time, in case the
+// first frame that draws text hitches. Fonts that bake in the background just queue them.
 void render_atlas_if_not_yet_rendered(Gfx_Font *font, u32 font_height, u32 codepoint) {
-	assert(font_height <= MAX_FONT_HEIGHT, "Font height too large; maximum of %d is allowed.", MAX_FONT_HEIGHT);
-	Gfx_Font_Variation *variation = &font->variations[font_height];
+	if (font->bake_in_background) {
+		for (u32 c = 32; c < 127; c++) font_get_glyph(font, font_height, c);
+		font_get_glyph(font, font_height, codepoint);
+		return;
+	}
 	
-	if (!variation->initted) {
-		font_variation_init(variation, font, font_height);
+	u32 codepoints[128];
+	u64 count = 0;
+	for (u32 c = 32; c < 127; c++) codepoints[count++] = c;
+	codepoints[count++] = codepoint;
+	font_rasterize_glyphs(font, font_height, codepoints, count);
+}
+
+Gfx_Font_Atlas_Stats get_font_atlas_stats(Gfx_Font *font) {
+	Gfx_Font_Atlas_Stats stats = ZERO(Gfx_Font_Atlas_Stats);
+	
+	stats.atlas_count = growing_array_get_valid_count(font->atlases);
+	for (u64 i = 0; i < stats.atlas_count; i++) {
+		stats.glyph_count += font->atlases[i].glyph_count;
+		stats.used_pixels += font->atlases[i].used_pixels;
+	}
+	stats.total_pixels = stats.atlas_count*FONT_ATLAS_WIDTH*FONT_ATLAS_HEIGHT;
+	stats.occupancy = stats.total_pixels ? (float32)stats.used_pixels/(float32)stats.total_pixels : 0;
+	stats.upload_count = font->upload_count;
+	stats.uploaded_pixels = font->uploaded_pixels;
+	
+	return stats;
+}
+
+typedef struct Baked_Font_Header {
+	u32 magic;
+	u32 version;
+	u32 atlas_width, atlas_height;
+	u32 sdf_reference_height;
+	u32 atlas_count;
+	u64 glyph_count;
+	u64 glyph_size; // sizeof(Baked_Font_Glyph) of whoever saved it
+	u64 font_data_size;
+	// Then:
+	//   font_data_size bytes of the .ttf
+	//   glyph_count Baked_Font_Glyph
+	//   atlas_count times a Baked_Font_Atlas, its packer nodes and atlas_width*atlas_height pixels
+} Baked_Font_Header;
+typedef struct Baked_Font_Glyph {
+	u32 font_height;
+	Gfx_Glyph glyph;
+} Baked_Font_Glyph;
+typedef struct Baked_Font_Atlas {
+	u32 node_count;
+	u32 glyph_count;
+	u64 used_pixels;
+} Baked_Font_Atlas;
+
+// Writes the font with all glyphs rasterized so far to a file that load_font_from_disk can
+// load without rasterizing them again. Waits for glyphs that are baking in the background.
+bool save_baked_font(Gfx_Font *font, string path) {
+	font_wait_for_background_glyphs(font);
+	
+	u64 glyph_count = 0;
+	for (u32 i = 0; i < MAX_FONT_HEIGHT; i++) {
+		Gfx_Font_Variation *variation = &font->variations[i];
+		if (!variation->initted) continue;
+		for (u32 c = 0; c < FONT_DIRECT_GLYPH_COUNT; c++) {
+			if (variation->direct_glyph_mask[c/64] & (1ULL << (c%64))) glyph_count += 1;
+		}
+		glyph_count += variation->glyphs.count;
+	}
+	u64 atlas_count = growing_array_get_valid_count(font->atlases);
+	
+	u64 size = sizeof(Baked_Font_Header) + font->raw_font_data.count + glyph_count*sizeof(Baked_Font_Glyph);
+	for (u64 i = 0; i < atlas_count; i++) {
+		size += sizeof(Baked_Font_Atlas) + font->atlases[i].packer.node_count*sizeof(Rect_Packer_Node);
+		size += FONT_ATLAS_WIDTH*FONT_ATLAS_HEIGHT;
+	}
+	
+	string file = alloc_string(get_heap_allocator(), size);
+	u8 *next = file.data;
+	
+	Baked_Font_Header header = ZERO(Baked_Font_Header);
+	header.magic = BAKED_FONT_MAGIC;
+	header.version = BAKED_FONT_VERSION;
+	header.atlas_width = FONT_ATLAS_WIDTH;
+	header.atlas_height = FONT_ATLAS_HEIGHT;
+	header.sdf_reference_height = font->sdf_reference_height;
+	header.atlas_count = (u32)atlas_count;
+	header.glyph_count = glyph_count;
+	header.glyph_size = sizeof(Baked_Font_Glyph);
+	header.font_data_size = font->raw_font_data.count;
+	memcpy(next, &header, sizeof(header));
+	next += sizeof(header);
+	
+	memcpy(next, font->raw_font_data.data, font->raw_font_data.count);
+	next += font->raw_font_data.count;
+	
+	for (u32 i = 0; i < MAX_FONT_HEIGHT; i++) {
+		Gfx_Font_Variation *variation = &font->variations[i];
+		if (!variation->initted) continue;
+		
+		for (u32 c = 0; c < FONT_DIRECT_GLYPH_COUNT; c++) {
+			if (!(variation->direct_glyph_mask[c/64] & (1ULL << (c%64)))) continue;
+			Baked_Font_Glyph baked = ZERO(Baked_Font_Glyph);
+			baked.font_height = i;
+			baked.glyph = variation->direct_glyphs[c];
+			memcpy(next, &baked, sizeof(baked));
+			next += sizeof(baked);
+		}
+		for (u64 j = 0; j < variation->glyphs.count; j++) {
+			Baked_Font_Glyph baked = ZERO(Baked_Font_Glyph);
+			baked.font_height = i;
+			baked.glyph = *(Gfx_Glyph*)hash_table_get_nth_value(&variation->glyphs, j);
+			memcpy(next, &baked, sizeof(baked));
+			next += sizeof(baked);
+		}
+	}
+	
+	for (u64 i = 0; i < atlas_count; i++) {
+		Gfx_Font_Atlas *atlas = &font->atlases[i];
+		
+		Baked_Font_Atlas baked = ZERO(Baked_Font_Atlas);
+		baked.node_count = atlas->packer.node_count;
+		baked.glyph_count = atlas->glyph_count;
+		baked.used_pixels = atlas->used_pixels;
+		memcpy(next, &baked, sizeof(baked));
+		next += sizeof(baked);
+		
+		memcpy(next, atlas->packer.nodes, baked.node_count*sizeof(Rect_Packer_Node));
+		next += baked.node_count*sizeof(Rect_Packer_Node);
+		
+		memcpy(next, atlas->pixels, FONT_ATLAS_WIDTH*FONT_ATLAS_HEIGHT);
+		next += FONT_ATLAS_WIDTH*FONT_ATLAS_HEIGHT;
+	}
+	assert(next == file.data + file.count, "Baked font size is off");
+	
+	bool ok = os_write_entire_file(path, file);
+	dealloc_string(get_heap_allocator(), file);
+	if (!ok) log_error("Could not write baked font file '%s'", path);
+	
+	return ok;
+}
+
+// Takes the file, which must be allocated with allocator. Use load_font_from_disk.
+Gfx_Font *load_baked_font(string file, Allocator allocator) {
+	Baked_Font_Header header = ZERO(Baked_Font_Header);
+	if (file.count >= sizeof(header)) memcpy(&header, file.data, sizeof(header));
+	
+	bool valid = file.count >= sizeof(header)
+	          && header.magic == BAKED_FONT_MAGIC
+	          && header.version == BAKED_FONT_VERSION
+	          && header.atlas_width == FONT_ATLAS_WIDTH
+	          && header.atlas_height == FONT_ATLAS_HEIGHT
+	          && header.glyph_size == sizeof(Baked_Font_Glyph)
+	          && header.sdf_reference_height < MAX_FONT_HEIGHT
+	          && header.font_data_size <= file.count - sizeof(header)
+	          && header.glyph_count <= (file.count - sizeof(header) - header.font_data_size)/sizeof(Baked_Font_Glyph);
+	if (!valid) {
+		log_error("Baked font file is invalid, or from another version of oogabooga");
+		dealloc_string(allocator, file);
+		return 0;
+	}
+	
+	u8 *next = file.data + sizeof(header);
+	u8 *end = file.data + file.count;
+	
+	// destroy_font frees raw_font_data, so it needs its own allocation
+	string font_data = alloc_string(allocator, header.font_data_size);
+	memcpy(font_data.data, next, header.font_data_size);
+	next += header.font_data_size;
+	
+	third_party_allocator = allocator;
+	stbtt_fontinfo stbtt_handle;
+	int result = stbtt_InitFont(&stbtt_handle, font_data.data, stbtt_GetFontOffsetForIndex(font_data.data, 0));
+	third_party_allocator = ZERO(Allocator);
+	if (result == 0) {
+		log_error("Baked font file has a bad font in it");
+		dealloc_string(allocator, font_data);
+		dealloc_string(allocator, file);
+		return 0;
+	}
+	
+	Gfx_Font *font = alloc(allocator, sizeof(Gfx_Font));
+	memset(font, 0, sizeof(Gfx_Font));
+	font->stbtt_handle = stbtt_handle;
+	font->raw_font_data = font_data;
+	font->allocator = allocator;
+	font->sdf_reference_height = header.sdf_reference_height;
+	growing_array_init((void**)&font->atlases, sizeof(Gfx_Font_Atlas), allocator);
+	font->has_kerning = stbtt_handle.kern != 0 || stbtt_handle.gpos != 0;
+	
+	Baked_Font_Glyph *glyphs = (Baked_Font_Glyph*)next;
+	next += header.glyph_count*sizeof(Baked_Font_Glyph);
+	
+	bool ok = true;
+	for (u32 i = 0; ok && i < header.atlas_count; i++) {
+		Baked_Font_Atlas baked;
+		if ((u64)(end-next) < sizeof(baked)) { ok = false; break; }
+		memcpy(&baked, next, sizeof(baked));
+		next += sizeof(baked);
+		
+		u64 nodes_size = (u64)baked.node_count*sizeof(Rect_Packer_Node);
+		if (baked.node_count == 0 || baked.node_count > FONT_ATLAS_WIDTH
+		 || (u64)(end-next) < nodes_size + FONT_ATLAS_WIDTH*FONT_ATLAS_HEIGHT) {
+			ok = false;
+			break;
+		}
+		
+		Gfx_Font_Atlas *atlas = growing_array_add_empty((void**)&font->atlases);
+		*atlas = ZERO(Gfx_Font_Atlas);
+		rect_packer_init(&atlas->packer, FONT_ATLAS_WIDTH, FONT_ATLAS_HEIGHT, allocator);
+		memcpy(atlas->packer.nodes, next, nodes_size);
+		atlas->packer.node_count = baked.node_count;
+		next += nodes_size;
+		
+		// #Memory
+		atlas->pixels = alloc(allocator, FONT_ATLAS_WIDTH*FONT_ATLAS_HEIGHT);
+		memcpy(atlas->pixels, next, FONT_ATLAS_WIDTH*FONT_ATLAS_HEIGHT);
+		next += FONT_ATLAS_WIDTH*FONT_ATLAS_HEIGHT;
+		atlas->image = make_image(FONT_ATLAS_WIDTH, FONT_ATLAS_HEIGHT, 1, atlas->pixels, allocator);
+		atlas->glyph_count = baked.glyph_count;
+		atlas->used_pixels = baked.used_pixels;
+	}
+	
+	for (u64 i = 0; ok && i < header.glyph_count; i++) {
+		Baked_Font_Glyph baked;
+		memcpy(&baked, &glyphs[i], sizeof(baked));
+		// SDF fonts only have glyphs at the reference height
+		if (baked.font_height == 0 || baked.font_height >= MAX_FONT_HEIGHT
+		 || (header.sdf_reference_height && baked.font_height != header.sdf_reference_height)
+		 || (baked.glyph.has_pixels && baked.glyph.atlas_index >= header.atlas_count)) {
+			ok = false;
+			break;
+		}
+		baked.glyph.is_pending = false;
+		
+		Gfx_Font_Variation *variation = &font->variations[baked.font_height];
+		if (!variation->initted) font_variation_init(variation, font, baked.font_height);
+		font_add_glyph(variation, baked.glyph);
+	}
+	
+	dealloc_string(allocator, file);
+	
+	if (!ok) {
+		log_error("Baked font file is truncated or broken");
+		destroy_font(font);
+		return 0;
 	}
 	
-	u32 atlas_index = codepoint / variation->codepoint_range_per_atlas;
+	return font;
+}
+
+// #Speed
+// stbtt_GetCodepointKernAdvance finds both glyphs and searches the GPOS or kern table every
+// time, so pairs are remembered after the first lookup. stbtt can't list the GPOS pairs so
+// they can't all be looked up ahead of time.
+// In font units, scale with Gfx_Font_Variation.scale.
+s32 font_get_kerning(Gfx_Font *font, u32 first, u32 second) {
+	if (!font->has_kerning) return 0;
 	
-	if (!hash_table_contains(&variation->atlases, atlas_index)) {
-		Gfx_Font_Atlas atlas = ZERO(Gfx_Font_Atlas);
-		font_atlas_init(&atlas, variation, atlas_index*variation->codepoint_range_per_atlas);
-		hash_table_add(&variation->atlases, atlas_index, atlas);
+	if (!font->latin_kerning) {
+		u64 count = FONT_DIRECT_GLYPH_COUNT*FONT_DIRECT_GLYPH_COUNT;
+		font->latin_kerning = alloc(font->allocator, count*sizeof(s16));
+		for (u64 i = 0; i < count; i++) font->latin_kerning[i] = FONT_KERNING_UNKNOWN;
+		font->kerning = make_hash_table(u64, s16, font->allocator);
 	}
+	
+	if (first < FONT_DIRECT_GLYPH_COUNT && second < FONT_DIRECT_GLYPH_COUNT) {
+		s16 *kerning = &font->latin_kerning[first*FONT_DIRECT_GLYPH_COUNT + second];
+		if (*kerning == FONT_KERNING_UNKNOWN) {
+			*kerning = (s16)stbtt_GetCodepointKernAdvance(&font->stbtt_handle, (int)first, (int)second);
+		}
+		return *kerning;
+	}
+	
+	u64 pair = ((u64)first << 32) | second;
+	s16 *found = (s16*)hash_table_find(&font->kerning, pair);
+	if (found) return *found;
+	
+	s16 kerning = (s16)stbtt_GetCodepointKernAdvance(&font->stbtt_handle, (int)first, (int)second);
+	hash_table_add(&font->kerning, pair, kerning);
+	return kerning;
 }
 
 typedef bool(*Walk_Glyphs_Callback_Proc)(Gfx_Glyph glyph, Gfx_Font_Atlas *atlas, float glyph_x, float glyph_y, void *ud);
@@ -295,21 +1134,45 @@ typedef struct {
 	Vector2 scale;
 	bool ignore_control_codes;
 	void *ud;
+	// Optional. Set to the byte index in text of each glyph before proc is called for it, and
+	// to the byte index after the last glyph that was walked when walk_glyphs returns.
+	u64 *byte_index;
 } Walk_Glyphs_Spec;
 void walk_glyphs(Walk_Glyphs_Spec spec, Walk_Glyphs_Callback_Proc proc) {
 	
 	if (spec.text.data == 0 || spec.text.count <= 0) return;
 	
+	assert(spec.raster_height < MAX_FONT_HEIGHT, "Font height too large; maximum of %d is allowed.", MAX_FONT_HEIGHT-1);
 	Gfx_Font_Variation *variation = &spec.font->variations[spec.raster_height];
+	// SDF fonts rasterize at another height, but metrics are still from this one
+	if (!variation->initted) {
+		font_variation_init(variation, spec.font, spec.raster_height);
+	}
 	
 	float x = 0;
 	float y = 0;
 	
+	u8 *text_start = spec.text.data;
+	u8 *glyph_start = spec.text.data;
+	u8 *walked_end = spec.text.data;
+	
 	u32 last_c = 0;
 	u32 c = next_utf8(&spec.text);
 	while (c != 0) {
 		
-		render_atlas_if_not_yet_rendered(spec.font, spec.raster_height, c);
+		walked_end = spec.text.data;
+		if (spec.byte_index) *spec.byte_index = (u64)(glyph_start - text_start);
+		
+		Gfx_Glyph glyph = *font_get_glyph(spec.font, spec.raster_height, c);
+		if (spec.font->sdf_reference_height) {
+			// Glyph is at the reference height
+			float sdf_scale = (float)spec.raster_height/(float)spec.font->sdf_reference_height;
+			glyph.xoffset *= sdf_scale;
+			glyph.yoffset *= sdf_scale;
+			glyph.width   *= sdf_scale;
+			glyph.height  *= sdf_scale;
+			glyph.advance *= sdf_scale;
+		}
 		
 		if (c == '\n') {
 			x = 0;
@@ -318,14 +1181,13 @@ void walk_glyphs(Walk_Glyphs_Spec spec, Walk_Glyphs_Callback_Proc proc) {
 		}
 		
 		if (c < 32 && spec.ignore_control_codes) {
+			glyph_start = spec.text.data;
 			c = next_utf8(&spec.text);
 			continue;
 		}
 		
-		u32 atlas_index = c/variation->codepoint_range_per_atlas;
-		
-		Gfx_Font_Atlas *atlas = (Gfx_Font_Atlas*)hash_table_find(&variation->atlases, atlas_index);
-		Gfx_Glyph glyph = atlas->glyphs[c-atlas->first_codepoint];
+		// Null for glyphs without pixels
+		Gfx_Font_Atlas *atlas = glyph.has_pixels ? &spec.font->atlases[glyph.atlas_index] : 0;
 		
 		float glyph_x = x+glyph.xoffset*spec.scale.x;
 		float glyph_y = y+(glyph.yoffset)*spec.scale.y;
@@ -336,14 +1198,17 @@ void walk_glyphs(Walk_Glyphs_Spec spec, Walk_Glyphs_Callback_Proc proc) {
 		// #Incomplete kerning
 		x += glyph.advance*spec.scale.x;
 		if (last_c != 0) {
-			int kerning_unscaled = stbtt_GetCodepointKernAdvance(&spec.font->stbtt_handle, last_c, c);
+			s32 kerning_unscaled = font_get_kerning(spec.font, last_c, c);
 			float kerning_scaled_to_font_height = kerning_unscaled * variation->scale;
 			x += kerning_scaled_to_font_height*spec.scale.x;
 		}
 		
 		last_c = c;
+		glyph_start = spec.text.data;
 		c = next_utf8(&spec.text);
 	}
+	
+	if (spec.byte_index) *spec.byte_index = (u64)(walked_end - text_start);
 }
 
 Gfx_Font_Metrics get_font_metrics(Gfx_Font *font, u32 raster_height) {
@@ -404,7 +1269,7 @@ bool measure_text_glyph_callback(Gfx_Glyph glyph, Gfx_Font_Atlas *atlas, float g
 	
 	return true;
 }
-Gfx_Text_Metrics measure_text(Gfx_Font *font, string text, u32 raster_height, Vector2 scale) {
+Gfx_Text_Metrics measure_text_uncached(Gfx_Font *font, string text, u32 raster_height, Vector2 scale) {
 
 	Measure_Text_Walk_Glyphs_Context c = ZERO(Measure_Text_Walk_Glyphs_Context);
 	
@@ -412,7 +1277,7 @@ Gfx_Text_Metrics measure_text(Gfx_Font *font, string text, u32 raster_height, Ve
 	c.font = font;
 	c.raster_height = raster_height;
 	
-	walk_glyphs((Walk_Glyphs_Spec){font, text, raster_height, scale, true, &c}, measure_text_glyph_callback);
+	walk_glyphs((Walk_Glyphs_Spec){font, text, raster_height, scale, true, &c, 0}, measure_text_glyph_callback);
 	
 	c.m.functional_size = v2_sub(c.m.functional_pos_max, c.m.functional_pos_min);
 	c.m.visual_size = v2_sub(c.m.visual_pos_max, c.m.visual_pos_min);
@@ -420,105 +1285,396 @@ Gfx_Text_Metrics measure_text(Gfx_Font *font, string text, u32 raster_height, Ve
 	return c.m;
 }
 
+typedef struct Text_Layout_Walk_Glyphs_Context {
+	Measure_Text_Walk_Glyphs_Context measure;
+	Text_Layout_Glyph *glyphs; // Growing array, temporary
+	bool has_pending_glyphs;
+} Text_Layout_Walk_Glyphs_Context;
+
+bool text_layout_glyph_callback(Gfx_Glyph glyph, Gfx_Font_Atlas *atlas, float glyph_x, float glyph_y, void *ud) {
+	Text_Layout_Walk_Glyphs_Context *c = (Text_Layout_Walk_Glyphs_Context*)ud;
+	
+	measure_text_glyph_callback(glyph, atlas, glyph_x, glyph_y, &c->measure);
+	
+	if (glyph.is_pending) c->has_pending_glyphs = true;
+	
+	if (atlas) {
+		Text_Layout_Glyph *g = growing_array_add_empty((void**)&c->glyphs);
+		g->glyph = glyph;
+		g->x = glyph_x;
+		g->y = glyph_y;
+	}
+	return true;
+}
+
+u64 text_layout_make_key(Gfx_Font *font, string text, u32 raster_height, Vector2 scale) {
+	struct { Gfx_Font *font; u32 raster_height; Vector2 scale; } params;
+	memset(&params, 0, sizeof(params)); // Padding too
+	params.font = font;
+	params.raster_height = raster_height;
+	params.scale = scale;
+	return hash_bytes(text.data, text.count, hash_bytes(&params, sizeof(params), 0));
+}
+
+void text_layout_cache_unlink(Text_Layout *layout) {
+	if (layout->prev) layout->prev->next = layout->next;
+	else              text_layout_cache.most_recent = layout->next;
+	if (layout->next) layout->next->prev = layout->prev;
+	else              text_layout_cache.least_recent = layout->prev;
+	layout->prev = layout->next = 0;
+}
+void text_layout_cache_push_most_recent(Text_Layout *layout) {
+	layout->prev = 0;
+	layout->next = text_layout_cache.most_recent;
+	if (text_layout_cache.most_recent) text_layout_cache.most_recent->prev = layout;
+	text_layout_cache.most_recent = layout;
+	if (!text_layout_cache.least_recent) text_layout_cache.least_recent = layout;
+}
+void text_layout_cache_remove(Text_Layout *layout) {
+	text_layout_cache_unlink(layout);
+	hash_table_remove(&text_layout_cache.layouts, layout->key);
+	text_layout_cache.count -= 1;
+	dealloc(get_heap_allocator(), layout);
+}
+
+void text_layout_cache_remove_font(Gfx_Font *font) {
+	Text_Layout *layout = text_layout_cache.most_recent;
+	while (layout) {
+		Text_Layout *next = layout->next;
+		if (layout->font == font) text_layout_cache_remove(layout);
+		layout = next;
+	}
+}
+
+void text_layout_cache_clear() {
+	while (text_layout_cache.least_recent) text_layout_cache_remove(text_layout_cache.least_recent);
+}
+
+// The layout is the cache's and may be thrown out next time a layout is made, so don't keep
+// it around. Null for text that's too long to be cached.
+Text_Layout *get_text_layout(Gfx_Font *font, string text, u32 raster_height, Vector2 scale) {
+	if (text.count > TEXT_LAYOUT_MAX_CACHED_LENGTH) return 0;
+	
+	if (!text_layout_cache.initted) {
+		text_layout_cache.layouts = make_hash_table_reserve(u64, Text_Layout*, TEXT_LAYOUT_CACHE_CAPACITY, get_heap_allocator());
+		text_layout_cache.initted = true;
+	}
+	
+	u64 key = text_layout_make_key(font, text, raster_height, scale);
+	
+	Text_Layout **found = (Text_Layout**)hash_table_find(&text_layout_cache.layouts, key);
+	if (found) {
+		Text_Layout *layout = *found;
+		if (layout->font == font && layout->raster_height == raster_height
+		 && layout->scale.x == scale.x && layout->scale.y == scale.y && strings_match(layout->text, text)
+		 && !layout->has_pending_glyphs) {
+			if (layout != text_layout_cache.most_recent) {
+				text_layout_cache_unlink(layout);
+				text_layout_cache_push_most_recent(layout);
+			}
+			text_layout_cache.hit_count += 1;
+			return layout;
+		}
+		// Same key for something else or glyphs that were pending, the new one takes its place
+		text_layout_cache_remove(layout);
+	}
+	
+	text_layout_cache.miss_count += 1;
+	
+	Text_Layout_Walk_Glyphs_Context c = ZERO(Text_Layout_Walk_Glyphs_Context);
+	c.measure.scale = scale;
+	c.measure.font = font;
+	c.measure.raster_height = raster_height;
+	growing_array_init((void**)&c.glyphs, sizeof(Text_Layout_Glyph), get_temporary_allocator());
+	
+	walk_glyphs((Walk_Glyphs_Spec){font, text, raster_height, scale, true, &c, 0}, text_layout_glyph_callback);
+	
+	u64 glyph_count = growing_array_get_valid_count(c.glyphs);
+	
+	while (text_layout_cache.count >= TEXT_LAYOUT_CACHE_CAPACITY) {
+		text_layout_cache_remove(text_layout_cache.least_recent);
+		text_layout_cache.eviction_count += 1;
+	}
+	
+	// Layout, glyphs and text in one allocation
+	u64 size = sizeof(Text_Layout) + glyph_count*sizeof(Text_Layout_Glyph) + text.count;
+	Text_Layout *layout = alloc(get_heap_allocator(), size);
+	*layout = ZERO(Text_Layout);
+	layout->key = key;
+	layout->font = font;
+	layout->raster_height = raster_height;
+	layout->scale = scale;
+	layout->has_pending_glyphs = c.has_pending_glyphs;
+	layout->glyphs = (Text_Layout_Glyph*)(layout+1);
+	layout->glyph_count = glyph_count;
+	memcpy(layout->glyphs, c.glyphs, glyph_count*sizeof(Text_Layout_Glyph));
+	layout->text.data = (u8*)(layout->glyphs + glyph_count);
+	layout->text.count = text.count;
+	memcpy(layout->text.data, text.data, text.count);
+	
+	layout->metrics = c.measure.m;
+	layout->metrics.functional_size = v2_sub(layout->metrics.functional_pos_max, layout->metrics.functional_pos_min);
+	layout->metrics.visual_size = v2_sub(layout->metrics.visual_pos_max, layout->metrics.visual_pos_min);
+	
+	growing_array_deinit((void**)&c.glyphs);
+	
+	hash_table_add(&text_layout_cache.layouts, key, layout);
+	text_layout_cache_push_most_recent(layout);
+	text_layout_cache.count += 1;
+	
+	return layout;
+}
+
+Gfx_Text_Metrics measure_text(Gfx_Font *font, string text, u32 raster_height, Vector2 scale) {
+	Text_Layout *layout = get_text_layout(font, text, raster_height, scale);
+	if (layout) return layout->metrics;
+	
+	return measure_text_uncached(font, text, raster_height, scale);
+}
+
 typedef struct State_For_Glyph_Line_Break_Search {
-	u64 *line_break_indices;
-	u64 *glyph_count_per_line;
+	// Byte ranges of the lines that were broken off, growing arrays
+	u64 *line_starts;
+	u64 *line_ends;
 	float32 width;
 	u64 line_num;
-	u64 start_index;
-	u64 index;
-	u64 last_space_index;
+	// Walking stops at the first glyph after this many lines were broken off, 0 for no limit
+	u64 max_line_count;
+	bool stopped;
+	// Byte indices are from base_byte, which is where the walked text starts
+	u64 base_byte;
+	u64 walked_byte_index; // Set by walk_glyphs
+	u64 start_byte;
+	u64 last_space_byte; // Byte after the last space
 	float32 line_start_x;
+	// The first glyph of the line sets line_start_x, so it's the same when walking from the line
+	bool line_start_x_pending;
 	float32 last_space_x; // -elon
 	u64 count;
 	Vector2 scale;
 } State_For_Glyph_Line_Break_Search;
 bool text_line_wrapping_callback(Gfx_Glyph g, Gfx_Font_Atlas *atlas, float x, float y, void *ud) {
 	State_For_Glyph_Line_Break_Search *state = (State_For_Glyph_Line_Break_Search*)ud;
+	
+	if (state->max_line_count && state->line_num >= state->max_line_count) {
+		state->stopped = true;
+		return false;
+	}
+	
+	u64 byte_index = state->base_byte + state->walked_byte_index;
 
 	bool is_newline = g.codepoint == '\n';
 	if (g.codepoint < 32 && !is_newline) {
-		state->index += 1;
 		state->count += 1;
 		return true;
 	}
-
+	
+	if (state->line_start_x_pending) {
+		state->line_start_x = x;
+		state->line_start_x_pending = false;
+	}
 
 	float32 glyph_right = x + g.width*state->scale.x;
 	
-	if (state->last_space_index == state->index) state->last_space_x = x;
+	if (state->last_space_byte == byte_index) state->last_space_x = x;
 
 	if ((g.codepoint != 32 && (glyph_right-state->line_start_x) > state->width) || is_newline) {
 
-		bool do_break_at_last_space = state->last_space_index > state->start_index && !is_newline;
+		bool do_break_at_last_space = state->last_space_byte > state->start_byte && !is_newline;
 
-		u64 break_index;
-		if (do_break_at_last_space) break_index = state->last_space_index;
-		else break_index = state->index;
+		u64 break_byte;
+		if (do_break_at_last_space) break_byte = state->last_space_byte;
+		else break_byte = byte_index;
 
-		growing_array_add((void**)&state->line_break_indices, &state->start_index);
+		growing_array_add((void**)&state->line_starts, &state->start_byte);
+		growing_array_add((void**)&state->line_ends, &break_byte);
 
-		u64 count_from_start_to_space = break_index-state->start_index;
-		growing_array_add((void**)&state->glyph_count_per_line, &count_from_start_to_space);
-
-		u64 count_from_space_to_now = state->index - break_index;
-		state->count = count_from_space_to_now;
+		state->count = 0;
 		
-		if (break_index == state->index && (is_newline || g.codepoint == ' ')) {
-			break_index += 1; // Skip \n and space if that's what we break on
+		if (break_byte == byte_index && (is_newline || g.codepoint == ' ')) {
+			break_byte += 1; // Skip \n and space if that's what we break on
 		}
-		state->start_index = break_index;
+		state->start_byte = break_byte;
 		state->line_num += 1;
 
 		if (do_break_at_last_space) state->line_start_x = state->last_space_x;
+		else if (is_newline) state->line_start_x_pending = true;
 		else state->line_start_x = x;
 	} else {
 		if (g.codepoint == ' ') {
-			state->last_space_index = state->index+1;
+			state->last_space_byte = byte_index+1;
 		}
 	}
 	
-	state->index += 1;
 	state->count += 1;
 	
 	return true;
 };
 
+// Walks text from byte start, adding the lines to line_starts & line_ends. Returns false if it
+// stopped because max_line_count lines were found. Else, the last line (which may be empty)
+// is added too and the text is done.
+bool wrap_text_lines(string text, u64 start, float32 width, Gfx_Font *font, u32 raster_height, Vector2 scale, u64 max_line_count, u64 **line_starts, u64 **line_ends, u64 *next_line_start) {
+	State_For_Glyph_Line_Break_Search state = ZERO(State_For_Glyph_Line_Break_Search);
+	state.line_starts = *line_starts;
+	state.line_ends = *line_ends;
+	state.width = width;
+	state.scale = scale;
+	state.max_line_count = max_line_count;
+	state.base_byte = start;
+	state.start_byte = start;
+	state.line_start_x_pending = true;
+	
+	string rest = string_view(text, start, text.count-start);
+	walk_glyphs((Walk_Glyphs_Spec){font, rest, raster_height, scale, false, &state, &state.walked_byte_index}, text_line_wrapping_callback);
+	
+	if (!state.stopped && state.count > 0) {
+		u64 end = max(start + state.walked_byte_index, state.start_byte);
+		growing_array_add((void**)&state.line_starts, &state.start_byte);
+		growing_array_add((void**)&state.line_ends, &end);
+	}
+	
+	*line_starts = state.line_starts;
+	*line_ends = state.line_ends;
+	*next_line_start = state.start_byte;
+	return !state.stopped;
+}
+
 // Returns a Growing_Array of string, allocated with temp allocator
 string *split_text_to_lines_with_wrapping(string str, float32 width, Gfx_Font *font, u32 raster_height, Vector2 scale, bool do_trim_lines) {
 
-	Gfx_Font_Variation *variation = &font->variations[raster_height];
-
-	string text = str;
-	State_For_Glyph_Line_Break_Search result = ZERO(State_For_Glyph_Line_Break_Search);
-	result.width = width;
-	result.scale = scale;
-	growing_array_init((void**)&result.line_break_indices, sizeof(u64), get_temporary_allocator());
-	growing_array_init((void**)&result.glyph_count_per_line, sizeof(u64), get_temporary_allocator());
+	u64 *line_starts;
+	u64 *line_ends;
+	growing_array_init((void**)&line_starts, sizeof(u64), get_temporary_allocator());
+	growing_array_init((void**)&line_ends, sizeof(u64), get_temporary_allocator());
 	
-	walk_glyphs((Walk_Glyphs_Spec){font, text, raster_height, scale, false, &result}, text_line_wrapping_callback);
+	u64 next_line_start;
+	wrap_text_lines(str, 0, width, font, raster_height, scale, 0, &line_starts, &line_ends, &next_line_start);
 
 	string *lines;
 	growing_array_init((void**)&lines, sizeof(string), get_temporary_allocator());
 
-	for (u64 i = 0; i < growing_array_get_valid_count(result.line_break_indices); i += 1) {
-		u64 utf8_index = result.line_break_indices[i];
-		u64 byte_index = utf8_index_to_byte_index(text, utf8_index);
-		u64 utf8_count = result.glyph_count_per_line[i];
-		u64 byte_count = utf8_index_to_byte_index(text, utf8_index + utf8_count) - byte_index;
-		string line_str = string_view(text, byte_index, byte_count);
-		if (do_trim_lines)  line_str = string_trim(line_str);
-		growing_array_add((void**)&lines, &line_str);
-	}
-	if (result.count > 0) {
-		u64 utf8_index = result.start_index;
-		u64 byte_index = utf8_index_to_byte_index(text, utf8_index);
-		u64 utf8_count = result.count;
-		u64 byte_count = utf8_index_to_byte_index(text, utf8_index + utf8_count) - byte_index;
-		string line_str = string_view(text, byte_index, byte_count);
+	for (u64 i = 0; i < growing_array_get_valid_count(line_starts); i += 1) {
+		string line_str = string_view(str, line_starts[i], line_ends[i]-line_starts[i]);
 		if (do_trim_lines)  line_str = string_trim(line_str);
 		growing_array_add((void**)&lines, &line_str);
 	}
 
 	return lines;
+}
+
+/*
+
+	Wrapped_Text is for text too large to wrap every frame, like chat logs and in-game books.
+	
+	Lines are wrapped as they're asked for and the byte range of each line is kept, so
+	scrolling through text that's already been wrapped only costs the visible lines. The text is
+	not copied, so keep it alive and unchanged while it's set.
+	
+	Example Usage:
+	
+		Wrapped_Text *book = make_wrapped_text(font, font_height, v2(1, 1), page_width, get_heap_allocator());
+		wrapped_text_set_text(book, book_text);
+		
+		...
+		
+		// Only wraps as far as the last visible line
+		for (u64 i = first_visible_line; i < first_visible_line+visible_line_count; i++) {
+			if (!wrapped_text_wrap_lines(book, i+1)) break; // Past the end
+			draw_text(font, string_trim(wrapped_text_get_line(book, i)), ...);
+		}
+		
+	For a chat log, call wrapped_text_set_text_appended when messages are added to the end so
+	lines before the last one are not wrapped again. wrapped_text_get_line_count wraps all of
+	the text.
+	
+	Lines are the same as split_text_to_lines_with_wrapping without trimming.
+
+*/
+
+// Lines are wrapped at least this many at a time
+#define WRAPPED_TEXT_MIN_LINES_PER_WALK 64
+
+typedef struct Wrapped_Text {
+	Gfx_Font *font;
+	u32 raster_height;
+	Vector2 scale;
+	float32 width;
+	string text;
+	
+	// Byte ranges of the lines wrapped so far, growing arrays
+	u64 *line_starts;
+	u64 *line_ends;
+	// Where the line after the last wrapped one starts
+	u64 next_line_start;
+	bool is_fully_wrapped;
+	
+	Allocator allocator;
+} Wrapped_Text;
+
+Wrapped_Text *make_wrapped_text(Gfx_Font *font, u32 raster_height, Vector2 scale, float32 width, Allocator allocator) {
+	Wrapped_Text *w = alloc(allocator, sizeof(Wrapped_Text));
+	*w = ZERO(Wrapped_Text);
+	w->font = font;
+	w->raster_height = raster_height;
+	w->scale = scale;
+	w->width = width;
+	w->allocator = allocator;
+	growing_array_init((void**)&w->line_starts, sizeof(u64), allocator);
+	growing_array_init((void**)&w->line_ends, sizeof(u64), allocator);
+	return w;
+}
+void destroy_wrapped_text(Wrapped_Text *w) {
+	growing_array_deinit((void**)&w->line_starts);
+	growing_array_deinit((void**)&w->line_ends);
+	dealloc(w->allocator, w);
+}
+
+void wrapped_text_set_text(Wrapped_Text *w, string text) {
+	w->text = text;
+	growing_array_clear((void**)&w->line_starts);
+	growing_array_clear((void**)&w->line_ends);
+	w->next_line_start = 0;
+	w->is_fully_wrapped = text.count == 0;
+}
+// Text must be the text that was set, with more at the end
+void wrapped_text_set_text_appended(Wrapped_Text *w, string text) {
+	assert(text.count >= w->text.count, "wrapped_text_set_text_appended text is shorter than before");
+	w->text = text;
+	
+	if (w->is_fully_wrapped) {
+		// Last line is wrapped again since it may continue now
+		u64 count = growing_array_get_valid_count(w->line_starts);
+		if (count > 0 && w->line_starts[count-1] == w->next_line_start) {
+			growing_array_pop((void**)&w->line_starts);
+			growing_array_pop((void**)&w->line_ends);
+		}
+		w->is_fully_wrapped = false;
+	}
+}
+
+// Wraps until there are at least line_count lines or all the text is wrapped.
+// Returns false if there are fewer lines than that.
+bool wrapped_text_wrap_lines(Wrapped_Text *w, u64 line_count) {
+	while (!w->is_fully_wrapped && growing_array_get_valid_count(w->line_starts) < line_count) {
+		u64 wanted = max(line_count - growing_array_get_valid_count(w->line_starts), WRAPPED_TEXT_MIN_LINES_PER_WALK);
+		w->is_fully_wrapped = wrap_text_lines(w->text, w->next_line_start, w->width, w->font, w->raster_height, w->scale, wanted, &w->line_starts, &w->line_ends, &w->next_line_start);
+	}
+	return growing_array_get_valid_count(w->line_starts) >= line_count;
+}
+
+u64 wrapped_text_get_line_count_so_far(Wrapped_Text *w) {
+	return growing_array_get_valid_count(w->line_starts);
+}
+// Wraps all of the text
+u64 wrapped_text_get_line_count(Wrapped_Text *w) {
+	wrapped_text_wrap_lines(w, UINT64_MAX);
+	return growing_array_get_valid_count(w->line_starts);
+}
+
+// View into the text, not trimmed. Wraps up to the line if it's not yet.
+string wrapped_text_get_line(Wrapped_Text *w, u64 line) {
+	bool ok = wrapped_text_wrap_lines(w, line+1);
+	assert(ok, "Line %llu is past the end of the wrapped text", line);
+	return string_view(w->text, w->line_starts[line], w->line_ends[line]-w->line_starts[line]);
 }
\ No newline at end of file
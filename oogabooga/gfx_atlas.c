@@ -0,0 +1,461 @@
+
+/*
+
+	Gfx_Atlas packs many small images into a few big page images.
+
+	Every image added to an atlas is a regular Gfx_Image which you can pass to draw_image & co,
+	but it draws from its page with remapped uv's. Quads that use images from the same page can
+	then go in the same batch, so drawing lots of different sprites doesn't hit the 32 textures
+	per batch limit or make the renderer look up a texture slot for every new image.
+
+	Example Usage:
+
+		Gfx_Atlas *atlas = make_atlas(2048, 2048, get_heap_allocator());
+
+		Gfx_Image *player = atlas_load_image_from_disk(atlas, STR("player.png"));
+		Gfx_Image *tree   = atlas_load_image_from_disk(atlas, STR("tree.png"));
+
+		while (...) {
+			...
+
+			// Both of these draw from the same page texture
+			draw_image(player, v2(x, y), get_image_size(player), COLOR_WHITE);
+			draw_image(tree,   v2(x, y), get_image_size(tree),   COLOR_WHITE);
+
+			...
+		}
+
+	For dynamic content, images can be removed with atlas_remove_image. The space they used is
+	reused once their page is empty, or when the atlas is repacked. Repacking happens by itself
+	when an image doesn't fit and enough space is wasted, or explicitly with atlas_repack.
+	Repacking keeps all Gfx_Image pointers valid.
+
+	Atlas images are always 4 channels and you should not call delete_image, gfx_set_image_data
+	or gfx_read_image_data on them.
+
+	Images are padded by repeating their edge pixels (atlas->padding, 1 by default) so linear
+	filtering doesn't bleed in pixels of neighbouring images.
+
+*/
+
+#define ATLAS_CHANNELS 4
+
+///
+// Skyline rectangle packer.
+// The skyline is the top edge of everything packed so far, stored as horizontal segments
+// from left to right. New rectangles go where their top ends up lowest (bottom-left rule).
+typedef struct Rect_Packer_Node {
+	u32 x, y, width;
+} Rect_Packer_Node;
+typedef struct Rect_Packer {
+	u32 width, height;
+	Rect_Packer_Node *nodes;
+	u32 node_count;
+	Allocator allocator;
+} Rect_Packer;
+
+void rect_packer_reset(Rect_Packer *packer) {
+	packer->nodes[0] = (Rect_Packer_Node){0, 0, packer->width};
+	packer->node_count = 1;
+}
+void rect_packer_init(Rect_Packer *packer, u32 width, u32 height, Allocator allocator) {
+	assert(width > 0 && height > 0, "Bad rect packer size %dx%d", width, height);
+
+	packer->width = width;
+	packer->height = height;
+	packer->allocator = allocator;
+	// Every node is at least one pixel wide so there can't be more than width of them
+	packer->nodes = alloc(allocator, sizeof(Rect_Packer_Node)*width);
+	rect_packer_reset(packer);
+}
+void rect_packer_deinit(Rect_Packer *packer) {
+	dealloc(packer->allocator, packer->nodes);
+	*packer = ZERO(Rect_Packer);
+}
+
+// Returns the y where a rectangle of given width would sit if placed at the start of node i,
+// or -1 if it doesn't fit there.
+s64 rect_packer_fit(Rect_Packer *packer, u32 i, u32 width, u32 height) {
+	u32 x = packer->nodes[i].x;
+	if (x + width > packer->width) return -1;
+
+	u32 y = 0;
+	u32 width_left = width;
+	while (width_left > 0) {
+		assert(i < packer->node_count, "Rect packer nodes don't cover the full width");
+		y = max(y, packer->nodes[i].y);
+		if (y + height > packer->height) return -1;
+		width_left -= min(width_left, packer->nodes[i].width);
+		i += 1;
+	}
+	return y;
+}
+
+bool rect_packer_insert(Rect_Packer *packer, u32 width, u32 height, u32 *out_x, u32 *out_y) {
+	if (width == 0 || height == 0 || width > packer->width || height > packer->height) return false;
+
+	s64 best_index = -1;
+	u32 best_top = UINT32_MAX;
+	u32 best_width = UINT32_MAX;
+	u32 best_y = 0;
+	for (u32 i = 0; i < packer->node_count; i++) {
+		s64 y = rect_packer_fit(packer, i, width, height);
+		if (y < 0) continue;
+
+		u32 top = (u32)y + height;
+		// Ties go to the narrowest segment so wide gaps are kept for wide rectangles
+		if (top < best_top || (top == best_top && packer->nodes[i].width < best_width)) {
+			best_index = i;
+			best_top = top;
+			best_width = packer->nodes[i].width;
+			best_y = (u32)y;
+		}
+	}
+	if (best_index < 0) return false;
+
+	u32 x = packer->nodes[best_index].x;
+
+	// Insert the new segment on top of the rectangle, then cut away whatever it covers to the right
+	memmove(&packer->nodes[best_index+1], &packer->nodes[best_index], (packer->node_count-best_index)*sizeof(Rect_Packer_Node));
+	packer->nodes[best_index] = (Rect_Packer_Node){x, best_top, width};
+	packer->node_count += 1;
+
+	u32 i = (u32)best_index + 1;
+	while (i < packer->node_count) {
+		Rect_Packer_Node *node = &packer->nodes[i];
+		u32 covered_to = x + width;
+		if (node->x >= covered_to) break;
+
+		u32 overlap = covered_to - node->x;
+		if (overlap < node->width) {
+			node->x += overlap;
+			node->width -= overlap;
+			break;
+		}
+		memmove(node, node+1, (packer->node_count-i-1)*sizeof(Rect_Packer_Node));
+		packer->node_count -= 1;
+	}
+
+	// Merge neighbours at the same height
+	for (u32 j = 0; j + 1 < packer->node_count;) {
+		if (packer->nodes[j].y == packer->nodes[j+1].y) {
+			packer->nodes[j].width += packer->nodes[j+1].width;
+			memmove(&packer->nodes[j+1], &packer->nodes[j+2], (packer->node_count-j-2)*sizeof(Rect_Packer_Node));
+			packer->node_count -= 1;
+		} else {
+			j += 1;
+		}
+	}
+
+	*out_x = x;
+	*out_y = best_y;
+	return true;
+}
+
+///
+// Atlas
+
+typedef struct Gfx_Atlas_Page {
+	Gfx_Image *image;
+	// #Memory
+	// CPU copy of the page so images can be moved around when repacking without reading back from the gpu
+	u8 *pixels;
+	Rect_Packer packer;
+	u32 image_count;
+	// Area of removed images that the packer can't give out again until the page is empty or repacked
+	u64 wasted_area;
+} Gfx_Atlas_Page;
+
+typedef struct Gfx_Atlas_Entry {
+	Gfx_Image *image;
+	u32 page_index;
+	// Where the image starts in the page, padding not included
+	u32 x, y;
+} Gfx_Atlas_Entry;
+
+typedef struct Gfx_Atlas {
+	u32 page_width, page_height;
+	u32 padding;
+	Allocator allocator;
+	Gfx_Atlas_Page *pages;     // Growing array
+	Gfx_Atlas_Entry *entries;  // Growing array
+	u64 repack_count;
+} Gfx_Atlas;
+
+Gfx_Atlas *make_atlas(u32 page_width, u32 page_height, Allocator allocator) {
+	assert(page_width > 0 && page_height > 0, "Bad atlas page size %dx%d", page_width, page_height);
+
+	Gfx_Atlas *atlas = alloc(allocator, sizeof(Gfx_Atlas));
+	*atlas = ZERO(Gfx_Atlas);
+
+	atlas->page_width = page_width;
+	atlas->page_height = page_height;
+	atlas->padding = 1; // Change this before adding any images
+	atlas->allocator = allocator;
+	growing_array_init((void**)&atlas->pages, sizeof(Gfx_Atlas_Page), allocator);
+	growing_array_init((void**)&atlas->entries, sizeof(Gfx_Atlas_Entry), allocator);
+
+	return atlas;
+}
+
+void atlas_page_init(Gfx_Atlas *atlas, Gfx_Atlas_Page *page, Gfx_Image *reuse_image) {
+	*page = ZERO(Gfx_Atlas_Page);
+
+	u64 pixels_size = (u64)atlas->page_width*atlas->page_height*ATLAS_CHANNELS;
+	page->pixels = alloc(atlas->allocator, pixels_size);
+	memset(page->pixels, 0, pixels_size);
+
+	rect_packer_init(&page->packer, atlas->page_width, atlas->page_height, atlas->allocator);
+
+	page->image = reuse_image ? reuse_image : make_image(atlas->page_width, atlas->page_height, ATLAS_CHANNELS, page->pixels, atlas->allocator);
+}
+void atlas_page_deinit(Gfx_Atlas *atlas, Gfx_Atlas_Page *page, bool delete_page_image) {
+	if (delete_page_image) delete_image(page->image);
+	dealloc(atlas->allocator, page->pixels);
+	rect_packer_deinit(&page->packer);
+	*page = ZERO(Gfx_Atlas_Page);
+}
+
+void destroy_atlas(Gfx_Atlas *atlas) {
+	u32 entry_count = growing_array_get_valid_count(atlas->entries);
+	for (u32 i = 0; i < entry_count; i++) {
+		dealloc(atlas->allocator, atlas->entries[i].image);
+	}
+	u32 page_count = growing_array_get_valid_count(atlas->pages);
+	for (u32 i = 0; i < page_count; i++) {
+		atlas_page_deinit(atlas, &atlas->pages[i], true);
+	}
+	growing_array_deinit((void**)&atlas->pages);
+	growing_array_deinit((void**)&atlas->entries);
+	dealloc(atlas->allocator, atlas);
+}
+
+// Copies the padded rectangle of an image from one 4 channel buffer to another.
+// Edge pixels are repeated out into the padding.
+void atlas_blit_padded(u8 *dst, u32 dst_width, u32 dst_x, u32 dst_y, const u8 *src, u32 src_width, u32 src_x, u32 src_y, u32 width, u32 height, u32 padding, bool extrude) {
+	u32 padded_width = width + padding*2;
+	u32 padded_height = height + padding*2;
+	for (u32 row = 0; row < padded_height; row++) {
+		u8 *dst_row = dst + ((u64)(dst_y + row)*dst_width + dst_x)*ATLAS_CHANNELS;
+		if (!extrude) {
+			// Source already has its padding, copy it as is
+			memcpy(dst_row, src + ((u64)(src_y + row)*src_width + src_x)*ATLAS_CHANNELS, padded_width*ATLAS_CHANNELS);
+			continue;
+		}
+
+		u32 src_row_index = (u32)clamp((s64)row - (s64)padding, 0, (s64)height-1);
+		const u8 *src_row = src + ((u64)(src_y + src_row_index)*src_width + src_x)*ATLAS_CHANNELS;
+
+		for (u32 p = 0; p < padding; p++) {
+			memcpy(dst_row + p*ATLAS_CHANNELS, src_row, ATLAS_CHANNELS);
+			memcpy(dst_row + (padding+width+p)*ATLAS_CHANNELS, src_row + (width-1)*ATLAS_CHANNELS, ATLAS_CHANNELS);
+		}
+		memcpy(dst_row + padding*ATLAS_CHANNELS, src_row, width*ATLAS_CHANNELS);
+	}
+}
+
+void atlas_update_image(Gfx_Atlas *atlas, Gfx_Atlas_Entry *entry) {
+	Gfx_Atlas_Page *page = &atlas->pages[entry->page_index];
+	Gfx_Image *image = entry->image;
+
+	image->gfx_handle = page->image->gfx_handle;
+	image->atlas_page = page->image;
+	image->atlas_uv = v4(
+		(float)entry->x / (float)atlas->page_width,
+		(float)entry->y / (float)atlas->page_height,
+		(float)(entry->x + image->width) / (float)atlas->page_width,
+		(float)(entry->y + image->height) / (float)atlas->page_height
+	);
+}
+
+// Finds room for a padded rectangle on an existing page. Returns the page index or -1.
+s64 atlas_find_space(Gfx_Atlas *atlas, u32 padded_width, u32 padded_height, u32 *x, u32 *y) {
+	u32 page_count = growing_array_get_valid_count(atlas->pages);
+	for (u32 i = 0; i < page_count; i++) {
+		if (rect_packer_insert(&atlas->pages[i].packer, padded_width, padded_height, x, y)) return i;
+	}
+	return -1;
+}
+
+u64 atlas_get_wasted_area(Gfx_Atlas *atlas) {
+	u64 wasted_area = 0;
+	u32 page_count = growing_array_get_valid_count(atlas->pages);
+	for (u32 i = 0; i < page_count; i++) wasted_area += atlas->pages[i].wasted_area;
+	return wasted_area;
+}
+
+void atlas_repack(Gfx_Atlas *atlas);
+
+// data is width*height 4 channel pixels, bottom row first like images loaded with load_image_from_disk.
+// The returned image belongs to the atlas. Remove it with atlas_remove_image, not delete_image.
+Gfx_Image *atlas_add_image(Gfx_Atlas *atlas, u32 width, u32 height, void *data) {
+	assert(width > 0 && height > 0 && data, "Bad parameters passed to atlas_add_image");
+	u32 padded_width = width + atlas->padding*2;
+	u32 padded_height = height + atlas->padding*2;
+	assert(padded_width <= atlas->page_width && padded_height <= atlas->page_height, "Image of size %dx%d does not fit in atlas pages of size %dx%d (padding %d)", width, height, atlas->page_width, atlas->page_height, atlas->padding);
+
+	u32 x, y;
+	s64 page_index = atlas_find_space(atlas, padded_width, padded_height, &x, &y);
+
+	// If the holes left by removed images add up to a good part of a page, try to fill them
+	// before making a new page.
+	u64 page_area = (u64)atlas->page_width*atlas->page_height;
+	if (page_index < 0 && atlas_get_wasted_area(atlas) >= page_area/4) {
+		atlas_repack(atlas);
+		page_index = atlas_find_space(atlas, padded_width, padded_height, &x, &y);
+	}
+
+	if (page_index < 0) {
+		Gfx_Atlas_Page *page = growing_array_add_empty((void**)&atlas->pages);
+		atlas_page_init(atlas, page, 0);
+		page_index = growing_array_get_valid_count(atlas->pages)-1;
+		bool ok = rect_packer_insert(&page->packer, padded_width, padded_height, &x, &y);
+		assert(ok, "Image should always fit in an empty page");
+	}
+
+	Gfx_Atlas_Page *page = &atlas->pages[page_index];
+
+	// Pad in a temporary block so we can upload it in one go
+	u8 *padded = alloc(get_temporary_allocator(), (u64)padded_width*padded_height*ATLAS_CHANNELS);
+	atlas_blit_padded(padded, padded_width, 0, 0, data, width, 0, 0, width, height, atlas->padding, true);
+	atlas_blit_padded(page->pixels, atlas->page_width, x, y, padded, padded_width, 0, 0, width, height, atlas->padding, false);
+	gfx_set_image_data(page->image, x, y, padded_width, padded_height, padded);
+
+	page->image_count += 1;
+
+	Gfx_Image *image = alloc(atlas->allocator, sizeof(Gfx_Image));
+	*image = ZERO(Gfx_Image);
+	image->width = width;
+	image->height = height;
+	image->channels = ATLAS_CHANNELS;
+	image->allocator = atlas->allocator;
+
+	Gfx_Atlas_Entry *entry = growing_array_add_empty((void**)&atlas->entries);
+	entry->image = image;
+	entry->page_index = (u32)page_index;
+	entry->x = x + atlas->padding;
+	entry->y = y + atlas->padding;
+	atlas_update_image(atlas, entry);
+
+	return image;
+}
+
+Gfx_Image *atlas_load_image_from_disk(Gfx_Atlas *atlas, string path) {
+	string png;
+	bool ok = os_read_entire_file(path, &png, get_temporary_allocator());
+	if (!ok) return 0;
+
+	int width, height, channels;
+	stbi_set_flip_vertically_on_load(1);
+	third_party_allocator = get_temporary_allocator();
+	unsigned char* stb_data = stbi_load_from_memory(png.data, png.count, &width, &height, &channels, STBI_rgb_alpha);
+	third_party_allocator = ZERO(Allocator);
+
+	if (!stb_data) return 0;
+
+	return atlas_add_image(atlas, (u32)width, (u32)height, stb_data);
+}
+
+// Evicts an image from the atlas. The image pointer is invalid after this.
+void atlas_remove_image(Gfx_Atlas *atlas, Gfx_Image *image) {
+	u32 entry_count = growing_array_get_valid_count(atlas->entries);
+
+	// #Speed linear, but this is not something you do a lot of per frame
+	s64 index = -1;
+	for (u32 i = 0; i < entry_count; i++) {
+		if (atlas->entries[i].image == image) {
+			index = i;
+			break;
+		}
+	}
+	assert(index >= 0, "Image passed to atlas_remove_image is not in the atlas");
+
+	Gfx_Atlas_Entry *entry = &atlas->entries[index];
+	Gfx_Atlas_Page *page = &atlas->pages[entry->page_index];
+
+	page->image_count -= 1;
+	if (page->image_count == 0) {
+		// Nothing left on the page so all of its space is free again
+		rect_packer_reset(&page->packer);
+		page->wasted_area = 0;
+	} else {
+		page->wasted_area += (u64)(image->width + atlas->padding*2)*(image->height + atlas->padding*2);
+	}
+
+	dealloc(atlas->allocator, image);
+	growing_array_unordered_remove_by_index((void**)&atlas->entries, (u32)index);
+}
+
+// Packs all images again from scratch, tallest first, which gets rid of the holes left by
+// removed images and usually also needs fewer pages.
+// Page images are reused and the sub-images keep their pointers, only their uv's change.
+// #Volatile
+// Quads already drawn to a Draw_Frame in DRAW_QUAD_LAYOUT_SOA have their uv's remapped when
+// they're drawn, so don't repack between drawing and rendering a frame.
+void atlas_repack(Gfx_Atlas *atlas) {
+	u32 entry_count = growing_array_get_valid_count(atlas->entries);
+	u32 old_page_count = growing_array_get_valid_count(atlas->pages);
+	Gfx_Atlas_Page *old_pages = atlas->pages;
+	u32 padding = atlas->padding;
+
+	u64 *keys = alloc(get_temporary_allocator(), sizeof(u64)*entry_count*2 + 1);
+	for (u32 i = 0; i < entry_count; i++) {
+		u32 padded_height = atlas->entries[i].image->height + padding*2;
+		keys[i] = make_sort_key(0xFFFF - min(padded_height, 0xFFFF), i);
+	}
+	u64 *sorted = radix_sort_keys(keys, keys + entry_count, entry_count, 16);
+
+	Gfx_Atlas_Page *new_pages;
+	growing_array_init((void**)&new_pages, sizeof(Gfx_Atlas_Page), atlas->allocator);
+
+	for (u32 i = 0; i < entry_count; i++) {
+		Gfx_Atlas_Entry *entry = &atlas->entries[get_sort_key_index(sorted[i])];
+		Gfx_Image *image = entry->image;
+		u32 padded_width = image->width + padding*2;
+		u32 padded_height = image->height + padding*2;
+
+		u32 x = 0, y = 0;
+		s64 page_index = -1;
+		u32 new_page_count = growing_array_get_valid_count(new_pages);
+		for (u32 j = 0; j < new_page_count; j++) {
+			if (rect_packer_insert(&new_pages[j].packer, padded_width, padded_height, &x, &y)) {
+				page_index = j;
+				break;
+			}
+		}
+		if (page_index < 0) {
+			Gfx_Image *reuse_image = new_page_count < old_page_count ? old_pages[new_page_count].image : 0;
+			Gfx_Atlas_Page *page = growing_array_add_empty((void**)&new_pages);
+			atlas_page_init(atlas, page, reuse_image);
+			page_index = new_page_count;
+			bool ok = rect_packer_insert(&page->packer, padded_width, padded_height, &x, &y);
+			assert(ok, "Image should always fit in an empty page");
+		}
+
+		Gfx_Atlas_Page *old_page = &old_pages[entry->page_index];
+		Gfx_Atlas_Page *new_page = &new_pages[page_index];
+		atlas_blit_padded(new_page->pixels, atlas->page_width, x, y, old_page->pixels, atlas->page_width, entry->x - padding, entry->y - padding, image->width, image->height, padding, false);
+		new_page->image_count += 1;
+
+		entry->page_index = (u32)page_index;
+		entry->x = x + padding;
+		entry->y = y + padding;
+	}
+
+	u32 new_page_count = growing_array_get_valid_count(new_pages);
+	for (u32 i = 0; i < new_page_count; i++) {
+		gfx_set_image_data(new_pages[i].image, 0, 0, atlas->page_width, atlas->page_height, new_pages[i].pixels);
+	}
+	for (u32 i = 0; i < old_page_count; i++) {
+		// Page images past the new page count weren't reused
+		atlas_page_deinit(atlas, &old_pages[i], i >= new_page_count);
+	}
+	growing_array_deinit((void**)&old_pages);
+
+	atlas->pages = new_pages;
+	for (u32 i = 0; i < entry_count; i++) {
+		atlas_update_image(atlas, &atlas->entries[i]);
+	}
+
+	atlas->repack_count += 1;
+}
@@ -7,24 +7,6 @@ const Gfx_Handle GFX_INVALID_HANDLE = 0;
 
 string temp_win32_null_terminated_wide_to_fixed_utf8(const u16 *utf16);
 
-// We wanna pack this at some point
-// #Cleanup #Memory why am I doing alignat(16)?
-typedef struct alignat(16) D3D11_Vertex {
-	
-	Vector4 color;
-	Vector4 position;
-	Vector2 uv;
-	Vector2 self_uv;
-	s8 texture_index;
-	u8 type;
-	u8 sampler;
-	u8 has_scissor;
-	
-	Vector4 userdata[VERTEX_USER_DATA_COUNT];
-	
-	Vector4 scissor;
-	
-} D3D11_Vertex;
 
 // #Global
 
@@ -53,13 +35,23 @@ ID3D11VertexShader *d3d11_default_vertex_shader = 0;
 ID3D11PixelShader  *d3d11_default_pixel_shader = 0;
 ID3D11InputLayout  *d3d11_image_vertex_layout = 0;
 
-ID3D11Buffer *d3d11_quad_vbo = 0;
+// Compiled shader bytecode from earlier runs, see shader_cache.c
+Shader_Cache d3d11_shader_cache;
+
+// One Gfx_Quad_Instance per quad, expanded to 4 vertices in vs_main
+ID3D11Buffer *d3d11_quad_instance_buffer = 0;
+u64 d3d11_quad_instance_buffer_size = 0;
+// The 6 indices of one quad
 ID3D11Buffer *d3d11_quad_ibo = 0;
-u32 d3d11_quad_vbo_size = 0;
-void *d3d11_staging_quad_buffer = 0;
+// Gfx_Quad_Extra's for quads with scissor or userdata, read with the instance extra_index
+ID3D11Buffer *d3d11_quad_extra_buffer = 0;
+ID3D11ShaderResourceView *d3d11_quad_extra_srv = 0;
+u64 d3d11_quad_extra_buffer_count = 0;
 
-Draw_Quad *d3d11_sort_quad_buffer = 0;
-u64 d3d11_sort_quad_buffer_size = 0;
+Gfx_Pack d3d11_quad_pack = {0};
+// Counted during a frame, moved to the last frame stats in gfx_update
+Gfx_Quad_Upload_Stats d3d11_quad_upload_stats = {0};
+Gfx_Quad_Upload_Stats d3d11_last_quad_upload_stats = {0};
 
 u64 d3d11_thread_id = 0;
 
@@ -250,116 +242,109 @@ void d3d11_update_swapchain() {
 	d3d11_check_hr(hr);
 }
 
+// Bytecode is allocated with the heap allocator. Looked up in d3d11_shader_cache first, and
+// stored there after compiling.
+bool
+d3d11_compile_shader_bytecode(string source, const char *entry, const char *target, string *bytecode) {
+	string defines = tprint("%cs %cs", entry, target);
+	u64 key = shader_cache_make_key(&d3d11_shader_cache, source, defines);
+	
+	if (shader_cache_lookup(&d3d11_shader_cache, key, bytecode, get_heap_allocator())) {
+		return true;
+	}
+	
+	ID3DBlob* blob = NULL;
+	ID3DBlob* err_blob = NULL;
+	HRESULT hr = D3DCompile((char*)source.data, source.count, 0, 0, 0, entry, target, 0, 0, &blob, &err_blob);
+	if (!SUCCEEDED(hr)) {
+		log_error("Shader Compilation Error (%cs): %cs\n", target, (char*)ID3D10Blob_GetBufferPointer(err_blob));
+		D3D11Release(err_blob);
+		return false;
+	}
+	
+	string compiled;
+	compiled.data  = ID3D10Blob_GetBufferPointer(blob);
+	compiled.count = ID3D10Blob_GetBufferSize(blob);
+	*bytecode = string_copy(compiled, get_heap_allocator());
+	D3D11Release(blob);
+	
+	shader_cache_store(&d3d11_shader_cache, key, *bytecode);
+	
+	return true;
+}
+
 bool
 d3d11_compile_vertex_shader(string source, ID3D11VertexShader **vs, ID3D11InputLayout **input_layout) {
 	
 	
 	// Compile vertex shader
-    ID3DBlob* vs_blob = NULL;
-    ID3DBlob* err_blob = NULL;
-    HRESULT hr = D3DCompile((char*)source.data, source.count, 0, 0, 0, "vs_main", "vs_5_0", 0, 0, &vs_blob, &err_blob);
-	if (!SUCCEEDED(hr)) {
-		log_error("Vertex Shader Compilation Error: %cs\n", (char*)ID3D10Blob_GetBufferPointer(err_blob));
+	string vs_bytecode;
+	if (!d3d11_compile_shader_bytecode(source, "vs_main", "vs_5_0", &vs_bytecode)) {
 		return false;
 	}
 	
-	void *vs_buffer = ID3D10Blob_GetBufferPointer(vs_blob);
-	u64   vs_size   = ID3D10Blob_GetBufferSize(vs_blob);
+	void *vs_buffer = vs_bytecode.data;
+	u64   vs_size   = vs_bytecode.count;
 	
-	hr = ID3D11Device_CreateVertexShader(d3d11_device, vs_buffer, vs_size, NULL, vs);
+	HRESULT hr = ID3D11Device_CreateVertexShader(d3d11_device, vs_buffer, vs_size, NULL, vs);
 	d3d11_check_hr(hr);
 	
-	#define layout_base_count 9
-	D3D11_INPUT_ELEMENT_DESC layout[layout_base_count+VERTEX_USER_DATA_COUNT];
+	// Everything is per instance, the corner comes from SV_VertexID
+	D3D11_INPUT_ELEMENT_DESC layout[6];
 	memset(layout, 0, sizeof(layout));
 	
-	layout[0].SemanticName = "POSITION";
+	layout[0].SemanticName = "CORNERS";
 	layout[0].SemanticIndex = 0;
 	layout[0].Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
 	layout[0].InputSlot = 0;
-	layout[0].AlignedByteOffset = offsetof(D3D11_Vertex, position);
-	layout[0].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
-	layout[0].InstanceDataStepRate = 0;
+	layout[0].AlignedByteOffset = offsetof(Gfx_Quad_Instance, corners);
+	layout[0].InputSlotClass = D3D11_INPUT_PER_INSTANCE_DATA;
+	layout[0].InstanceDataStepRate = 1;
 	
-	layout[1].SemanticName = "TEXCOORD";
-	layout[1].SemanticIndex = 0;
-	layout[1].Format = DXGI_FORMAT_R32G32_FLOAT;
+	layout[1].SemanticName = "CORNERS";
+	layout[1].SemanticIndex = 1;
+	layout[1].Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
 	layout[1].InputSlot = 0;
-	layout[1].AlignedByteOffset = offsetof(D3D11_Vertex, uv);
-	layout[1].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
-	layout[1].InstanceDataStepRate = 0;
+	layout[1].AlignedByteOffset = offsetof(Gfx_Quad_Instance, corners) + sizeof(Vector2)*2;
+	layout[1].InputSlotClass = D3D11_INPUT_PER_INSTANCE_DATA;
+	layout[1].InstanceDataStepRate = 1;
 	
-	layout[2].SemanticName = "COLOR";
+	layout[2].SemanticName = "UV_RECT";
 	layout[2].SemanticIndex = 0;
 	layout[2].Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
 	layout[2].InputSlot = 0;
-	layout[2].AlignedByteOffset = offsetof(D3D11_Vertex, color);
-	layout[2].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
-	layout[2].InstanceDataStepRate = 0;
+	layout[2].AlignedByteOffset = offsetof(Gfx_Quad_Instance, uv);
+	layout[2].InputSlotClass = D3D11_INPUT_PER_INSTANCE_DATA;
+	layout[2].InstanceDataStepRate = 1;
 	
-	layout[3].SemanticName = "TEXTURE_INDEX";
+	layout[3].SemanticName = "COLOR";
 	layout[3].SemanticIndex = 0;
-	layout[3].Format = DXGI_FORMAT_R8_SINT;
+	layout[3].Format = DXGI_FORMAT_R8G8B8A8_UNORM;
 	layout[3].InputSlot = 0;
-	layout[3].AlignedByteOffset = offsetof(D3D11_Vertex, texture_index);
-	layout[3].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
-	layout[3].InstanceDataStepRate = 0;
+	layout[3].AlignedByteOffset = offsetof(Gfx_Quad_Instance, color);
+	layout[3].InputSlotClass = D3D11_INPUT_PER_INSTANCE_DATA;
+	layout[3].InstanceDataStepRate = 1;
 	
-	layout[4].SemanticName = "TYPE";
+	layout[4].SemanticName = "QUAD_FLAGS";
 	layout[4].SemanticIndex = 0;
-	layout[4].Format = DXGI_FORMAT_R8_UINT;
+	layout[4].Format = DXGI_FORMAT_R32_UINT;
 	layout[4].InputSlot = 0;
-	layout[4].AlignedByteOffset = offsetof(D3D11_Vertex, type);
-	layout[4].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
-	layout[4].InstanceDataStepRate = 0;
+	layout[4].AlignedByteOffset = offsetof(Gfx_Quad_Instance, flags);
+	layout[4].InputSlotClass = D3D11_INPUT_PER_INSTANCE_DATA;
+	layout[4].InstanceDataStepRate = 1;
 	
-	layout[5].SemanticName = "SAMPLER_INDEX";
+	layout[5].SemanticName = "EXTRA_INDEX";
 	layout[5].SemanticIndex = 0;
-	layout[5].Format = DXGI_FORMAT_R8_SINT;
+	layout[5].Format = DXGI_FORMAT_R32_UINT;
 	layout[5].InputSlot = 0;
-	layout[5].AlignedByteOffset = offsetof(D3D11_Vertex, sampler);
-	layout[5].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
-	layout[5].InstanceDataStepRate = 0;
-	
-	layout[6].SemanticName = "SELF_UV";
-	layout[6].SemanticIndex = 0;
-	layout[6].Format = DXGI_FORMAT_R32G32_FLOAT;
-	layout[6].InputSlot = 0;
-	layout[6].AlignedByteOffset = offsetof(D3D11_Vertex, self_uv);
-	layout[6].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
-	layout[6].InstanceDataStepRate = 0;
-	
-	layout[7].SemanticName = "SCISSOR";
-	layout[7].SemanticIndex = 0;
-	layout[7].Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
-	layout[7].InputSlot = 0;
-	layout[7].AlignedByteOffset = offsetof(D3D11_Vertex, scissor);
-	layout[7].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
-	layout[7].InstanceDataStepRate = 0;
-	
-	layout[8].SemanticName = "HAS_SCISSOR";
-	layout[8].SemanticIndex = 0;
-	layout[8].Format = DXGI_FORMAT_R8_UINT;
-	layout[8].InputSlot = 0;
-	layout[8].AlignedByteOffset = offsetof(D3D11_Vertex, has_scissor);
-	layout[8].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
-	layout[8].InstanceDataStepRate = 0;
-	
-	for (int i = 0; i < VERTEX_USER_DATA_COUNT; ++i) {
-	    layout[layout_base_count + i].SemanticName = "USERDATA";
-	    layout[layout_base_count + i].SemanticIndex = i;
-	    layout[layout_base_count + i].Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
-	    layout[layout_base_count + i].InputSlot = 0;
-	    layout[layout_base_count + i].AlignedByteOffset = offsetof(D3D11_Vertex, userdata) + sizeof(Vector4) * i;
-	    layout[layout_base_count + i].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
-	}
+	layout[5].AlignedByteOffset = offsetof(Gfx_Quad_Instance, extra_index);
+	layout[5].InputSlotClass = D3D11_INPUT_PER_INSTANCE_DATA;
+	layout[5].InstanceDataStepRate = 1;
 	
-	hr = ID3D11Device_CreateInputLayout(d3d11_device, layout, layout_base_count+VERTEX_USER_DATA_COUNT, vs_buffer, vs_size, input_layout);
+	hr = ID3D11Device_CreateInputLayout(d3d11_device, layout, sizeof(layout)/sizeof(layout[0]), vs_buffer, vs_size, input_layout);
 	d3d11_check_hr(hr);
-	
-	#undef layout_base_count
 
-	D3D11Release(vs_blob);
+	dealloc_string(get_heap_allocator(), vs_bytecode);
 	
 	return true;
 }
@@ -370,21 +355,15 @@ d3d11_compile_pixel_shader(string source, ID3D11PixelShader **ps) {
 	HRESULT hr;
 
     // Compile pixel shader
-    ID3DBlob* ps_blob = NULL;
-    ID3DBlob* err_blob = NULL;
-    hr = D3DCompile((char*)source.data, source.count, 0, 0, 0, "ps_main", "ps_5_0", 0, 0, &ps_blob, &err_blob);
-	if (!SUCCEEDED(hr)) {
-		log_error("Fragment Shader Compilation Error: %cs\n", (char*)ID3D10Blob_GetBufferPointer(err_blob));
+	string ps_bytecode;
+	if (!d3d11_compile_shader_bytecode(source, "ps_main", "ps_5_0", &ps_bytecode)) {
 		return false;
 	}
-	
-	void *ps_buffer = ID3D10Blob_GetBufferPointer(ps_blob);
-	u64   ps_size   = ID3D10Blob_GetBufferSize(ps_blob);
 
-    hr = ID3D11Device_CreatePixelShader(d3d11_device, ps_buffer, ps_size, NULL, ps);
+    hr = ID3D11Device_CreatePixelShader(d3d11_device, ps_bytecode.data, ps_bytecode.count, NULL, ps);
     d3d11_check_hr(hr);
 
-    D3D11Release(ps_blob);
+    dealloc_string(get_heap_allocator(), ps_bytecode);
 
 	return true;
 }
@@ -539,6 +518,10 @@ void gfx_init() {
 	    d3d11_check_hr(hr);
 	}
 	
+	// Bytecode depends on the compiler dll as well as the source
+	string compiler_id = tprint("D3DCompile %d", D3D_COMPILER_VERSION);
+	shader_cache_init(&d3d11_shader_cache, STR(SHADER_CACHE_DIRECTORY), compiler_id, get_heap_allocator());
+	
 	string source = STR(d3d11_image_shader_source);
 	source = string_replace_all(source, STR("$INJECT_PIXEL_POST_PROCESS"), STR("float4 pixel_shader_extension(PS_INPUT input, float4 color) { return color; }"), get_temporary_allocator());
 	source = string_replace_all(source, STR("$VERTEX_USER_DATA_COUNT"), tprint("%d", VERTEX_USER_DATA_COUNT), get_temporary_allocator());
@@ -547,13 +530,15 @@ void gfx_init() {
 	assert(ok, "Failed compiling vertex shader");
 	ok = d3d11_compile_pixel_shader(source, &d3d11_default_pixel_shader);
 	assert(ok, "Failed compiling default pixel shader");
+	
+	log_verbose("Shader cache: %llu hits, %llu misses", d3d11_shader_cache.hit_count, d3d11_shader_cache.miss_count);
 
 	log_info("D3D11 init done");
 	
 	
 }
 
-void d3d11_draw_call(int number_of_rendered_quads, ID3D11ShaderResourceView **textures, u64 num_textures, ID3D11ShaderResourceView **bind_textures, u64 num_bind_textures, Draw_Frame *frame, Gfx_Image *render_target) {
+void d3d11_draw_call(u64 first_quad, u64 number_of_rendered_quads, ID3D11ShaderResourceView **textures, u64 num_textures, ID3D11ShaderResourceView **bind_textures, u64 num_bind_textures, Draw_Frame *frame, Gfx_Image *render_target) {
 
 	u32 view_width;
 	u32 view_height;
@@ -579,15 +564,17 @@ void d3d11_draw_call(int number_of_rendered_quads, ID3D11ShaderResourceView **te
 	viewport.MaxDepth = 1.0;
 	ID3D11DeviceContext_RSSetViewports(d3d11_context, 1, &viewport);
 	
-    UINT stride = sizeof(D3D11_Vertex);
+    UINT stride = sizeof(Gfx_Quad_Instance);
     UINT offset = 0;
 	
 	ID3D11DeviceContext_IASetInputLayout(d3d11_context, d3d11_image_vertex_layout);
-    ID3D11DeviceContext_IASetVertexBuffers(d3d11_context, 0, 1, &d3d11_quad_vbo, &stride, &offset);
+    ID3D11DeviceContext_IASetVertexBuffers(d3d11_context, 0, 1, &d3d11_quad_instance_buffer, &stride, &offset);
     ID3D11DeviceContext_IASetIndexBuffer(d3d11_context, d3d11_quad_ibo, DXGI_FORMAT_R32_UINT, 0);
     ID3D11DeviceContext_IASetPrimitiveTopology(d3d11_context, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
     ID3D11DeviceContext_VSSetShader(d3d11_context, d3d11_default_vertex_shader, NULL, 0);
+    // #Volatile quad_extras register in the 2D batch shader
+    ID3D11DeviceContext_VSSetShaderResources(d3d11_context, 63, 1, &d3d11_quad_extra_srv);
     if (frame->shader_extension.ps) {
     	ID3D11DeviceContext_PSSetShader(d3d11_context, frame->shader_extension.ps, NULL, 0);
 		if (frame->cbuffer && frame->shader_extension.cbuffer && frame->shader_extension.cbuffer_size) {
@@ -621,7 +608,7 @@ void d3d11_draw_call(int number_of_rendered_quads, ID3D11ShaderResourceView **te
     	}
     }
 
-    ID3D11DeviceContext_DrawIndexed(d3d11_context, number_of_rendered_quads * 6, 0, 0);
+    ID3D11DeviceContext_DrawIndexedInstanced(d3d11_context, 6, number_of_rendered_quads, 0, 0, first_quad);
      
     ID3D11ShaderResourceView* null_srv[32] = {0};
     ID3D11DeviceContext_PSSetShaderResources(d3d11_context, 31, num_textures, null_srv);
@@ -641,257 +628,133 @@ void gfx_clear_render_target(Gfx_Image *render_target, Vector4 clear_color) {
 	ID3D11DeviceContext_ClearRenderTargetView(d3d11_context, render_target->gfx_render_target, (float*)&clear_color);
 }
 
-// gfx_interface.c impl
-void gfx_render_draw_frame(Draw_Frame *frame, Gfx_Image *render_target) {
-	assert(context.thread_id == d3d11_thread_id, "gfx_ functions must be called on the main thread");
+void d3d11_reserve_quad_instances(u64 instance_count) {
+	u64 required_size = instance_count*sizeof(Gfx_Quad_Instance);
+	if (required_size <= d3d11_quad_instance_buffer_size) return;
 	
-	HRESULT hr;
+	if (d3d11_quad_instance_buffer) D3D11Release(d3d11_quad_instance_buffer);
 	
+	u64 new_size = get_next_power_of_two(required_size);
 	
-	if (!frame->quad_buffer) return;
-
-	u64 number_of_quads = growing_array_get_valid_count(frame->quad_buffer);
+	D3D11_BUFFER_DESC desc = ZERO(D3D11_BUFFER_DESC);
+	desc.Usage = D3D11_USAGE_DYNAMIC; 
+	desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	desc.ByteWidth = new_size;
+	desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	HRESULT hr = ID3D11Device_CreateBuffer(d3d11_device, &desc, 0, &d3d11_quad_instance_buffer);
+	assert(SUCCEEDED(hr), "CreateBuffer failed");
 	
-	///
-	// Maybe grow quad vbo
-	u64 required_size = sizeof(D3D11_Vertex) * number_of_quads*4;
-
-	// #Copypaste
-	if (required_size > d3d11_quad_vbo_size) {
-		if (d3d11_quad_vbo) {
-			D3D11Release(d3d11_quad_vbo);
-			dealloc(get_heap_allocator(), d3d11_staging_quad_buffer);
-		}
-		u64 new_size = get_next_power_of_two(required_size);
-		u64 new_indices = ((new_size/sizeof(D3D11_Vertex))/4)*6;
-		
-		d3d11_quad_vbo_size = new_size;
-		
-		d3d11_staging_quad_buffer = alloc(get_heap_allocator(), d3d11_quad_vbo_size);
-		u32 *indices = (u32*)alloc(get_heap_allocator(), new_indices*sizeof(u32));
-		
-		for (u64 i = 0; i < new_indices; i += 6) {
-			indices[i + 0] = (i/6)*4 + 0;
-			indices[i + 1] = (i/6)*4 + 1;
-			indices[i + 2] = (i/6)*4 + 2;
-			indices[i + 3] = (i/6)*4 + 0;
-			indices[i + 4] = (i/6)*4 + 2;
-			indices[i + 5] = (i/6)*4 + 3;
-		}
-		
-		D3D11_BUFFER_DESC desc = ZERO(D3D11_BUFFER_DESC);
-		desc.Usage = D3D11_USAGE_DYNAMIC; 
-		desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-		desc.ByteWidth = new_size;
-		desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-		HRESULT hr = ID3D11Device_CreateBuffer(d3d11_device, &desc, 0, &d3d11_quad_vbo);
-		assert(SUCCEEDED(hr), "CreateBuffer failed");
+	d3d11_quad_instance_buffer_size = new_size;
+	
+	if (!d3d11_quad_ibo) {
+		u32 indices[6] = {0, 1, 2, 0, 2, 3};
 		
 		D3D11_BUFFER_DESC index_buffer_desc = ZERO(D3D11_BUFFER_DESC);
-		index_buffer_desc.Usage = D3D11_USAGE_DEFAULT;
-		index_buffer_desc.ByteWidth = new_indices*sizeof(u32);
+		index_buffer_desc.Usage = D3D11_USAGE_IMMUTABLE;
+		index_buffer_desc.ByteWidth = sizeof(indices);
 		index_buffer_desc.BindFlags = D3D11_BIND_INDEX_BUFFER;
 		index_buffer_desc.CPUAccessFlags = 0;
 		
 		D3D11_SUBRESOURCE_DATA index_data = {};
 		index_data.pSysMem = indices;
 		
-		ID3D11Device_CreateBuffer(d3d11_device, &index_buffer_desc, &index_data, &d3d11_quad_ibo);
-		
-		
-		log_verbose("Grew quad vbo to %d bytes.", d3d11_quad_vbo_size);
+		hr = ID3D11Device_CreateBuffer(d3d11_device, &index_buffer_desc, &index_data, &d3d11_quad_ibo);
+		assert(SUCCEEDED(hr), "CreateBuffer failed");
 	}
+	
+	log_verbose("Grew quad instance buffer to %d bytes.", d3d11_quad_instance_buffer_size);
+}
 
-	if (number_of_quads > 0) {
-		///
-		// Render geometry from into vbo quad list
-	    
-		
-		ID3D11ShaderResourceView *textures[32];
-		ID3D11ShaderResourceView *bind_textures[MAX_BOUND_IMAGES];
-		ID3D11ShaderResourceView *last_texture = 0;
-		u64 num_textures = 0;
-		s8 last_texture_index = 0;
-		for (int i = 0; i < frame->highest_bound_slot_index+1; i += 1) {
-			bind_textures[i] = frame->bound_images[i]->gfx_handle;
-		}
-		
-		D3D11_Vertex* head = (D3D11_Vertex*)d3d11_staging_quad_buffer;
-		D3D11_Vertex* pointer = head;
-		u64 number_of_rendered_quads = 0;
-		
-		
-		///
-		// This is where we convert Draw_Quad's to vertices. It should be very fast as all it's doing is mostly
-		// copying and some minor computing.
-		// Most computation is done in draw_quad_projected in drawing.c.
-		// This way, we could easily build different draw frames on different threads and then render them
-		// here on the main thread.
-		//
-		{
-			if (frame->enable_z_sorting) {
-				if (!d3d11_sort_quad_buffer || (d3d11_sort_quad_buffer_size < number_of_quads*sizeof(Draw_Quad))) {
-					// #Memory #Heapalloc
-					if (d3d11_sort_quad_buffer) dealloc(get_heap_allocator(), d3d11_sort_quad_buffer);
-					d3d11_sort_quad_buffer = alloc(get_heap_allocator(), number_of_quads*sizeof(Draw_Quad));
-					d3d11_sort_quad_buffer_size = number_of_quads*sizeof(Draw_Quad);
-				}
-				radix_sort(frame->quad_buffer, d3d11_sort_quad_buffer, number_of_quads, sizeof(Draw_Quad), offsetof(Draw_Quad, z), MAX_Z_BITS);
-			}
-		
-			for (u64 i = 0; i < number_of_quads; i++)  {
-				
-				Draw_Quad *q = &frame->quad_buffer[i];
-				
-				assert(q->z <= MAX_Z, "Z is too high. Z is %d, Max is %d.", q->z, MAX_Z);
-				assert(q->z >= (-MAX_Z+1), "Z is too low. Z is %d, Min is %d.", q->z, -MAX_Z+1);
-				
-				s8 texture_index = -1;
-				
-				if (q->image) {
-					
-					if (last_texture == q->image->gfx_handle) {
-						texture_index = last_texture_index;
-					} else {
-						// First look if texture is already bound
-						for (u64 j = 0; j < num_textures; j++) {
-							if (textures[j] == q->image->gfx_handle) {
-								texture_index = (s8)j;
-								break;
-							}
-						}
-						// Otherwise use a new slot
-						if (texture_index <= -1) {
-							if (num_textures >= 32) {
-								
-								// If max textures reached, make a draw call and start over
-								D3D11_MAPPED_SUBRESOURCE buffer_mapping;
-								ID3D11DeviceContext_Map(d3d11_context, (ID3D11Resource*)d3d11_quad_vbo, 0, D3D11_MAP_WRITE_DISCARD, 0, &buffer_mapping);
-								memcpy(buffer_mapping.pData, d3d11_staging_quad_buffer, number_of_rendered_quads*sizeof(D3D11_Vertex)*4);
-								ID3D11DeviceContext_Unmap(d3d11_context, (ID3D11Resource*)d3d11_quad_vbo, 0);
-								d3d11_draw_call(number_of_rendered_quads, textures, num_textures, bind_textures, frame->highest_bound_slot_index+1, frame, render_target);
-								head = (D3D11_Vertex*)d3d11_staging_quad_buffer;
-								num_textures = 1;
-								texture_index = 0;
-								number_of_rendered_quads = 0;
-								pointer = head;
-							} else {
-								texture_index = (s8)num_textures;
-								num_textures += 1;
-							}
-						}
-					}
-					textures[texture_index] = q->image->gfx_handle;
-					last_texture = q->image->gfx_handle;
-					last_texture_index = texture_index;
-				}
-				
-				
-				
-				// We will write to 4 vertices for the one quad
-				 {
-				
-					D3D11_Vertex* BL  = pointer + 0;
-					D3D11_Vertex* TL  = pointer + 1;
-					D3D11_Vertex* TR  = pointer + 2;
-					D3D11_Vertex* BR  = pointer + 3;
-					pointer += 4;
-					
-					BL->position = v4(q->bottom_left.x,  q->bottom_left.y,  0, 1);
-					TL->position = v4(q->top_left.x,     q->top_left.y,     0, 1);
-					TR->position = v4(q->top_right.x,    q->top_right.y,    0, 1);
-					BR->position = v4(q->bottom_right.x, q->bottom_right.y, 0, 1);
-					
-					
-					if (q->image) {
-
-						BL->uv = v2(q->uv.x1, q->uv.y1);
-						TL->uv = v2(q->uv.x1, q->uv.y2);
-						TR->uv = v2(q->uv.x2, q->uv.y2);
-						BR->uv = v2(q->uv.x2, q->uv.y1);
-						// #Hack #Bug #Cleanup
-						// When a window dimension is uneven it slightly under/oversamples on an axis by a
-						// seemingly arbitrary amount. The 0.25 is a magic value I got from trial and error.
-						// (It undersamples by a fourth of the atlas texture?)
-						// Anything > 0.25 < will slightly over/undersample on my machine.
-						// I have no idea about #Portability here.
-						// - Charlie M 26th July 2024
-						if (window.width % 2 != 0) {
-							BL->uv.x += (2.0/(float)q->image->width)*0.25;
-							TL->uv.x += (2.0/(float)q->image->width)*0.25;
-							TR->uv.x += (2.0/(float)q->image->width)*0.25;
-							BR->uv.x += (2.0/(float)q->image->width)*0.25;
-						}
-						if (window.height % 2 != 0) {
-							BL->uv.y -= (2.0/(float)q->image->height)*0.25;
-							TL->uv.y -= (2.0/(float)q->image->height)*0.25;
-							TR->uv.y -= (2.0/(float)q->image->height)*0.25;
-							BR->uv.y -= (2.0/(float)q->image->height)*0.25;
-						}
-
-						u8 sampler = -1;
-						if (q->image_min_filter == GFX_FILTER_MODE_NEAREST
-									&& q->image_mag_filter == GFX_FILTER_MODE_NEAREST)
-								sampler = 0;
-						if (q->image_min_filter == GFX_FILTER_MODE_LINEAR
-									&& q->image_mag_filter == GFX_FILTER_MODE_LINEAR)
-								sampler = 1;
-						if (q->image_min_filter == GFX_FILTER_MODE_LINEAR
-									&& q->image_mag_filter == GFX_FILTER_MODE_NEAREST)
-								sampler = 2;
-						if (q->image_min_filter == GFX_FILTER_MODE_NEAREST
-									&& q->image_mag_filter == GFX_FILTER_MODE_LINEAR)
-								sampler = 3;
-						BL->sampler=TL->sampler=TR->sampler=BR->sampler = (u8)sampler;
-								
-					}
-					BL->texture_index=TL->texture_index=TR->texture_index=BR->texture_index = texture_index;
-					
-					BL->self_uv = v2(0, 0);
-					TL->self_uv = v2(0, 1);
-					TR->self_uv = v2(1, 1);
-					BR->self_uv = v2(1, 0);
-					
-					// #Speed #Cleanup
-					// Many programs may not user userdata, which means a lot of redundant time spent on this.
-					memcpy(BL->userdata, q->userdata, sizeof(q->userdata));
-					memcpy(TL->userdata, q->userdata, sizeof(q->userdata));
-					memcpy(TR->userdata, q->userdata, sizeof(q->userdata));
-					memcpy(BR->userdata, q->userdata, sizeof(q->userdata));
-					
-					BL->color = TL->color = TR->color = BR->color = q->color;
-					
-					BL->type=TL->type=TR->type=BR->type = (u8)q->type;
-					
-					float t = q->scissor.y1;
-					q->scissor.y1 = q->scissor.y2;
-					q->scissor.y2 = t;
-					
-					q->scissor.y1 = window.pixel_height - q->scissor.y1;
-					q->scissor.y2 = window.pixel_height - q->scissor.y2;
-					
-					BL->has_scissor=TL->has_scissor=TR->has_scissor=BR->has_scissor = q->has_scissor;
-					BL->scissor=TL->scissor=TR->scissor=BR->scissor = q->scissor;
-					
-					number_of_rendered_quads += 1;
-				}
-			}
-		}
-		
-		{
-		    D3D11_MAPPED_SUBRESOURCE buffer_mapping;
-			hr = ID3D11DeviceContext_Map(d3d11_context, (ID3D11Resource*)d3d11_quad_vbo, 0, D3D11_MAP_WRITE_DISCARD, 0, &buffer_mapping);
-			d3d11_check_hr(hr);
-			memcpy(buffer_mapping.pData, d3d11_staging_quad_buffer, number_of_rendered_quads*sizeof(D3D11_Vertex)*4);
-			ID3D11DeviceContext_Unmap(d3d11_context, (ID3D11Resource*)d3d11_quad_vbo, 0);
-		}
-		
-		///
-		// Draw call
-		d3d11_draw_call(number_of_rendered_quads, textures, num_textures, bind_textures, frame->highest_bound_slot_index+1, frame, render_target);
-    }
-    
-    
+void d3d11_reserve_quad_extras(u64 extra_count) {
+	// Always have one so there's something to bind
+	extra_count = max(extra_count, 1);
+	if (extra_count <= d3d11_quad_extra_buffer_count) return;
+	
+	if (d3d11_quad_extra_buffer) {
+		D3D11Release(d3d11_quad_extra_srv);
+		D3D11Release(d3d11_quad_extra_buffer);
+	}
+	
+	u64 new_count = get_next_power_of_two(extra_count);
+	
+	D3D11_BUFFER_DESC desc = ZERO(D3D11_BUFFER_DESC);
+	desc.Usage = D3D11_USAGE_DYNAMIC; 
+	desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	desc.ByteWidth = new_count*sizeof(Gfx_Quad_Extra);
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	desc.StructureByteStride = sizeof(Gfx_Quad_Extra);
+	HRESULT hr = ID3D11Device_CreateBuffer(d3d11_device, &desc, 0, &d3d11_quad_extra_buffer);
+	assert(SUCCEEDED(hr), "CreateBuffer failed");
+	
+	D3D11_SHADER_RESOURCE_VIEW_DESC srv_desc = ZERO(D3D11_SHADER_RESOURCE_VIEW_DESC);
+	srv_desc.Format = DXGI_FORMAT_UNKNOWN;
+	srv_desc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+	srv_desc.Buffer.FirstElement = 0;
+	srv_desc.Buffer.NumElements = new_count;
+	hr = ID3D11Device_CreateShaderResourceView(d3d11_device, (ID3D11Resource*)d3d11_quad_extra_buffer, &srv_desc, &d3d11_quad_extra_srv);
+	d3d11_check_hr(hr);
+	
+	d3d11_quad_extra_buffer_count = new_count;
+	
+	log_verbose("Grew quad extra buffer to %d extras.", d3d11_quad_extra_buffer_count);
+}
+
+// gfx_interface.c impl
+void gfx_render_draw_frame(Draw_Frame *frame, Gfx_Image *render_target) {
+	assert(context.thread_id == d3d11_thread_id, "gfx_ functions must be called on the main thread");
+	
+	HRESULT hr;
+	
+	
+	Gfx_Pack_Input input = draw_frame_get_pack_input(frame);
+	
+	u64 number_of_quads = input.quad_count;
+	if (number_of_quads == 0) return;
+	
+	///
+	// This is where we convert quads to instances. It should be very fast as all it's doing is mostly
+	// copying and some minor computing, and it's split over threads for big frames.
+	// Most computation is done in draw_quad_projected in drawing.c.
+	// This way, we could easily build different draw frames on different threads and then render them
+	// here on the main thread.
+	//
+	gfx_pack_begin(&d3d11_quad_pack, &input);
+	
+	d3d11_reserve_quad_instances(number_of_quads);
+	d3d11_reserve_quad_extras(d3d11_quad_pack.extra_count);
+	
+	// Written straight into the buffers. We only write and never read, so it's fine
+	// that the mapped memory is write combined.
+	D3D11_MAPPED_SUBRESOURCE instance_mapping;
+	hr = ID3D11DeviceContext_Map(d3d11_context, (ID3D11Resource*)d3d11_quad_instance_buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &instance_mapping);
+	d3d11_check_hr(hr);
+	D3D11_MAPPED_SUBRESOURCE extra_mapping;
+	hr = ID3D11DeviceContext_Map(d3d11_context, (ID3D11Resource*)d3d11_quad_extra_buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &extra_mapping);
+	d3d11_check_hr(hr);
+	
+	gfx_pack_write_instances(&d3d11_quad_pack, &input, (Gfx_Quad_Instance*)instance_mapping.pData, (Gfx_Quad_Extra*)extra_mapping.pData);
+	
+	ID3D11DeviceContext_Unmap(d3d11_context, (ID3D11Resource*)d3d11_quad_instance_buffer, 0);
+	ID3D11DeviceContext_Unmap(d3d11_context, (ID3D11Resource*)d3d11_quad_extra_buffer, 0);
+	
+	d3d11_quad_upload_stats.quad_count   += number_of_quads;
+	d3d11_quad_upload_stats.extra_count  += d3d11_quad_pack.extra_count;
+	d3d11_quad_upload_stats.bytes        += number_of_quads*sizeof(Gfx_Quad_Instance) + d3d11_quad_pack.extra_count*sizeof(Gfx_Quad_Extra);
+	d3d11_quad_upload_stats.vertex_bytes += number_of_quads*4*sizeof(Gfx_Quad_Vertex);
+	d3d11_quad_upload_stats.draw_call_count += d3d11_quad_pack.batch_count;
+	
+	ID3D11ShaderResourceView *bind_textures[MAX_BOUND_IMAGES];
+	u64 num_bind_textures = frame->highest_bound_slot_index+1;
+	for (int i = 0; i < frame->highest_bound_slot_index+1; i += 1) {
+		bind_textures[i] = frame->bound_images[i]->gfx_handle;
+	}
+	
+	// One draw call per GFX_PACK_MAX_TEXTURES textures
+	for (u64 i = 0; i < d3d11_quad_pack.batch_count; i++) {
+		Gfx_Pack_Batch *batch = &d3d11_quad_pack.batches[i];
+		d3d11_draw_call(batch->first_quad, batch->quad_count, (ID3D11ShaderResourceView**)batch->textures, batch->texture_count, bind_textures, num_bind_textures, frame, render_target);
+	}
 }
 void gfx_render_draw_frame_to_window(Draw_Frame *frame) {
 	gfx_render_draw_frame(frame, 0);
@@ -910,6 +773,9 @@ void gfx_update() {
 	// Clear window & render global draw frame to window
 	gfx_render_draw_frame_to_window(&draw_frame);
 	draw_frame_reset(&draw_frame);
+	
+	d3d11_last_quad_upload_stats = d3d11_quad_upload_stats;
+	d3d11_quad_upload_stats = ZERO(Gfx_Quad_Upload_Stats);
 
 	IDXGISwapChain1_Present(d3d11_swap_chain, window.enable_vsync, window.enable_vsync ? 0 : DXGI_PRESENT_ALLOW_TEARING);
 	ID3D11DeviceContext_ClearRenderTargetView(d3d11_context, d3d11_window_render_target_view, (float*)&window.clear_color);
@@ -920,54 +786,18 @@ void gfx_update() {
 	
 }
 
-void gfx_reserve_vbo_bytes(u64 number_of_bytes) {
+void gfx_reserve_quad_instances(u64 quad_count) {
 	assert(context.thread_id == d3d11_thread_id, "gfx_ functions must be called on the main thread");
+	
+	d3d11_reserve_quad_instances(quad_count);
+}
+void gfx_reserve_vbo_bytes(u64 number_of_bytes) {
+	u64 quad_bytes = 4*sizeof(Gfx_Quad_Vertex);
+	gfx_reserve_quad_instances((number_of_bytes + quad_bytes - 1)/quad_bytes);
+}
 
-	// #Copypaste
-	if (number_of_bytes > d3d11_quad_vbo_size) {
-		if (d3d11_quad_vbo) {
-			D3D11Release(d3d11_quad_vbo);
-			dealloc(get_heap_allocator(), d3d11_staging_quad_buffer);
-		}
-		u64 new_size = get_next_power_of_two(number_of_bytes);
-		u64 new_indices = ((new_size/sizeof(D3D11_Vertex))/4)*6;
-		
-		d3d11_quad_vbo_size = new_size;
-		
-		d3d11_staging_quad_buffer = alloc(get_heap_allocator(), d3d11_quad_vbo_size);
-		u32 *indices = (u32*)alloc(get_heap_allocator(), new_indices*sizeof(u32));
-		
-		for (u64 i = 0; i < new_indices; i += 6) {
-			indices[i + 0] = (i/6)*4 + 0;
-			indices[i + 1] = (i/6)*4 + 1;
-			indices[i + 2] = (i/6)*4 + 2;
-			indices[i + 3] = (i/6)*4 + 0;
-			indices[i + 4] = (i/6)*4 + 2;
-			indices[i + 5] = (i/6)*4 + 3;
-		}
-		
-		D3D11_BUFFER_DESC desc = ZERO(D3D11_BUFFER_DESC);
-		desc.Usage = D3D11_USAGE_DYNAMIC; 
-		desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-		desc.ByteWidth = new_size;
-		desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-		HRESULT hr = ID3D11Device_CreateBuffer(d3d11_device, &desc, 0, &d3d11_quad_vbo);
-		assert(SUCCEEDED(hr), "CreateBuffer failed");
-		
-		D3D11_BUFFER_DESC index_buffer_desc = ZERO(D3D11_BUFFER_DESC);
-		index_buffer_desc.Usage = D3D11_USAGE_DEFAULT;
-		index_buffer_desc.ByteWidth = new_indices*sizeof(u32);
-		index_buffer_desc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-		index_buffer_desc.CPUAccessFlags = 0;
-		
-		D3D11_SUBRESOURCE_DATA index_data = {};
-		index_data.pSysMem = indices;
-		
-		ID3D11Device_CreateBuffer(d3d11_device, &index_buffer_desc, &index_data, &d3d11_quad_ibo);
-		
-		
-		log_verbose("Grew quad vbo to %d bytes.", d3d11_quad_vbo_size);
-	}
+Gfx_Quad_Upload_Stats gfx_get_quad_upload_stats() {
+	return d3d11_last_quad_upload_stats;
 }
 
 
@@ -1045,6 +875,7 @@ void gfx_set_image_data(Gfx_Image *image, u32 x, u32 y, u32 w, u32 h, void *data
 	assert(context.thread_id == d3d11_thread_id, "gfx_ functions must be called on the main thread");
 	
     assert(image && data, "Bad parameters passed to gfx_set_image_data");
+    assert(!image->atlas_page, "gfx_set_image_data can't be used on images in a Gfx_Atlas");
 
     ID3D11ShaderResourceView *view = image->gfx_handle;
     ID3D11Resource *resource = NULL;
@@ -1185,18 +1016,22 @@ gfx_shader_recompile_with_extension(string ext_source, u64 cbuffer_size) {
 
 const char *d3d11_image_shader_source = RAW_STRING(
 	
+// #Volatile Gfx_Quad_Instance and the input layout in d3d11_compile_vertex_shader
 struct VS_INPUT
 {
-    float4 position : POSITION;
-    float2 uv : TEXCOORD;
-    float2 self_uv : SELF_UV;
+    float4 corners[2] : CORNERS;
+    float4 uv_rect : UV_RECT;
     float4 color : COLOR;
-    int texture_index : TEXTURE_INDEX;
-    uint type : TYPE;
-    uint sampler_index : SAMPLER_INDEX;
-    uint has_scissor : HAS_SCISSOR;
-    float4 userdata[$VERTEX_USER_DATA_COUNT] : USERDATA;
-    float4 scissor : SCISSOR;
+    uint flags : QUAD_FLAGS;
+    uint extra_index : EXTRA_INDEX;
+    uint vertex_id : SV_VertexID;
+};
+
+// #Volatile Gfx_Quad_Extra
+struct Quad_Extra
+{
+    float4 scissor;
+    float4 userdata[$VERTEX_USER_DATA_COUNT];
 };
 
 struct PS_INPUT
@@ -1216,22 +1051,43 @@ struct PS_INPUT
 
 
 
+// Above the textures so it doesn't collide with images bound to the pixel shader
+StructuredBuffer<Quad_Extra> quad_extras : register(t63);
+
+// Expands one quad instance to the corner vertex_id is.
+// 0 bottom_left, 1 top_left, 2 top_right, 3 bottom_right.
+// #Volatile GFX_QUAD_INSTANCE_ flags in gfx_pack.c
 PS_INPUT vs_main(VS_INPUT input)
 {
+    uint corner = input.vertex_id;
+    float4 corner_pair = input.corners[corner / 2];
+    float2 position = (corner % 2 == 0) ? corner_pair.xy : corner_pair.zw;
+    float2 self_uv = float2(corner >= 2 ? 1.0 : 0.0, (corner == 1 || corner == 2) ? 1.0 : 0.0);
+
     PS_INPUT output;
-    output.position_screen = input.position;
-    output.position = input.position;
-    output.uv = input.uv;
+    output.position_screen = float4(position, 0.0, 1.0);
+    output.position = output.position_screen;
+    output.uv = float2(corner >= 2 ? input.uv_rect.z : input.uv_rect.x, (corner == 1 || corner == 2) ? input.uv_rect.w : input.uv_rect.y);
     output.color = input.color;
-    output.texture_index = input.texture_index;
-    output.type          = input.type;
-    output.sampler_index = input.sampler_index;
-    output.self_uv = input.self_uv;
+    output.texture_index = ((int)(input.flags << 24)) >> 24;
+    output.type          = (input.flags >> 8) & 255;
+    output.sampler_index = (input.flags >> 16) & 255;
+    output.self_uv = self_uv;
+    
+    output.has_scissor = (input.flags >> 24) & 1;
+    output.scissor = float4(0.0, 0.0, 0.0, 0.0);
 	for (int i = 0; i < $VERTEX_USER_DATA_COUNT; i++) {
-    	output.userdata[i] = input.userdata[i];
+    	output.userdata[i] = float4(0.0, 0.0, 0.0, 0.0);
+	}
+	if (input.flags & (3u << 24)) {
+		Quad_Extra extra = quad_extras[input.extra_index];
+		output.scissor = extra.scissor;
+		if (input.flags & (1u << 25)) {
+			for (int i = 0; i < $VERTEX_USER_DATA_COUNT; i++) {
+		    	output.userdata[i] = extra.userdata[i];
+			}
+		}
 	}
-	output.scissor = input.scissor;
-	output.has_scissor = input.has_scissor;
     return output;
 }
 
@@ -1390,6 +1246,7 @@ $INJECT_PIXEL_POST_PROCESS
 \043define QUAD_TYPE_REGULAR 0\n
 \043define QUAD_TYPE_TEXT 1\n
 \043define QUAD_TYPE_CIRCLE 2\n
+\043define QUAD_TYPE_TEXT_SDF 3\n
 float4 ps_main(PS_INPUT input) : SV_TARGET
 {
 
@@ -1406,9 +1263,14 @@ float4 ps_main(PS_INPUT input) : SV_TARGET
 		} else {
 			return pixel_shader_extension(input, input.color);
 		}
-	} else if (input.type == QUAD_TYPE_TEXT) {
+	} else if (input.type == QUAD_TYPE_TEXT || input.type == QUAD_TYPE_TEXT_SDF) {
 		if (input.texture_index >= 0 && input.texture_index < 32 && input.sampler_index >= 0  && input.sampler_index <= 3) {
 			float alpha = sample_texture(input.texture_index, input.sampler_index, input.uv).x;
+			if (input.type == QUAD_TYPE_TEXT_SDF) {
+				// Outline is at 128/255, faded over about a pixel whatever the scale
+				float edge_width = max(fwidth(alpha), 0.0001);
+				alpha = saturate((alpha - 128.0/255.0)/edge_width + 0.5);
+			}
 			return pixel_shader_extension(input, float4(1.0, 1.0, 1.0, alpha)*input.color);
 		} else {
 			return pixel_shader_extension(input, input.color);
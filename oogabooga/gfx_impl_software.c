@@ -0,0 +1,971 @@
+/*
+
+	Software renderer (GFX_RENDERER_SOFTWARE)
+
+	Renders draw frames on the CPU. Useful on machines without a working gpu driver and for
+	checking what a frame renders to without a gpu.
+
+		#define GFX_RENDERER GFX_RENDERER_SOFTWARE
+		#include "oogabooga/oogabooga.c"
+
+	It does everything in gfx_interface.c except shader extensions, which are hlsl.
+	Images, render targets, gfx_read_image_data, scissors, z sorting and the regular, text,
+	SDF text and circle quad types all work like in the d3d11 renderer:
+
+		- Same blend state: color is alpha blended and alpha is added.
+		- Same samplers: nearest or linear depending on the quad's min/mag filter, clamped uv's.
+		- Row 0 of a render target is the top of the frame.
+		- A pixel center exactly on an edge shared by two quads is only drawn by one of them
+		  (top-left rule), so tiles put next to each other don't blend twice on their seams.
+
+	A frame is rendered in 3 passes, each split over threads with parallel_for:
+
+		1. Setup: quads are z sorted and each quad gets its edge functions, uv planes and
+		   pixel bounds (clipped to the target and its scissor).
+		2. Binning: the target is split into SOFTWARE_TILE_SIZE tiles and each row of tiles
+		   collects the quads touching its tiles, in draw order.
+		3. Rasterizing: each tile draws its quads. Tiles don't share pixels so they don't need
+		   to sync, and a tile stays in cache while all of its quads are blended into it.
+
+	Pixels are shaded SOFTWARE_LANES at a time, 8 with AVX2 or 4 with SSE2 depending on what
+	the compiler is allowed to use (see cpu.c).
+
+	The window is presented with GDI, which doesn't vsync, so window.enable_vsync is ignored.
+	Linux has no window yet, so it renders but doesn't present. It's the default renderer there.
+
+*/
+
+#if !COMPILER_CAN_DO_SSE2
+	// #Portability
+	#error "The software renderer needs at least SSE2"
+#endif
+
+#define SOFTWARE_TILE_SIZE 64
+// Below this many quads per thread, threading the setup costs more than it gains
+#define SOFTWARE_MIN_QUADS_PER_RANGE 4096
+
+const Gfx_Handle GFX_INVALID_HANDLE = 0;
+
+typedef struct Software_Texture {
+	u32 width, height, channels;
+	// In pixels. Render targets are padded to whole tiles so the rasterizer can always
+	// load and store full lanes.
+	u32 stride;
+	u8 *pixels;
+} Software_Texture;
+
+///
+// Lanes
+#if COMPILER_CAN_DO_AVX2
+	#define SOFTWARE_LANES 8
+	typedef __m256  Software_F32;
+	typedef __m256i Software_U32;
+	#define sw_f32(x)            _mm256_set1_ps(x)
+	#define sw_u32(x)            _mm256_set1_epi32(x)
+	#define sw_lane_index()      _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7)
+	#define sw_add               _mm256_add_ps
+	#define sw_sub               _mm256_sub_ps
+	#define sw_mul               _mm256_mul_ps
+	#define sw_min               _mm256_min_ps
+	#define sw_max               _mm256_max_ps
+	#define sw_and               _mm256_and_ps
+	#define sw_or                _mm256_or_ps
+	#define sw_gt(a, b)          _mm256_cmp_ps(a, b, _CMP_GT_OQ)
+	#define sw_ge(a, b)          _mm256_cmp_ps(a, b, _CMP_GE_OQ)
+	#define sw_lt(a, b)          _mm256_cmp_ps(a, b, _CMP_LT_OQ)
+	#define sw_le(a, b)          _mm256_cmp_ps(a, b, _CMP_LE_OQ)
+	#define sw_eq(a, b)          _mm256_cmp_ps(a, b, _CMP_EQ_OQ)
+	#define sw_select(m, a, b)   _mm256_blendv_ps(b, a, m)
+	#define sw_mask_bits         _mm256_movemask_ps
+	#define sw_load_u32(p)       _mm256_loadu_si256((const __m256i*)(p))
+	#define sw_store_u32(p, x)   _mm256_storeu_si256((__m256i*)(p), x)
+	#define sw_load_f32          _mm256_loadu_ps
+	#define sw_store_f32         _mm256_storeu_ps
+	#define sw_u32_and           _mm256_and_si256
+	#define sw_u32_or            _mm256_or_si256
+	#define sw_u32_shl           _mm256_slli_epi32
+	#define sw_u32_shr           _mm256_srli_epi32
+	#define sw_u32_to_f32        _mm256_cvtepi32_ps
+	#define sw_round_to_u32      _mm256_cvtps_epi32
+	#define sw_truncate_to_u32   _mm256_cvttps_epi32
+	#define sw_as_u32            _mm256_castps_si256
+	#define sw_as_f32            _mm256_castsi256_ps
+#else
+	#define SOFTWARE_LANES 4
+	typedef __m128  Software_F32;
+	typedef __m128i Software_U32;
+	#define sw_f32(x)            _mm_set1_ps(x)
+	#define sw_u32(x)            _mm_set1_epi32(x)
+	#define sw_lane_index()      _mm_setr_ps(0, 1, 2, 3)
+	#define sw_add               _mm_add_ps
+	#define sw_sub               _mm_sub_ps
+	#define sw_mul               _mm_mul_ps
+	#define sw_min               _mm_min_ps
+	#define sw_max               _mm_max_ps
+	#define sw_and               _mm_and_ps
+	#define sw_or                _mm_or_ps
+	#define sw_gt                _mm_cmpgt_ps
+	#define sw_ge                _mm_cmpge_ps
+	#define sw_lt                _mm_cmplt_ps
+	#define sw_le                _mm_cmple_ps
+	#define sw_eq                _mm_cmpeq_ps
+	#define sw_select(m, a, b)   _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b))
+	#define sw_mask_bits         _mm_movemask_ps
+	#define sw_load_u32(p)       _mm_loadu_si128((const __m128i*)(p))
+	#define sw_store_u32(p, x)   _mm_storeu_si128((__m128i*)(p), x)
+	#define sw_load_f32          _mm_loadu_ps
+	#define sw_store_f32         _mm_storeu_ps
+	#define sw_u32_and           _mm_and_si128
+	#define sw_u32_or            _mm_or_si128
+	#define sw_u32_shl           _mm_slli_epi32
+	#define sw_u32_shr           _mm_srli_epi32
+	#define sw_u32_to_f32        _mm_cvtepi32_ps
+	#define sw_round_to_u32      _mm_cvtps_epi32
+	#define sw_truncate_to_u32   _mm_cvttps_epi32
+	#define sw_as_u32            _mm_castps_si128
+	#define sw_as_f32            _mm_castsi128_ps
+#endif
+
+// A quad is drawn as one convex polygon when it's a parallelogram (anything drawn with an
+// affine xform), otherwise as 2 triangles split like the d3d11 renderer splits it.
+typedef struct Software_Polygon {
+	// Inside where a*dx + b*dy + c >= 0, dx and dy relative to Software_Quad.ref.
+	// Unused edges are always inside.
+	float32 edge_a[4];
+	float32 edge_b[4];
+	float32 edge_c[4];
+	// Top-left rule: pixel centers exactly on an edge only count for top and left edges
+	u32 edge_inclusive[4];
+
+	// u, v, self_u, self_v as base + ddx*dx + ddy*dy
+	float32 attribute_base[4];
+	float32 attribute_ddx[4];
+	float32 attribute_ddy[4];
+
+	// Min or mag filter, depending on if the image is shrunk
+	bool linear;
+	// How many texels a pixel step covers, at most
+	float32 texels_per_pixel;
+} Software_Polygon;
+
+typedef struct Software_Quad {
+	Vector2 ref;
+	// In 0-1
+	Vector4 color;
+	Software_Texture *texture;
+	u8 type;
+	u8 polygon_count;
+	Software_Polygon polygons[2];
+} Software_Quad;
+
+// Kept next to the quads so binning doesn't need to stream the big Software_Quad's.
+// Pixels in [min, max), max_x <= min_x if the quad is culled.
+typedef struct Software_Quad_Bounds {
+	s32 min_x, min_y, max_x, max_y;
+} Software_Quad_Bounds;
+
+// Quads touching a tile, as indices into the sorted quads
+typedef struct Software_Tile_Bin {
+	u32 *quads;
+	u64 count;
+	u64 capacity;
+} Software_Tile_Bin;
+
+typedef struct Software_Frame_Job {
+	const Gfx_Pack_Input *input;
+	const u32 *order;
+	Software_Texture *target;
+	Software_Quad *quads;
+	Software_Quad_Bounds *bounds;
+	u64 quad_count;
+	Software_Tile_Bin *bins;
+	u32 tiles_x;
+	u32 tiles_y;
+} Software_Frame_Job;
+
+// #Global
+u64 software_thread_id = 0;
+
+Software_Texture software_window_target = {0};
+// BGRA copy of software_window_target for GDI
+u32 *software_present_pixels = 0;
+
+Software_Quad *software_quads = 0;
+Software_Quad_Bounds *software_quad_bounds = 0;
+u32 *software_order = 0;
+u64 *software_sort_keys = 0;
+u64 software_quad_capacity = 0;
+
+Software_Tile_Bin *software_bins = 0;
+u64 software_bin_count = 0;
+
+// Counted during a frame, moved to the last frame stats in gfx_update
+Gfx_Quad_Upload_Stats software_quad_stats = {0};
+Gfx_Quad_Upload_Stats software_last_quad_stats = {0};
+
+void software_init_texture(Software_Texture *texture, u32 width, u32 height, u32 channels, bool render_target) {
+	*texture = ZERO(Software_Texture);
+	texture->width = width;
+	texture->height = height;
+	texture->channels = channels;
+	texture->stride = render_target ? (u32)align_next(width, SOFTWARE_TILE_SIZE) : width;
+
+	// #Memory #Heapalloc
+	u64 size = max((u64)texture->stride*height*channels, 1);
+	texture->pixels = alloc(get_heap_allocator(), size);
+	memset(texture->pixels, 0, size);
+}
+void software_deinit_texture(Software_Texture *texture) {
+	if (texture->pixels) dealloc(get_heap_allocator(), texture->pixels);
+	*texture = ZERO(Software_Texture);
+}
+
+void software_clear_texture(Software_Texture *texture, Vector4 color) {
+	assert(texture->channels == 4, "Only 4 channel images can be cleared");
+	u32 pixel = gfx_pack_color_rgba8(color);
+	u32 *pixels = (u32*)texture->pixels;
+	u64 count = (u64)texture->stride*texture->height;
+	for (u64 i = 0; i < count; i++) pixels[i] = pixel;
+}
+
+void software_resize_window_target() {
+	software_deinit_texture(&software_window_target);
+	if (software_present_pixels) dealloc(get_heap_allocator(), software_present_pixels);
+
+	u32 width  = (u32)max(window.pixel_width, 1);
+	u32 height = (u32)max(window.pixel_height, 1);
+	software_init_texture(&software_window_target, width, height, 4, true);
+	software_clear_texture(&software_window_target, window.clear_color);
+
+	// #Memory #Heapalloc
+	software_present_pixels = alloc(get_heap_allocator(), (u64)software_window_target.stride*height*sizeof(u32));
+
+	log_verbose("Resized software framebuffer to %dx%d", width, height);
+}
+
+void software_reserve_quads(u64 quad_count) {
+	if (quad_count <= software_quad_capacity) return;
+
+	Allocator heap = get_heap_allocator();
+	if (software_quads) {
+		dealloc(heap, software_quads);
+		dealloc(heap, software_quad_bounds);
+		dealloc(heap, software_order);
+		dealloc(heap, software_sort_keys);
+	}
+
+	// #Memory #Heapalloc
+	u64 capacity = get_next_power_of_two(quad_count);
+	software_quads       = alloc(heap, capacity*sizeof(Software_Quad));
+	software_quad_bounds = alloc(heap, capacity*sizeof(Software_Quad_Bounds));
+	software_order       = alloc(heap, capacity*sizeof(u32));
+	software_sort_keys   = alloc(heap, capacity*2*sizeof(u64));
+	software_quad_capacity = capacity;
+
+	log_verbose("Grew software quad buffers to %d quads.", software_quad_capacity);
+}
+
+void software_reserve_bins(u64 bin_count) {
+	if (bin_count <= software_bin_count) return;
+
+	// #Memory #Heapalloc
+	software_bins = reallocate(get_heap_allocator(), software_bins, software_bin_count*sizeof(Software_Tile_Bin), bin_count*sizeof(Software_Tile_Bin));
+	memset(software_bins + software_bin_count, 0, (bin_count-software_bin_count)*sizeof(Software_Tile_Bin));
+	software_bin_count = bin_count;
+}
+
+///
+// Setup
+
+// vertices are in pixels, y down. attributes is u, v, self_u, self_v per vertex.
+// Returns false if the polygon has no area.
+bool software_setup_polygon(Software_Polygon *polygon, Vector2 ref, const Vector2 *vertices, const Vector4 *attributes, u32 vertex_count, Software_Texture *texture, u32 flags) {
+
+	Vector2 e1 = v2_sub(vertices[1], vertices[0]);
+	Vector2 e2 = v2_sub(vertices[2], vertices[0]);
+	float32 det = e1.x*e2.y - e1.y*e2.x;
+	if (fabs(det) < 0.0001f) return false;
+	float32 orientation = det > 0 ? 1.0f : -1.0f;
+
+	for (u32 i = 0; i < 4; i++) {
+		if (i >= vertex_count) {
+			polygon->edge_a[i] = 0;
+			polygon->edge_b[i] = 0;
+			polygon->edge_c[i] = 1;
+			polygon->edge_inclusive[i] = 0;
+			continue;
+		}
+		Vector2 from = vertices[i];
+		Vector2 to   = vertices[(i+1)%vertex_count];
+
+		float32 a = -(to.y - from.y)*orientation;
+		float32 b =  (to.x - from.x)*orientation;
+		polygon->edge_a[i] = a;
+		polygon->edge_b[i] = b;
+		// Relative to ref so edges shared by the two triangles of a quad cancel out exactly
+		polygon->edge_c[i] = -(a*(from.x - ref.x) + b*(from.y - ref.y));
+		// Interior is to the right of a left edge and below a top edge (y is down)
+		polygon->edge_inclusive[i] = (a > 0 || (a == 0 && b > 0)) ? 0xffffffff : 0;
+	}
+
+	// Planes through the first 3 vertices. For a parallelogram the 4th is on them too.
+	Vector4 d1 = v4_sub(attributes[1], attributes[0]);
+	Vector4 d2 = v4_sub(attributes[2], attributes[0]);
+	float32 inv_det = 1.0f/det;
+	for (u32 i = 0; i < 4; i++) {
+		float32 ddx = (d1.data[i]*e2.y - d2.data[i]*e1.y)*inv_det;
+		float32 ddy = (d2.data[i]*e1.x - d1.data[i]*e2.x)*inv_det;
+		polygon->attribute_ddx[i] = ddx;
+		polygon->attribute_ddy[i] = ddy;
+		polygon->attribute_base[i] = attributes[0].data[i] - ddx*(vertices[0].x - ref.x) - ddy*(vertices[0].y - ref.y);
+	}
+
+	polygon->linear = false;
+	if (texture) {
+		// Texels per pixel along x and y, like the gpu decides between the min and mag filter
+		float32 ux = polygon->attribute_ddx[0]*texture->width;
+		float32 vx = polygon->attribute_ddx[1]*texture->height;
+		float32 uy = polygon->attribute_ddy[0]*texture->width;
+		float32 vy = polygon->attribute_ddy[1]*texture->height;
+		float32 rho_squared = max(ux*ux + vx*vx, uy*uy + vy*vy);
+		polygon->texels_per_pixel = sqrt(rho_squared);
+		if (rho_squared > 1.0f) polygon->linear = (flags & DRAW_QUAD_FLAG_MIN_FILTER_LINEAR) != 0;
+		else                    polygon->linear = (flags & DRAW_QUAD_FLAG_MAG_FILTER_LINEAR) != 0;
+	}
+
+	return true;
+}
+
+void software_setup_quad(Software_Frame_Job *job, u64 n, Software_Quad *quad, Software_Quad_Bounds *bounds) {
+	const Gfx_Pack_Input *input = job->input;
+	Software_Texture *target = job->target;
+
+	float32 width  = (float32)target->width;
+	float32 height = (float32)target->height;
+
+	// Clip space to pixels, y down
+	Vector2 p[4];
+	Vector2 p_min = v2( INFINITY,  INFINITY);
+	Vector2 p_max = v2(-INFINITY, -INFINITY);
+	for (u32 i = 0; i < 4; i++) {
+		Vector2 c = input->positions[n*4 + i];
+		p[i] = v2((c.x + 1.0f)*0.5f*width, (1.0f - c.y)*0.5f*height);
+		p_min = v2(min(p_min.x, p[i].x), min(p_min.y, p[i].y));
+		p_max = v2(max(p_max.x, p[i].x), max(p_max.y, p[i].y));
+	}
+
+	// Pixels whose center can be inside
+	float32 x1 = max(ceilf(p_min.x - 0.5f), 0.0f);
+	float32 y1 = max(ceilf(p_min.y - 0.5f), 0.0f);
+	float32 x2 = min(floorf(p_max.x - 0.5f) + 1.0f, width);
+	float32 y2 = min(floorf(p_max.y - 0.5f) + 1.0f, height);
+
+	u32 flags = input->flags[n];
+	if (flags & DRAW_QUAD_FLAG_HAS_SCISSOR) {
+		// Flip y, scissors are pushed with y up. Same as in gfx_pack.c.
+		Vector4 scissor = input->scissors[n];
+		float32 sy1 = input->window_pixel_height - scissor.y2;
+		float32 sy2 = input->window_pixel_height - scissor.y1;
+		x1 = max(x1, ceilf(scissor.x1 - 0.5f));
+		x2 = min(x2, ceilf(scissor.x2 - 0.5f));
+		y1 = max(y1, ceilf(sy1 - 0.5f));
+		y2 = min(y2, ceilf(sy2 - 0.5f));
+	}
+
+	quad->polygon_count = 0;
+	*bounds = ZERO(Software_Quad_Bounds);
+	// Also false for NaN's
+	if (!(x1 < x2 && y1 < y2)) return;
+
+	bounds->min_x = (s32)x1;
+	bounds->min_y = (s32)y1;
+	bounds->max_x = (s32)x2;
+	bounds->max_y = (s32)y2;
+
+	Gfx_Pack_Image *image = input->images[n];
+
+	quad->ref = p[0];
+	Vector4 color = input->colors[n];
+	quad->color = v4(clamp(color.r, 0.0f, 1.0f), clamp(color.g, 0.0f, 1.0f), clamp(color.b, 0.0f, 1.0f), clamp(color.a, 0.0f, 1.0f));
+	quad->texture = image ? (Software_Texture*)image->gfx_handle : 0;
+	quad->type = (u8)(flags >> DRAW_QUAD_FLAG_TYPE_SHIFT);
+
+	// u, v, self_u, self_v for bottom_left, top_left, top_right, bottom_right
+	Vector4 uv = image ? input->uvs[n] : v4(0, 0, 0, 0);
+	Vector4 attributes[4] = {
+		v4(uv.x1, uv.y1, 0, 0),
+		v4(uv.x1, uv.y2, 0, 1),
+		v4(uv.x2, uv.y2, 1, 1),
+		v4(uv.x2, uv.y1, 1, 0),
+	};
+
+	Vector2 skew = v2_sub(v2_add(p[0], p[2]), v2_add(p[1], p[3]));
+	if (fabs(skew.x) < 0.001f && fabs(skew.y) < 0.001f) {
+		if (software_setup_polygon(&quad->polygons[0], quad->ref, p, attributes, 4, quad->texture, flags)) {
+			quad->polygon_count = 1;
+		}
+	} else {
+		Vector2 second[3]    = { p[0], p[2], p[3] };
+		Vector4 second_at[3] = { attributes[0], attributes[2], attributes[3] };
+		if (software_setup_polygon(&quad->polygons[quad->polygon_count], quad->ref, p, attributes, 3, quad->texture, flags)) {
+			quad->polygon_count += 1;
+		}
+		if (software_setup_polygon(&quad->polygons[quad->polygon_count], quad->ref, second, second_at, 3, quad->texture, flags)) {
+			quad->polygon_count += 1;
+		}
+	}
+
+	// Nothing to draw
+	if (quad->polygon_count == 0) *bounds = ZERO(Software_Quad_Bounds);
+}
+
+void software_setup_quads_range(u64 first, u64 end, u64 range_index, void *data) {
+	Software_Frame_Job *job = (Software_Frame_Job*)data;
+	const Gfx_Pack_Input *input = job->input;
+
+	for (u64 i = first; i < end; i++) {
+		u64 n = job->order ? job->order[i] : i;
+
+		assert(input->z[n] <= MAX_Z, "Z is too high. Z is %d, Max is %d.", input->z[n], MAX_Z);
+		assert(input->z[n] >= (-MAX_Z+1), "Z is too low. Z is %d, Min is %d.", input->z[n], -MAX_Z+1);
+
+		software_setup_quad(job, n, &job->quads[i], &job->bounds[i]);
+	}
+}
+
+///
+// Binning
+
+// False if no polygon of the quad can cover a pixel center in the rect.
+// Only used for quads covering more than one tile, to skip the tiles rotated quads miss.
+bool software_quad_touches_rect(Software_Quad *quad, s32 x1, s32 y1, s32 x2, s32 y2) {
+	// First and last pixel centers
+	float32 dx1 = x1 + 0.5f - quad->ref.x;
+	float32 dy1 = y1 + 0.5f - quad->ref.y;
+	float32 dx2 = x2 - 0.5f - quad->ref.x;
+	float32 dy2 = y2 - 0.5f - quad->ref.y;
+
+	for (u32 p = 0; p < quad->polygon_count; p++) {
+		Software_Polygon *polygon = &quad->polygons[p];
+		bool touches = true;
+		for (u32 i = 0; i < 4; i++) {
+			float32 a = polygon->edge_a[i];
+			float32 b = polygon->edge_b[i];
+			// Edge function is biggest in the corner it points to
+			float32 e = a*(a > 0 ? dx2 : dx1) + b*(b > 0 ? dy2 : dy1) + polygon->edge_c[i];
+			if (e < 0) {
+				touches = false;
+				break;
+			}
+		}
+		if (touches) return true;
+	}
+	return false;
+}
+
+inline void software_push_to_bin(Software_Tile_Bin *bin, u32 quad_index) {
+	if (bin->count >= bin->capacity) {
+		u64 capacity = max(bin->capacity*2, 256);
+		// #Memory #Heapalloc
+		bin->quads = reallocate(get_heap_allocator(), bin->quads, bin->capacity*sizeof(u32), capacity*sizeof(u32));
+		bin->capacity = capacity;
+	}
+	bin->quads[bin->count] = quad_index;
+	bin->count += 1;
+}
+
+// Each range owns whole rows of tiles, so each bin is only written by one thread, and quads
+// are walked in draw order so the bins come out in draw order.
+void software_bin_quads_range(u64 first_row, u64 end_row, u64 range_index, void *data) {
+	Software_Frame_Job *job = (Software_Frame_Job*)data;
+
+	for (u64 row = first_row; row < end_row; row++) {
+		Software_Tile_Bin *row_bins = job->bins + row*job->tiles_x;
+		for (u32 x = 0; x < job->tiles_x; x++) row_bins[x].count = 0;
+
+		s32 row_y1 = (s32)row*SOFTWARE_TILE_SIZE;
+		s32 row_y2 = row_y1 + SOFTWARE_TILE_SIZE;
+
+		for (u64 i = 0; i < job->quad_count; i++) {
+			Software_Quad_Bounds b = job->bounds[i];
+			if (b.max_x <= b.min_x || b.min_y >= row_y2 || b.max_y <= row_y1) continue;
+
+			u32 first_tile = b.min_x/SOFTWARE_TILE_SIZE;
+			u32 last_tile  = (b.max_x-1)/SOFTWARE_TILE_SIZE;
+			bool spans_tiles = first_tile != last_tile || b.min_y < row_y1 || b.max_y > row_y2;
+
+			for (u32 x = first_tile; x <= last_tile; x++) {
+				if (spans_tiles) {
+					s32 x1 = max(b.min_x, (s32)x*SOFTWARE_TILE_SIZE);
+					s32 x2 = min(b.max_x, (s32)(x+1)*SOFTWARE_TILE_SIZE);
+					s32 y1 = max(b.min_y, row_y1);
+					s32 y2 = min(b.max_y, row_y2);
+					if (!software_quad_touches_rect(&job->quads[i], x1, y1, x2, y2)) continue;
+				}
+				software_push_to_bin(&row_bins[x], (u32)i);
+			}
+		}
+	}
+}
+
+///
+// Rasterizing
+
+// RGBA8 (r in the lowest byte) to 0-255 floats
+inline void software_unpack_pixels(Software_U32 pixels, Software_F32 *r, Software_F32 *g, Software_F32 *b, Software_F32 *a) {
+	Software_U32 byte_mask = sw_u32(0xff);
+	*r = sw_u32_to_f32(sw_u32_and(pixels, byte_mask));
+	*g = sw_u32_to_f32(sw_u32_and(sw_u32_shr(pixels, 8), byte_mask));
+	*b = sw_u32_to_f32(sw_u32_and(sw_u32_shr(pixels, 16), byte_mask));
+	*a = sw_u32_to_f32(sw_u32_shr(pixels, 24));
+}
+// Channels need to be in 0-255
+inline Software_U32 software_pack_pixels(Software_F32 r, Software_F32 g, Software_F32 b, Software_F32 a) {
+	Software_U32 result = sw_round_to_u32(r);
+	result = sw_u32_or(result, sw_u32_shl(sw_round_to_u32(g), 8));
+	result = sw_u32_or(result, sw_u32_shl(sw_round_to_u32(b), 16));
+	result = sw_u32_or(result, sw_u32_shl(sw_round_to_u32(a), 24));
+	return result;
+}
+
+// 0-255 per channel. Like d3d11, missing channels read as 0 and missing alpha as 1.
+inline void software_fetch_texel(Software_Texture *texture, s32 x, s32 y, float32 *result) {
+	u8 *texel = texture->pixels + ((u64)y*texture->stride + x)*texture->channels;
+	switch (texture->channels) {
+		case 1: result[0] = texel[0]; result[1] = 0;        result[2] = 0;        result[3] = 255;      break;
+		case 2: result[0] = texel[0]; result[1] = texel[1]; result[2] = 0;        result[3] = 255;      break;
+		case 4: result[0] = texel[0]; result[1] = texel[1]; result[2] = texel[2]; result[3] = texel[3]; break;
+		default: panic("Bad channel count in software texture");
+	}
+}
+// Same as a d3d11 sampler with clamped addressing
+void software_sample(Software_Texture *texture, float32 u, float32 v, bool linear, float32 *result) {
+	s32 w = (s32)texture->width;
+	s32 h = (s32)texture->height;
+	if (!linear) {
+		s32 x = (s32)clamp(u*w, 0.0f, (float32)(w-1));
+		s32 y = (s32)clamp(v*h, 0.0f, (float32)(h-1));
+		software_fetch_texel(texture, x, y, result);
+		return;
+	}
+
+	float32 tu = u*w - 0.5f;
+	float32 tv = v*h - 0.5f;
+	float32 fx = floorf(tu);
+	float32 fy = floorf(tv);
+	float32 ax = tu - fx;
+	float32 ay = tv - fy;
+	s32 x0 = (s32)clamp(fx,        0.0f, (float32)(w-1));
+	s32 x1 = (s32)clamp(fx + 1.0f, 0.0f, (float32)(w-1));
+	s32 y0 = (s32)clamp(fy,        0.0f, (float32)(h-1));
+	s32 y1 = (s32)clamp(fy + 1.0f, 0.0f, (float32)(h-1));
+
+	float32 t00[4], t10[4], t01[4], t11[4];
+	software_fetch_texel(texture, x0, y0, t00);
+	software_fetch_texel(texture, x1, y0, t10);
+	software_fetch_texel(texture, x0, y1, t01);
+	software_fetch_texel(texture, x1, y1, t11);
+	for (u32 i = 0; i < 4; i++) {
+		float32 top    = t00[i] + (t10[i] - t00[i])*ax;
+		float32 bottom = t01[i] + (t11[i] - t01[i])*ax;
+		result[i] = top + (bottom - top)*ay;
+	}
+}
+
+void software_sample_lanes(Software_Texture *texture, Software_F32 u, Software_F32 v, bool linear, Software_F32 mask, Software_F32 *r, Software_F32 *g, Software_F32 *b, Software_F32 *a) {
+
+	if (!linear && texture->channels == 4) {
+		// The common case, nearest sampled rgba sprites
+		Software_F32 w = sw_f32((float32)texture->width);
+		Software_F32 h = sw_f32((float32)texture->height);
+		Software_U32 x = sw_truncate_to_u32(sw_min(sw_max(sw_mul(u, w), sw_f32(0)), sw_sub(w, sw_f32(1))));
+		Software_U32 y = sw_truncate_to_u32(sw_min(sw_max(sw_mul(v, h), sw_f32(0)), sw_sub(h, sw_f32(1))));
+#if COMPILER_CAN_DO_AVX2
+		Software_U32 index = _mm256_add_epi32(_mm256_mullo_epi32(y, sw_u32((s32)texture->stride)), x);
+		Software_U32 texels = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), (const int*)texture->pixels, index, sw_as_u32(mask), 4);
+#else
+		alignat(16) s32 xs[SOFTWARE_LANES];
+		alignat(16) s32 ys[SOFTWARE_LANES];
+		alignat(16) u32 fetched[SOFTWARE_LANES];
+		sw_store_u32(xs, x);
+		sw_store_u32(ys, y);
+		u32 *pixels = (u32*)texture->pixels;
+		for (u32 i = 0; i < SOFTWARE_LANES; i++) {
+			fetched[i] = pixels[(u64)ys[i]*texture->stride + xs[i]];
+		}
+		Software_U32 texels = sw_load_u32(fetched);
+#endif
+		software_unpack_pixels(texels, r, g, b, a);
+		return;
+	}
+
+	// #Speed
+	// Linear filtering and 1 or 2 channel images go one lane at a time
+	alignat(32) float32 us[SOFTWARE_LANES];
+	alignat(32) float32 vs[SOFTWARE_LANES];
+	alignat(32) float32 channels[4][SOFTWARE_LANES];
+	sw_store_f32(us, u);
+	sw_store_f32(vs, v);
+	int lanes = sw_mask_bits(mask);
+	for (u32 i = 0; i < SOFTWARE_LANES; i++) {
+		float32 texel[4] = {0};
+		if (lanes & (1 << i)) software_sample(texture, us[i], vs[i], linear, texel);
+		channels[0][i] = texel[0];
+		channels[1][i] = texel[1];
+		channels[2][i] = texel[2];
+		channels[3][i] = texel[3];
+	}
+	*r = sw_load_f32(channels[0]);
+	*g = sw_load_f32(channels[1]);
+	*b = sw_load_f32(channels[2]);
+	*a = sw_load_f32(channels[3]);
+}
+
+// Draws the part of the polygon in [x1, x2) [y1, y2). x2 can't be past the tile the rect is in.
+void software_rasterize_polygon(Software_Texture *target, Software_Quad *quad, Software_Polygon *polygon, s32 x1, s32 y1, s32 x2, s32 y2) {
+
+	Software_F32 zero = sw_f32(0);
+	Software_F32 edge_a[4];
+	Software_F32 edge_inclusive[4];
+	for (u32 i = 0; i < 4; i++) {
+		edge_a[i] = sw_f32(polygon->edge_a[i]);
+		edge_inclusive[i] = sw_as_f32(sw_u32((s32)polygon->edge_inclusive[i]));
+	}
+
+	Software_Texture *texture = quad->texture;
+	bool is_circle = quad->type == QUAD_TYPE_CIRCLE;
+	bool is_text   = quad->type == QUAD_TYPE_TEXT;
+	bool is_sdf    = quad->type == QUAD_TYPE_TEXT_SDF;
+	
+	// Distance field values fade from 0 to 1 alpha over about a pixel around the outline, like
+	// fwidth does in the shader
+	float32 sdf_edge_width = max(FONT_SDF_DISTANCE_PER_TEXEL*polygon->texels_per_pixel, 0.0001f);
+	Software_F32 sdf_scale  = sw_f32(1.0f/sdf_edge_width);
+	Software_F32 sdf_offset = sw_f32(0.5f - (float32)FONT_SDF_ON_EDGE/sdf_edge_width);
+
+	// Source color in 0-255 and alpha in 0-1
+	Software_F32 color_r = sw_f32(quad->color.r*255.0f);
+	Software_F32 color_g = sw_f32(quad->color.g*255.0f);
+	Software_F32 color_b = sw_f32(quad->color.b*255.0f);
+	Software_F32 color_a = sw_f32(quad->color.a);
+
+	Software_F32 lane_x = sw_add(sw_lane_index(), sw_f32(0.5f - quad->ref.x));
+	Software_F32 min_x = sw_f32((float32)x1);
+	Software_F32 max_x = sw_f32((float32)x2);
+
+	s32 first_x = x1 & ~(SOFTWARE_LANES-1);
+
+	for (s32 y = y1; y < y2; y++) {
+		float32 dy = y + 0.5f - quad->ref.y;
+
+		Software_F32 row_edge[4];
+		for (u32 i = 0; i < 4; i++) row_edge[i] = sw_f32(polygon->edge_b[i]*dy + polygon->edge_c[i]);
+		Software_F32 row_attribute[4];
+		for (u32 i = 0; i < 4; i++) row_attribute[i] = sw_f32(polygon->attribute_base[i] + polygon->attribute_ddy[i]*dy);
+
+		u32 *row = (u32*)target->pixels + (u64)y*target->stride;
+
+		for (s32 x = first_x; x < x2; x += SOFTWARE_LANES) {
+			Software_F32 px = sw_add(sw_f32((float32)x), sw_lane_index());
+			Software_F32 dx = sw_add(sw_f32((float32)x), lane_x);
+
+			Software_F32 mask = sw_and(sw_ge(px, min_x), sw_lt(px, max_x));
+			for (u32 i = 0; i < 4; i++) {
+				Software_F32 e = sw_add(sw_mul(edge_a[i], dx), row_edge[i]);
+				mask = sw_and(mask, sw_or(sw_gt(e, zero), sw_and(sw_eq(e, zero), edge_inclusive[i])));
+			}
+			if (!sw_mask_bits(mask)) continue;
+
+			if (is_circle) {
+				Software_F32 su = sw_sub(sw_add(row_attribute[2], sw_mul(sw_f32(polygon->attribute_ddx[2]), dx)), sw_f32(0.5f));
+				Software_F32 sv = sw_sub(sw_add(row_attribute[3], sw_mul(sw_f32(polygon->attribute_ddx[3]), dx)), sw_f32(0.5f));
+				Software_F32 dist_squared = sw_add(sw_mul(su, su), sw_mul(sv, sv));
+				mask = sw_and(mask, sw_le(dist_squared, sw_f32(0.25f)));
+				if (!sw_mask_bits(mask)) continue;
+			}
+
+			Software_F32 src_r = color_r;
+			Software_F32 src_g = color_g;
+			Software_F32 src_b = color_b;
+			Software_F32 src_a = color_a;
+			if (texture) {
+				Software_F32 u = sw_add(row_attribute[0], sw_mul(sw_f32(polygon->attribute_ddx[0]), dx));
+				Software_F32 v = sw_add(row_attribute[1], sw_mul(sw_f32(polygon->attribute_ddx[1]), dx));
+				Software_F32 tr, tg, tb, ta;
+				software_sample_lanes(texture, u, v, polygon->linear, mask, &tr, &tg, &tb, &ta);
+
+				Software_F32 inv_255 = sw_f32(1.0f/255.0f);
+				if (is_text) {
+					// Glyph coverage is in the red channel
+					src_a = sw_mul(color_a, sw_mul(tr, inv_255));
+				} else if (is_sdf) {
+					Software_F32 coverage = sw_add(sw_mul(tr, sdf_scale), sdf_offset);
+					coverage = sw_min(sw_max(coverage, zero), sw_f32(1.0f));
+					src_a = sw_mul(color_a, coverage);
+				} else {
+					src_r = sw_mul(color_r, sw_mul(tr, inv_255));
+					src_g = sw_mul(color_g, sw_mul(tg, inv_255));
+					src_b = sw_mul(color_b, sw_mul(tb, inv_255));
+					src_a = sw_mul(color_a, sw_mul(ta, inv_255));
+				}
+			}
+
+			// Color: src*src_a + dst*(1-src_a), alpha: src_a + dst_a
+			Software_U32 dst = sw_load_u32(row + x);
+			Software_F32 dst_r, dst_g, dst_b, dst_a;
+			software_unpack_pixels(dst, &dst_r, &dst_g, &dst_b, &dst_a);
+
+			Software_F32 out_r = sw_add(dst_r, sw_mul(sw_sub(src_r, dst_r), src_a));
+			Software_F32 out_g = sw_add(dst_g, sw_mul(sw_sub(src_g, dst_g), src_a));
+			Software_F32 out_b = sw_add(dst_b, sw_mul(sw_sub(src_b, dst_b), src_a));
+			Software_F32 out_a = sw_min(sw_add(dst_a, sw_mul(src_a, sw_f32(255.0f))), sw_f32(255.0f));
+
+			Software_U32 result = software_pack_pixels(out_r, out_g, out_b, out_a);
+			sw_store_u32(row + x, sw_as_u32(sw_select(mask, sw_as_f32(result), sw_as_f32(dst))));
+		}
+	}
+}
+
+void software_rasterize_tiles_range(u64 first, u64 end, u64 range_index, void *data) {
+	Software_Frame_Job *job = (Software_Frame_Job*)data;
+	Software_Texture *target = job->target;
+
+	for (u64 tile = first; tile < end; tile++) {
+		Software_Tile_Bin *bin = &job->bins[tile];
+		if (bin->count == 0) continue;
+
+		s32 tile_x1 = (s32)(tile % job->tiles_x)*SOFTWARE_TILE_SIZE;
+		s32 tile_y1 = (s32)(tile / job->tiles_x)*SOFTWARE_TILE_SIZE;
+		s32 tile_x2 = min(tile_x1 + SOFTWARE_TILE_SIZE, (s32)target->width);
+		s32 tile_y2 = min(tile_y1 + SOFTWARE_TILE_SIZE, (s32)target->height);
+
+		for (u64 i = 0; i < bin->count; i++) {
+			u32 quad_index = bin->quads[i];
+			Software_Quad *quad = &job->quads[quad_index];
+			Software_Quad_Bounds b = job->bounds[quad_index];
+
+			s32 x1 = max(b.min_x, tile_x1);
+			s32 y1 = max(b.min_y, tile_y1);
+			s32 x2 = min(b.max_x, tile_x2);
+			s32 y2 = min(b.max_y, tile_y2);
+
+			for (u32 p = 0; p < quad->polygon_count; p++) {
+				software_rasterize_polygon(target, quad, &quad->polygons[p], x1, y1, x2, y2);
+			}
+		}
+	}
+}
+
+void software_present() {
+	Software_Texture *target = &software_window_target;
+
+	// Swap r and b for GDI
+	u64 count = (u64)target->stride*target->height;
+	u32 *src = (u32*)target->pixels;
+	Software_U32 green_alpha = sw_u32((s32)0xff00ff00);
+	Software_U32 byte_mask = sw_u32(0xff);
+	for (u64 i = 0; i < count; i += SOFTWARE_LANES) {
+		Software_U32 p = sw_load_u32(src + i);
+		Software_U32 r = sw_u32_and(p, byte_mask);
+		Software_U32 b = sw_u32_and(sw_u32_shr(p, 16), byte_mask);
+		Software_U32 bgra = sw_u32_or(sw_u32_and(p, green_alpha), sw_u32_or(sw_u32_shl(r, 16), b));
+		sw_store_u32(software_present_pixels + i, bgra);
+	}
+
+#if TARGET_OS == WINDOWS
+	BITMAPINFO info = ZERO(BITMAPINFO);
+	info.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+	info.bmiHeader.biWidth = target->stride;
+	// Negative for top-down rows
+	info.bmiHeader.biHeight = -(LONG)target->height;
+	info.bmiHeader.biPlanes = 1;
+	info.bmiHeader.biBitCount = 32;
+	info.bmiHeader.biCompression = BI_RGB;
+
+	HDC dc = GetDC(window._os_handle);
+	SetDIBitsToDevice(dc, 0, 0, target->width, target->height, 0, 0, 0, target->height, software_present_pixels, &info, DIB_RGB_COLORS);
+	ReleaseDC(window._os_handle, dc);
+#elif TARGET_OS == LINUX
+	// #Portability
+	// No window on linux yet (see os_impl_linux.c), the frame just stays in software_present_pixels
+#else
+	// #Portability
+	#error "The software renderer can't present on this os"
+#endif
+}
+
+// gfx_interface.c impl
+void gfx_init() {
+	software_thread_id = context.thread_id;
+
+	draw_frame_init(&draw_frame);
+	draw_frame_reset(&draw_frame);
+
+	software_resize_window_target();
+
+	log_info("Software renderer init done, %d lanes per pixel batch", SOFTWARE_LANES);
+}
+
+void gfx_render_draw_frame(Draw_Frame *frame, Gfx_Image *render_target) {
+	assert(context.thread_id == software_thread_id, "gfx_ functions must be called on the main thread");
+
+	Software_Texture *target = &software_window_target;
+	if (render_target) {
+		assert(render_target->gfx_render_target, "Image was not created as a render target");
+		target = render_target->gfx_render_target;
+	}
+
+	Gfx_Pack_Input input = draw_frame_get_pack_input(frame);
+
+	u64 number_of_quads = input.quad_count;
+	if (number_of_quads == 0) return;
+	assert(number_of_quads <= UINT32_MAX, "Too many quads to render");
+
+	software_reserve_quads(number_of_quads);
+	bool has_order = false;
+	if (input.enable_z_sorting) {
+		Gfx_Pack_Sort_Path path = gfx_pack_sort_by_z(&input, software_order, software_sort_keys);
+		has_order = path != GFX_PACK_SORT_ALREADY_SORTED;
+	}
+
+	u32 tiles_x = (target->width  + SOFTWARE_TILE_SIZE-1)/SOFTWARE_TILE_SIZE;
+	u32 tiles_y = (target->height + SOFTWARE_TILE_SIZE-1)/SOFTWARE_TILE_SIZE;
+	u64 tile_count = (u64)tiles_x*tiles_y;
+	software_reserve_bins(tile_count);
+
+	Software_Frame_Job job = ZERO(Software_Frame_Job);
+	job.input = &input;
+	job.order = has_order ? software_order : 0;
+	job.target = target;
+	job.quads = software_quads;
+	job.bounds = software_quad_bounds;
+	job.quad_count = number_of_quads;
+	job.bins = software_bins;
+	job.tiles_x = tiles_x;
+	job.tiles_y = tiles_y;
+
+	u64 range_count = clamp(number_of_quads/SOFTWARE_MIN_QUADS_PER_RANGE, 1, parallel_for_get_thread_count());
+	parallel_for(number_of_quads, range_count, software_setup_quads_range, &job);
+
+	// Every row walks all quad bounds, only worth threading with a lot of them
+	u64 bin_range_count = number_of_quads >= SOFTWARE_MIN_QUADS_PER_RANGE ? tiles_y : 1;
+	parallel_for(tiles_y, bin_range_count, software_bin_quads_range, &job);
+
+	// One tile per range, so threads that get cheap tiles just pick up more of them
+	parallel_for(tile_count, tile_count, software_rasterize_tiles_range, &job);
+
+	software_quad_stats.quad_count      += number_of_quads;
+	software_quad_stats.bytes           += number_of_quads*(sizeof(Software_Quad) + sizeof(Software_Quad_Bounds));
+	software_quad_stats.vertex_bytes    += number_of_quads*4*sizeof(Gfx_Quad_Vertex);
+	software_quad_stats.draw_call_count += 1;
+}
+void gfx_render_draw_frame_to_window(Draw_Frame *frame) {
+	gfx_render_draw_frame(frame, 0);
+}
+
+void gfx_clear_render_target(Gfx_Image *render_target, Vector4 clear_color) {
+	assert(context.thread_id == software_thread_id, "gfx_ functions must be called on the main thread");
+	assert(render_target->gfx_render_target, "Image was not created as a render target");
+	software_clear_texture(render_target->gfx_render_target, clear_color);
+}
+
+void gfx_update() {
+	if (window.should_close) return;
+
+	if ((u32)window.pixel_width != software_window_target.width || (u32)window.pixel_height != software_window_target.height) {
+		software_resize_window_target();
+	}
+
+	gfx_render_draw_frame_to_window(&draw_frame);
+	draw_frame_reset(&draw_frame);
+
+	software_last_quad_stats = software_quad_stats;
+	software_quad_stats = ZERO(Gfx_Quad_Upload_Stats);
+
+	software_present();
+	software_clear_texture(&software_window_target, window.clear_color);
+}
+
+void gfx_reserve_quad_instances(u64 quad_count) {
+	assert(context.thread_id == software_thread_id, "gfx_ functions must be called on the main thread");
+
+	software_reserve_quads(quad_count);
+}
+void gfx_reserve_vbo_bytes(u64 number_of_bytes) {
+	u64 quad_bytes = 4*sizeof(Gfx_Quad_Vertex);
+	gfx_reserve_quad_instances((number_of_bytes + quad_bytes - 1)/quad_bytes);
+}
+
+Gfx_Quad_Upload_Stats gfx_get_quad_upload_stats() {
+	return software_last_quad_stats;
+}
+
+void gfx_init_image(Gfx_Image *image, void *initial_data, bool render_target) {
+	assert(context.thread_id == software_thread_id, "gfx_ functions must be called on the main thread");
+	assert(image->channels > 0 && image->channels <= 4 && image->channels != 3, "Only 1, 2 or 4 channels allowed on images. Got %d", image->channels);
+	assert(!render_target || image->channels == 4, "The software renderer can only render to 4 channel images");
+
+	// #Memory #Heapalloc
+	Software_Texture *texture = alloc(get_heap_allocator(), sizeof(Software_Texture));
+	software_init_texture(texture, image->width, image->height, image->channels, render_target);
+
+	if (initial_data) {
+		u64 row_size = (u64)image->width*image->channels;
+		for (u32 y = 0; y < image->height; y++) {
+			memcpy(texture->pixels + (u64)y*texture->stride*texture->channels, (u8*)initial_data + y*row_size, row_size);
+		}
+	}
+
+	image->gfx_handle = texture;
+	image->gfx_render_target = render_target ? texture : 0;
+
+	log_verbose("Created a software image%s of width %d and height %d.", render_target ? STR(" render target") : STR(""), image->width, image->height);
+}
+void gfx_set_image_data(Gfx_Image *image, u32 x, u32 y, u32 w, u32 h, void *data) {
+	assert(context.thread_id == software_thread_id, "gfx_ functions must be called on the main thread");
+
+	assert(image && data, "Bad parameters passed to gfx_set_image_data");
+	assert(!image->atlas_page, "gfx_set_image_data can't be used on images in a Gfx_Atlas");
+	assert(image->gfx_handle, "Invalid image passed to gfx_set_image_data");
+	assert(x+w <= image->width && y+h <= image->height, "Specified subregion in image is out of bounds");
+
+	Software_Texture *texture = image->gfx_handle;
+	u64 row_size = (u64)w*texture->channels;
+	for (u32 row = 0; row < h; row++) {
+		memcpy(texture->pixels + ((u64)(y+row)*texture->stride + x)*texture->channels, (u8*)data + row*row_size, row_size);
+	}
+}
+void gfx_read_image_data(Gfx_Image *image, u32 x, u32 y, u32 w, u32 h, void *output) {
+	assert(context.thread_id == software_thread_id, "gfx_ functions must be called on the main thread");
+	assert(x+w <= image->width && y+h <= image->height, "Specified subregion in image is out of bounds");
+
+	Software_Texture *texture = image->gfx_handle;
+	u64 row_size = (u64)w*texture->channels;
+	for (u32 row = 0; row < h; row++) {
+		memcpy((u8*)output + row*row_size, texture->pixels + ((u64)(y+row)*texture->stride + x)*texture->channels, row_size);
+	}
+}
+void gfx_deinit_image(Gfx_Image *image) {
+	assert(context.thread_id == software_thread_id, "gfx_ functions must be called on the main thread");
+
+	Software_Texture *texture = image->gfx_handle;
+	software_deinit_texture(texture);
+	dealloc(get_heap_allocator(), texture);
+	image->gfx_handle = 0;
+	image->gfx_render_target = 0;
+}
+
+bool gfx_compile_shader_extension(string ext_source, u64 cbuffer_size, Gfx_Shader_Extension *result) {
+	*result = (Gfx_Shader_Extension){0};
+	log_error("Shader extensions are not supported by the software renderer");
+	return false;
+}
+
+void gfx_destroy_shader_extension(Gfx_Shader_Extension shader_extension) {
+}
+
+// DEPRECATED #Cleanup
+bool
+gfx_shader_recompile_with_extension(string ext_source, u64 cbuffer_size) {
+	return false;
+}
@@ -10,6 +10,14 @@
 	
 	typedef struct { ID3D11PixelShader *ps; ID3D11Buffer *cbuffer; u64 cbuffer_size; } Gfx_Shader_Extension;
 	
+#elif GFX_RENDERER == GFX_RENDERER_SOFTWARE
+	// Pixels in memory, see gfx_impl_software.c
+	typedef struct Software_Texture * Gfx_Handle;
+	typedef struct Software_Texture * Gfx_Render_Target_Handle;
+	
+	// Shader extensions are hlsl, which the software renderer can't run
+	typedef struct { void *ps; void *cbuffer; u64 cbuffer_size; } Gfx_Shader_Extension;
+	
 #elif GFX_RENDERER == GFX_RENDERER_VULKAN
 	#error "We only have a D3D11 renderer at the moment"
 #elif GFX_RENDERER == GFX_RENDERER_METAL
@@ -19,33 +27,44 @@
 #endif
 
 
-#ifdef VERTEX_2D_USER_DATA_COUNT
-	#error VERTEX_2D_USER_DATA_COUNT has been renamed to VERTEX_USER_DATA_COUNT, please use that instead
-#endif
-#ifndef VERTEX_USER_DATA_COUNT
-	#define VERTEX_USER_DATA_COUNT 1
-#endif
-
 ogb_instance const Gfx_Handle GFX_INVALID_HANDLE;
 // #Volatile reflected in 2D batch shader
 #define QUAD_TYPE_REGULAR 0
 #define QUAD_TYPE_TEXT 1
 #define QUAD_TYPE_CIRCLE 2
+// Text from a signed distance field, see font_enable_sdf
+#define QUAD_TYPE_TEXT_SDF 3
 
 typedef enum Gfx_Filter_Mode {
 	GFX_FILTER_MODE_NEAREST,
 	GFX_FILTER_MODE_LINEAR,
 } Gfx_Filter_Mode;
 
+// #Volatile must start like Gfx_Pack_Image in gfx_pack.c
 typedef struct Gfx_Image {
 	u32 width, height, channels;
 	Gfx_Handle gfx_handle;
 	Gfx_Render_Target_Handle gfx_render_target;
 	Allocator allocator;
+	// Set for images in a Gfx_Atlas (see gfx_atlas.c). Drawing them draws atlas_page with the
+	// uv's remapped into atlas_uv.
+	struct Gfx_Image *atlas_page;
+	Vector4 atlas_uv;
 } Gfx_Image;
 
 typedef struct Draw_Frame Draw_Frame;
 
+// What the renderer uploaded for quads during the last gfx_update frame
+typedef struct Gfx_Quad_Upload_Stats {
+	u64 quad_count;
+	// Quads with scissor or userdata, which upload a Gfx_Quad_Extra next to the instance
+	u64 extra_count;
+	u64 bytes;
+	// What it would have been with 4 Gfx_Quad_Vertex's per quad
+	u64 vertex_bytes;
+	u64 draw_call_count;
+} Gfx_Quad_Upload_Stats;
+
 // Implemented per renderer
 
 ogb_instance void 
@@ -72,9 +91,17 @@ gfx_init();
 ogb_instance void 
 gfx_update();
 
+// Makes room for this many quads up front so the buffers don't grow a bit at a time
+ogb_instance void 
+gfx_reserve_quad_instances(u64 quad_count);
+
+// Old way of reserving, in bytes of 4 Gfx_Quad_Vertex's per quad. Use gfx_reserve_quad_instances.
 ogb_instance void 
 gfx_reserve_vbo_bytes(u64 number_of_bytes);
 
+ogb_instance Gfx_Quad_Upload_Stats
+gfx_get_quad_upload_stats();
+
 ogb_instance bool
 gfx_compile_shader_extension(string ext_source, u64 cbuffer_size, Gfx_Shader_Extension *result);
 
@@ -89,6 +116,7 @@ DEPRECATED(ogb_instance bool gfx_shader_recompile_with_extension(string ext_sour
 Gfx_Image *make_image(u32 width, u32 height, u32 channels, void *initial_data, Allocator allocator) {
 	// This is annoying but I did this long ago because stuff was a bit different and now I can't really change it :(
 	Gfx_Image *image = alloc(allocator, sizeof(Gfx_Image));
+	*image = ZERO(Gfx_Image);
 	
 	assert(channels > 0 && channels <= 4, "Only 1, 2, 3 or 4 channels allowed on images. Got %d", channels);
 	
@@ -105,6 +133,7 @@ Gfx_Image *make_image(u32 width, u32 height, u32 channels, void *initial_data, A
 Gfx_Image *make_image_render_target(u32 width, u32 height, u32 channels, void *initial_data, Allocator allocator) {
 	// This is annoying but I did this long ago because stuff was a bit different and now I can't really change it :(
 	Gfx_Image *image = alloc(allocator, sizeof(Gfx_Image));
+	*image = ZERO(Gfx_Image);
 	
 	assert(channels > 0 && channels <= 4, "Only 1, 2, 3 or 4 channels allowed on images. Got %d", channels);
 	
@@ -124,6 +153,7 @@ Gfx_Image *load_image_from_disk(string path, Allocator allocator) {
     if (!ok) return 0;
 
     Gfx_Image *image = alloc(allocator, sizeof(Gfx_Image));
+    *image = ZERO(Gfx_Image);
     
     int width, height, channels;
     stbi_set_flip_vertically_on_load(1);
@@ -156,9 +186,24 @@ Gfx_Image *load_image_from_disk(string path, Allocator allocator) {
 
 void 
 delete_image(Gfx_Image *image) {
+	assert(!image->atlas_page, "Images in a Gfx_Atlas are removed with atlas_remove_image");
       // Free the image data allocated by stb_image
     image->width = 0;
     image->height = 0;
     gfx_deinit_image(image);
     dealloc(image->allocator, image);
 }
+
+Gfx_Image *render_target_pool_make_image(u32 width, u32 height, u32 channels, void *userdata) {
+	Render_Target_Pool *pool = (Render_Target_Pool*)userdata;
+	return make_image_render_target(width, height, channels, 0, pool->allocator);
+}
+void render_target_pool_delete_image(Gfx_Image *image, void *userdata) {
+	delete_image(image);
+}
+// See gfx_target_pool.c
+Render_Target_Pool *make_render_target_pool(u64 max_unused_frames, Allocator allocator) {
+	Render_Target_Pool *pool = make_render_target_pool_with_procs(max_unused_frames, render_target_pool_make_image, render_target_pool_delete_image, 0, allocator);
+	pool->userdata = pool;
+	return pool;
+}
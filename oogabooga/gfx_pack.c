@@ -0,0 +1,678 @@
+
+/*
+	Quad packing
+
+	This is the CPU part of rendering a draw frame which doesn't care about the graphics api:
+	z sorting, giving each image a texture slot, splitting into batches of at most
+	GFX_PACK_MAX_TEXTURES textures and writing the quads in one of two formats:
+	
+		- Gfx_Quad_Instance: 64 bytes per quad, the vertex shader expands it to the 4 corners.
+		  Scissor and userdata are only stored for quads that have them, as a Gfx_Quad_Extra
+		  which the instance points to. This is what the d3d11 renderer uses.
+		- Gfx_Quad_Vertex: 4 fat vertices per quad (over 300 bytes), for renderers that can't
+		  expand quads in a shader.
+	
+	The renderer just uploads the result once and makes one draw call per batch.
+
+	It only reads plain streams (see Draw_Quad_Streams) and doesn't touch any renderer or
+	window state, so it can run on any thread and it's in OOGABOOGA_HEADLESS builds too, which
+	means we can test and benchmark it without a gpu.
+
+	Z sorting is stable. When the submitting side passes Gfx_Pack_Input.z_layers (Draw_Frame
+	does), quads that came in z order aren't sorted at all, and a few distinct z layers are
+	sorted with one counting pass. Only many distinct z's out of order need the radix sort.
+
+	Vertex writing is split over threads with parallel_for for large frames. Each quad knows
+	where it goes (quad i in sorted order is vertices [i*4, i*4+4)) and its texture slot is
+	decided up front, so the ranges don't need to sync.
+
+	Usage:
+
+		Gfx_Pack pack = ZERO(Gfx_Pack); // Keep it around, the buffers are reused
+
+		Gfx_Pack_Input input = ...;
+		gfx_pack_begin(&pack, &input); // Sorts and decides batches, pack.extra_count is now known
+		
+		Gfx_Quad_Instance *instances = alloc(allocator, pack.quad_count*sizeof(Gfx_Quad_Instance));
+		Gfx_Quad_Extra *extras = alloc(allocator, pack.extra_count*sizeof(Gfx_Quad_Extra));
+		gfx_pack_write_instances(&pack, &input, instances, extras);
+
+		for (u64 i = 0; i < pack.batch_count; i++) {
+			Gfx_Pack_Batch *batch = &pack.batches[i];
+			// Draw batch->quad_count quads starting at batch->first_quad with batch->textures bound
+		}
+	
+	Or gfx_pack_quads(&pack, &input, vertices) to do it all in one go with Gfx_Quad_Vertex's.
+*/
+
+#ifdef VERTEX_2D_USER_DATA_COUNT
+	#error VERTEX_2D_USER_DATA_COUNT has been renamed to VERTEX_USER_DATA_COUNT, please use that instead
+#endif
+#ifndef VERTEX_USER_DATA_COUNT
+	#define VERTEX_USER_DATA_COUNT 1
+#endif
+
+// We use radix sort so the exact bit count is of importance
+#define MAX_Z_BITS 21
+#define MAX_Z ((1 << MAX_Z_BITS)/2)
+
+// Packed per quad in Draw_Quad_Streams.flags
+#define DRAW_QUAD_FLAG_MIN_FILTER_LINEAR (1 << 0)
+#define DRAW_QUAD_FLAG_MAG_FILTER_LINEAR (1 << 1)
+#define DRAW_QUAD_FLAG_HAS_SCISSOR       (1 << 2)
+#define DRAW_QUAD_FLAG_HAS_USERDATA      (1 << 3)
+#define DRAW_QUAD_FLAG_FILTER_MASK       (DRAW_QUAD_FLAG_MIN_FILTER_LINEAR | DRAW_QUAD_FLAG_MAG_FILTER_LINEAR)
+#define DRAW_QUAD_FLAG_TYPE_SHIFT        8
+
+// #Volatile reflected in 2D batch shader
+#define GFX_PACK_MAX_TEXTURES 32
+
+// Below this many quads per thread, threading costs more than it gains
+#define GFX_PACK_MIN_QUADS_PER_RANGE 16384
+
+// 4 per quad for renderers which don't use Gfx_Quad_Instance
+// #Cleanup #Memory why am I doing alignat(16)?
+typedef struct alignat(16) Gfx_Quad_Vertex {
+
+	Vector4 color;
+	Vector4 position;
+	Vector2 uv;
+	Vector2 self_uv;
+	s8 texture_index;
+	u8 type;
+	u8 sampler;
+	u8 has_scissor;
+
+	Vector4 userdata[VERTEX_USER_DATA_COUNT];
+
+	Vector4 scissor;
+
+} Gfx_Quad_Vertex;
+
+// Gfx_Quad_Instance.flags
+// #Volatile reflected in vs_instanced_main in the 2D batch shader
+#define GFX_QUAD_INSTANCE_TEXTURE_INDEX_MASK 0xff // s8, -1 for no texture
+#define GFX_QUAD_INSTANCE_TYPE_SHIFT         8
+#define GFX_QUAD_INSTANCE_SAMPLER_SHIFT      16
+#define GFX_QUAD_INSTANCE_HAS_SCISSOR        (1 << 24)
+#define GFX_QUAD_INSTANCE_HAS_USERDATA       (1 << 25)
+
+// #Volatile input layout in gfx_impl_d3d11.c and vs_instanced_main in the 2D batch shader
+typedef struct Gfx_Quad_Instance {
+	// bottom_left, top_left, top_right, bottom_right in ndc
+	Vector2 corners[4];
+	// x1, y1, x2, y2, with the odd window size nudge already applied
+	Vector4 uv;
+	// RGBA8, r in the lowest byte
+	u32 color;
+	u32 flags;
+	// Into the Gfx_Quad_Extra's, only valid with GFX_QUAD_INSTANCE_HAS_SCISSOR or GFX_QUAD_INSTANCE_HAS_USERDATA
+	u32 extra_index;
+	u32 reserved;
+} Gfx_Quad_Instance;
+
+// Only for quads with scissor or userdata
+// #Volatile reflected in the 2D batch shader
+typedef struct Gfx_Quad_Extra {
+	// In window pixels, y down
+	Vector4 scissor;
+	Vector4 userdata[VERTEX_USER_DATA_COUNT];
+} Gfx_Quad_Extra;
+
+// Distinct z values seen while quads are submitted, kept by Draw_Quad_Streams as quads are
+// pushed. With these, z sorting can skip sorting when quads came in order, and otherwise
+// place each quad straight into its layer with one pass instead of a radix sort.
+#define GFX_PACK_MAX_Z_LAYERS 64
+typedef struct Gfx_Pack_Z_Layers {
+	// A quad had a lower z than the one before it
+	bool unordered;
+	// There were more than GFX_PACK_MAX_Z_LAYERS distinct z's, so z and quad_counts are incomplete
+	bool overflow;
+	s32 last_z;
+	u32 last_layer;
+	u32 count;
+	s32 z[GFX_PACK_MAX_Z_LAYERS];
+	u32 quad_counts[GFX_PACK_MAX_Z_LAYERS];
+} Gfx_Pack_Z_Layers;
+
+// Most quads have the same z as the one before, so that's one compare
+inline void gfx_pack_z_layers_add(Gfx_Pack_Z_Layers *layers, s32 z) {
+	if (layers->count > 0) {
+		if (z == layers->last_z) {
+			if (!layers->overflow) layers->quad_counts[layers->last_layer] += 1;
+			return;
+		}
+		if (z < layers->last_z) layers->unordered = true;
+	}
+	layers->last_z = z;
+	
+	if (layers->overflow) return;
+	
+	for (u32 i = 0; i < layers->count; i++) {
+		if (layers->z[i] == z) {
+			layers->last_layer = i;
+			layers->quad_counts[i] += 1;
+			return;
+		}
+	}
+	if (layers->count == GFX_PACK_MAX_Z_LAYERS) {
+		layers->overflow = true;
+		return;
+	}
+	layers->last_layer = layers->count;
+	layers->z[layers->count] = z;
+	layers->quad_counts[layers->count] = 1;
+	layers->count += 1;
+}
+
+// How gfx_pack_sort_by_z ended up sorting
+typedef enum Gfx_Pack_Sort_Path {
+	GFX_PACK_SORT_NONE = 0,
+	// Quads were submitted in z order, nothing to do
+	GFX_PACK_SORT_ALREADY_SORTED,
+	// Counting sort over the z layers
+	GFX_PACK_SORT_LAYERS,
+	// No layer info or too many layers
+	GFX_PACK_SORT_RADIX,
+} Gfx_Pack_Sort_Path;
+
+// The part of Gfx_Image the packing needs to know about.
+// #Volatile Gfx_Image must start with exactly these members
+typedef struct Gfx_Pack_Image {
+	u32 width, height, channels;
+	void *gfx_handle;
+} Gfx_Pack_Image;
+
+typedef struct Gfx_Pack_Input {
+	u64 quad_count;
+
+	// Same streams as Draw_Quad_Streams. uvs is only read for quads with an image,
+	// scissors for quads with DRAW_QUAD_FLAG_HAS_SCISSOR and userdata for quads with
+	// DRAW_QUAD_FLAG_HAS_USERDATA.
+	const Vector2 *positions;
+	const Vector4 *colors;
+	const Vector4 *uvs;
+	Gfx_Pack_Image *const *images;
+	const u32 *flags;
+	const s32 *z;
+	const Vector4 *scissors;
+	const Vector4 *userdata;
+
+	bool enable_z_sorting;
+	// Optional, what was seen of z while the quads were submitted. Must cover all quads.
+	// Without it, z sorting is always a radix sort.
+	const Gfx_Pack_Z_Layers *z_layers;
+
+	// Window size in points for the odd window size uv hack,
+	// and in pixels to flip the scissors.
+	u32 window_width;
+	u32 window_height;
+	u32 window_pixel_height;
+} Gfx_Pack_Input;
+
+typedef struct Gfx_Pack_Batch {
+	// In quads, into the packed vertices
+	u64 first_quad;
+	u64 quad_count;
+
+	void *textures[GFX_PACK_MAX_TEXTURES];
+	u64 texture_count;
+} Gfx_Pack_Batch;
+
+// Zero initialize and keep around, buffers only grow.
+typedef struct Gfx_Pack {
+	// Result of the last gfx_pack_quads
+	Gfx_Pack_Batch *batches;
+	u64 batch_count;
+	u64 quad_count;
+	// Quads with scissor or userdata, which need a Gfx_Quad_Extra
+	u64 extra_count;
+
+	u64 batch_capacity;
+	u64 quad_capacity;
+	// Sorted position -> index in the input streams. Only used with z sorting, and only valid
+	// if has_order since quads that came in order aren't sorted.
+	u32 *order;
+	u64 *sort_keys;
+	bool has_order;
+	Gfx_Pack_Sort_Path sort_path;
+	// Per quad in sorted order
+	s8 *texture_indices;
+	u32 *extra_indices;
+} Gfx_Pack;
+
+// #Volatile sampler slots in the renderer, indexed by the DRAW_QUAD_FLAG_FILTER_MASK bits
+inline u8 gfx_pack_get_sampler_index(u32 flags) {
+	switch (flags & DRAW_QUAD_FLAG_FILTER_MASK) {
+		case 0:                                                                   return 0;
+		case DRAW_QUAD_FLAG_MIN_FILTER_LINEAR:                                    return 2;
+		case DRAW_QUAD_FLAG_MAG_FILTER_LINEAR:                                    return 3;
+		case DRAW_QUAD_FLAG_MIN_FILTER_LINEAR | DRAW_QUAD_FLAG_MAG_FILTER_LINEAR: return 1;
+	}
+	return 0;
+}
+
+// Clamps to [0, 1], r in the lowest byte
+inline u32 gfx_pack_color_rgba8(Vector4 color) {
+	u32 r = (u32)(clamp(color.r, 0.0f, 1.0f)*255.0f + 0.5f);
+	u32 g = (u32)(clamp(color.g, 0.0f, 1.0f)*255.0f + 0.5f);
+	u32 b = (u32)(clamp(color.b, 0.0f, 1.0f)*255.0f + 0.5f);
+	u32 a = (u32)(clamp(color.a, 0.0f, 1.0f)*255.0f + 0.5f);
+	return r | (g << 8) | (b << 16) | (a << 24);
+}
+
+void gfx_pack_reserve(Gfx_Pack *pack, u64 quad_count, bool z_sorting) {
+	Allocator heap = get_heap_allocator();
+
+	// #Memory #Heapalloc
+	if (quad_count > pack->quad_capacity) {
+		u64 capacity = get_next_power_of_two(quad_count);
+		if (pack->order) {
+			dealloc(heap, pack->order);
+			dealloc(heap, pack->sort_keys);
+			pack->order = 0;
+			pack->sort_keys = 0;
+		}
+		pack->texture_indices = reallocate(heap, pack->texture_indices, pack->quad_capacity, capacity);
+		pack->extra_indices = reallocate(heap, pack->extra_indices, pack->quad_capacity*sizeof(u32), capacity*sizeof(u32));
+		pack->quad_capacity = capacity;
+	}
+	if (z_sorting && !pack->order) {
+		pack->order = alloc(heap, pack->quad_capacity*sizeof(u32));
+		pack->sort_keys = alloc(heap, pack->quad_capacity*2*sizeof(u64));
+	}
+}
+
+void gfx_pack_deinit(Gfx_Pack *pack) {
+	Allocator heap = get_heap_allocator();
+	if (pack->batches)         dealloc(heap, pack->batches);
+	if (pack->order)           dealloc(heap, pack->order);
+	if (pack->sort_keys)       dealloc(heap, pack->sort_keys);
+	if (pack->texture_indices) dealloc(heap, pack->texture_indices);
+	if (pack->extra_indices)   dealloc(heap, pack->extra_indices);
+	*pack = ZERO(Gfx_Pack);
+}
+
+Gfx_Pack_Batch *gfx_pack_push_batch(Gfx_Pack *pack, u64 first_quad) {
+	if (pack->batch_count >= pack->batch_capacity) {
+		u64 capacity = max(pack->batch_capacity*2, 8);
+		pack->batches = reallocate(get_heap_allocator(), pack->batches, pack->batch_capacity*sizeof(Gfx_Pack_Batch), capacity*sizeof(Gfx_Pack_Batch));
+		pack->batch_capacity = capacity;
+	}
+	Gfx_Pack_Batch *batch = &pack->batches[pack->batch_count];
+	pack->batch_count += 1;
+
+	batch->first_quad = first_quad;
+	batch->quad_count = 0;
+	batch->texture_count = 0;
+
+	return batch;
+}
+
+// Sequential since a batch needs to know all textures before it, and an extra needs to know
+// how many came before it. It only reads the image and flag streams, so it's cheap next to
+// writing the quads.
+void gfx_pack_assign_slots(Gfx_Pack *pack, const Gfx_Pack_Input *input, const u32 *order) {
+	Gfx_Pack_Batch *batch = gfx_pack_push_batch(pack, 0);
+
+	void *last_texture = 0;
+	s8 last_texture_index = -1;
+
+	for (u64 i = 0; i < input->quad_count; i++) {
+		u64 n = order ? order[i] : i;
+
+		assert(input->z[n] <= MAX_Z, "Z is too high. Z is %d, Max is %d.", input->z[n], MAX_Z);
+		assert(input->z[n] >= (-MAX_Z+1), "Z is too low. Z is %d, Min is %d.", input->z[n], -MAX_Z+1);
+
+		Gfx_Pack_Image *image = input->images[n];
+		s8 texture_index = -1;
+
+		if (image) {
+			void *texture = image->gfx_handle;
+
+			if (texture == last_texture) {
+				texture_index = last_texture_index;
+			} else {
+				// First look if texture is already bound
+				for (u64 j = 0; j < batch->texture_count; j++) {
+					if (batch->textures[j] == texture) {
+						texture_index = (s8)j;
+						break;
+					}
+				}
+				// Otherwise use a new slot
+				if (texture_index <= -1) {
+					if (batch->texture_count >= GFX_PACK_MAX_TEXTURES) {
+						// If max textures reached, start a new batch
+						batch = gfx_pack_push_batch(pack, i);
+					}
+					texture_index = (s8)batch->texture_count;
+					batch->textures[texture_index] = texture;
+					batch->texture_count += 1;
+				}
+				last_texture = texture;
+				last_texture_index = texture_index;
+			}
+		}
+
+		pack->texture_indices[i] = texture_index;
+		batch->quad_count += 1;
+		
+		if (input->flags[n] & (DRAW_QUAD_FLAG_HAS_SCISSOR | DRAW_QUAD_FLAG_HAS_USERDATA)) {
+			pack->extra_indices[i] = (u32)pack->extra_count;
+			pack->extra_count += 1;
+		}
+	}
+}
+
+typedef struct Gfx_Pack_Job {
+	const Gfx_Pack_Input *input;
+	const u32 *order;
+	const s8 *texture_indices;
+	const u32 *extra_indices;
+	Gfx_Quad_Vertex *vertices;
+	Gfx_Quad_Instance *instances;
+	Gfx_Quad_Extra *extras;
+} Gfx_Pack_Job;
+
+// With z sorting we jump around in the streams, so fetch the quads a bit ahead
+#define GFX_PACK_PREFETCH_DISTANCE 8
+inline void gfx_pack_prefetch_quad(const Gfx_Pack_Input *input, const u32 *order, u64 i, u64 end) {
+#if COMPILER_CAN_DO_SSE2
+	if (i + GFX_PACK_PREFETCH_DISTANCE < end) {
+		u64 next = order[i + GFX_PACK_PREFETCH_DISTANCE];
+		_mm_prefetch((const char*)&input->positions[next*4], _MM_HINT_T0);
+		_mm_prefetch((const char*)&input->colors[next], _MM_HINT_T0);
+		_mm_prefetch((const char*)&input->images[next], _MM_HINT_T0);
+		_mm_prefetch((const char*)&input->flags[next], _MM_HINT_T0);
+		_mm_prefetch((const char*)&input->uvs[next], _MM_HINT_T0);
+	}
+#endif
+}
+
+void gfx_pack_write_vertices_range(u64 first, u64 end, u64 range_index, void *data) {
+	Gfx_Pack_Job *job = (Gfx_Pack_Job*)data;
+	const Gfx_Pack_Input *input = job->input;
+
+	bool odd_width  = input->window_width  % 2 != 0;
+	bool odd_height = input->window_height % 2 != 0;
+
+	for (u64 i = first; i < end; i++) {
+		u64 n = job->order ? job->order[i] : i;
+
+		if (job->order) gfx_pack_prefetch_quad(input, job->order, i, end);
+
+		Gfx_Quad_Vertex* BL  = job->vertices + i*4 + 0;
+		Gfx_Quad_Vertex* TL  = job->vertices + i*4 + 1;
+		Gfx_Quad_Vertex* TR  = job->vertices + i*4 + 2;
+		Gfx_Quad_Vertex* BR  = job->vertices + i*4 + 3;
+
+		const Vector2 *corners = &input->positions[n*4];
+		Gfx_Pack_Image *image = input->images[n];
+		u32 flags = input->flags[n];
+
+		BL->position = v4(corners[0].x, corners[0].y, 0, 1);
+		TL->position = v4(corners[1].x, corners[1].y, 0, 1);
+		TR->position = v4(corners[2].x, corners[2].y, 0, 1);
+		BR->position = v4(corners[3].x, corners[3].y, 0, 1);
+
+		if (image) {
+			Vector4 uv = input->uvs[n];
+			BL->uv = v2(uv.x1, uv.y1);
+			TL->uv = v2(uv.x1, uv.y2);
+			TR->uv = v2(uv.x2, uv.y2);
+			BR->uv = v2(uv.x2, uv.y1);
+			// #Hack #Bug #Cleanup
+			// When a window dimension is uneven it slightly under/oversamples on an axis by a
+			// seemingly arbitrary amount. The 0.25 is a magic value I got from trial and error.
+			// (It undersamples by a fourth of the atlas texture?)
+			// Anything > 0.25 < will slightly over/undersample on my machine.
+			// I have no idea about #Portability here.
+			// - Charlie M 26th July 2024
+			if (odd_width) {
+				BL->uv.x += (2.0/(float)image->width)*0.25;
+				TL->uv.x += (2.0/(float)image->width)*0.25;
+				TR->uv.x += (2.0/(float)image->width)*0.25;
+				BR->uv.x += (2.0/(float)image->width)*0.25;
+			}
+			if (odd_height) {
+				BL->uv.y -= (2.0/(float)image->height)*0.25;
+				TL->uv.y -= (2.0/(float)image->height)*0.25;
+				TR->uv.y -= (2.0/(float)image->height)*0.25;
+				BR->uv.y -= (2.0/(float)image->height)*0.25;
+			}
+
+			BL->sampler=TL->sampler=TR->sampler=BR->sampler = gfx_pack_get_sampler_index(flags);
+		}
+		s8 texture_index = job->texture_indices[i];
+		BL->texture_index=TL->texture_index=TR->texture_index=BR->texture_index = texture_index;
+
+		BL->self_uv = v2(0, 0);
+		TL->self_uv = v2(0, 1);
+		TR->self_uv = v2(1, 1);
+		BR->self_uv = v2(1, 0);
+
+		if (flags & DRAW_QUAD_FLAG_HAS_USERDATA) {
+			const Vector4 *userdata = &input->userdata[n*VERTEX_USER_DATA_COUNT];
+			memcpy(BL->userdata, userdata, sizeof(BL->userdata));
+			memcpy(TL->userdata, userdata, sizeof(TL->userdata));
+			memcpy(TR->userdata, userdata, sizeof(TR->userdata));
+			memcpy(BR->userdata, userdata, sizeof(BR->userdata));
+		} else {
+			memset(BL->userdata, 0, sizeof(BL->userdata));
+			memset(TL->userdata, 0, sizeof(TL->userdata));
+			memset(TR->userdata, 0, sizeof(TR->userdata));
+			memset(BR->userdata, 0, sizeof(BR->userdata));
+		}
+
+		Vector4 color = input->colors[n];
+		BL->color = TL->color = TR->color = BR->color = color;
+
+		u8 type = (u8)(flags >> DRAW_QUAD_FLAG_TYPE_SHIFT);
+		BL->type=TL->type=TR->type=BR->type = type;
+
+		bool has_scissor = (flags & DRAW_QUAD_FLAG_HAS_SCISSOR) != 0;
+		Vector4 window_scissor = v4(0, 0, 0, 0);
+		if (has_scissor) {
+			// Flip y, scissors are pushed with y up
+			Vector4 scissor = input->scissors[n];
+			window_scissor.x1 = scissor.x1;
+			window_scissor.y1 = input->window_pixel_height - scissor.y2;
+			window_scissor.x2 = scissor.x2;
+			window_scissor.y2 = input->window_pixel_height - scissor.y1;
+		}
+
+		BL->has_scissor=TL->has_scissor=TR->has_scissor=BR->has_scissor = has_scissor;
+		BL->scissor=TL->scissor=TR->scissor=BR->scissor = window_scissor;
+	}
+}
+
+void gfx_pack_write_instances_range(u64 first, u64 end, u64 range_index, void *data) {
+	Gfx_Pack_Job *job = (Gfx_Pack_Job*)data;
+	const Gfx_Pack_Input *input = job->input;
+
+	bool odd_width  = input->window_width  % 2 != 0;
+	bool odd_height = input->window_height % 2 != 0;
+
+	for (u64 i = first; i < end; i++) {
+		u64 n = job->order ? job->order[i] : i;
+
+		if (job->order) gfx_pack_prefetch_quad(input, job->order, i, end);
+
+		Gfx_Quad_Instance *instance = &job->instances[i];
+		Gfx_Pack_Image *image = input->images[n];
+		u32 flags = input->flags[n];
+
+		memcpy(instance->corners, &input->positions[n*4], sizeof(instance->corners));
+
+		u32 instance_flags = (u8)job->texture_indices[i];
+		instance_flags |= ((flags >> DRAW_QUAD_FLAG_TYPE_SHIFT) & 0xff) << GFX_QUAD_INSTANCE_TYPE_SHIFT;
+
+		if (image) {
+			Vector4 uv = input->uvs[n];
+			// #Hack #Bug #Cleanup same as in gfx_pack_write_vertices_range
+			if (odd_width) {
+				uv.x1 += (2.0/(float)image->width)*0.25;
+				uv.x2 += (2.0/(float)image->width)*0.25;
+			}
+			if (odd_height) {
+				uv.y1 -= (2.0/(float)image->height)*0.25;
+				uv.y2 -= (2.0/(float)image->height)*0.25;
+			}
+			instance->uv = uv;
+			instance_flags |= (u32)gfx_pack_get_sampler_index(flags) << GFX_QUAD_INSTANCE_SAMPLER_SHIFT;
+		} else {
+			instance->uv = v4(0, 0, 0, 0);
+		}
+
+		instance->color = gfx_pack_color_rgba8(input->colors[n]);
+		instance->extra_index = 0;
+		instance->reserved = 0;
+
+		if (flags & (DRAW_QUAD_FLAG_HAS_SCISSOR | DRAW_QUAD_FLAG_HAS_USERDATA)) {
+			u32 extra_index = job->extra_indices[i];
+			Gfx_Quad_Extra *extra = &job->extras[extra_index];
+			instance->extra_index = extra_index;
+
+			if (flags & DRAW_QUAD_FLAG_HAS_SCISSOR) {
+				// Flip y, scissors are pushed with y up
+				Vector4 scissor = input->scissors[n];
+				extra->scissor.x1 = scissor.x1;
+				extra->scissor.y1 = input->window_pixel_height - scissor.y2;
+				extra->scissor.x2 = scissor.x2;
+				extra->scissor.y2 = input->window_pixel_height - scissor.y1;
+				instance_flags |= GFX_QUAD_INSTANCE_HAS_SCISSOR;
+			} else {
+				extra->scissor = v4(0, 0, 0, 0);
+			}
+			if (flags & DRAW_QUAD_FLAG_HAS_USERDATA) {
+				memcpy(extra->userdata, &input->userdata[n*VERTEX_USER_DATA_COUNT], sizeof(extra->userdata));
+				instance_flags |= GFX_QUAD_INSTANCE_HAS_USERDATA;
+			} else {
+				memset(extra->userdata, 0, sizeof(extra->userdata));
+			}
+		}
+
+		instance->flags = instance_flags;
+	}
+}
+
+// Stable, so quads with the same z keep the order they were drawn in. order and key_buffer
+// need room for quad_count u32's and quad_count*2 u64's.
+// Returns how it sorted; with GFX_PACK_SORT_ALREADY_SORTED order is not written and the
+// quads should be walked as they are.
+Gfx_Pack_Sort_Path gfx_pack_sort_by_z(const Gfx_Pack_Input *input, u32 *order, u64 *key_buffer) {
+	const Gfx_Pack_Z_Layers *layers = input->z_layers;
+	
+	if (layers && !layers->unordered) return GFX_PACK_SORT_ALREADY_SORTED;
+	
+	if (!layers || layers->overflow) {
+		// Only reads the z stream. Nothing is moved, we just walk the streams in sorted order.
+		radix_sort_indices_by_s32(input->z, order, key_buffer, input->quad_count, MAX_Z_BITS);
+		return GFX_PACK_SORT_RADIX;
+	}
+	
+	// Layers in z order. There are only a few so insertion sort is fine.
+	u32 sorted_layers[GFX_PACK_MAX_Z_LAYERS];
+	for (u32 i = 0; i < layers->count; i++) {
+		u32 j = i;
+		while (j > 0 && layers->z[sorted_layers[j-1]] > layers->z[i]) {
+			sorted_layers[j] = sorted_layers[j-1];
+			j -= 1;
+		}
+		sorted_layers[j] = i;
+	}
+	
+	// Where each layer starts in the sorted order
+	u32 next[GFX_PACK_MAX_Z_LAYERS];
+	u64 offset = 0;
+	for (u32 i = 0; i < layers->count; i++) {
+		next[sorted_layers[i]] = (u32)offset;
+		offset += layers->quad_counts[sorted_layers[i]];
+	}
+	assert(offset == input->quad_count, "Z layers have %llu quads but there are %llu quads. Was the z stream changed after the quads were pushed?", offset, input->quad_count);
+	
+	// One pass, each quad goes to the end of its layer
+	u32 layer = 0;
+	s32 layer_z = layers->z[0];
+	for (u64 i = 0; i < input->quad_count; i++) {
+		s32 z = input->z[i];
+		if (z != layer_z) {
+			u32 l = 0;
+			while (l < layers->count && layers->z[l] != z) l += 1;
+			assert(l < layers->count, "Quad z %d is not in the z layers", z);
+			layer = l;
+			layer_z = z;
+		}
+		order[next[layer]] = (u32)i;
+		next[layer] += 1;
+	}
+	
+	return GFX_PACK_SORT_LAYERS;
+}
+
+// Sorts, assigns texture slots and extras and decides the batches. After this, pack->quad_count,
+// pack->extra_count and the batches are known, and the quads can be written with
+// gfx_pack_write_instances or gfx_pack_write_vertices.
+// Can be called from any thread, but the same Gfx_Pack can't be used by two threads at once.
+void gfx_pack_begin(Gfx_Pack *pack, const Gfx_Pack_Input *input) {
+	pack->batch_count = 0;
+	pack->extra_count = 0;
+	pack->quad_count = input->quad_count;
+	pack->sort_path = GFX_PACK_SORT_NONE;
+	pack->has_order = false;
+
+	if (input->quad_count == 0) return;
+
+	assert(input->quad_count <= UINT32_MAX, "Too many quads to pack");
+
+	gfx_pack_reserve(pack, input->quad_count, input->enable_z_sorting);
+
+	if (input->enable_z_sorting) {
+		pack->sort_path = gfx_pack_sort_by_z(input, pack->order, pack->sort_keys);
+	}
+	pack->has_order = pack->sort_path == GFX_PACK_SORT_LAYERS || pack->sort_path == GFX_PACK_SORT_RADIX;
+
+	gfx_pack_assign_slots(pack, input, pack->has_order ? pack->order : 0);
+}
+
+Gfx_Pack_Job gfx_pack_make_job(Gfx_Pack *pack, const Gfx_Pack_Input *input) {
+	assert(pack->quad_count == input->quad_count, "Call gfx_pack_begin with the same input first");
+
+	Gfx_Pack_Job job = ZERO(Gfx_Pack_Job);
+	job.input = input;
+	job.order = pack->has_order ? pack->order : 0;
+	job.texture_indices = pack->texture_indices;
+	job.extra_indices = pack->extra_indices;
+	return job;
+}
+
+// instances needs room for pack->quad_count and extras for pack->extra_count
+void gfx_pack_write_instances(Gfx_Pack *pack, const Gfx_Pack_Input *input, Gfx_Quad_Instance *instances, Gfx_Quad_Extra *extras) {
+	if (input->quad_count == 0) return;
+
+	Gfx_Pack_Job job = gfx_pack_make_job(pack, input);
+	job.instances = instances;
+	job.extras = extras;
+
+	u64 range_count = clamp(input->quad_count/GFX_PACK_MIN_QUADS_PER_RANGE, 1, parallel_for_get_thread_count());
+	parallel_for(input->quad_count, range_count, gfx_pack_write_instances_range, &job);
+}
+
+// vertices needs room for pack->quad_count*4
+void gfx_pack_write_vertices(Gfx_Pack *pack, const Gfx_Pack_Input *input, Gfx_Quad_Vertex *vertices) {
+	if (input->quad_count == 0) return;
+
+	Gfx_Pack_Job job = gfx_pack_make_job(pack, input);
+	job.vertices = vertices;
+
+	u64 range_count = clamp(input->quad_count/GFX_PACK_MIN_QUADS_PER_RANGE, 1, parallel_for_get_thread_count());
+	parallel_for(input->quad_count, range_count, gfx_pack_write_vertices_range, &job);
+}
+
+// Packs input->quad_count quads into vertices, which needs room for input->quad_count*4
+// Gfx_Quad_Vertex's. The batches are in pack->batches.
+void gfx_pack_quads(Gfx_Pack *pack, const Gfx_Pack_Input *input, Gfx_Quad_Vertex *vertices) {
+	gfx_pack_begin(pack, input);
+	gfx_pack_write_vertices(pack, input, vertices);
+}
@@ -0,0 +1,217 @@
+
+/*
+
+	Render_Target_Pool hands out transient render targets for post-processing passes, so you
+	don't have to keep track of which targets exist and re-create them when the window resizes.
+
+	Ask the pool for a target of some size each frame, use it, and call
+	render_target_pool_end_frame after gfx_update. Targets handed out during a frame are
+	given back to the pool at the end of it, and can then be handed out again for the same
+	width, height & channels. Targets that haven't been handed out for max_unused_frames frames
+	are deleted, which is what happens to the old sizes after a resize.
+
+	Example Usage:
+
+		Render_Target_Pool *pool = make_render_target_pool(4, get_heap_allocator());
+
+		while (...) {
+			...
+
+			Gfx_Image *game_image = render_target_pool_get(pool, window.width, window.height, 4);
+			Gfx_Image *bloom_map  = render_target_pool_get(pool, window.width, window.height, 4);
+
+			// Draw to the targets, draw them to the window ...
+
+			os_update();
+			gfx_update();
+			render_target_pool_end_frame(pool);
+		}
+
+	A target can be given back before the end of the frame with render_target_pool_release so a
+	later pass in the same frame can reuse it. Its content is kept until it's handed out again,
+	but you should clear it before drawing to it since it may come from any earlier pass.
+
+	The pool doesn't need a renderer; it creates and deletes targets through the create & destroy
+	procs so it's in OOGABOOGA_HEADLESS builds too. make_render_target_pool in gfx_interface.c
+	sets them to make_image_render_target & delete_image.
+
+*/
+
+typedef struct Gfx_Image *(*Render_Target_Create_Proc)(u32 width, u32 height, u32 channels, void *userdata);
+typedef void (*Render_Target_Destroy_Proc)(struct Gfx_Image *target, void *userdata);
+
+typedef struct Render_Target_Pool_Entry {
+	struct Gfx_Image *target;
+	u32 width, height, channels;
+	// The pool frame this target was last handed out in
+	u64 last_used_frame;
+	bool in_use;
+} Render_Target_Pool_Entry;
+
+typedef struct Render_Target_Pool {
+	// Growing array
+	Render_Target_Pool_Entry *entries;
+
+	// Idle targets are deleted when they haven't been handed out for this many frames
+	u64 max_unused_frames;
+	u64 frame_index;
+
+	Render_Target_Create_Proc create_proc;
+	Render_Target_Destroy_Proc destroy_proc;
+	void *userdata;
+
+	Allocator allocator;
+
+	// Pixel data of all targets that are alive, in use or not.
+	u64 live_bytes;
+	u64 in_use_bytes;
+	u64 in_use_count;
+	u64 create_count;
+	u64 destroy_count;
+} Render_Target_Pool;
+
+// Pixel data only, assuming 8 bits per channel like the renderers do
+inline u64 render_target_pool_get_target_bytes(u32 width, u32 height, u32 channels) {
+	return (u64)width*height*channels;
+}
+
+Render_Target_Pool *
+make_render_target_pool_with_procs(u64 max_unused_frames, Render_Target_Create_Proc create_proc, Render_Target_Destroy_Proc destroy_proc, void *userdata, Allocator allocator) {
+	assert(create_proc && destroy_proc, "A Render_Target_Pool needs both a create and a destroy proc");
+
+	Render_Target_Pool *pool = alloc(allocator, sizeof(Render_Target_Pool));
+	*pool = ZERO(Render_Target_Pool);
+
+	pool->max_unused_frames = max_unused_frames;
+	pool->create_proc = create_proc;
+	pool->destroy_proc = destroy_proc;
+	pool->userdata = userdata;
+	pool->allocator = allocator;
+
+	growing_array_init((void**)&pool->entries, sizeof(Render_Target_Pool_Entry), allocator);
+
+	return pool;
+}
+
+void render_target_pool_destroy_entry(Render_Target_Pool *pool, u32 index) {
+	Render_Target_Pool_Entry *entry = &pool->entries[index];
+	u64 bytes = render_target_pool_get_target_bytes(entry->width, entry->height, entry->channels);
+
+	if (entry->in_use) {
+		pool->in_use_bytes -= bytes;
+		pool->in_use_count -= 1;
+	}
+	pool->live_bytes -= bytes;
+	pool->destroy_count += 1;
+
+	pool->destroy_proc(entry->target, pool->userdata);
+	growing_array_unordered_remove_by_index((void**)&pool->entries, index);
+}
+
+// Deletes all targets, including the ones in use
+void destroy_render_target_pool(Render_Target_Pool *pool) {
+	while (growing_array_get_valid_count(pool->entries) > 0) {
+		render_target_pool_destroy_entry(pool, growing_array_get_valid_count(pool->entries)-1);
+	}
+	growing_array_deinit((void**)&pool->entries);
+	dealloc(pool->allocator, pool);
+}
+
+// The target is the pool's until the end of the frame or render_target_pool_release.
+// Don't delete_image it.
+struct Gfx_Image *
+render_target_pool_get(Render_Target_Pool *pool, u32 width, u32 height, u32 channels) {
+	assert(width > 0 && height > 0, "Render targets can't be empty, got %dx%d", width, height);
+
+	u32 count = growing_array_get_valid_count(pool->entries);
+	for (u32 i = 0; i < count; i++) {
+		Render_Target_Pool_Entry *entry = &pool->entries[i];
+		if (entry->in_use) continue;
+		if (entry->width != width || entry->height != height || entry->channels != channels) continue;
+
+		entry->in_use = true;
+		entry->last_used_frame = pool->frame_index;
+		pool->in_use_bytes += render_target_pool_get_target_bytes(width, height, channels);
+		pool->in_use_count += 1;
+		return entry->target;
+	}
+
+	Render_Target_Pool_Entry *entry = growing_array_add_empty((void**)&pool->entries);
+	*entry = ZERO(Render_Target_Pool_Entry);
+	entry->target = pool->create_proc(width, height, channels, pool->userdata);
+	assert(entry->target, "Render_Target_Pool create proc failed for %dx%d, %d channels", width, height, channels);
+	entry->width = width;
+	entry->height = height;
+	entry->channels = channels;
+	entry->in_use = true;
+	entry->last_used_frame = pool->frame_index;
+
+	u64 bytes = render_target_pool_get_target_bytes(width, height, channels);
+	pool->live_bytes += bytes;
+	pool->in_use_bytes += bytes;
+	pool->in_use_count += 1;
+	pool->create_count += 1;
+
+	return entry->target;
+}
+
+// Give a target back before the end of the frame so it can be handed out again in the same frame.
+void render_target_pool_release(Render_Target_Pool *pool, struct Gfx_Image *target) {
+	u32 count = growing_array_get_valid_count(pool->entries);
+	for (u32 i = 0; i < count; i++) {
+		Render_Target_Pool_Entry *entry = &pool->entries[i];
+		if (entry->target != target) continue;
+
+		assert(entry->in_use, "Render target was released twice");
+		entry->in_use = false;
+		pool->in_use_bytes -= render_target_pool_get_target_bytes(entry->width, entry->height, entry->channels);
+		pool->in_use_count -= 1;
+		return;
+	}
+	panic("Released a render target which is not from this Render_Target_Pool");
+}
+
+// Call once per frame after the targets handed out this frame are done being drawn, so
+// after gfx_update if they're drawn to the window.
+void render_target_pool_end_frame(Render_Target_Pool *pool) {
+	pool->frame_index += 1;
+
+	u32 count = growing_array_get_valid_count(pool->entries);
+	for (u32 i = 0; i < count; ) {
+		Render_Target_Pool_Entry *entry = &pool->entries[i];
+
+		if (entry->in_use) {
+			entry->in_use = false;
+			pool->in_use_bytes -= render_target_pool_get_target_bytes(entry->width, entry->height, entry->channels);
+			pool->in_use_count -= 1;
+		}
+
+		if (pool->frame_index - entry->last_used_frame > pool->max_unused_frames) {
+			// Last entry is moved into i
+			render_target_pool_destroy_entry(pool, i);
+			count -= 1;
+		} else {
+			i += 1;
+		}
+	}
+}
+
+// Deletes all targets that are not in use right now
+void render_target_pool_trim(Render_Target_Pool *pool) {
+	u32 count = growing_array_get_valid_count(pool->entries);
+	for (u32 i = 0; i < count; ) {
+		if (!pool->entries[i].in_use) {
+			render_target_pool_destroy_entry(pool, i);
+			count -= 1;
+		} else {
+			i += 1;
+		}
+	}
+}
+
+u64 render_target_pool_get_live_bytes(Render_Target_Pool *pool) {
+	return pool->live_bytes;
+}
+u64 render_target_pool_get_live_count(Render_Target_Pool *pool) {
+	return growing_array_get_valid_count(pool->entries);
+}
@@ -120,16 +120,11 @@ growing_array_reserve(void **array, u64 count_to_reserve) {
     u64 old_allocated_bytes = header->allocated_count*header->block_size_in_bytes+sizeof(Growing_Array_Header);
     count_to_reserve = get_next_power_of_two(count_to_reserve);
     u64 bytes_to_allocate = count_to_reserve*header->block_size_in_bytes+sizeof(Growing_Array_Header);
-    Growing_Array_Header *new_header = (Growing_Array_Header*)alloc(header->allocator, bytes_to_allocate);
-    
-    memcpy(new_header, header, old_allocated_bytes);
-    
+    Growing_Array_Header *new_header = (Growing_Array_Header*)reallocate(header->allocator, header, old_allocated_bytes, bytes_to_allocate);
     
     *array = new_header+1;
     
     new_header->allocated_count = count_to_reserve;
-    
-    dealloc(header->allocator, header);
 }
 
 void*
@@ -213,7 +208,7 @@ growing_array_ordered_remove_by_index(void **array, u32 index) {
     
     u64 byte_index = header->block_size_in_bytes*index;
     
-    memcpy(
+    memmove( // Ranges overlap
         (u8*)*array + byte_index, 
         (u8*)*array + byte_index + header->block_size_in_bytes,
         (header->valid_count-index-1)*header->block_size_in_bytes
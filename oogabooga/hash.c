@@ -1,11 +1,18 @@
-
-
 #define PRIME64_1 11400714785074694791ULL
 #define PRIME64_2 14029467366897019727ULL
 #define PRIME64_3 1609587929392839161ULL
 #define PRIME64_4 9650029242287828579ULL
 #define PRIME64_5 2870177450012600261ULL
 
+#define PRIME32_1 2654435761ULL
+#define PRIME32_2 2246822519ULL
+#define PRIME32_3 3266489917ULL
+
+#define HASH_WY_0 0xa0761d6478bd642fULL
+#define HASH_WY_1 0xe7037ed1a0b428dbULL
+#define HASH_WY_2 0x8ebc6af09c88c6e3ULL
+#define HASH_WY_3 0x589965cc75374cc3ULL
+
 static inline u64 xx_hash(u64 x) {
     u64 h64 = PRIME64_5 + 8;
     h64 += x * PRIME64_3;
@@ -18,32 +25,220 @@ static inline u64 xx_hash(u64 x) {
     return h64;
 }
 
-static inline u64 city_hash(string s) {
-    const u64 k = 0x9ddfea08eb382d69ULL;
-    u64 a = s.count;
-    u64 b = s.count * 5;
-    u64 c = 9;
-    u64 d = b;
-
-    if (s.count <= 16) {
-        memcpy(&a, s.data, sizeof(u64));
-        memcpy(&b, s.data + s.count - 8, sizeof(u64));
-    } else {
-        memcpy(&a, s.data, sizeof(u64));
-        memcpy(&b, s.data + 8, sizeof(u64));
-        memcpy(&c, s.data + s.count - 8, sizeof(u64));
-        memcpy(&d, s.data + s.count - 16, sizeof(u64));
-    }
+///
+// Byte hashing
+//
+// hash_bytes() is wyhash for anything up to HASH_LONG_SIZE bytes, which never reads
+// outside of the given bytes. Longer inputs are hashed in 64 byte stripes into 8
+// accumulators, xxh3 style, which is where SIMD helps. The stripe loop is picked in
+// hash_init() from what the cpu can do, all versions give the exact same hash.
+
+#define HASH_LONG_SIZE 256
+#define HASH_STRIPE_SIZE 64
+// Accumulators are scrambled every this many stripes so they don't degenerate
+#define HASH_STRIPES_PER_SCRAMBLE 16
+
+static const u64 hash_secret[8] = {
+	HASH_WY_0, HASH_WY_1, HASH_WY_2, HASH_WY_3, PRIME64_1, PRIME64_2, PRIME64_4, PRIME64_5
+};
+// Secret rotated one step, for scrambling
+static const u64 hash_scramble_secret[8] = {
+	HASH_WY_1, HASH_WY_2, HASH_WY_3, PRIME64_1, PRIME64_2, PRIME64_4, PRIME64_5, HASH_WY_0
+};
+
+static inline u64 hash_read_64(const u8 *p) {
+	u64 x;
+	memcpy(&x, p, sizeof(u64));
+	return x;
+}
+static inline u64 hash_read_32(const u8 *p) {
+	u32 x;
+	memcpy(&x, p, sizeof(u32));
+	return x;
+}
+
+// Multiply to 128 bits and fold
+static inline u64 hash_mix(u64 a, u64 b) {
+	u64 high;
+	u64 low = multiply_u64_full(a, b, &high);
+	return low ^ high;
+}
+
+typedef void(*Hash_Accumulate_Proc)(u64 *acc, const u8 *p, u64 stripe_count);
+
+void hash_accumulate_scalar(u64 *acc, const u8 *p, u64 stripe_count) {
+	for (u64 s = 0; s < stripe_count; s++) {
+		const u8 *stripe = p + s*HASH_STRIPE_SIZE;
+		for (u64 i = 0; i < 8; i++) {
+			u64 data = hash_read_64(stripe + i*8);
+			u64 key = data ^ hash_secret[i];
+			acc[i^1] += data;
+			acc[i]   += (key & 0xFFFFFFFF) * (key >> 32);
+		}
+		if ((s+1) % HASH_STRIPES_PER_SCRAMBLE == 0) {
+			for (u64 i = 0; i < 8; i++) {
+				acc[i] ^= acc[i] >> 47;
+				acc[i] ^= hash_scramble_secret[i];
+				acc[i] *= PRIME32_1;
+			}
+		}
+	}
+}
+
+#if COMPILER_CAN_DO_SSE2
+void hash_accumulate_sse2(u64 *acc, const u8 *p, u64 stripe_count) {
+	__m128i a[4];
+	for (u64 i = 0; i < 4; i++) a[i] = _mm_loadu_si128((__m128i*)acc + i);
+
+	const __m128i prime = _mm_set1_epi32((int)PRIME32_1);
+
+	for (u64 s = 0; s < stripe_count; s++) {
+		const u8 *stripe = p + s*HASH_STRIPE_SIZE;
+		for (u64 i = 0; i < 4; i++) {
+			__m128i data = _mm_loadu_si128((__m128i*)stripe + i);
+			__m128i key = _mm_xor_si128(data, _mm_loadu_si128((__m128i*)hash_secret + i));
+			__m128i key_high = _mm_shuffle_epi32(key, _MM_SHUFFLE(0, 3, 0, 1));
+			__m128i product = _mm_mul_epu32(key, key_high);
+			__m128i data_swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+			a[i] = _mm_add_epi64(a[i], _mm_add_epi64(product, data_swapped));
+		}
+		if ((s+1) % HASH_STRIPES_PER_SCRAMBLE == 0) {
+			for (u64 i = 0; i < 4; i++) {
+				__m128i x = _mm_xor_si128(a[i], _mm_srli_epi64(a[i], 47));
+				x = _mm_xor_si128(x, _mm_loadu_si128((__m128i*)hash_scramble_secret + i));
+				__m128i low  = _mm_mul_epu32(x, prime);
+				__m128i high = _mm_mul_epu32(_mm_srli_epi64(x, 32), prime);
+				a[i] = _mm_add_epi64(low, _mm_slli_epi64(high, 32));
+			}
+		}
+	}
+
+	for (u64 i = 0; i < 4; i++) _mm_storeu_si128((__m128i*)acc + i, a[i]);
+}
+#endif
 
-    a += b;
-    a = (a << 43) | (a >> (64 - 43));
-    a += c;
-    a = a * 5 + 0x52dce729;
-    d ^= a;
-    d = (d << 44) | (d >> (64 - 44));
-    d += b;
+#if COMPILER_CAN_TARGET_AVX2
+TARGET_AVX2 void hash_accumulate_avx2(u64 *acc, const u8 *p, u64 stripe_count) {
+	__m256i a[2];
+	for (u64 i = 0; i < 2; i++) a[i] = _mm256_loadu_si256((__m256i*)acc + i);
 
-    return d * k;
+	const __m256i prime = _mm256_set1_epi32((int)PRIME32_1);
+
+	for (u64 s = 0; s < stripe_count; s++) {
+		const u8 *stripe = p + s*HASH_STRIPE_SIZE;
+		for (u64 i = 0; i < 2; i++) {
+			__m256i data = _mm256_loadu_si256((__m256i*)stripe + i);
+			__m256i key = _mm256_xor_si256(data, _mm256_loadu_si256((__m256i*)hash_secret + i));
+			__m256i key_high = _mm256_shuffle_epi32(key, _MM_SHUFFLE(0, 3, 0, 1));
+			__m256i product = _mm256_mul_epu32(key, key_high);
+			__m256i data_swapped = _mm256_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+			a[i] = _mm256_add_epi64(a[i], _mm256_add_epi64(product, data_swapped));
+		}
+		if ((s+1) % HASH_STRIPES_PER_SCRAMBLE == 0) {
+			for (u64 i = 0; i < 2; i++) {
+				__m256i x = _mm256_xor_si256(a[i], _mm256_srli_epi64(a[i], 47));
+				x = _mm256_xor_si256(x, _mm256_loadu_si256((__m256i*)hash_scramble_secret + i));
+				__m256i low  = _mm256_mul_epu32(x, prime);
+				__m256i high = _mm256_mul_epu32(_mm256_srli_epi64(x, 32), prime);
+				a[i] = _mm256_add_epi64(low, _mm256_slli_epi64(high, 32));
+			}
+		}
+	}
+
+	for (u64 i = 0; i < 2; i++) _mm256_storeu_si256((__m256i*)acc + i, a[i]);
+}
+#endif
+
+// #Global
+ogb_instance Hash_Accumulate_Proc hash_accumulate;
+
+#if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
+Hash_Accumulate_Proc hash_accumulate = hash_accumulate_scalar;
+#endif
+
+void hash_init(Cpu_Capabilities features) {
+	hash_accumulate = hash_accumulate_scalar;
+#if COMPILER_CAN_DO_SSE2
+	if (features.sse2) hash_accumulate = hash_accumulate_sse2;
+#endif
+#if COMPILER_CAN_TARGET_AVX2
+	if (features.avx2) hash_accumulate = hash_accumulate_avx2;
+#endif
+}
+
+u64 hash_bytes_long(const u8 *p, u64 count, u64 seed, Hash_Accumulate_Proc accumulate) {
+	assert(count > HASH_STRIPE_SIZE, "Internal hash error");
+
+	alignat(32) u64 acc[8] = {
+		PRIME32_3, PRIME64_1, PRIME64_2, PRIME64_3, PRIME64_4, PRIME32_2, PRIME64_5, PRIME32_1
+	};
+
+	// Last stripe is done separately and overlaps with the previous stripe if needed
+	u64 stripe_count = (count-1) / HASH_STRIPE_SIZE;
+	accumulate(acc, p, stripe_count);
+	accumulate(acc, p + count - HASH_STRIPE_SIZE, 1);
+
+	u64 h = count * PRIME64_1;
+	for (u64 i = 0; i < 4; i++) {
+		h += hash_mix(acc[i*2] ^ hash_secret[i*2] ^ seed, acc[i*2+1] ^ hash_secret[i*2+1]);
+	}
+
+	h ^= h >> 37;
+	h *= 0x165667919E3779F9ULL;
+	h ^= h >> 32;
+	return h;
+}
+
+u64 hash_bytes(const void *data, u64 count, u64 seed) {
+	const u8 *p = (const u8*)data;
+
+	if (count > HASH_LONG_SIZE) return hash_bytes_long(p, count, seed, hash_accumulate);
+
+	seed ^= hash_mix(seed ^ HASH_WY_0, HASH_WY_1);
+
+	u64 a, b;
+	if (count <= 16) {
+		if (count >= 4) {
+			u64 offset = (count >> 3) << 2;
+			a = (hash_read_32(p) << 32) | hash_read_32(p + offset);
+			b = (hash_read_32(p + count - 4) << 32) | hash_read_32(p + count - 4 - offset);
+		} else if (count > 0) {
+			a = ((u64)p[0] << 16) | ((u64)p[count >> 1] << 8) | p[count - 1];
+			b = 0;
+		} else {
+			a = 0;
+			b = 0;
+		}
+	} else {
+		u64 left = count;
+		if (left > 48) {
+			u64 seed1 = seed;
+			u64 seed2 = seed;
+			do {
+				seed  = hash_mix(hash_read_64(p)    ^ HASH_WY_1, hash_read_64(p+8)  ^ seed);
+				seed1 = hash_mix(hash_read_64(p+16) ^ HASH_WY_2, hash_read_64(p+24) ^ seed1);
+				seed2 = hash_mix(hash_read_64(p+32) ^ HASH_WY_3, hash_read_64(p+40) ^ seed2);
+				p += 48;
+				left -= 48;
+			} while (left > 48);
+			seed ^= seed1 ^ seed2;
+		}
+		while (left > 16) {
+			seed = hash_mix(hash_read_64(p) ^ HASH_WY_1, hash_read_64(p+8) ^ seed);
+			p += 16;
+			left -= 16;
+		}
+		// Last 16 bytes, overlapping with what we already did since count > 16
+		a = hash_read_64(p + left - 16);
+		b = hash_read_64(p + left - 8);
+	}
+
+	a ^= HASH_WY_1;
+	b ^= seed;
+	u64 high;
+	a = multiply_u64_full(a, b, &high);
+	b = high;
+	return hash_mix(a ^ HASH_WY_0 ^ count, b ^ HASH_WY_1);
 }
 
 u64 djb2_hash(string s) {
@@ -55,8 +250,7 @@ u64 djb2_hash(string s) {
 }
 
 u64 string_get_hash(string s) {
-    if (s.count > 32) return djb2_hash(s);
-    return city_hash(s);
+	return hash_bytes(s.data, s.count, 0);
 }
 u64 pointer_get_hash(void *p) {
 	return xx_hash((u64)p);
@@ -68,6 +262,20 @@ u64 float32_get_hash(float32 x) {
 	return float64_get_hash((float64)x);
 }
 
+// Hash many strings in one go, i.e. when building a table. Fetches the next strings
+// while hashing the current ones.
+void hash_strings(string *strings, u64 count, u64 *hashes) {
+	const u64 prefetch_distance = 8;
+	for (u64 i = 0; i < count; i++) {
+#if COMPILER_CAN_DO_SSE2
+		if (i + prefetch_distance < count) {
+			_mm_prefetch((const char*)strings[i + prefetch_distance].data, _MM_HINT_T0);
+		}
+#endif
+		hashes[i] = hash_bytes(strings[i].data, strings[i].count, 0);
+	}
+}
+
 #define get_hash(x) _Generic((x), \
 		    string: string_get_hash, \
 		    s8: xx_hash, \
@@ -81,4 +289,4 @@ u64 float32_get_hash(float32 x) {
 		    f32: float32_get_hash, \
 		    f64: float64_get_hash, \
 		    default: pointer_get_hash \
-		    )(x)
\ No newline at end of file
+		    )(x)
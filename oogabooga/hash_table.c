@@ -1,58 +1,76 @@
-
-// Very naive implementation but it should be very cache efficient so it's alright
-// for non-excessive use for now.
+// Open addressing hash table.
+//
+// Entries (hash-key-value) are stored densely in one array, so iterating with
+// hash_table_get_nth_value() is just walking an array. Lookup goes through a separate
+// slot table which maps to entry indices. Each slot has one control byte which is
+// either empty, a tombstone or 7 bits of the hash, so a probe checks 16 slots at once
+// with SSE2 and only compares keys when those 7 bits match.
 
 /*
 
 	Example Usage:
-	
-	
+
+
 	// Make a table with key type 'string' and value type 'int', allocated on the heap
 	Hash_Table table = make_hash_table(string, int, get_heap_allocator());
-	
+
 	// Set key "Key string" to integer value 69. This returns whether or not key was newly added.
 	string key = STR("Key string");
 	bool newly_added = hash_table_set(&table, key, 69);
-	
+
 	// Find value associated with given key. Returns pointer to that value.
 	string other_key = STR("Some other key");
 	int* value = hash_table_find(&table, other_key);
-	
+
 	if (value) {
 		// Pointer is OK, item with key exists
 	} else {
 		// Pointer is null, item with key does NOT exist
 	}
-	
+
 	// Same as hash_table_find() != NULL
 	string another_key = STR("Another key");
 	if (hash_table_contains(&table, another_key)) {
-		
+
 	}
-	
+
+	// Remove an entry. Returns whether or not the key existed.
+	// This moves the last entry into the removed entry's place, so value pointers and
+	// indices into the table are not stable across removes.
+	hash_table_remove(&table, key);
+
+	// Iterate all values
+	for (u64 i = 0; i < table.count; i++) {
+		int *value = (int*)hash_table_get_nth_value(&table, i);
+	}
+
 	// Reset all entries (but keep allocated memory)
 	hash_table_reset(&table);
-	
+
 	// Free allocated entries in hash table
 	hash_table_destroy(&table);
-	
-	
+
+
 	Limitations:
-		- Key can only be a base type or pointer
+		- Key can only be a base type, pointer or string
+		- String keys are compared by their contents, and they are copied into the table
+		  with the table's allocator so the string you pass doesn't need to stay alive.
+		  Other keys are compared byte by byte.
 		- Key and value passed to the following function needs to be lvalues (we need to be able to take their addresses with '&'):
 			- hash_table_add
 			- hash_table_find
 			- hash_table_contains
 			- hash_table_set
-			
+			- hash_table_remove
+
 			Example:
-			
+
 			hash_table_set(&table, my_key+5, my_value+3); // ERROR
-			
+
 			int key = my_key+5;
 			int value = my_value+3;
 			hash_table_set(&table, key, value); // OK
-			
+
 
 */
 
@@ -60,159 +78,376 @@ typedef struct Hash_Table Hash_Table;
 
 // API:
 #define make_hash_table_reserve(Key_Type, Value_Type, capacity_count, allocator) \
-	make_hash_table_reserve(sizeof(Key_Type), sizeof(Value_Type), capacity_count, allocator)
-	
+	make_hash_table_reserve_raw(sizeof(Key_Type), sizeof(Value_Type), capacity_count, hash_table_is_string_key_type(Key_Type), allocator)
+
 #define make_hash_table(Key_Type, Value_Type, allocator) \
-	make_hash_table_raw(sizeof(Key_Type), sizeof(Value_Type), allocator)
+	make_hash_table_raw(sizeof(Key_Type), sizeof(Value_Type), hash_table_is_string_key_type(Key_Type), allocator)
 
 #define hash_table_add(table_ptr, key, value) \
 	hash_table_add_raw((table_ptr), get_hash(key), &(key), &(value), sizeof(key), sizeof(value))
 
 #define hash_table_find(table_ptr, key) \
-	hash_table_find_raw((table_ptr), get_hash(key))
-	
+	hash_table_find_raw((table_ptr), get_hash(key), &(key), sizeof(key))
+
 #define hash_table_contains(table_ptr, key) \
-	hash_table_contains_raw((table_ptr), get_hash(key))
-	
+	hash_table_contains_raw((table_ptr), get_hash(key), &(key), sizeof(key))
+
 #define hash_table_set(table_ptr, key, value) \
 	hash_table_set_raw((table_ptr), get_hash(key), &key, &value, sizeof(key), sizeof(value))
 
+#define hash_table_remove(table_ptr, key) \
+	hash_table_remove_raw((table_ptr), get_hash(key), &(key), sizeof(key))
+
 void hash_table_reserve(Hash_Table *t, u64 required_count);
 
+#define hash_table_is_string_key_type(Key_Type) _Generic(*(Key_Type*)0, string: true, default: false)
+
+#define HASH_TABLE_GROUP_SIZE 16
+#define HASH_TABLE_MIN_SLOT_COUNT 16
+
+#define HASH_TABLE_CONTROL_EMPTY     0x80
+#define HASH_TABLE_CONTROL_TOMBSTONE 0xFE
 
 typedef struct Hash_Table {
-	
+
 	// Each entry is hash-key-value
-	// Hash is sizeof(u64) bytes, key is _key_size bytes and value is _value_size bytes
-	void *entries; 
-	
+	// Hash is sizeof(u64) bytes, key is _key_size bytes and value is _value_size bytes,
+	// each aligned to 8 bytes.
+	void *entries;
+
 	u64 count; // Number of valid entries
 	u64 capacity_count; // Number of allocated entries
-	
+
 	u64 _key_size;
 	u64 _value_size;
-	
+	u64 _value_offset;
+	u64 _entry_size;
+	bool _string_keys;
+
+	// Slot table, power of two count. _slot_control is one byte per slot followed by
+	// u32 entry index per slot.
+	u8  *_slot_control;
+	u32 *_slot_entries;
+	u64 _slot_count;
+	u64 _tombstone_count;
+
 	Allocator allocator;
 } Hash_Table;
 
-Hash_Table make_hash_table_reserve_raw(u64 key_size, u64 value_size, u64 capacity_count, Allocator allocator) {
+Hash_Table make_hash_table_reserve_raw(u64 key_size, u64 value_size, u64 capacity_count, bool string_keys, Allocator allocator) {
+
+	assert(!string_keys || key_size == sizeof(string), "Internal hash table error");
 
-	capacity_count = min(capacity_count, 8);
+	capacity_count = max(capacity_count, 8);
 
 	Hash_Table t = ZERO(Hash_Table);
-	
+
 	t._key_size = key_size;
 	t._value_size = value_size;
+	t._string_keys = string_keys;
+	t._value_offset = align_next(sizeof(u64)+key_size, 8);
+	t._entry_size = align_next(t._value_offset+value_size, 8);
 	t.allocator = allocator;
-	
-	u64 entry_size = value_size+sizeof(u64);
-	t.entries = alloc(t.allocator, entry_size*capacity_count);
-	memset(t.entries, 0, entry_size*capacity_count);
-	t.capacity_count = capacity_count;
-	
+
+	hash_table_reserve(&t, capacity_count);
+
 	return t;
 }
-inline Hash_Table make_hash_table_raw(u64 key_size, u64 value_size, Allocator allocator) {
-	return make_hash_table_reserve_raw(key_size, value_size, 128, allocator);
+inline Hash_Table make_hash_table_raw(u64 key_size, u64 value_size, bool string_keys, Allocator allocator) {
+	return make_hash_table_reserve_raw(key_size, value_size, 128, string_keys, allocator);
+}
+
+inline u8 *hash_table_get_nth_entry(Hash_Table *t, u64 n) {
+	return (u8*)t->entries+t->_entry_size*n;
+}
+
+// Bit mask of which of the 16 control bytes in the group are equal to byte
+inline u32 hash_table_group_match(u8 *group, u8 byte) {
+#if COMPILER_CAN_DO_SSE2
+	__m128i control = _mm_loadu_si128((__m128i*)group);
+	return (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(control, _mm_set1_epi8((char)byte)));
+#else
+	u32 mask = 0;
+	for (u32 i = 0; i < HASH_TABLE_GROUP_SIZE; i++) {
+		if (group[i] == byte) mask |= 1 << i;
+	}
+	return mask;
+#endif
+}
+// Empty and tombstone are the only control bytes with the high bit set
+inline u32 hash_table_group_match_empty_or_tombstone(u8 *group) {
+#if COMPILER_CAN_DO_SSE2
+	__m128i control = _mm_loadu_si128((__m128i*)group);
+	return (u32)_mm_movemask_epi8(control);
+#else
+	u32 mask = 0;
+	for (u32 i = 0; i < HASH_TABLE_GROUP_SIZE; i++) {
+		if (group[i] & 0x80) mask |= 1 << i;
+	}
+	return mask;
+#endif
+}
+
+inline u8 hash_table_hash_to_control(u64 hash) {
+	return (u8)(hash & 0x7F);
+}
+inline u64 hash_table_hash_to_group(Hash_Table *t, u64 hash) {
+	return (hash >> 7) & (t->_slot_count/HASH_TABLE_GROUP_SIZE-1);
+}
+
+bool hash_table_keys_match(Hash_Table *t, void *a, void *b) {
+	if (t->_string_keys) return strings_match(*(string*)a, *(string*)b);
+	return memcmp(a, b, t->_key_size) == 0;
+}
+
+// Returns slot index, or -1 if not found
+s64 hash_table_find_slot(Hash_Table *t, u64 hash, void *k) {
+	u8 control = hash_table_hash_to_control(hash);
+	u64 group_count = t->_slot_count/HASH_TABLE_GROUP_SIZE;
+	u64 group = hash_table_hash_to_group(t, hash);
+
+	// Triangular probe over groups, visits every group when group count is a power of two
+	for (u64 step = 1; step <= group_count; step += 1) {
+		u8 *group_control = t->_slot_control+group*HASH_TABLE_GROUP_SIZE;
+
+		u32 match = hash_table_group_match(group_control, control);
+		while (match) {
+			u64 slot = group*HASH_TABLE_GROUP_SIZE + bit_scan_forward_64(match);
+			u8 *entry = hash_table_get_nth_entry(t, t->_slot_entries[slot]);
+			if (*(u64*)entry == hash && hash_table_keys_match(t, entry+sizeof(u64), k)) {
+				return (s64)slot;
+			}
+			match &= match-1;
+		}
+
+		// Nothing was ever probed past a group with an empty slot
+		if (hash_table_group_match(group_control, HASH_TABLE_CONTROL_EMPTY)) return -1;
+
+		group = (group+step) & (group_count-1);
+	}
+	return -1;
+}
+// Slot which points to entry at index
+u64 hash_table_find_slot_of_entry(Hash_Table *t, u64 hash, u64 index) {
+	u8 control = hash_table_hash_to_control(hash);
+	u64 group_count = t->_slot_count/HASH_TABLE_GROUP_SIZE;
+	u64 group = hash_table_hash_to_group(t, hash);
+
+	for (u64 step = 1; step <= group_count; step += 1) {
+		u8 *group_control = t->_slot_control+group*HASH_TABLE_GROUP_SIZE;
+
+		u32 match = hash_table_group_match(group_control, control);
+		while (match) {
+			u64 slot = group*HASH_TABLE_GROUP_SIZE + bit_scan_forward_64(match);
+			if (t->_slot_entries[slot] == index) return slot;
+			match &= match-1;
+		}
+
+		group = (group+step) & (group_count-1);
+	}
+	panic("Internal hash table error: entry has no slot");
+	return 0;
+}
+// First empty or tombstone slot in the probe sequence of hash
+u64 hash_table_find_insert_slot(Hash_Table *t, u64 hash) {
+	u64 group_count = t->_slot_count/HASH_TABLE_GROUP_SIZE;
+	u64 group = hash_table_hash_to_group(t, hash);
+
+	for (u64 step = 1; step <= group_count; step += 1) {
+		u8 *group_control = t->_slot_control+group*HASH_TABLE_GROUP_SIZE;
+
+		u32 match = hash_table_group_match_empty_or_tombstone(group_control);
+		if (match) return group*HASH_TABLE_GROUP_SIZE + bit_scan_forward_64(match);
+
+		group = (group+step) & (group_count-1);
+	}
+	panic("Internal hash table error: no free slot");
+	return 0;
+}
+
+// Rebuilds the slot table from the entries, which also gets rid of tombstones
+void hash_table_rehash(Hash_Table *t, u64 slot_count) {
+	assert((slot_count & (slot_count-1)) == 0 && slot_count >= HASH_TABLE_MIN_SLOT_COUNT, "Internal hash table error");
+
+	if (slot_count != t->_slot_count) {
+		if (t->_slot_control) dealloc(t->allocator, t->_slot_control);
+		t->_slot_control = (u8*)alloc(t->allocator, slot_count + slot_count*sizeof(u32));
+		t->_slot_entries = (u32*)(t->_slot_control+slot_count);
+		t->_slot_count = slot_count;
+	}
+
+	memset(t->_slot_control, HASH_TABLE_CONTROL_EMPTY, t->_slot_count);
+	t->_tombstone_count = 0;
+
+	for (u64 i = 0; i < t->count; i++) {
+		u64 hash = *(u64*)hash_table_get_nth_entry(t, i);
+		u64 slot = hash_table_find_insert_slot(t, hash);
+		t->_slot_control[slot] = hash_table_hash_to_control(hash);
+		t->_slot_entries[slot] = (u32)i;
+	}
+}
+
+// Keep at most 7/8 of the slots used, counting tombstones
+inline u64 hash_table_get_slot_count_for(u64 entry_count) {
+	return max(get_next_power_of_two(entry_count + entry_count/7 + 1), HASH_TABLE_MIN_SLOT_COUNT);
+}
+
+void hash_table_free_key(Hash_Table *t, u8 *entry) {
+	if (t->_string_keys) {
+		string *key = (string*)(entry+sizeof(u64));
+		if (key->data) dealloc(t->allocator, key->data);
+	}
 }
 
 void hash_table_reset(Hash_Table *t) {
+	for (u64 i = 0; i < t->count; i++) hash_table_free_key(t, hash_table_get_nth_entry(t, i));
 	t->count = 0;
+	if (t->_slot_control) memset(t->_slot_control, HASH_TABLE_CONTROL_EMPTY, t->_slot_count);
+	t->_tombstone_count = 0;
 }
 void hash_table_destroy(Hash_Table *t) {
+	for (u64 i = 0; i < t->count; i++) hash_table_free_key(t, hash_table_get_nth_entry(t, i));
 	dealloc(t->allocator, t->entries);
-	
+	if (t->_slot_control) dealloc(t->allocator, t->_slot_control);
+
 	t->entries = 0;
 	t->count = 0;
 	t->capacity_count = 0;
+	t->_slot_control = 0;
+	t->_slot_entries = 0;
+	t->_slot_count = 0;
+	t->_tombstone_count = 0;
 }
 
 void hash_table_reserve(Hash_Table *t, u64 required_count) {
-	u64 entry_size = t->_value_size+sizeof(u64);
-	
-	u64 required_size = required_count*entry_size;
-	
-	u64 current_size = t->capacity_count*entry_size;
-	
-	if (current_size >= required_size) return;
-	
-	u64 new_count = get_next_power_of_two(required_count);
-	u64 new_size = new_count*entry_size;
-	
-	void *new_entries = alloc(t->allocator, new_size);
-	memcpy(new_entries, t->entries, current_size);
-	
-	dealloc(t->allocator, t->entries);
-	
-	t->entries = new_entries;
-	t->capacity_count = new_count;
+	assert(required_count <= UINT32_MAX, "Hash table can't have more than UINT32_MAX entries");
+
+	if (t->capacity_count < required_count) {
+		u64 new_count = get_next_power_of_two(required_count);
+
+		t->entries = reallocate(t->allocator, t->entries, t->capacity_count*t->_entry_size, new_count*t->_entry_size);
+		t->capacity_count = new_count;
+	}
+
+	u64 slot_count = hash_table_get_slot_count_for(t->capacity_count);
+	if (slot_count > t->_slot_count) hash_table_rehash(t, slot_count);
 }
 
-// This can add multiple entries of same hash, beware!
+// This can add multiple entries of same key, beware! hash_table_find will then find one of them.
 void hash_table_add_raw(Hash_Table *t, u64 hash, void *k, void *v, u64 key_size, u64 value_size) {
 
 	assert(t->_key_size == key_size, "Key type size does not match hash table initted key type size");
 	assert(t->_value_size == value_size, "Value type size does not match hash table initted value type size");
 
 	hash_table_reserve(t, t->count+1);
-	
-	u64 entry_size = t->_value_size+sizeof(u64);
-	
-	u64 index = entry_size*t->count;
+
+	// Too many tombstones, rehash in place to clear them
+	if (t->count+t->_tombstone_count+1 > t->_slot_count - t->_slot_count/8) {
+		hash_table_rehash(t, t->_slot_count);
+	}
+
+	u64 index = t->count;
 	t->count += 1;
-	
-	u64 hash_offset = 0;
-	u64 value_offset = hash_offset + sizeof(u64);
-	
-	memcpy((u8*)t->entries+index+hash_offset,  &hash, sizeof(u64));
-	memcpy((u8*)t->entries+index+value_offset, v,     value_size);
-}
-
-void *hash_table_find_raw(Hash_Table *t, u64 hash) {
-
-	// #Speed #Incomplete
-	// Do quadratic probe 'triangular numbers'
-
-	u64 entry_size = t->_value_size+sizeof(u64);
-	u64 hash_offset = 0;
-	u64 value_offset = hash_offset + sizeof(u64);
-	
-	for (u64 i = 0; i < t->count; i += 1) {
-		u64 existing_hash = *(u64*)((u8*)t->entries+i*entry_size+hash_offset);
-		if (existing_hash == hash) {
-			void *value = ((u8*)t->entries+i*entry_size+value_offset);
-			return value;
+
+	u8 *entry = hash_table_get_nth_entry(t, index);
+
+	memcpy(entry, &hash, sizeof(u64));
+	if (t->_string_keys) {
+		string key = *(string*)k;
+		string copy = ZERO(string);
+		if (key.count) {
+			copy.data = (u8*)alloc(t->allocator, key.count);
+			copy.count = key.count;
+			memcpy(copy.data, key.data, key.count);
 		}
+		memcpy(entry+sizeof(u64), &copy, sizeof(string));
+	} else {
+		memcpy(entry+sizeof(u64), k, key_size);
 	}
-	return 0;
+	memcpy(entry+t->_value_offset, v, value_size);
+
+	u64 slot = hash_table_find_insert_slot(t, hash);
+	if (t->_slot_control[slot] == HASH_TABLE_CONTROL_TOMBSTONE) t->_tombstone_count -= 1;
+	t->_slot_control[slot] = hash_table_hash_to_control(hash);
+	t->_slot_entries[slot] = (u32)index;
+}
+
+void *hash_table_find_raw(Hash_Table *t, u64 hash, void *k, u64 key_size) {
+
+	assert(t->_key_size == key_size, "Key type size does not match hash table initted key type size");
+
+	if (!t->_slot_count) return 0;
+
+	s64 slot = hash_table_find_slot(t, hash, k);
+	if (slot < 0) return 0;
+
+	return hash_table_get_nth_entry(t, t->_slot_entries[slot])+t->_value_offset;
 }
 
 void *hash_table_get_nth_value(Hash_Table *t, u64 n) {
 	assert(n < t->count, "Hash table n is out of range");
-	
-	u64 entry_size = t->_value_size+sizeof(u64);
-	u64 hash_offset = 0;
-	u64 value_offset = hash_offset + sizeof(u64);
-	
-	return (u8*)t->entries+entry_size*n+value_offset;
+
+	return hash_table_get_nth_entry(t, n)+t->_value_offset;
+}
+void *hash_table_get_nth_key(Hash_Table *t, u64 n) {
+	assert(n < t->count, "Hash table n is out of range");
+
+	return hash_table_get_nth_entry(t, n)+sizeof(u64);
 }
 
-bool hash_table_contains_raw(Hash_Table *t, u64 hash) {
-	return hash_table_find_raw(t, hash) != 0;
+bool hash_table_contains_raw(Hash_Table *t, u64 hash, void *k, u64 key_size) {
+	return hash_table_find_raw(t, hash, k, key_size) != 0;
 }
 
 // Returns true if key was newly added or false if it already existed
 bool hash_table_set_raw(Hash_Table *t, u64 hash, void *k, void *v, u64 key_size, u64 value_size) {
-	bool newly_added = true;
-	
-	if (hash_table_contains_raw(t, hash)) newly_added = false;
-	
-	if (newly_added) {
-		hash_table_add_raw(t, hash, k, v, key_size, value_size);
-	} else {
-		memcpy(hash_table_find_raw(t, hash), v, value_size);
+
+	assert(t->_value_size == value_size, "Value type size does not match hash table initted value type size");
+
+	void *existing = hash_table_find_raw(t, hash, k, key_size);
+
+	if (existing) {
+		memcpy(existing, v, value_size);
+		return false;
 	}
-	
-	return newly_added;
+
+	hash_table_add_raw(t, hash, k, v, key_size, value_size);
+	return true;
 }
 
+// Returns true if key existed
+bool hash_table_remove_raw(Hash_Table *t, u64 hash, void *k, u64 key_size) {
+
+	assert(t->_key_size == key_size, "Key type size does not match hash table initted key type size");
+
+	if (!t->_slot_count) return false;
+
+	s64 slot = hash_table_find_slot(t, hash, k);
+	if (slot < 0) return false;
+
+	u64 index = t->_slot_entries[slot];
+
+	// If the group still has an empty slot, no probe went past it so we don't need a tombstone
+	u8 *group_control = t->_slot_control + (slot/HASH_TABLE_GROUP_SIZE)*HASH_TABLE_GROUP_SIZE;
+	if (hash_table_group_match(group_control, HASH_TABLE_CONTROL_EMPTY)) {
+		t->_slot_control[slot] = HASH_TABLE_CONTROL_EMPTY;
+	} else {
+		t->_slot_control[slot] = HASH_TABLE_CONTROL_TOMBSTONE;
+		t->_tombstone_count += 1;
+	}
+
+	hash_table_free_key(t, hash_table_get_nth_entry(t, index));
+
+	// Keep entries dense, move the last entry into the hole and point its slot to it
+	u64 last = t->count-1;
+	if (index != last) {
+		u8 *last_entry = hash_table_get_nth_entry(t, last);
+		u64 last_slot = hash_table_find_slot_of_entry(t, *(u64*)last_entry, last);
+
+		memcpy(hash_table_get_nth_entry(t, index), last_entry, t->_entry_size);
+		t->_slot_entries[last_slot] = (u32)index;
+	}
+	t->count -= 1;
+
+	return true;
+}
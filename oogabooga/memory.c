@@ -43,12 +43,23 @@ Allocator get_initialization_allocator() {
 
 ///
 ///
-// Basic general heap allocator, free list
+// General heap allocator
 ///
-// Technically thread safe but synchronization is horrible.
-// Fragmentation is catastrophic.
-// We could fix it by merging free nodes every now and then
-// BUT: We aren't really supposed to allocate/deallocate directly on the heap too much anyways...
+// Two paths:
+//  - Small allocations (metadata included, up to HEAP_MAX_SMALL_SIZE) are served from
+//    size-class bins. Each size class has its own lock and a free list of fixed size
+//    slots, so alloc & free is O(1) and threads only contend if they hit the same size class.
+//    Slots are carved out of slabs which are allocated on the free list path.
+//    On top of that, each thread has a small cache of slots per size class which is
+//    refilled from & returned to the size class in batches, so most small allocations
+//    don't take a lock at all.
+//    Any thread can dealloc memory allocated on any other thread; the slot just ends up
+//    in the cache of the thread that freed it and flows back to the size class from there.
+//  - Everything else goes to the best-fit free list in the heap blocks.
+//    Technically thread safe but synchronization is horrible.
+//    Fragmentation is catastrophic.
+//    We could fix it by merging free nodes every now and then
+//    BUT: We aren't really supposed to allocate/deallocate big things directly on the heap too much anyways...
 
 #define MAX_HEAP_BLOCK_SIZE align_next(MB(500), os.page_size)
 #define DEFAULT_HEAP_BLOCK_SIZE (min(MAX_HEAP_BLOCK_SIZE, program_memory_capacity))
@@ -56,6 +67,19 @@ Allocator get_initialization_allocator() {
 typedef struct Heap_Free_Node Heap_Free_Node;
 typedef struct Heap_Block Heap_Block;
 
+// Size classes are 16 byte steps up to 128 bytes, and then 4 classes per power of two
+// up to HEAP_MAX_SMALL_SIZE. Worst case waste is 25% of the slot.
+// #Volatile
+// Free list allocations are always bigger than HEAP_MAX_SMALL_SIZE, that's how we know
+// which path a pointer belongs to when deallocating.
+#define HEAP_MAX_SMALL_SIZE KB(16)
+#define HEAP_SIZE_CLASS_COUNT 36
+#define HEAP_SLAB_SIZE KB(128)
+// Max number of slots moved between a thread cache and a size class at once.
+// A thread cache holds at most 2 batches per size class.
+#define HEAP_THREAD_CACHE_MAX_BATCH 32
+#define HEAP_THREAD_CACHE_BATCH_BYTES KB(16)
+
 typedef struct Heap_Free_Node {
 	u64 size;
 	Heap_Free_Node *next;
@@ -83,16 +107,83 @@ typedef alignat(16) struct Heap_Allocation_Metadata {
 #endif
 } Heap_Allocation_Metadata;
 
+typedef struct Heap_Free_Slot Heap_Free_Slot;
+typedef struct Heap_Free_Slot {
+	Heap_Free_Slot *next;
+} Heap_Free_Slot;
+
+typedef struct Heap_Size_Class {
+	// Aligned to cache line so the per-class locks don't false share
+	alignat(64) Spinlock lock;
+	u64 slot_size;
+	u64 batch_count;
+	Heap_Free_Slot *free_head;
+	
+	// What's left of the current slab that hasn't been handed out yet
+	u8 *slab_next;
+	u8 *slab_end;
+	// The heap block which the current slab lives in, so check_meta() stays happy
+	Heap_Block *slab_block;
+	
+	u64 lock_acquisition_count;
+} Heap_Size_Class;
+
+typedef struct Heap_Thread_Cache_Bin {
+	Heap_Free_Slot *head;
+	u64 count;
+} Heap_Thread_Cache_Bin;
+
+typedef struct Heap_Thread_Cache {
+	Heap_Thread_Cache_Bin bins[HEAP_SIZE_CLASS_COUNT];
+	u64 hit_count;
+	u64 miss_count;
+} Heap_Thread_Cache;
+
+typedef struct Heap_Stats {
+	// How many times the best-fit free list lock (heap_lock) was taken
+	u64 global_lock_acquisitions;
+	// How many times any size class lock was taken (thread cache refills & returns)
+	u64 size_class_lock_acquisitions;
+	// Small allocations served by the calling thread's cache without taking a lock
+	u64 thread_cache_hits;
+	u64 thread_cache_misses;
+} Heap_Stats;
+
 // #Global
 ogb_instance Heap_Block *heap_head;
 ogb_instance bool heap_initted;
 ogb_instance Spinlock heap_lock;
+ogb_instance u64 heap_lock_acquisition_count;
+ogb_instance Heap_Size_Class heap_size_classes[HEAP_SIZE_CLASS_COUNT];
 
 #if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
 Heap_Block *heap_head;
 bool heap_initted = false;
 Spinlock heap_lock;
+u64 heap_lock_acquisition_count = 0;
+Heap_Size_Class heap_size_classes[HEAP_SIZE_CLASS_COUNT];
 #endif // NOT OOGABOOGA_LINK_EXTERNAL_INSTANCE
+
+thread_local Heap_Thread_Cache heap_thread_cache;
+
+// size includes metadata
+inline u64 heap_get_size_class_index(u64 size) {
+	if (size <= 128) return (size+15)/16 - 1;
+	
+	u64 power = bit_scan_reverse_64(size-1);
+	u64 step = 1ull << (power-2);
+	u64 sub = ((size-1) - (1ull << power)) / step;
+	
+	return 8 + (power-7)*4 + sub;
+}
+inline u64 heap_get_size_class_slot_size(u64 index) {
+	if (index < 8) return (index+1)*16;
+	
+	u64 power = 7 + (index-8)/4;
+	u64 sub   = (index-8)%4;
+	
+	return (1ull << power) + (sub+1)*(1ull << (power-2));
+}
 	
 
 u64 get_heap_block_size_excluding_metadata(Heap_Block *block) {
@@ -244,17 +335,36 @@ void heap_init() {
 	if (heap_initted) return;
 	assert(HEAP_ALIGNMENT == 16);
 	assert(sizeof(Heap_Allocation_Metadata) % HEAP_ALIGNMENT == 0);
+	assert(heap_get_size_class_index(HEAP_MAX_SMALL_SIZE) == HEAP_SIZE_CLASS_COUNT-1);
 	heap_initted = true;
 	heap_head = make_heap_block(0, DEFAULT_HEAP_BLOCK_SIZE);
 	spinlock_init(&heap_lock);
+	
+	for (u64 i = 0; i < HEAP_SIZE_CLASS_COUNT; i++) {
+		Heap_Size_Class *c = &heap_size_classes[i];
+		spinlock_init(&c->lock);
+		c->slot_size = heap_get_size_class_slot_size(i);
+		c->batch_count = clamp(HEAP_THREAD_CACHE_BATCH_BYTES/c->slot_size, 2, HEAP_THREAD_CACHE_MAX_BATCH);
+		c->lock_acquisition_count = 0;
+		c->free_head = 0;
+		c->slab_next = 0;
+		c->slab_end = 0;
+		c->slab_block = 0;
+		
+		assert(c->slot_size % HEAP_ALIGNMENT == 0, "Internal heap error: size class is not aligned");
+		assert(heap_get_size_class_index(c->slot_size) == i, "Internal heap error: size class mapping is wrong");
+	}
 }
 
-void *heap_alloc(u64 size) {
+// Best-fit free list path. You probably want heap_alloc() which only comes here for
+// large allocations.
+void *heap_free_list_alloc(u64 size) {
 
 	if (!heap_initted) heap_init();
 
 	// #Sync #Speed oof
 	spinlock_acquire_or_wait(&heap_lock);
+	heap_lock_acquisition_count += 1;
 	
 
 
@@ -396,12 +506,13 @@ void *heap_alloc(u64 size) {
 	assert((u64)p % HEAP_ALIGNMENT == 0, "Internal heap error. Result pointer is not aligned to HEAP_ALIGNMENT");
 	return p;
 }
-void heap_dealloc(void *p) {
+void heap_free_list_dealloc(void *p) {
 	// #Sync #Speed oof
 	
 	if (!heap_initted) heap_init();
 
 	spinlock_acquire_or_wait(&heap_lock);
+	heap_lock_acquisition_count += 1;
 	
 	assert(is_pointer_in_program_memory(p), "A bad pointer was passed tp heap_dealloc: it is out of program memory bounds!"); 
 	p = (u8*)p-sizeof(Heap_Allocation_Metadata);
@@ -531,6 +642,274 @@ void heap_dealloc(void *p) {
 	spinlock_release(&heap_lock);
 }
 
+// Moves up to 'count' slots from the size class into the bin. Returns number of slots moved.
+u64 heap_size_class_take_slots(Heap_Size_Class *c, Heap_Thread_Cache_Bin *bin, u64 count) {
+	spinlock_acquire_or_wait(&c->lock);
+	c->lock_acquisition_count += 1;
+	
+	u64 taken = 0;
+	while (taken < count && c->free_head) {
+		Heap_Free_Slot *slot = c->free_head;
+		c->free_head = slot->next;
+		slot->next = bin->head;
+		bin->head = slot;
+		taken += 1;
+	}
+	
+	while (taken < count) {
+		if (c->slab_next + c->slot_size > c->slab_end) {
+			// We have a few slots so let's not bother with a new slab yet
+			if (taken > 0) break;
+			
+			// #Memory
+			// Slabs are never given back to the free list. The slots are recycled within
+			// the size class, so this only grows to the peak usage for each size.
+			u8 *slab = (u8*)heap_free_list_alloc(HEAP_SLAB_SIZE-sizeof(Heap_Allocation_Metadata)*2);
+			Heap_Allocation_Metadata *slab_meta = (Heap_Allocation_Metadata*)(slab-sizeof(Heap_Allocation_Metadata));
+			c->slab_next = slab;
+			c->slab_end = slab + slab_meta->size - sizeof(Heap_Allocation_Metadata);
+			c->slab_block = slab_meta->block;
+		}
+		
+		Heap_Allocation_Metadata *meta = (Heap_Allocation_Metadata*)c->slab_next;
+		c->slab_next += c->slot_size;
+		
+		// The free slot link only overwrites the size, so the block stays valid in the
+		// metadata for as long as the slot lives.
+		meta->block = c->slab_block;
+		
+		Heap_Free_Slot *slot = (Heap_Free_Slot*)meta;
+		slot->next = bin->head;
+		bin->head = slot;
+		taken += 1;
+	}
+	
+	spinlock_release(&c->lock);
+	
+	bin->count += taken;
+	return taken;
+}
+// Moves up to 'count' slots from the bin back to the size class
+void heap_size_class_return_slots(Heap_Size_Class *c, Heap_Thread_Cache_Bin *bin, u64 count) {
+	count = min(count, bin->count);
+	if (count == 0) return;
+	
+	Heap_Free_Slot *first = bin->head;
+	Heap_Free_Slot *last = first;
+	for (u64 i = 1; i < count; i++) last = last->next;
+	
+	bin->head = last->next;
+	bin->count -= count;
+	
+	spinlock_acquire_or_wait(&c->lock);
+	c->lock_acquisition_count += 1;
+	last->next = c->free_head;
+	c->free_head = first;
+	spinlock_release(&c->lock);
+}
+
+void *heap_alloc(u64 size) {
+
+	if (!heap_initted) heap_init();
+	
+	u64 slot_size = align_next(size + sizeof(Heap_Allocation_Metadata), HEAP_ALIGNMENT);
+	if (slot_size > HEAP_MAX_SMALL_SIZE) return heap_free_list_alloc(size);
+	
+	u64 class_index = heap_get_size_class_index(slot_size);
+	Heap_Size_Class *c = &heap_size_classes[class_index];
+	Heap_Thread_Cache_Bin *bin = &heap_thread_cache.bins[class_index];
+	
+	if (bin->head) {
+		heap_thread_cache.hit_count += 1;
+	} else {
+		heap_thread_cache.miss_count += 1;
+		heap_size_class_take_slots(c, bin, c->batch_count);
+	}
+	
+	assert(bin->head, "Internal heap error: thread cache refill failed");
+	
+	Heap_Allocation_Metadata *meta = (Heap_Allocation_Metadata*)bin->head;
+	bin->head = bin->head->next;
+	bin->count -= 1;
+	
+	meta->size = c->slot_size;
+#if CONFIGURATION == DEBUG
+	meta->signature = HEAP_META_SIGNATURE;
+#endif
+
+	check_meta(meta);
+	
+	void *p = ((u8*)meta)+sizeof(Heap_Allocation_Metadata);
+	assert((u64)p % HEAP_ALIGNMENT == 0, "Internal heap error. Result pointer is not aligned to HEAP_ALIGNMENT");
+	return p;
+}
+void heap_dealloc(void *p) {
+
+	if (!heap_initted) heap_init();
+	
+	assert(is_pointer_in_program_memory(p), "A bad pointer was passed tp heap_dealloc: it is out of program memory bounds!"); 
+	Heap_Allocation_Metadata *meta = (Heap_Allocation_Metadata*)((u8*)p-sizeof(Heap_Allocation_Metadata));
+	check_meta(meta);
+	
+	if (meta->size > HEAP_MAX_SMALL_SIZE) {
+		heap_free_list_dealloc(p);
+		return;
+	}
+	
+	u64 slot_size = meta->size;
+	u64 class_index = heap_get_size_class_index(slot_size);
+	Heap_Size_Class *c = &heap_size_classes[class_index];
+	assert(c->slot_size == slot_size, "Heap error. Either 1) You passed a bad pointer to dealloc or 2) You corrupted the heap.");
+	
+#if CONFIGURATION == DEBUG
+	Heap_Block *block = meta->block;
+	memset(meta, 0x69696969, slot_size);
+	meta->block = block;
+#endif
+	
+	// This might not be the thread that allocated it, but that doesn't matter since
+	// slots are not owned by any thread. It just goes into this thread's cache.
+	Heap_Thread_Cache_Bin *bin = &heap_thread_cache.bins[class_index];
+	Heap_Free_Slot *slot = (Heap_Free_Slot*)meta;
+	slot->next = bin->head;
+	bin->head = slot;
+	bin->count += 1;
+	
+	if (bin->count > c->batch_count*2) {
+		heap_size_class_return_slots(c, bin, c->batch_count);
+	}
+}
+
+// Tries to grow or shrink the allocation without moving it. Returns false if it can't,
+// in which case nothing has changed.
+bool heap_try_resize_in_place(void *p, u64 size) {
+	Heap_Allocation_Metadata *meta = (Heap_Allocation_Metadata*)((u8*)p-sizeof(Heap_Allocation_Metadata));
+	check_meta(meta);
+	
+	if (meta->size <= HEAP_MAX_SMALL_SIZE) {
+		// Slots can't grow, but anything that fits can stay unless it would waste most of the slot
+		u64 slot_size = align_next(size + sizeof(Heap_Allocation_Metadata), HEAP_ALIGNMENT);
+		return slot_size <= meta->size && slot_size > meta->size/2;
+	}
+	
+	// #Copypaste
+	// Same rounding as in heap_free_list_alloc()
+	u64 new_size = size + sizeof(Heap_Allocation_Metadata);
+	new_size = (new_size+HEAP_ALIGNMENT) & ~(HEAP_ALIGNMENT-1);
+	
+	// #Volatile
+	// Free list allocations always need to be bigger than HEAP_MAX_SMALL_SIZE
+	if (new_size <= HEAP_MAX_SMALL_SIZE) return false;
+	if (new_size == meta->size) return true;
+	
+	// #Sync #Speed oof
+	spinlock_acquire_or_wait(&heap_lock);
+	heap_lock_acquisition_count += 1;
+	
+	Heap_Block *block = meta->block;
+	
+	if (new_size < meta->size) {
+		u64 remainder = meta->size - new_size;
+		
+		if (remainder < sizeof(Heap_Allocation_Metadata)) {
+			spinlock_release(&heap_lock);
+			return true;
+		}
+		
+		// Make the tail look like its own allocation and give it back to the free list.
+		// The tail pages are already unlocked since they belong to this allocation.
+		meta->size = new_size;
+		Heap_Allocation_Metadata *tail = (Heap_Allocation_Metadata*)((u8*)meta + new_size);
+		tail->size = remainder;
+		tail->block = block;
+#if CONFIGURATION == DEBUG
+		tail->signature = HEAP_META_SIGNATURE;
+#endif
+		spinlock_release(&heap_lock);
+		
+		heap_free_list_dealloc((u8*)tail + sizeof(Heap_Allocation_Metadata));
+		return true;
+	}
+	
+	u64 extra = new_size - meta->size;
+	u8 *allocation_tail = (u8*)meta + meta->size;
+	
+	// Is there a free node right after us, with enough space?
+	Heap_Free_Node *node = block->free_head;
+	Heap_Free_Node *previous = 0;
+	while (node && (u8*)node != allocation_tail) {
+		previous = node;
+		node = node->next;
+	}
+	
+	if (!node || node->size < extra) {
+		spinlock_release(&heap_lock);
+		return false;
+	}
+	
+	// Unlock free node
+	// #Copypaste
+	void *free_tail = (u8*)node + node->size;
+	void *first_page = (void*)align_previous(node, os.page_size);
+	void *last_page_end = (void*)align_previous(free_tail, os.page_size);
+	if ((u8*)last_page_end > (u8*)first_page) {
+		os_unlock_program_memory_pages(first_page, (u64)last_page_end-(u64)first_page);
+	}
+	
+	Heap_Free_Node *replacement = node->next;
+	if (node->size != extra) {
+		Heap_Free_Node *new_free_node = (Heap_Free_Node*)((u8*)node + extra);
+		new_free_node->size = node->size - extra;
+		new_free_node->next = node->next;
+		
+		// Lock remaining free node
+		// #Copypaste
+		void *free_tail = (u8*)new_free_node + new_free_node->size;
+		void *next_page = (void*)align_next(new_free_node, os.page_size);
+		void *last_page_end = (void*)align_previous(free_tail, os.page_size);
+		if ((u8*)last_page_end > (u8*)next_page) {
+			os_lock_program_memory_pages(next_page, (u64)last_page_end-(u64)next_page);
+		}
+		
+		replacement = new_free_node;
+	}
+	
+	if (previous) previous->next = replacement;
+	else          block->free_head = replacement;
+	
+	meta->size = new_size;
+#if CONFIGURATION == DEBUG
+	block->total_allocated += extra;
+#endif
+
+#if VERY_DEBUG
+	sanity_check_block(block);
+#endif
+
+	spinlock_release(&heap_lock);
+	return true;
+}
+
+// Returns all slots cached by the calling thread to the size classes.
+// This is called when a thread started with os_thread_start exits.
+void heap_thread_cache_flush() {
+	for (u64 i = 0; i < HEAP_SIZE_CLASS_COUNT; i++) {
+		heap_size_class_return_slots(&heap_size_classes[i], &heap_thread_cache.bins[i], heap_thread_cache.bins[i].count);
+	}
+}
+
+// Lock counters are global, thread cache hits/misses are for the calling thread.
+Heap_Stats heap_get_stats() {
+	Heap_Stats stats = ZERO(Heap_Stats);
+	stats.global_lock_acquisitions = heap_lock_acquisition_count;
+	for (u64 i = 0; i < HEAP_SIZE_CLASS_COUNT; i++) {
+		stats.size_class_lock_acquisitions += heap_size_classes[i].lock_acquisition_count;
+	}
+	stats.thread_cache_hits = heap_thread_cache.hit_count;
+	stats.thread_cache_misses = heap_thread_cache.miss_count;
+	return stats;
+}
+
 void* heap_allocator_proc(u64 size, void *p, Allocator_Message message, void* data) {
 	switch (message) {
 		case ALLOCATOR_ALLOCATE: {
@@ -548,8 +927,11 @@ void* heap_allocator_proc(u64 size, void *p, Allocator_Message message, void* da
 			assert(is_pointer_valid(p), "Invalid pointer passed to heap allocator reallocate");
 			Heap_Allocation_Metadata *meta = (Heap_Allocation_Metadata*)(((u64)p)-sizeof(Heap_Allocation_Metadata));
 			check_meta(meta);
+			
+			if (heap_try_resize_in_place(p, size)) return p;
+			
 			void *new = heap_alloc(size);
-			memcpy(new, p, min(size, meta->size));
+			memcpy(new, p, min(size, meta->size-sizeof(Heap_Allocation_Metadata)));
 			heap_dealloc(p);
 			return new;
 		}
@@ -566,15 +948,369 @@ Allocator get_heap_allocator() {
 	return heap_allocator;
 }
 
+///
+///
+// Arena
+///
+// Linear allocator backed by chunks of program memory pages. When a chunk is full, a new
+// (bigger) chunk is chained on, so an arena can grow indefinitely.
+// Pages are committed lazily (unlocked, in practice this only matters in DEBUG where
+// free program memory is PAGE_NOACCESS) as the arena grows into them.
+// Chunks are never given back to the OS, instead they go to a global pool which arenas
+// take chunks from before reserving new pages.
+//
+// Not thread safe, one arena should only be used by one thread at a time.
+//
+// Usage:
+//
+//     Arena arena = make_arena(MB(1));
+//
+//     Thing *thing = arena_push_struct(&arena, Thing);
+//     void *simd_stuff = arena_push_aligned(&arena, 256, 32);
+//
+//     // Scratch scope, everything pushed inside is freed at the end of the scope
+//     arena_scratch_scope(&arena) {
+//         void *temporary_stuff = arena_push(&arena, 1024);
+//     }
+//
+//     // Or manually
+//     Arena_Marker marker = arena_save(&arena);
+//     arena_push(&arena, 1024);
+//     arena_restore(&arena, marker);
+//
+//     // Free everything in one go, i.e. at the end of each frame
+//     arena_reset(&arena);
+//
+//     // Use it anywhere you can use an Allocator. Reallocating the last allocation is
+//     // done in place.
+//     Allocator allocator = make_arena_allocator_from_arena(&arena);
+//
+//     destroy_arena(&arena);
+
+#define ARENA_DEFAULT_ALIGNMENT 8
+#define ARENA_MIN_CHUNK_SIZE KB(64)
+#define ARENA_MAX_GROW_CHUNK_SIZE MB(64)
+
+typedef struct Arena_Chunk Arena_Chunk;
+typedef struct Arena_Chunk {
+	Arena_Chunk *previous;
+	// Reserved size, including this header
+	u64 size;
+	// Pages before this are unlocked
+	u8 *committed;
+	// How much of the arena was used in previous chunks when this chunk was chained on
+	u64 used_before;
+} Arena_Chunk;
+
+typedef struct Arena {
+	// Usable memory in current chunk
+	void *start;
+	void *next;
+	u64 size;
+	
+	// 0 if the arena is on memory passed by the user, then it cannot grow
+	Arena_Chunk *chunk;
+	void *last_allocation;
+	// Most memory used since last arena_reset()
+	u64 high_water_mark;
+} Arena;
+
+typedef struct Arena_Marker {
+	Arena_Chunk *chunk;
+	void *next;
+} Arena_Marker;
+
+// #Global
+ogb_instance Arena_Chunk *arena_free_chunks;
+ogb_instance Spinlock arena_free_chunks_lock;
+
+#if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
+Arena_Chunk *arena_free_chunks = 0;
+Spinlock arena_free_chunks_lock = ZERO(Spinlock);
+#endif // NOT OOGABOOGA_LINK_EXTERNAL_INSTANCE
+
+Arena_Chunk *arena_acquire_chunk(u64 minimum_size) {
+	
+	minimum_size = align_next(minimum_size+sizeof(Arena_Chunk), os.page_size);
+	
+	Arena_Chunk *chunk = 0;
+	
+	// Best fit in the pool, so small arenas don't take the big chunks
+	spinlock_acquire_or_wait(&arena_free_chunks_lock);
+	Arena_Chunk *node = arena_free_chunks;
+	Arena_Chunk *previous = 0;
+	Arena_Chunk *best_previous = 0;
+	while (node) {
+		if (node->size >= minimum_size && (!chunk || node->size < chunk->size)) {
+			chunk = node;
+			best_previous = previous;
+			if (node->size == minimum_size) break;
+		}
+		previous = node;
+		node = node->previous;
+	}
+	if (chunk) {
+		if (best_previous) best_previous->previous = chunk->previous;
+		else               arena_free_chunks = chunk->previous;
+	}
+	spinlock_release(&arena_free_chunks_lock);
+	
+	if (!chunk) {
+		// os_reserve_next_memory_pages is not thread safe, and the heap uses it too
+		spinlock_acquire_or_wait(&heap_lock);
+		heap_lock_acquisition_count += 1;
+		chunk = (Arena_Chunk*)os_reserve_next_memory_pages(minimum_size);
+		spinlock_release(&heap_lock);
+		
+		// Only commit the header, the rest is committed as the arena grows into it
+		os_unlock_program_memory_pages(chunk, os.page_size);
+		chunk->size = minimum_size;
+		chunk->committed = (u8*)chunk + os.page_size;
+	}
+	
+	chunk->previous = 0;
+	chunk->used_before = 0;
+	
+	return chunk;
+}
+void arena_release_chunk(Arena_Chunk *chunk) {
+	
+#if CONFIGURATION == DEBUG
+	// Lock it again so we catch anyone still using memory from it
+	u8 *first_page = (u8*)chunk + os.page_size;
+	if (chunk->committed > first_page) {
+		os_lock_program_memory_pages(first_page, (u64)(chunk->committed-first_page));
+		chunk->committed = first_page;
+	}
+#endif
+
+	spinlock_acquire_or_wait(&arena_free_chunks_lock);
+	chunk->previous = arena_free_chunks;
+	arena_free_chunks = chunk;
+	spinlock_release(&arena_free_chunks_lock);
+}
+
+void arena_set_chunk(Arena *arena, Arena_Chunk *chunk) {
+	arena->chunk = chunk;
+	arena->start = (u8*)chunk + sizeof(Arena_Chunk);
+	arena->next = arena->start;
+	arena->size = chunk->size - sizeof(Arena_Chunk);
+}
+
+Arena make_arena(u64 size) {
+	Arena arena = ZERO(Arena);
+	arena_set_chunk(&arena, arena_acquire_chunk(max(size, ARENA_MIN_CHUNK_SIZE-sizeof(Arena_Chunk))));
+	return arena;
+}
+// The arena can't grow past the given memory
+Arena make_arena_with_memory(u64 size, void *p) {
+	Arena arena = ZERO(Arena);
+	arena.start = p;
+	arena.next = p;
+	arena.size = size;
+	return arena;
+}
+
+void destroy_arena(Arena *arena) {
+	Arena_Chunk *chunk = arena->chunk;
+	while (chunk) {
+		Arena_Chunk *previous = chunk->previous;
+		arena_release_chunk(chunk);
+		chunk = previous;
+	}
+	*arena = ZERO(Arena);
+}
+
+inline u64 arena_get_used_bytes(Arena *arena) {
+	u64 used = (u64)arena->next - (u64)arena->start;
+	if (arena->chunk) used += arena->chunk->used_before;
+	return used;
+}
+
+// Commits pages up to arena->next and tracks the high water mark
+inline void arena_did_grow(Arena *arena) {
+	if (arena->chunk && (u8*)arena->next > arena->chunk->committed) {
+		u8 *committed = (u8*)align_next((u64)arena->next, os.page_size);
+		os_unlock_program_memory_pages(arena->chunk->committed, (u64)(committed-arena->chunk->committed));
+		arena->chunk->committed = committed;
+	}
+	arena->high_water_mark = max(arena->high_water_mark, arena_get_used_bytes(arena));
+}
+
+void *arena_push_aligned(Arena *arena, u64 size, u64 alignment) {
+	assert(alignment > 0 && (alignment & (alignment-1)) == 0, "Arena alignment must be a power of two");
+	
+	u8 *p = (u8*)align_next((u64)arena->next, alignment);
+	u8 *end = (u8*)arena->start + arena->size;
+	
+	if (p + size > end) {
+		assert(arena->chunk, "Arena with fixed memory is out of memory (%llu bytes)", arena->size);
+		
+		u64 chunk_size = min(arena->chunk->size*2, ARENA_MAX_GROW_CHUNK_SIZE);
+		chunk_size = max(chunk_size, size+alignment);
+		
+		Arena_Chunk *chunk = arena_acquire_chunk(chunk_size);
+		chunk->previous = arena->chunk;
+		chunk->used_before = arena_get_used_bytes(arena);
+		arena_set_chunk(arena, chunk);
+		
+		p = (u8*)align_next((u64)arena->next, alignment);
+		end = (u8*)arena->start + arena->size;
+		assert(p + size <= end, "Internal arena error");
+	}
+	
+	arena->next = p + size;
+	arena->last_allocation = p;
+	
+	arena_did_grow(arena);
+	
+	return p;
+}
+inline void *arena_push(Arena *arena, u64 size) {
+	return arena_push_aligned(arena, size, ARENA_DEFAULT_ALIGNMENT);
+}
+#define arena_push_struct(parena, type) arena_push_aligned((parena), sizeof(type), _Alignof(type))
+
+// Resize the last allocation without moving it. Returns false if it's not the last
+// allocation or if it doesn't fit in the current chunk.
+bool arena_try_resize_last(Arena *arena, void *p, u64 new_size) {
+	if (!p || p != arena->last_allocation) return false;
+	
+	u8 *end = (u8*)arena->start + arena->size;
+	if ((u8*)p + new_size > end) return false;
+	
+	arena->next = (u8*)p + new_size;
+	
+	arena_did_grow(arena);
+	
+	return true;
+}
+
+inline Arena_Marker arena_save(Arena *arena) {
+	return (Arena_Marker){arena->chunk, arena->next};
+}
+void arena_restore(Arena *arena, Arena_Marker marker) {
+	while (arena->chunk != marker.chunk) {
+		assert(arena->chunk, "Arena marker does not belong to this arena, or it was already restored past it");
+		Arena_Chunk *chunk = arena->chunk;
+		arena_set_chunk(arena, chunk->previous);
+		arena_release_chunk(chunk);
+	}
+	assert((u8*)marker.next >= (u8*)arena->start && (u8*)marker.next <= (u8*)arena->start+arena->size, "Bad arena marker");
+	arena->next = marker.next;
+	arena->last_allocation = 0;
+}
+
+// Everything pushed inside the scope is freed when the scope ends.
+// Don't break/return out of it.
+#define arena_scratch_scope(arena) \
+	for (Arena_Marker _arena_marker_ = arena_save(arena), *_arena_scope_ = &_arena_marker_; _arena_scope_; arena_restore((arena), _arena_marker_), _arena_scope_ = 0)
+
+// Frees everything. If the arena had to grow since last reset, all chunks are
+// replaced with one chunk that fits the high water mark, so it doesn't need to grow
+// again for the same amount of memory.
+void arena_reset(Arena *arena) {
+	if (arena->chunk && arena->chunk->previous) {
+		u64 size = arena->high_water_mark;
+		destroy_arena(arena);
+		arena_set_chunk(arena, arena_acquire_chunk(size));
+	} else {
+		arena->next = arena->start;
+		arena->last_allocation = 0;
+	}
+	arena->high_water_mark = 0;
+}
+
+void* arena_allocator_proc(u64 size, void *p, Allocator_Message message, void* data) {
+	Arena *arena = (Arena*)data;
+	switch (message) {
+		case ALLOCATOR_ALLOCATE: {
+			return arena_push(arena, size);
+		}
+		case ALLOCATOR_DEALLOCATE: {
+			return 0;
+		}
+		case ALLOCATOR_REALLOCATE: {
+			if (arena_try_resize_last(arena, p, size)) return p;
+			// Can't do it, reallocate() will alloc & copy
+			return 0;
+		}
+	}
+	return 0;
+}
+
+// Arena is allocated on the heap and lives until you deallocate allocator.data
+Allocator make_arena_allocator(u64 size) {
+	Arena *arena = (Arena*)alloc(get_heap_allocator(), sizeof(Arena));
+	*arena = make_arena(size);
+	
+	Allocator allocator;
+	allocator.data = arena;
+	allocator.proc = arena_allocator_proc;
+	
+	return allocator;
+}
+Allocator make_arena_allocator_with_memory(u64 size, void *p) {
+	Arena *arena = (Arena*)alloc(get_heap_allocator(), sizeof(Arena));
+	*arena = make_arena_with_memory(size, p);
+	
+	Allocator allocator;
+	allocator.data = arena;
+	allocator.proc = arena_allocator_proc;
+	
+	return allocator;
+}
+Allocator make_arena_allocator_from_arena(Arena *arena) {
+	Allocator allocator;
+	allocator.data = arena;
+	allocator.proc = arena_allocator_proc;
+	
+	return allocator;
+}
+
 ///
 ///
 // Temporary storage
 ///
+// Per-thread arena which is reset with reset_temporary_storage(), usually once per frame.
+// TEMPORARY_STORAGE_SIZE is only the initial size, if a frame needs more then the arena
+// chains on more chunks, so earlier temporary allocations in the frame are never
+// overwritten. On reset, the chunks are merged into one chunk big enough for the peak
+// usage. If usage goes down again for a while, it shrinks back to fit the new peak.
+//
+// Nested scratch scopes free everything allocated inside of them when the scope ends:
+//
+//     temporary_storage_scope() {
+//         string s = tprint("%i", 69);
+//     }
+//
+// Use get_temporary_storage_stats() to see how much a frame actually used, so you can
+// set TEMPORARY_STORAGE_SIZE from data.
 
 #ifndef TEMPORARY_STORAGE_SIZE
 	#define TEMPORARY_STORAGE_SIZE (1024ULL*1024ULL*2ULL) // 2mb
 #endif
 
+// Temporary storage shrinks if it was more than twice as big as needed in this many resets
+#ifndef TEMPORARY_STORAGE_SHRINK_DELAY
+	#define TEMPORARY_STORAGE_SHRINK_DELAY 120
+#endif
+
+typedef struct Temporary_Storage_Stats {
+	// Used right now
+	u64 used;
+	// Most used since last reset_temporary_storage()
+	u64 peak;
+	// Peak of the frame before the last reset_temporary_storage()
+	u64 last_frame_peak;
+	// Highest last_frame_peak ever
+	u64 highest_peak;
+	// Usable bytes in the current chunk
+	u64 capacity;
+	// How many times temporary storage had to grow past its capacity
+	u64 grow_count;
+} Temporary_Storage_Stats;
+
 ogb_instance void* talloc(u64);
 ogb_instance void* temp_allocator_proc(u64 size, void *p, Allocator_Message message, void*);
 
@@ -583,14 +1319,17 @@ ogb_instance Allocator
 get_temporary_allocator();
 
 #if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
-thread_local void * temporary_storage = 0;
-thread_local void * temporary_storage_pointer = 0;
-thread_local bool   has_warned_temporary_storage_overflow = false;
+thread_local Arena temporary_storage = ZERO(Arena);
+thread_local u64   temporary_storage_initial_size = 0;
+// Peak over the last TEMPORARY_STORAGE_SHRINK_DELAY resets
+thread_local u64   temporary_storage_window_peak = 0;
+thread_local u64   temporary_storage_window_frames = 0;
+thread_local Temporary_Storage_Stats temporary_storage_stats = ZERO(Temporary_Storage_Stats);
 thread_local Allocator temp_allocator;
 
 ogb_instance Allocator 
 get_temporary_allocator() {
-	if (!temporary_storage) return get_initialization_allocator();
+	if (!temporary_storage.chunk) return get_initialization_allocator();
 	return temp_allocator;
 }
 #endif
@@ -601,12 +1340,27 @@ temp_allocator_proc(u64 size, void *p, Allocator_Message message, void* data);
 ogb_instance void 
 temporary_storage_init(u64 arena_size);
 
+ogb_instance void 
+temporary_storage_deinit();
+
 ogb_instance void* 
 talloc(u64 size);
 
 ogb_instance void 
 reset_temporary_storage();
 
+ogb_instance Arena_Marker 
+temporary_storage_save();
+
+ogb_instance void 
+temporary_storage_restore(Arena_Marker marker);
+
+ogb_instance Temporary_Storage_Stats 
+get_temporary_storage_stats();
+
+// Everything allocated with the temporary allocator inside the scope is freed when the
+// scope ends. Scopes can be nested. Don't break/return out of it.
+#define temporary_storage_scope() arena_scratch_scope(&temporary_storage)
 
 #if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
 void* temp_allocator_proc(u64 size, void *p, Allocator_Message message, void* data) {
@@ -619,7 +1373,8 @@ void* temp_allocator_proc(u64 size, void *p, Allocator_Message message, void* da
 			return 0;
 		}
 		case ALLOCATOR_REALLOCATE: {
-			panic("Temporary allocator cannot 'reallocate'");
+			if (arena_try_resize_last(&temporary_storage, p, size)) return p;
+			// Can't do it, reallocate() will alloc & copy
 			return 0;
 		}
 	}
@@ -628,124 +1383,78 @@ void* temp_allocator_proc(u64 size, void *p, Allocator_Message message, void* da
 
 void temporary_storage_init(u64 arena_size) {
 	
-	temporary_storage = heap_alloc(arena_size);
-	assert(temporary_storage, "Failed allocating temporary storage");
-	temporary_storage_pointer = temporary_storage;
+	assert(!temporary_storage.chunk, "Temporary storage was already initialized on this thread");
+	
+	temporary_storage = make_arena(arena_size);
+	temporary_storage_initial_size = arena_size;
+	temporary_storage_window_peak = 0;
+	temporary_storage_window_frames = 0;
+	temporary_storage_stats = ZERO(Temporary_Storage_Stats);
 
 	temp_allocator.proc = temp_allocator_proc;
 	temp_allocator.data = 0;
-	
-	temp_allocator.proc = temp_allocator_proc;
+}
+void temporary_storage_deinit() {
+	destroy_arena(&temporary_storage);
 }
 
 void* talloc(u64 size) {
 	
-	assert(size < TEMPORARY_STORAGE_SIZE, "Bruddah this is too large for temp allocator");
+	assert(temporary_storage.chunk, "Temporary storage was not initialized on this thread");
 	
-	void* p = temporary_storage_pointer;
+	Arena_Chunk *chunk = temporary_storage.chunk;
 	
-	temporary_storage_pointer = (u8*)temporary_storage_pointer + size;
+	void *p = arena_push(&temporary_storage, size);
 	
-	if ((u8*)temporary_storage_pointer >= (u8*)temporary_storage+TEMPORARY_STORAGE_SIZE) {
-		if (!has_warned_temporary_storage_overflow) {
-			os_write_string_to_stdout(STR("WARNING: temporary storage was overflown, we wrap around at the start.\n"));
-			has_warned_temporary_storage_overflow = true;
-		}
-		temporary_storage_pointer = temporary_storage;
-		return talloc(size);;
-	}
+	if (temporary_storage.chunk != chunk) temporary_storage_stats.grow_count += 1;
 	
 	return p;
 }
 
 void reset_temporary_storage() {
-	temporary_storage_pointer = temporary_storage;	
-	has_warned_temporary_storage_overflow = false;
-}
-
-#endif // NOT OOGABOOGA_LINK_EXTERNAL_INSTANCE
-
-
-typedef struct Arena {
-	void *start;
-	void *next;
-	u64 size;
-} Arena;
-
-
-
-// Allocates arena from heap
-Arena make_arena(u64 size) {
-	size = align_next(size, 8);
-	Arena arena;
 	
-	arena.start = alloc(get_heap_allocator(), size);
-	arena.next = arena.start;
-	arena.size = size;
+	u64 peak = temporary_storage.high_water_mark;
 	
-	return arena;
-}
-
-void *arena_push(Arena *arena, u64 size) {
-	void *p = arena->next;
-	arena->next = (u8*)arena->next + size;
-	return p;
-}
-#define arena_push_struct(parena, type) arena_push((parena), sizeof(type))
-
-void* arena_allocator_proc(u64 size, void *p, Allocator_Message message, void* data) {
-	if (size > 8) size = align_next(size, 8);
-	Arena *arena = (Arena*)data;
-	switch (message) {
-		case ALLOCATOR_ALLOCATE: {
-			return arena_push(arena, size);
-		}
-		case ALLOCATOR_DEALLOCATE: {
-			return 0;
-		}
-		case ALLOCATOR_REALLOCATE: {
-			panic("Arena allocator cannot 'reallocate'");
-			return 0;
-		}
-	}
-	return 0;
-}
-
-// Allocates arena from heap
-Allocator make_arena_allocator(u64 size) {
-	void *mem = alloc(get_heap_allocator(), size + sizeof(Arena));
+	temporary_storage_stats.last_frame_peak = peak;
+	temporary_storage_stats.highest_peak = max(temporary_storage_stats.highest_peak, peak);
 	
-	Arena *arena = (Arena*)mem;
+	// Shrink when the chunk has been much bigger than needed for a while
+	temporary_storage_window_peak = max(temporary_storage_window_peak, peak);
+	temporary_storage_window_frames += 1;
 	
-	arena->start = (u8*)mem + sizeof(Arena);
-	arena->next = arena->start;
-	arena->size = size;
+	u64 wanted_size = max(temporary_storage_window_peak, temporary_storage_initial_size);
+	bool shrink = temporary_storage_window_frames >= TEMPORARY_STORAGE_SHRINK_DELAY
+	           && !temporary_storage.chunk->previous
+	           && temporary_storage.size > max(wanted_size*2, ARENA_MIN_CHUNK_SIZE);
 	
-	Allocator allocator;
-	allocator.data = arena;
-	allocator.proc = arena_allocator_proc;
+	if (temporary_storage_window_frames >= TEMPORARY_STORAGE_SHRINK_DELAY) {
+		temporary_storage_window_peak = 0;
+		temporary_storage_window_frames = 0;
+	}
 	
-	return allocator;
+	if (shrink) {
+		Arena old = temporary_storage;
+		temporary_storage = make_arena(wanted_size);
+		destroy_arena(&old);
+	} else {
+		// Merges chained chunks into one that fits peak
+		arena_reset(&temporary_storage);
+	}
 }
-Allocator make_arena_allocator_with_memory(u64 size, void *p) {
-	void *mem = alloc(get_heap_allocator(), size + sizeof(Arena));
-	
-	Arena *arena = (Arena*)alloc(get_heap_allocator(), sizeof(Arena));
-	
-	arena->start = p;
-	arena->next = arena->start;
-	arena->size = size;
-	
-	Allocator allocator;
-	allocator.data = arena;
-	allocator.proc = arena_allocator_proc;
-	
-	return allocator;
+
+Arena_Marker temporary_storage_save() {
+	return arena_save(&temporary_storage);
 }
-Allocator make_arena_allocator_from_arena(Arena *arena) {
-	Allocator allocator;
-	allocator.data = arena;
-	allocator.proc = arena_allocator_proc;
-	
-	return allocator;
+void temporary_storage_restore(Arena_Marker marker) {
+	arena_restore(&temporary_storage, marker);
+}
+
+Temporary_Storage_Stats get_temporary_storage_stats() {
+	Temporary_Storage_Stats stats = temporary_storage_stats;
+	stats.used = arena_get_used_bytes(&temporary_storage);
+	stats.peak = temporary_storage.high_water_mark;
+	stats.capacity = temporary_storage.size;
+	return stats;
 }
+
+#endif // NOT OOGABOOGA_LINK_EXTERNAL_INSTANCE
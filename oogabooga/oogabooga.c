@@ -136,6 +136,27 @@
             Example:
             
                 #define OOGABOOGA_HEADLESS 1
+                
+		- GFX_RENDERER
+			Which renderer to use. Defaults to the native one for the target os.
+			
+			GFX_RENDERER_D3D11:    Direct3D 11 (Windows)
+			GFX_RENDERER_SOFTWARE: Renders on the CPU, see gfx_impl_software.c (default on Linux)
+			
+			Example:
+			
+				#define GFX_RENDERER GFX_RENDERER_SOFTWARE
+				
+		- SHADER_CACHE_DIRECTORY
+			Where compiled shaders are kept between runs so they don't have to be compiled
+			again on startup. Relative to the working directory. Define it as "" to disable.
+			
+			Example:
+			
+				#define SHADER_CACHE_DIRECTORY "build/shader_cache"
+				
+			Note:
+				See shader_cache.c
 */
 
 #define OGB_VERSION_MAJOR 0
@@ -144,9 +165,16 @@
 
 #define OGB_VERSION (OGB_VERSION_MAJOR*1000000+OGB_VERSION_MINOR*1000+OGB_VERSION_PATCH)
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+	// Needs to come before any system header. For pthread_getattr_np & co.
+	#define _GNU_SOURCE
+#endif
+
 #include <math.h>
 #include <immintrin.h>
-#include <intrin.h>
+#ifdef _WIN32
+	#include <intrin.h>
+#endif
 #include <stdint.h>
 
 typedef uint8_t  u8;
@@ -223,6 +251,10 @@ typedef u8 bool;
     #define INITIAL_PROGRAM_MEMORY_SIZE MB(5)
 #endif
 
+#ifndef SHADER_CACHE_DIRECTORY
+	#define SHADER_CACHE_DIRECTORY ".oogabooga/shader_cache"
+#endif
+
 #if ENABLE_SIMD && !defined(SIMD_ENABLE_SSE2)
 	#if COMPILER_CAN_DO_SSE2
 		#define SIMD_ENABLE_SSE2 1
@@ -258,9 +290,22 @@ typedef u8 bool;
 	#define TARGET_OS WINDOWS
 	#define OS_PATHS_HAVE_BACKSLASH 1
 #elif defined(__linux__)
-	// Include whatever #Incomplete #Portability
+	// Headless or software renderer without a window for now, see os_impl_linux.c
+	#include <pthread.h>
+	#include <errno.h>
+	#include <limits.h>
+	#include <stdarg.h>
+	#include <stddef.h>
+	#include <string.h>
+	#include <stdlib.h>
+	#include <unistd.h>
+	// Calling convention and SAL annotations in declarations shared with windows
+	#define __cdecl
+	#define _In_
+	// windows.h has these and they're used before os_interface.c
+	#define max(a, b) ((a) > (b) ? (a) : (b))
+	#define min(a, b) ((a) < (b) ? (a) : (b))
 	#define TARGET_OS LINUX
-	#error "Linux is not supported yet";
 	#define OS_PATHS_HAVE_BACKSLASH 0
 #elif defined(__APPLE__) && defined(__MACH__)
 	// Include whatever #Incomplete #Portability
@@ -290,12 +335,14 @@ typedef u8 bool;
 #define GFX_RENDERER_D3D11  0
 #define GFX_RENDERER_VULKAN 1
 #define GFX_RENDERER_METAL  2
+#define GFX_RENDERER_SOFTWARE 3
 #ifndef GFX_RENDERER
 // #Portability
 	#if TARGET_OS == WINDOWS
 		#define GFX_RENDERER GFX_RENDERER_D3D11
 	#elif TARGET_OS == LINUX
-		#define GFX_RENDERER GFX_RENDERER_VULKAN
+		// There's no vulkan renderer yet
+		#define GFX_RENDERER GFX_RENDERER_SOFTWARE
 	#elif TARGET_OS == MACOS
 		#define GFX_RENDERER GFX_RENDERER_METAL
 	#endif
@@ -327,6 +374,7 @@ typedef u8 bool;
 /////
 
 #include "concurrency.c"
+#include "sort.c"
 
 #include "profiling.c"
 #include "random.c"
@@ -334,9 +382,16 @@ typedef u8 bool;
 #include "memory.c"
 #include "input.c"
 
+#include "gfx_pack.c"
+#include "tilemap.c"
+#include "gfx_target_pool.c"
+#include "shader_cache.c"
+
 #ifndef OOGABOOGA_HEADLESS
 
     #include "gfx_interface.c"
+    
+    #include "gfx_atlas.c"
 
     #include "font.c"
 
@@ -370,6 +425,8 @@ typedef u8 bool;
             #error "We only have a D3D11 renderer at the moment"
         #elif GFX_RENDERER == GFX_RENDERER_METAL
             #error "We only have a D3D11 renderer at the moment"
+        #elif GFX_RENDERER == GFX_RENDERER_SOFTWARE
+            #include "gfx_impl_software.c"
         #else
             #error "Unknown renderer GFX_RENDERER defined"
         #endif
@@ -411,6 +468,7 @@ void oogabooga_init(u64 program_memory_size) {
 	context.logger = default_logger;
 	temp_allocator = get_initialization_allocator();
 	Cpu_Capabilities features = query_cpu_capabilities();
+	hash_init(features);
 	os_init(program_memory_size);
 	heap_init();
 	temporary_storage_init(TEMPORARY_STORAGE_SIZE);
@@ -0,0 +1,891 @@
+/*
+
+	Linux os layer.
+
+	Threads, mutexes, semaphores, time, dynamic libraries, files and program memory.
+	That's enough for headless builds (OOGABOOGA_HEADLESS), e.g. servers and the tests.
+
+	Non-headless builds work with GFX_RENDERER_SOFTWARE, but there is no window yet:
+	- The window is virtual. Its size and position follow the same rules as on windows, but
+	  nothing is shown and gfx_update renders into memory only.
+	- There is no input, so nothing is ever pressed.
+	- There is no audio device. Audio sources can be made and played but nothing is heard.
+
+	Build with gcc or clang:
+
+		gcc -std=gnu11 -msse4.1 your_main.c -lm -lpthread -ldl
+
+	See build_headless.sh.
+
+*/
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <dlfcn.h>
+#include <sched.h>
+#include <time.h>
+#include <execinfo.h>
+
+// #Global
+struct timespec linux_time_at_start;
+Os_Monitor linux_headless_monitor;
+
+// Program memory is one big reservation that we commit from, so it stays contiguous like on windows
+#define LINUX_PROGRAM_MEMORY_RESERVE GB(64)
+
+// impl input.c
+const u64 MAX_NUMBER_OF_GAMEPADS = 4;
+
+#ifndef OOGABOOGA_HEADLESS
+void
+linux_init_window() {
+	memset(&window, 0, sizeof(window));
+
+	// Same defaults as the windows layer
+	window.title = STR("Unnamed Window");
+	window.point_width = 960;
+	window.point_height = 540;
+	window.x = 200;
+	window.y = 150;
+	window.should_close = false;
+	window.force_topmost = false;
+	window.clear_color.r = 0.392f;
+	window.clear_color.g = 0.584f;
+	window.clear_color.b = 0.929f;
+	window.clear_color.a = 1.0f;
+
+	window._initialized = true;
+	window.allow_resize = true;
+}
+#endif /* NOT OOGABOOGA_HEADLESS */
+
+void os_init(u64 program_memory_capacity) {
+
+    // #Volatile
+    // Any printing uses vsnprintf, and printing may happen in init,
+    // especially on errors, so this needs to happen first.
+	os.crt = os_load_dynamic_library(STR("libc.so.6"));
+	assert(os.crt != 0, "Could not load libc.so.6");
+	os.crt_vsnprintf = (Crt_Vsnprintf_Proc)os_dynamic_library_load_symbol(os.crt, STR("vsnprintf"));
+	assert(os.crt_vsnprintf, "Missing vsnprintf in crt");
+
+	context.thread_id = (u64)pthread_self();
+
+	os.page_size = (u64)sysconf(_SC_PAGESIZE);
+	// Memory is committed in steps of this, same as the windows allocation granularity
+	os.granularity = KB(64);
+
+	// Provided by the linker, from the start of the program image to the end of .bss
+	extern char __executable_start[], _end[];
+	os.static_memory_start = __executable_start;
+	os.static_memory_end = _end;
+
+	program_memory_mutex = os_make_mutex();
+	os_grow_program_memory(program_memory_capacity);
+
+	heap_init();
+
+	clock_gettime(CLOCK_MONOTONIC, &linux_time_at_start);
+
+	// No display to ask, but os.primary_monitor is expected to be there
+	linux_headless_monitor.name = STR("Headless");
+	linux_headless_monitor.refresh_rate = 60;
+#ifndef OOGABOOGA_HEADLESS
+	// What fullscreen resizes the virtual window to
+	linux_headless_monitor.name = STR("Virtual");
+	linux_headless_monitor.resolution_x = 1920;
+	linux_headless_monitor.resolution_y = 1080;
+#endif
+	linux_headless_monitor.dpi = 96;
+	linux_headless_monitor.dpi_y = 96;
+	os.monitors = &linux_headless_monitor;
+	os.primary_monitor = &linux_headless_monitor;
+	os.number_of_connected_monitors = 1;
+
+#ifndef OOGABOOGA_HEADLESS
+
+	linux_init_window();
+
+	// Nothing consumes this yet, but audio.c converts sources to it
+	audio_output_format.sample_rate = 48000;
+	audio_output_format.channels = 2;
+	audio_output_format.bit_width = AUDIO_BITS_32;
+#endif /* NOT OOGABOOGA_HEADLESS */
+
+	window.monitor = os.primary_monitor;
+}
+
+///
+///
+// Threading
+///
+
+///
+// Thread primitive
+
+void *linux_thread_invoker(void *param) {
+	Thread *t = (Thread*)param;
+
+	temporary_storage_init(t->temporary_storage_size);
+
+	context = t->initial_context;
+	context.thread_id = (u64)pthread_self();
+
+	t->proc(t);
+
+	temporary_storage_deinit();
+	heap_thread_cache_flush();
+
+	return 0;
+}
+
+////// DEPRECATED   vvvvvvvvvvvvvvvvv
+Thread* os_make_thread(Thread_Proc proc, Allocator allocator) {
+	Thread *t = (Thread*)alloc(allocator, sizeof(Thread));
+	os_thread_init(t, proc);
+	t->allocator = allocator;
+	return t;
+}
+void os_destroy_thread(Thread *t) {
+	os_thread_destroy(t);
+	dealloc(t->allocator, t);
+}
+void os_start_thread(Thread *t) {
+	os_thread_start(t);
+}
+void os_join_thread(Thread *t) {
+	os_thread_join(t);
+}
+////// DEPRECATED   ^^^^^^^^^^^^^^^^
+
+void os_thread_init(Thread *t, Thread_Proc proc) {
+	memset(t, 0, sizeof(Thread));
+	t->id = 0;
+	t->proc = proc;
+	t->initial_context = context;
+	t->temporary_storage_size = KB(10);
+}
+void os_thread_destroy(Thread *t) {
+	os_thread_join(t);
+}
+void os_thread_start(Thread *t) {
+	int result = pthread_create(&t->os_handle, 0, linux_thread_invoker, t);
+	assert(result == 0, "Failed creating thread, error %d", result);
+	t->id = (u64)t->os_handle;
+}
+void os_thread_join(Thread *t) {
+	// Windows lets you wait on a thread more than once, pthreads doesn't
+	if (!t->os_handle) return;
+	pthread_join(t->os_handle, 0);
+	t->os_handle = 0;
+}
+
+///
+// Mutex primitive
+
+Mutex_Handle os_make_mutex() {
+	// #Memory
+	// Mutex_Handle is a pointer so it can be copied around like a windows HANDLE.
+	// These are made before the heap exists, so they are mapped directly.
+	Mutex_Handle m = (Mutex_Handle)mmap(0, sizeof(pthread_mutex_t), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	assert(m != MAP_FAILED, "Failed allocating mutex");
+
+	int result = pthread_mutex_init(m, 0);
+	assert(result == 0, "Failed creating mutex, error %d", result);
+
+	return m;
+}
+void os_destroy_mutex(Mutex_Handle m) {
+	pthread_mutex_destroy(m);
+	munmap(m, sizeof(pthread_mutex_t));
+}
+void os_lock_mutex(Mutex_Handle m) {
+	int result = pthread_mutex_lock(m);
+	assert(result == 0, "Unexpected mutex lock result %d", result);
+}
+void os_unlock_mutex(Mutex_Handle m) {
+	int result = pthread_mutex_unlock(m);
+	assert(result == 0, "Unlock mutex 0x%x failed with error %d", m, result);
+}
+
+///
+// Binary semaphore
+
+// Same as the manual reset event on windows, wait returns once it's set and then resets it
+typedef struct Linux_Event {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	bool is_set;
+} Linux_Event;
+
+void os_binary_semaphore_init(Binary_Semaphore *sem, bool initial_state) {
+	Linux_Event *e = (Linux_Event*)mmap(0, sizeof(Linux_Event), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	assert(e != MAP_FAILED, "Failed allocating binary semaphore");
+
+	pthread_mutex_init(&e->mutex, 0);
+	pthread_cond_init(&e->cond, 0);
+	e->is_set = initial_state;
+
+	sem->os_event = e;
+}
+
+void os_binary_semaphore_destroy(Binary_Semaphore *sem) {
+	Linux_Event *e = (Linux_Event*)sem->os_event;
+	pthread_cond_destroy(&e->cond);
+	pthread_mutex_destroy(&e->mutex);
+	munmap(e, sizeof(Linux_Event));
+}
+
+void os_binary_semaphore_wait(Binary_Semaphore *sem) {
+	Linux_Event *e = (Linux_Event*)sem->os_event;
+	pthread_mutex_lock(&e->mutex);
+	while (!e->is_set) pthread_cond_wait(&e->cond, &e->mutex);
+	e->is_set = false;
+	pthread_mutex_unlock(&e->mutex);
+}
+
+void os_binary_semaphore_signal(Binary_Semaphore *sem) {
+	Linux_Event *e = (Linux_Event*)sem->os_event;
+	pthread_mutex_lock(&e->mutex);
+	e->is_set = true;
+	pthread_cond_broadcast(&e->cond);
+	pthread_mutex_unlock(&e->mutex);
+}
+
+
+void os_sleep(u32 ms) {
+	struct timespec t;
+	t.tv_sec = ms/1000;
+	t.tv_nsec = (long)(ms%1000)*1000000;
+	while (nanosleep(&t, &t) != 0) {}
+}
+
+void os_yield_thread() {
+	sched_yield();
+}
+
+void os_high_precision_sleep(f64 ms) {
+
+	const f64 s = ms/1000.0;
+
+	f64 start = os_get_elapsed_seconds();
+	f64 end = start + (f64)s;
+
+	// nanosleep is a lot more precise than Sleep, so only spin for the last millisecond
+	s32 sleep_time = (s32)(ms-1.0);
+	if (sleep_time >= 1) os_sleep(sleep_time);
+
+	while (os_get_elapsed_seconds() < end) {
+		os_yield_thread();
+	}
+}
+
+
+///
+///
+// Time
+///
+
+
+// #Cleanup deprecated
+float64
+os_get_current_time_in_seconds() {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (float64)t.tv_sec + (float64)t.tv_nsec/1000000000.0;
+}
+
+float64
+os_get_elapsed_seconds() {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (float64)(t.tv_sec-linux_time_at_start.tv_sec) + (float64)(t.tv_nsec-linux_time_at_start.tv_nsec)/1000000000.0;
+}
+
+
+///
+///
+// Dynamic Libraries
+///
+
+Dynamic_Library_Handle os_load_dynamic_library(string path) {
+	return dlopen(temp_convert_to_null_terminated_string(path), RTLD_NOW);
+}
+void *os_dynamic_library_load_symbol(Dynamic_Library_Handle l, string identifier) {
+	return dlsym(l, temp_convert_to_null_terminated_string(identifier));
+}
+void os_unload_dynamic_library(Dynamic_Library_Handle l) {
+	dlclose(l);
+}
+
+
+///
+///
+// IO
+///
+
+// #Global
+const File OS_INVALID_FILE = -1;
+void os_write_string_to_stdout(string s) {
+	u64 written = 0;
+	while (written < s.count) {
+		ssize_t n = write(STDOUT_FILENO, s.data+written, s.count-written);
+		if (n <= 0) return;
+		written += (u64)n;
+	}
+}
+
+File os_file_open_s(string path, Os_Io_Open_Flags flags) {
+	// Same as windows: O_CREATE replaces the file, O_WRITE alone writes over it from the start
+	int linux_flags = (flags & O_WRITE) ? O_RDWR : O_RDONLY;
+	if (flags & O_CREATE) linux_flags = O_RDWR | O_CREAT | O_TRUNC;
+
+	return open(temp_convert_to_null_terminated_string(path), linux_flags | O_CLOEXEC, 0644);
+}
+
+void os_file_close(File f) {
+	if (f != OS_INVALID_FILE) close(f);
+}
+
+bool os_file_delete_s(string path) {
+	return unlink(temp_convert_to_null_terminated_string(path)) == 0;
+}
+
+bool os_file_copy_s(string from, string to, bool replace_if_exists) {
+	if (!replace_if_exists && os_is_file_s(to)) return false;
+
+	string data;
+	if (!os_read_entire_file_s(from, &data, get_heap_allocator())) return false;
+
+	bool ok = os_write_entire_file_s(to, data);
+	dealloc_string(get_heap_allocator(), data);
+
+	return ok;
+}
+
+bool os_make_directory_s(string path, bool recursive) {
+	char *cpath = temp_convert_to_null_terminated_string(path);
+
+	if (recursive) {
+		for (char *sep = strchr(cpath+1, '/'); sep; sep = strchr(sep+1, '/')) {
+			*sep = 0;
+			if (mkdir(cpath, 0755) != 0 && errno != EEXIST) return false;
+			*sep = '/';
+		}
+	}
+
+	if (mkdir(cpath, 0755) != 0 && errno != EEXIST) return false;
+
+	return true;
+}
+bool os_delete_directory_s(string path, bool recursive) {
+	char *cpath = temp_convert_to_null_terminated_string(path);
+
+	if (recursive) {
+		DIR *dir = opendir(cpath);
+		if (!dir) return false;
+
+		struct dirent *entry;
+		while ((entry = readdir(dir)) != 0) {
+			if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+
+			string child = tprint("%s/%cs", path, entry->d_name);
+
+			bool ok;
+			if (os_is_directory_s(child)) ok = os_delete_directory_s(child, true);
+			else                          ok = os_file_delete_s(child);
+			if (!ok) {
+				closedir(dir);
+				return false;
+			}
+		}
+		closedir(dir);
+	}
+
+	return rmdir(cpath) == 0;
+}
+
+bool os_file_write_string(File f, string s) {
+	return os_file_write_bytes(f, s.data, s.count);
+}
+
+bool os_file_write_bytes(File f, void *buffer, u64 size_in_bytes) {
+	u64 written = 0;
+	while (written < size_in_bytes) {
+		ssize_t n = write(f, (u8*)buffer+written, size_in_bytes-written);
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			return false;
+		}
+		written += (u64)n;
+	}
+	return true;
+}
+
+bool os_file_read(File f, void* buffer, u64 bytes_to_read, u64 *actual_read_bytes) {
+	// ReadFile only returns less than asked for at the end of the file, so keep reading
+	u64 read_count = 0;
+	while (read_count < bytes_to_read) {
+		ssize_t n = read(f, (u8*)buffer+read_count, bytes_to_read-read_count);
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			if (actual_read_bytes) *actual_read_bytes = read_count;
+			return false;
+		}
+		if (n == 0) break;
+		read_count += (u64)n;
+	}
+	if (actual_read_bytes) *actual_read_bytes = read_count;
+	return true;
+}
+
+bool os_file_set_pos(File f, s64 pos_in_bytes) {
+	if (pos_in_bytes < 0) return false;
+	return lseek(f, (off_t)pos_in_bytes, SEEK_SET) >= 0;
+}
+
+s64
+os_file_get_size(File f) {
+	struct stat st;
+	if (fstat(f, &st) != 0) return -1;
+	return (s64)st.st_size;
+}
+
+s64
+os_file_get_size_from_path(string path) {
+	struct stat st;
+	if (stat(temp_convert_to_null_terminated_string(path), &st) != 0) return -1;
+	return (s64)st.st_size;
+}
+
+s64 os_file_get_pos(File f) {
+	off_t pos = lseek(f, 0, SEEK_CUR);
+	return pos < 0 ? -1 : (s64)pos;
+}
+
+bool os_write_entire_file_handle(File f, string data) {
+    return os_file_write_string(f, data);
+}
+
+bool os_write_entire_file_s(string path, string data) {
+    File file = os_file_open_s(path, O_WRITE | O_CREATE);
+    if (file == OS_INVALID_FILE) {
+        return false;
+    }
+    bool result = os_file_write_string(file, data);
+    os_file_close(file);
+    return result;
+}
+
+bool os_read_entire_file_handle(File f, string *result, Allocator allocator) {
+	s64 size = os_file_get_size(f);
+	if (size < 0) return false;
+
+	u64 actual_read = 0;
+	result->data = (u8*)alloc(allocator, (u64)size);
+	result->count = (u64)size;
+
+	bool ok = os_file_read(f, result->data, (u64)size, &actual_read);
+	if (!ok) {
+		dealloc(allocator, result->data);
+		result->data = 0;
+		return false;
+	}
+
+	return actual_read == (u64)size;
+}
+
+bool os_read_entire_file_s(string path, string *result, Allocator allocator) {
+    File file = os_file_open_s(path, O_READ);
+    if (file == OS_INVALID_FILE) {
+        return false;
+    }
+    bool res = os_read_entire_file_handle(file, result, allocator);
+    os_file_close(file);
+    return res;
+}
+
+bool os_is_file_s(string path) {
+	struct stat st;
+	if (stat(temp_convert_to_null_terminated_string(path), &st) != 0) return false;
+	return S_ISREG(st.st_mode);
+}
+
+bool os_is_directory_s(string path) {
+	struct stat st;
+	if (stat(temp_convert_to_null_terminated_string(path), &st) != 0) return false;
+	return S_ISDIR(st.st_mode);
+}
+
+bool os_is_path_absolute(string path) {
+	return path.count > 0 && path.data[0] == '/';
+}
+
+// Like GetFullPathName, the path doesn't need to exist. "." and ".." are resolved but
+// symlinks are not.
+bool os_get_absolute_path(string path, string *result, Allocator allocator) {
+	string full = path;
+	if (!os_is_path_absolute(path)) {
+		char cwd[PATH_MAX];
+		if (!getcwd(cwd, sizeof(cwd))) return false;
+		full = tprint("%cs/%s", cwd, path);
+	}
+
+	// Worst case the resolved path is just as long
+	u8 *out = (u8*)alloc(allocator, full.count+1);
+	u64 count = 0;
+
+	u64 i = 0;
+	while (i < full.count) {
+		while (i < full.count && full.data[i] == '/') i += 1;
+		u64 start = i;
+		while (i < full.count && full.data[i] != '/') i += 1;
+		string part = string_view(full, start, i-start);
+
+		if (part.count == 0 || strings_match(part, STR("."))) continue;
+		if (strings_match(part, STR(".."))) {
+			while (count > 0 && out[count-1] != '/') count -= 1;
+			if (count > 0) count -= 1;
+			continue;
+		}
+		out[count++] = '/';
+		memcpy(out+count, part.data, part.count);
+		count += part.count;
+	}
+	if (count == 0) out[count++] = '/';
+
+	result->data = out;
+	result->count = count;
+
+	return true;
+}
+
+bool os_get_relative_path(string from, string to, string *result, Allocator allocator) {
+
+	if (!os_get_absolute_path(from, &from, get_temporary_allocator())) return false;
+	if (!os_get_absolute_path(to, &to, get_temporary_allocator())) return false;
+
+	// Same as PathRelativePathTo, relative to the directory of from if from is a file
+	if (os_is_file_s(from)) {
+		u64 last_slash = 0;
+		for (u64 i = 0; i < from.count; i++) if (from.data[i] == '/') last_slash = i;
+		from.count = last_slash;
+	}
+
+	// "/" becomes an empty path so every directory starts with a slash
+	if (from.count == 1) from.count = 0;
+	if (to.count == 1)   to.count = 0;
+
+	// Length of the directories both paths start with
+	u64 common = 0;
+	for (u64 i = 0; i <= from.count && i <= to.count; i++) {
+		bool from_end = i == from.count || from.data[i] == '/';
+		bool to_end   = i == to.count   || to.data[i]   == '/';
+		if (from_end && to_end) common = i;
+		if (i == from.count || i == to.count || from.data[i] != to.data[i]) break;
+	}
+
+	String_Builder b;
+	string_builder_init_reserve(&b, from.count+to.count+2, get_temporary_allocator());
+
+	string_builder_append(&b, STR("."));
+	for (u64 i = common; i < from.count; i++) {
+		if (from.data[i] == '/') string_builder_append(&b, STR("/.."));
+	}
+	string_builder_append(&b, string_view(to, common, to.count-common));
+
+	*result = string_copy(string_builder_get_string(b), allocator);
+
+	return true;
+}
+
+bool os_do_paths_match(string a, string b) {
+	string full_a, full_b;
+	if (!os_get_absolute_path(a, &full_a, get_temporary_allocator())) return false;
+	if (!os_get_absolute_path(b, &full_b, get_temporary_allocator())) return false;
+
+	return strings_match(full_a, full_b);
+}
+
+// #Cleanup
+// These are not os-specific, why are they here?
+void fprints(File f, string fmt, ...) {
+	va_list args;
+	va_start(args, fmt);
+	fprint_va_list_buffered(f, fmt, args);
+	va_end(args);
+}
+void fprintf(File f, const char* fmt, ...) {
+	va_list args;
+	va_start(args, fmt);
+	string s;
+	s.data = cast(u8*)fmt;
+	s.count = strlen(fmt);
+	fprint_va_list_buffered(f, s, args);
+	va_end(args);
+}
+
+void os_wait_and_read_stdin(string *result, u64 max_count, Allocator allocator) {
+	char *buffer = talloc(max_count);
+
+	ssize_t n = read(STDIN_FILENO, buffer, max_count);
+
+	if (n < 0) {
+		*result = string_copy(STR("STDIN is not available"), allocator);
+	} else {
+		*result = alloc_string(allocator, (u64)n);
+		memcpy(result->data, buffer, (u64)n);
+		if (result->count >= 1 && result->data[result->count-1] == '\n') result->count -= 1;
+	}
+}
+
+
+
+///
+///
+// Queries
+///
+
+thread_local void *linux_stack_base = 0;
+thread_local void *linux_stack_limit = 0;
+void linux_query_stack() {
+	pthread_attr_t attributes;
+	void *address;
+	size_t size;
+	pthread_getattr_np(pthread_self(), &attributes);
+	pthread_attr_getstack(&attributes, &address, &size);
+	pthread_attr_destroy(&attributes);
+
+	linux_stack_limit = address;
+	linux_stack_base = (u8*)address + size;
+}
+
+void*
+os_get_stack_base() {
+	if (!linux_stack_base) linux_query_stack();
+	return linux_stack_base;
+}
+void*
+os_get_stack_limit() {
+	if (!linux_stack_base) linux_query_stack();
+	return linux_stack_limit;
+}
+
+u64
+os_get_number_of_logical_processors() {
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count > 0 ? (u64)count : 1;
+}
+
+///
+///
+// Debug
+///
+#define LINUX_MAX_STACK_FRAMES 64
+string *
+os_get_stack_trace(u64 *trace_count, Allocator allocator) {
+	void *frames[LINUX_MAX_STACK_FRAMES];
+	int frame_count = backtrace(frames, LINUX_MAX_STACK_FRAMES);
+
+	// Names are only there for symbols that are exported, link with -rdynamic to get them all
+	char **symbols = backtrace_symbols(frames, frame_count);
+
+	string *stack_strings = (string*)alloc(allocator, (u64)frame_count*sizeof(string));
+	for (int i = 0; i < frame_count; i++) {
+		if (symbols) {
+			stack_strings[i] = string_copy(STR(symbols[i]), allocator);
+		} else {
+			stack_strings[i] = sprint(allocator, STR("0x%llx"), (u64)frames[i]);
+		}
+	}
+	*trace_count = (u64)frame_count;
+
+	// backtrace_symbols mallocs
+	free(symbols);
+
+	return stack_strings;
+}
+
+bool os_grow_program_memory(u64 new_size) {
+	os_lock_mutex(program_memory_mutex); // #Sync
+	if (program_memory_capacity >= new_size) {
+		os_unlock_mutex(program_memory_mutex); // #Sync
+		return true;
+	}
+
+	bool is_first_time = program_memory == 0;
+
+	if (is_first_time) {
+		// Only reserves address space, pages are committed below as we grow
+		void *base = mmap(0, LINUX_PROGRAM_MEMORY_RESERVE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		if (base == MAP_FAILED) {
+			os_unlock_mutex(program_memory_mutex); // #Sync
+			return false;
+		}
+		program_memory = base;
+		program_memory_next = program_memory;
+	}
+
+	// Keep the tail aligned to granularity, same as on windows
+	u64 aligned_size = align_next(new_size, os.granularity);
+	if (aligned_size > LINUX_PROGRAM_MEMORY_RESERVE) {
+		os_unlock_mutex(program_memory_mutex); // #Sync
+		return false;
+	}
+
+	void *tail = (u8*)program_memory + program_memory_capacity;
+	u64 amount_to_allocate = aligned_size - program_memory_capacity;
+
+	if (mprotect(tail, amount_to_allocate, PROT_READ | PROT_WRITE) != 0) {
+		os_unlock_mutex(program_memory_mutex); // #Sync
+		return false;
+	}
+#if CONFIGURATION == DEBUG
+	memset(tail, 0xBA, amount_to_allocate);
+	mprotect(tail, amount_to_allocate, PROT_NONE);
+#endif
+
+	program_memory_capacity = aligned_size;
+
+	// No print, it might need memory
+	char size_str[64];
+	u64 size_count = format_string_to_buffer_vararg(size_str, sizeof(size_str), "Program memory grew to %llu kb\n", program_memory_capacity/1024);
+	os_write_string_to_stdout((string){size_count, (u8*)size_str});
+	os_unlock_mutex(program_memory_mutex); // #Sync
+	return true;
+}
+
+void*
+os_reserve_next_memory_pages(u64 size) {
+	assert(size % os.page_size == 0, "size was not aligned to page size in os_reserve_next_memory_pages");
+
+	void *p = program_memory_next;
+
+	program_memory_next = (u8*)program_memory_next + size;
+
+	void *program_tail = (u8*)program_memory + program_memory_capacity;
+
+	if ((u64)program_memory_next > (u64)program_tail) {
+		u64 minimum_size = ((u64)program_memory_next) - (u64)program_memory + 1;
+		u64 new_program_size = get_next_power_of_two(minimum_size);
+
+		bool ok = os_grow_program_memory(new_program_size);
+		assert(ok, "OS is not letting us allocate more memory. Maybe we are out of memory? You sure must be using a lot of memory then.");
+	}
+
+	return p;
+}
+
+void
+os_unlock_program_memory_pages(void *start, u64 size) {
+#if CONFIGURATION == DEBUG
+	assert((u64)start % os.page_size == 0, "When unlocking memory pages, the start address must be the start of a page");
+	assert(size       % os.page_size == 0, "When unlocking memory pages, the size must be aligned to page_size");
+	int result = mprotect(start, size, PROT_READ | PROT_WRITE);
+	assert(result == 0, "mprotect failed with error %d", errno);
+#endif
+}
+
+void
+os_lock_program_memory_pages(void *start, u64 size) {
+#if CONFIGURATION == DEBUG
+	assert((u64)start % os.page_size == 0, "When locking memory pages, the start address must be the start of a page");
+	assert(size       % os.page_size == 0, "When locking memory pages, the size must be aligned to page_size");
+	int result = mprotect(start, size, PROT_NONE);
+	assert(result == 0, "mprotect failed with error %d", errno);
+#endif
+}
+
+///
+///
+// Mouse pointer
+
+// No window, so these do nothing
+
+void
+os_set_mouse_pointer_standard(Mouse_Pointer_Kind kind) {
+}
+
+void
+os_set_mouse_pointer_custom(Custom_Mouse_Pointer p) {
+}
+
+Custom_Mouse_Pointer
+os_make_custom_mouse_pointer(void *image, int width, int height, int hotspot_x, int hotspot_y) {
+	return 0;
+}
+
+Custom_Mouse_Pointer
+os_make_custom_mouse_pointer_from_file(string path, int hotspot_x, int hotspot_y, Allocator allocator) {
+	return 0;
+}
+
+///
+///
+// Input
+
+void set_gamepad_vibration(float32 left, float32 right) {
+}
+void set_specific_gamepad_vibration(u64 gamepad_index, float32 left, float32 right) {
+}
+
+Input_Key_Code os_key_to_key_code(void* os_key) {
+	return KEY_UNKNOWN;
+}
+void* key_code_to_os_key(Input_Key_Code key_code) {
+	return 0;
+}
+
+void os_update() {
+	// No os inputs, but events and the one frame key states still only last for one frame
+	input_frame.number_of_events = 0;
+	for (u64 i = 0; i < INPUT_KEY_CODE_COUNT; i++) {
+		input_frame.key_states[i] &= ~(INPUT_STATE_REPEAT);
+		input_frame.key_states[i] &= ~(INPUT_STATE_JUST_PRESSED);
+		input_frame.key_states[i] &= ~(INPUT_STATE_JUST_RELEASED);
+	}
+
+#ifndef OOGABOOGA_HEADLESS
+	window.dpi = window.monitor->dpi;
+	window.point_size_in_pixels = window.dpi / 72.0;
+
+	local_persist Os_Window last_window;
+
+	//
+	// Virtual window sizing, same rules as the windows layer minus the actual window and the
+	// deprecated scaled size
+
+	if (window.fullscreen) {
+		window.pixel_width = window.monitor->resolution_x;
+		window.pixel_height = window.monitor->resolution_y;
+		window.x = 0;
+		window.y = 0;
+	} else if (last_window.pixel_width == window.pixel_width && last_window.pixel_height == window.pixel_height) {
+		if (last_window.point_width != window.point_width || last_window.point_height != window.point_height) {
+			window.width = window.point_width*window.point_size_in_pixels;
+			window.height = window.point_height*window.point_size_in_pixels;
+		}
+
+		if (last_window.point_x != window.point_x || last_window.point_y != window.point_y) {
+			window.x = window.point_x*window.point_size_in_pixels;
+			window.y = window.point_y*window.point_size_in_pixels;
+		}
+	}
+
+	// #Hack
+	// Even sizes only, like on windows
+	if (window.pixel_width % 2 != 0) window.pixel_width += 1;
+	if (window.pixel_height % 2 != 0) window.pixel_height += 1;
+
+	window.point_width = window.pixel_width / window.point_size_in_pixels;
+	window.point_height = window.pixel_height / window.point_size_in_pixels;
+	window.point_x = window.pixel_x / window.point_size_in_pixels;
+	window.point_y = window.pixel_y / window.point_size_in_pixels;
+
+	last_window = window;
+#endif /* NOT OOGABOOGA_HEADLESS */
+}
@@ -614,7 +614,8 @@ DWORD WINAPI win32_thread_invoker(LPVOID param) {
 	
 	t->proc(t);
 	
-	heap_dealloc(temporary_storage);
+	temporary_storage_deinit();
+	heap_thread_cache_flush();
 	
 	return 0;
 }
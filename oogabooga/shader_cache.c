@@ -0,0 +1,168 @@
+
+/*
+
+	Shader_Cache keeps compiled shader bytecode on disk so shaders don't have to be compiled
+	again every time the program starts.
+
+	A blob is found by a key which is a hash of the shader source and anything else that
+	changes the output, like defines, entry point and target. Changing any of those gives a
+	new key, so an edited shader is compiled and stored again by itself.
+
+	Example Usage:
+
+		Shader_Cache cache;
+		shader_cache_init(&cache, STR(".oogabooga/shader_cache"), STR("my compiler 1.0"), get_heap_allocator());
+
+		u64 key = shader_cache_make_key(&cache, source, STR("ps_main ps_5_0"));
+
+		string bytecode;
+		if (!shader_cache_lookup(&cache, key, &bytecode, get_heap_allocator())) {
+			bytecode = my_compile(source);
+			shader_cache_store(&cache, key, bytecode);
+		}
+
+	The compiler id given to shader_cache_init is hashed into every key along with
+	SHADER_CACHE_VERSION and the oogabooga version, so blobs from another compiler or
+	another version of the engine are never used. Files are checked against their header and
+	a hash of the blob when they're read, and ones that don't check out (truncated, written by
+	something else) are deleted and count as a miss.
+
+	There's no way to list the files in a directory yet, so blobs that are no longer used are
+	not deleted. Delete the directory to clear the cache.
+
+*/
+
+// #Volatile bump when the file layout or what goes into keys changes
+#define SHADER_CACHE_VERSION 1
+#define SHADER_CACHE_MAGIC 0x4353474F // "OGSC"
+
+typedef struct Shader_Cache_File_Header {
+	u32 magic;
+	u32 version;
+	u64 key;
+	u64 blob_size;
+	u64 blob_hash;
+} Shader_Cache_File_Header;
+
+typedef struct Shader_Cache {
+	// Empty if the cache is disabled, then lookups miss and stores do nothing
+	string directory;
+	// Hash of the compiler id & versions, seeds every key
+	u64 seed;
+	Allocator allocator;
+
+	u64 hit_count;
+	u64 miss_count;
+	u64 store_count;
+	// Files that were found but didn't check out
+	u64 invalid_count;
+} Shader_Cache;
+
+// Returns false and leaves the cache disabled if the directory could not be made
+bool shader_cache_init(Shader_Cache *cache, string directory, string compiler_id, Allocator allocator) {
+	*cache = ZERO(Shader_Cache);
+	cache->allocator = allocator;
+
+	u64 versions[2] = { SHADER_CACHE_VERSION, OGB_VERSION };
+	cache->seed = hash_bytes(compiler_id.data, compiler_id.count, hash_bytes(versions, sizeof(versions), 0));
+
+	if (directory.count == 0) return false;
+
+	if (!os_is_directory(directory) && !os_make_directory(directory, true)) {
+		log_warning("Could not make shader cache directory '%s', shaders will not be cached", directory);
+		return false;
+	}
+
+	cache->directory = string_copy(directory, allocator);
+	return true;
+}
+
+void shader_cache_deinit(Shader_Cache *cache) {
+	if (cache->directory.count) dealloc_string(cache->allocator, cache->directory);
+	cache->directory = ZERO(string);
+}
+
+// Defines is anything other than the source that changes the output
+u64 shader_cache_make_key(Shader_Cache *cache, string source, string defines) {
+	u64 h = hash_bytes(source.data, source.count, cache->seed);
+	return hash_bytes(defines.data, defines.count, h);
+}
+
+string shader_cache_get_path(Shader_Cache *cache, u64 key, Allocator allocator) {
+	return sprint(allocator, STR("%s/%016llx.shader"), cache->directory, key);
+}
+
+// On a hit, bytecode is allocated with allocator and freed with dealloc_string
+bool shader_cache_lookup(Shader_Cache *cache, u64 key, string *bytecode, Allocator allocator) {
+	*bytecode = ZERO(string);
+	if (cache->directory.count == 0) return false;
+
+	string path = shader_cache_get_path(cache, key, get_temporary_allocator());
+
+	string file;
+	if (!os_is_file(path) || !os_read_entire_file(path, &file, allocator)) {
+		cache->miss_count += 1;
+		return false;
+	}
+
+	Shader_Cache_File_Header header = ZERO(Shader_Cache_File_Header);
+	if (file.count >= sizeof(header)) memcpy(&header, file.data, sizeof(header));
+
+	u8 *blob = file.data + sizeof(header);
+	bool valid = file.count >= sizeof(header)
+	          && header.magic == SHADER_CACHE_MAGIC
+	          && header.version == SHADER_CACHE_VERSION
+	          && header.key == key
+	          && header.blob_size == file.count - sizeof(header)
+	          && header.blob_hash == hash_bytes(blob, header.blob_size, key);
+
+	if (!valid) {
+		dealloc_string(allocator, file);
+		os_file_delete(path);
+		cache->invalid_count += 1;
+		cache->miss_count += 1;
+		return false;
+	}
+
+	// Move the blob to the start of the allocation so it can be freed as a string
+	memmove(file.data, blob, header.blob_size);
+	bytecode->data = file.data;
+	bytecode->count = header.blob_size;
+
+	cache->hit_count += 1;
+	return true;
+}
+
+bool shader_cache_store(Shader_Cache *cache, u64 key, string bytecode) {
+	if (cache->directory.count == 0) return false;
+
+	Shader_Cache_File_Header header = ZERO(Shader_Cache_File_Header);
+	header.magic = SHADER_CACHE_MAGIC;
+	header.version = SHADER_CACHE_VERSION;
+	header.key = key;
+	header.blob_size = bytecode.count;
+	header.blob_hash = hash_bytes(bytecode.data, bytecode.count, key);
+
+	string file = alloc_string(cache->allocator, sizeof(header) + bytecode.count);
+	memcpy(file.data, &header, sizeof(header));
+	memcpy(file.data + sizeof(header), bytecode.data, bytecode.count);
+
+	string path = shader_cache_get_path(cache, key, get_temporary_allocator());
+	bool ok = os_write_entire_file(path, file);
+	dealloc_string(cache->allocator, file);
+	if (!ok) {
+		log_warning("Could not write shader cache file '%s'", path);
+		return false;
+	}
+
+	cache->store_count += 1;
+	return true;
+}
+
+// Deletes the blob for key, if there is one
+void shader_cache_invalidate(Shader_Cache *cache, u64 key) {
+	if (cache->directory.count == 0) return;
+
+	string path = shader_cache_get_path(cache, key, get_temporary_allocator());
+	if (os_is_file(path)) os_file_delete(path);
+}
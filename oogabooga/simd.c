@@ -40,6 +40,10 @@ inline void basic_rsqrt_float32_96(float32 *a, float32 *result);
 inline void basic_rsqrt_float32_128(float32 *a, float32 *result);
 inline void basic_rsqrt_float32_256(float32 *a, float32 *result);
 inline void basic_rsqrt_float32_512(float32 *a, float32 *result);
+// Round to nearest, halves up: floor(x + 0.5). Unlike ties to even or away from zero, this
+// doesn't depend on where x is, so snapped edges move together.
+inline void basic_round_float32_128(float32 *a, float32 *result);
+inline void basic_round_float32_256(float32 *a, float32 *result);
 
 
 
@@ -50,7 +54,9 @@ inline void basic_rsqrt_float32_512(float32 *a, float32 *result);
 #endif
 
 #include <immintrin.h>
-#include <intrin.h>
+#ifdef _WIN32
+	#include <intrin.h>
+#endif
 
 
 // SSE
@@ -210,10 +216,23 @@ inline void simd_sub_int32_128_aligned(s32 *a, s32 *b, s32* result) {
     __m128i vr = _mm_sub_epi32(va, vb);
     _mm_store_si128((__m128i*)result, vr);
 }
+inline void simd_round_float32_128(float32 *a, float32 *result) {
+	__m128 va = _mm_loadu_ps(a);
+	// No floor before SSE4.1: truncate x + 0.5 and take 1 where that went up (negative x)
+	__m128 half_up = _mm_add_ps(va, _mm_set1_ps(0.5f));
+	__m128 vr = _mm_cvtepi32_ps(_mm_cvttps_epi32(half_up));
+	vr = _mm_sub_ps(vr, _mm_and_ps(_mm_cmpgt_ps(vr, half_up), _mm_set1_ps(1.0f)));
+	// cvttps_epi32 overflows from 2^31 and up, but floats that big are already whole
+	__m128 abs = _mm_andnot_ps(_mm_set1_ps(-0.0f), va);
+	__m128 big = _mm_cmpge_ps(abs, _mm_set1_ps(2147483648.0f));
+	vr = _mm_or_ps(_mm_and_ps(big, va), _mm_andnot_ps(big, vr));
+	_mm_storeu_ps(result, vr);
+}
 
 #else
 	#define simd_add_int32_128 		basic_add_int32_128
 	#define simd_sub_int32_128 		basic_sub_int32_128
+	#define simd_round_float32_128 	basic_round_float32_128
 	
 	#define simd_add_int32_128_aligned 		basic_add_int32_128
 	#define simd_sub_int32_128_aligned 		basic_sub_int32_128
@@ -343,7 +362,13 @@ inline void simd_rsqrt_float32_256_aligned(float32 *a, float32 *result) {
     __m256 vr = _mm256_rsqrt_ps(va);
     _mm256_store_ps(result, vr);
 }
+inline void simd_round_float32_256(float32 *a, float32 *result) {
+	__m256 va = _mm256_loadu_ps(a);
+	__m256 vr = _mm256_round_ps(_mm256_add_ps(va, _mm256_set1_ps(0.5f)), _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+	_mm256_storeu_ps(result, vr);
+}
 #else
+	#define simd_round_float32_256 	basic_round_float32_256
 	#define simd_add_float32_256 	basic_add_float32_256
 	#define simd_sub_float32_256 	basic_sub_float32_256
 	#define simd_mul_float32_256 	basic_mul_float32_256
@@ -571,6 +596,7 @@ inline void simd_rsqrt_float32_512_aligned(float32 *a, float32 *result) {
 #define simd_add_int32_128 		basic_add_int32_128
 #define simd_sub_int32_128 		basic_sub_int32_128
 #define simd_mul_int32_128 		basic_mul_int32_128
+#define simd_round_float32_128 	basic_round_float32_128
 #define simd_add_int32_128_aligned 		basic_add_int32_128
 #define simd_sub_int32_128_aligned 		basic_sub_int32_128
 #define simd_mul_int32_128_aligned 		basic_mul_int32_128
@@ -584,6 +610,7 @@ inline void simd_rsqrt_float32_512_aligned(float32 *a, float32 *result) {
 #define simd_dot_product_float32_128_aligned basic_dot_product_float32_128
 
 // AVX
+#define simd_round_float32_256 	basic_round_float32_256
 #define simd_add_float32_256 	basic_add_float32_256
 #define simd_sub_float32_256 	basic_sub_float32_256
 #define simd_mul_float32_256 	basic_mul_float32_256
@@ -799,4 +826,13 @@ inline void basic_rsqrt_float32_512(float32 *a, float32 *result) {
     basic_rsqrt_float32_256(a, result);
     basic_rsqrt_float32_256(a+8, result+8);
 }
-
+inline void basic_round_float32_128(float32 *a, float32 *result) {
+	result[0] = floorf(a[0] + 0.5f);
+	result[1] = floorf(a[1] + 0.5f);
+	result[2] = floorf(a[2] + 0.5f);
+	result[3] = floorf(a[3] + 0.5f);
+}
+inline void basic_round_float32_256(float32 *a, float32 *result) {
+	simd_round_float32_128(a, result);
+	simd_round_float32_128(a+4, result+4);
+}
@@ -0,0 +1,283 @@
+// This is a very niche sort algorithm.
+// I use it for Z sorting quads.
+// help_buffer should be same size as collection.
+// This only works with integers, and it will use the first number_of_bits in the integer
+// at sort_value_offset_in_item for sorting.
+// There is a cost of memory as we need to double the buffer we're sorting BUT the performance
+// gain is very promising.
+// At 21 bits I'm able to sort a completely randomized collection of 100k integers at around
+// 8m cycles (or 2.5-2.6ms on my shitty laptop i5-11300H)
+// For big items, radix_sort_by_s32 is much faster since it only moves each item once.
+void radix_sort(void *collection, void *help_buffer, u64 item_count, u64 item_size, u64 sort_value_offset_in_item, u64 number_of_bits) {
+    local_persist const int RADIX = 256;
+    local_persist const int BITS_PER_PASS = 8;
+    
+    const int PASS_COUNT = ((number_of_bits + BITS_PER_PASS - 1) / BITS_PER_PASS);
+    const u64 HALF_RANGE_OF_VALUE_BITS = 1ULL << (number_of_bits - 1);
+    // Only read the bytes we sort by, the value might not be 8 bytes (Draw_Quad.z is s32)
+    const u64 VALUE_BYTES = min(PASS_COUNT, sizeof(u64));
+
+    u64 count[RADIX];
+    u64 prefix_sum[RADIX];
+
+    for (u32 pass = 0; pass < PASS_COUNT; ++pass) {
+        u32 shift = pass * BITS_PER_PASS;
+
+        memset(count, 0, sizeof(count));
+
+        for (u64 i = 0; i < item_count; ++i) {
+        	u8 *item = (u8*)collection + i * item_size;
+        	
+            u64 sort_value = 0;
+            memcpy(&sort_value, item + sort_value_offset_in_item, VALUE_BYTES);
+            sort_value += HALF_RANGE_OF_VALUE_BITS; // We treat the value as a signed integer
+            
+            u32 digit = (sort_value >> shift) & (RADIX-1);
+            ++count[digit];
+        }
+
+        prefix_sum[0] = 0;
+        for (u32 i = 1; i < RADIX; ++i) {
+            prefix_sum[i] = prefix_sum[i - 1] + count[i - 1];
+        }
+
+        for (u64 i = 0; i < item_count; ++i) {
+        	u8 *item = (u8*)collection + i * item_size;
+        	
+            u64 sort_value = 0;
+            memcpy(&sort_value, item + sort_value_offset_in_item, VALUE_BYTES);
+            sort_value += HALF_RANGE_OF_VALUE_BITS; // We treat the value as a signed integer
+            
+            u32 digit = (sort_value >> shift) & (RADIX-1);
+            memcpy((u8*)help_buffer + prefix_sum[digit] * item_size, item, item_size);
+            ++prefix_sum[digit];
+        }
+
+        memcpy(collection, help_buffer, item_count * item_size);
+    }
+}
+
+void merge_sort(void *collection, void *help_buffer, u64 item_count, u64 item_size, int (*compare)(const void *, const void *)) {
+    u8 *items = (u8 *)collection;
+    u8 *buffer = (u8 *)help_buffer;
+
+    for (u64 width = 1; width < item_count; width *= 2) {
+        for (u64 i = 0; i < item_count; i += 2 * width) {
+            u64 left = i;
+            u64 right = (i + width < item_count) ? (i + width) : item_count;
+            u64 end = (i + 2 * width < item_count) ? (i + 2 * width) : item_count;
+
+            u64 left_index = left;
+            u64 right_index = right;
+            u64 k = left;
+
+            while (left_index < right && right_index < end) {
+                if (compare(items + left_index * item_size, items + right_index * item_size) <= 0) {
+                    memcpy(buffer + k * item_size, items + left_index * item_size, item_size);
+                    left_index++;
+                } else {
+                    memcpy(buffer + k * item_size, items + right_index * item_size, item_size);
+                    right_index++;
+                }
+                k++;
+            }
+
+            while (left_index < right) {
+                memcpy(buffer + k * item_size, items + left_index * item_size, item_size);
+                left_index++;
+                k++;
+            }
+
+            while (right_index < end) {
+                memcpy(buffer + k * item_size, items + right_index * item_size, item_size);
+                right_index++;
+                k++;
+            }
+
+            for (u64 j = left; j < end; j++) {
+                memcpy(items + j * item_size, buffer + j * item_size, item_size);
+            }
+        }
+    }
+}
+
+///
+// Key/index radix sort
+//
+// Sorting big structs directly means moving every struct on every radix pass. Instead we
+// sort 64 bit keys with the sort value in the high 32 bits and the item index in the low
+// 32 bits, and then move each item once, straight to its sorted place.
+// Histogram and scatter are split over threads with parallel_for for large counts, and
+// passes where all keys have the same digit are skipped, which is common with few z layers.
+
+#define RADIX_SORT_BITS_PER_PASS 8
+#define RADIX_SORT_RADIX (1 << RADIX_SORT_BITS_PER_PASS)
+// Below this many items per thread, threading costs more than it gains
+#define RADIX_SORT_MIN_ITEMS_PER_RANGE 32768
+#define RADIX_SORT_MAX_RANGES (PARALLEL_FOR_MAX_WORKERS+1)
+
+inline u64 make_sort_key(u32 value, u32 index) {
+	return ((u64)value << 32) | (u64)index;
+}
+inline u32 get_sort_key_index(u64 key) {
+	return (u32)key;
+}
+
+typedef struct Radix_Sort_Pass {
+	u64 *source;
+	u64 *destination;
+	u32 shift;
+	// Counts per range and digit, turned into write offsets before the scatter
+	u64 (*histograms)[RADIX_SORT_RADIX];
+} Radix_Sort_Pass;
+
+void radix_sort_histogram_range(u64 first, u64 end, u64 range_index, void *data) {
+	Radix_Sort_Pass *pass = (Radix_Sort_Pass*)data;
+	u64 *histogram = pass->histograms[range_index];
+	memset(histogram, 0, sizeof(u64)*RADIX_SORT_RADIX);
+	for (u64 i = first; i < end; i++) {
+		histogram[(pass->source[i] >> pass->shift) & (RADIX_SORT_RADIX-1)] += 1;
+	}
+}
+void radix_sort_scatter_range(u64 first, u64 end, u64 range_index, void *data) {
+	Radix_Sort_Pass *pass = (Radix_Sort_Pass*)data;
+	u64 *offsets = pass->histograms[range_index];
+	for (u64 i = first; i < end; i++) {
+		u64 key = pass->source[i];
+		u64 digit = (key >> pass->shift) & (RADIX_SORT_RADIX-1);
+		pass->destination[offsets[digit]] = key;
+		offsets[digit] += 1;
+	}
+}
+
+// Stable sort of keys made with make_sort_key() by the first number_of_bits of the value.
+// Returns the buffer which ended up with the result, which is either keys or help_buffer.
+// help_buffer needs room for count keys.
+u64 *radix_sort_keys(u64 *keys, u64 *help_buffer, u64 count, u64 number_of_bits) {
+	assert(number_of_bits > 0 && number_of_bits <= 32, "Sort keys have 32 bit values");
+	
+	u64 range_count = clamp(count/RADIX_SORT_MIN_ITEMS_PER_RANGE, 1, min(parallel_for_get_thread_count(), RADIX_SORT_MAX_RANGES));
+	u64 pass_count = (number_of_bits + RADIX_SORT_BITS_PER_PASS - 1) / RADIX_SORT_BITS_PER_PASS;
+	
+	u64 histograms[RADIX_SORT_MAX_RANGES][RADIX_SORT_RADIX];
+	
+	u64 *source = keys;
+	u64 *destination = help_buffer;
+	
+	for (u64 pass_index = 0; pass_index < pass_count; pass_index++) {
+		Radix_Sort_Pass pass;
+		pass.source = source;
+		pass.destination = destination;
+		pass.shift = 32 + pass_index*RADIX_SORT_BITS_PER_PASS;
+		pass.histograms = histograms;
+		
+		parallel_for(count, range_count, radix_sort_histogram_range, &pass);
+		
+		// Where each range writes each digit. Digits in order, and within a digit the
+		// ranges in order, so the sort stays stable.
+		u64 offset = 0;
+		bool all_same_digit = false;
+		for (u64 digit = 0; digit < RADIX_SORT_RADIX; digit++) {
+			u64 digit_count = 0;
+			for (u64 range = 0; range < range_count; range++) {
+				u64 range_digit_count = histograms[range][digit];
+				histograms[range][digit] = offset;
+				offset += range_digit_count;
+				digit_count += range_digit_count;
+			}
+			if (digit_count == count) all_same_digit = true;
+		}
+		
+		// Nothing would move
+		if (all_same_digit) continue;
+		
+		parallel_for(count, range_count, radix_sort_scatter_range, &pass);
+		
+		swap(source, destination, u64*);
+	}
+	
+	return source;
+}
+
+typedef struct Radix_Sort_Items {
+	u8 *items;
+	u8 *sorted_items;
+	u64 *keys;
+	u64 item_size;
+	u64 value_offset_in_item;
+	s64 value_bias;
+} Radix_Sort_Items;
+
+void radix_sort_make_keys_range(u64 first, u64 end, u64 range_index, void *data) {
+	Radix_Sort_Items *sort = (Radix_Sort_Items*)data;
+	for (u64 i = first; i < end; i++) {
+		s32 value;
+		memcpy(&value, sort->items + i*sort->item_size + sort->value_offset_in_item, sizeof(s32));
+		sort->keys[i] = make_sort_key((u32)((s64)value + sort->value_bias), (u32)i);
+	}
+}
+void radix_sort_move_items_range(u64 first, u64 end, u64 range_index, void *data) {
+	Radix_Sort_Items *sort = (Radix_Sort_Items*)data;
+	for (u64 i = first; i < end; i++) {
+		u64 index = get_sort_key_index(sort->keys[i]);
+		memcpy(sort->sorted_items + i*sort->item_size, sort->items + index*sort->item_size, sort->item_size);
+	}
+}
+
+void radix_sort_write_indices_range(u64 first, u64 end, u64 range_index, void *data) {
+	Radix_Sort_Items *sort = (Radix_Sort_Items*)data;
+	u32 *indices = (u32*)sort->sorted_items;
+	for (u64 i = first; i < end; i++) {
+		indices[i] = get_sort_key_index(sort->keys[i]);
+	}
+}
+
+// Stable sort of items by the s32 at value_offset_in_item, i.e. Draw_Quad.z.
+// Values must be in [-2^(number_of_bits-1), 2^(number_of_bits-1)].
+// Items are written sorted to sorted_items, items is left as is.
+// key_buffer needs room for item_count*2 u64's.
+void radix_sort_by_s32(void *items, void *sorted_items, u64 *key_buffer, u64 item_count, u64 item_size, u64 value_offset_in_item, u64 number_of_bits) {
+	assert(item_count <= UINT32_MAX, "Too many items for radix_sort_by_s32");
+	assert(number_of_bits > 0 && number_of_bits < 32, "Bad number of bits for radix_sort_by_s32");
+	
+	u64 range_count = clamp(item_count/RADIX_SORT_MIN_ITEMS_PER_RANGE, 1, parallel_for_get_thread_count());
+	
+	Radix_Sort_Items sort;
+	sort.items = (u8*)items;
+	sort.sorted_items = (u8*)sorted_items;
+	sort.keys = key_buffer;
+	sort.item_size = item_size;
+	sort.value_offset_in_item = value_offset_in_item;
+	sort.value_bias = 1LL << (number_of_bits-1);
+	
+	parallel_for(item_count, range_count, radix_sort_make_keys_range, &sort);
+	
+	// One extra bit since the biased max value is 2^number_of_bits
+	sort.keys = radix_sort_keys(key_buffer, key_buffer+item_count, item_count, number_of_bits+1);
+	
+	parallel_for(item_count, range_count, radix_sort_move_items_range, &sort);
+}
+
+// Same as radix_sort_by_s32 but for a plain stream of values, i.e. Draw_Quad_Streams.z.
+// Nothing is moved; indices receives the sorted order as indices into values.
+// key_buffer needs room for count*2 u64's.
+void radix_sort_indices_by_s32(const s32 *values, u32 *indices, u64 *key_buffer, u64 count, u64 number_of_bits) {
+	assert(count <= UINT32_MAX, "Too many values for radix_sort_indices_by_s32");
+	assert(number_of_bits > 0 && number_of_bits < 32, "Bad number of bits for radix_sort_indices_by_s32");
+	
+	u64 range_count = clamp(count/RADIX_SORT_MIN_ITEMS_PER_RANGE, 1, parallel_for_get_thread_count());
+	
+	Radix_Sort_Items sort;
+	sort.items = (u8*)values;
+	sort.sorted_items = (u8*)indices;
+	sort.keys = key_buffer;
+	sort.item_size = sizeof(s32);
+	sort.value_offset_in_item = 0;
+	sort.value_bias = 1LL << (number_of_bits-1);
+	
+	parallel_for(count, range_count, radix_sort_make_keys_range, &sort);
+	
+	sort.keys = radix_sort_keys(key_buffer, key_buffer+count, count, number_of_bits+1);
+	
+	parallel_for(count, range_count, radix_sort_write_indices_range, &sort);
+}
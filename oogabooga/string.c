@@ -154,12 +154,7 @@ string_builder_reserve(String_Builder *b, u64 required_capacity) {
 	if (b->buffer_capacity >= required_capacity) return;
 	
 	u64 new_capacity = max(b->buffer_capacity*2, (u64)(required_capacity*1.5));
-	u8 *new_buffer = alloc(b->allocator, new_capacity);
-	if (b->buffer) {
-		memcpy(new_buffer, b->buffer, b->count);
-		dealloc(b->allocator, b->buffer);
-	}
-	b->buffer = new_buffer;
+	b->buffer = (u8*)reallocate(b->allocator, b->buffer, b->buffer_capacity, new_capacity);
 	b->buffer_capacity = new_capacity;
 }
 void 
@@ -44,7 +44,12 @@ u64 format_string_to_buffer_vararg(char* buffer, u64 count, const char* fmt, ...
 typedef struct _8_Bytes {u8 _[8];} _8_Bytes;
 typedef struct _12_Bytes {u8 _[12];} _12_Bytes;
 typedef struct _16_Bytes {u8 _[16];} _16_Bytes;
-u64 format_string_to_buffer(char* buffer, u64 count, const char* fmt, va_list args) {
+u64 format_string_to_buffer(char* buffer, u64 count, const char* fmt, va_list args_in) {
+	// va_list is a pointer on windows and an array on linux, so without a copy the caller's
+	// args would be used up on linux. Callers expect to be able to format the same args twice.
+	va_list args;
+	va_copy(args, args_in);
+	
 	if (!buffer) count = UINT64_MAX;
     const char* p = fmt;
     char* bufp = buffer;
@@ -161,7 +166,10 @@ u64 format_string_to_buffer(char* buffer, u64 count, const char* fmt, va_list ar
                 }
                 format_specifier[specifier_len] = '\0';
 
-                int temp_len = vsnprintf(temp_buffer, sizeof(temp_buffer), format_specifier, args);
+                va_list args2;
+                va_copy(args2, args);
+                int temp_len = vsnprintf(temp_buffer, sizeof(temp_buffer), format_specifier, args2);
+                va_end(args2);
                 switch (format_specifier[specifier_len - 1]) {
                     case 'd': case 'i': va_arg(args, int); break;
                     case 'u': case 'x': case 'X': case 'o': va_arg(args, unsigned int); break;
@@ -174,6 +182,7 @@ u64 format_string_to_buffer(char* buffer, u64 count, const char* fmt, va_list ar
                 }
                 
                 if (temp_len < 0) {
+                    va_end(args);
                     return -1; // Error in formatting
                 }
 
@@ -192,6 +201,8 @@ u64 format_string_to_buffer(char* buffer, u64 count, const char* fmt, va_list ar
     }
     if (buffer)  *bufp = '\0';
     
+    va_end(args);
+    
     return bufp - buffer;
 }
 u64 format_string_to_buffer_va(char* buffer, u64 count, const char* fmt, ...) {
@@ -235,7 +246,7 @@ string sprint_va_list(Allocator allocator, const string fmt, va_list args) {
 
 
 string sprints(Allocator allocator, const string fmt, ...) {
-	va_list args = 0;
+	va_list args;
 	va_start(args, fmt);
 	string s = sprint_va_list(allocator, fmt, args);
 	va_end(args);
@@ -244,7 +255,7 @@ string sprints(Allocator allocator, const string fmt, ...) {
 
 // temp allocator
 string tprints(const string fmt, ...) {
-	va_list args = 0;
+	va_list args;
 	va_start(args, fmt);
 	string s = sprint_va_list(get_temporary_allocator(), fmt, args);
 	va_end(args);
@@ -347,9 +358,9 @@ typedef void(*Logger_Proc)(Log_Level level, string s);
 void string_builder_prints(String_Builder *b, string fmt, ...) {
 	assert(b->allocator.proc, "String_Builder is missing allocator");
 	
-	va_list args1 = 0;
+	va_list args1;
 	va_start(args1, fmt);
-	va_list args2 = 0;
+	va_list args2;
 	va_copy(args2, args1);
 	
 	u64 formatted_count = format_string_to_buffer(0, 0, temp_convert_to_null_terminated_string(fmt), args1);
@@ -366,9 +377,9 @@ void string_builder_prints(String_Builder *b, string fmt, ...) {
 void string_builder_printf(String_Builder *b, const char *fmt, ...) {
 	assert(b->allocator.proc, "String_Builder is missing allocator");
 	
-	va_list args1 = 0;
+	va_list args1;
 	va_start(args1, fmt);
-	va_list args2 = 0;
+	va_list args2;
 	va_copy(args2, args1);
 	
 	u64 formatted_count = format_string_to_buffer(0, 0, fmt, args1);
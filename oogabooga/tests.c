@@ -197,6 +197,361 @@ void test_allocator(bool do_log_heap) {
     if (do_log_heap) log_heap();
 }
 
+typedef void*(*Test_Heap_Alloc_Proc)(u64);
+typedef void (*Test_Heap_Dealloc_Proc)(void*);
+void test_heap_workload(Test_Heap_Alloc_Proc alloc_proc, Test_Heap_Dealloc_Proc dealloc_proc, void **pointers, u64 *sizes, u64 count, u64 *order) {
+	for (u64 i = 0; i < count; i++) {
+		pointers[i] = alloc_proc(sizes[i]);
+		memset(pointers[i], (u8)i, sizes[i]);
+	}
+	
+	// Free every other in random order and allocate them again, like a game would during a frame
+	for (u64 i = 0; i < count; i += 2) {
+		u64 index = order[i];
+		dealloc_proc(pointers[index]);
+		pointers[index] = alloc_proc(sizes[index]);
+		memset(pointers[index], (u8)index, sizes[index]);
+	}
+	
+	for (u64 i = 0; i < count; i++) {
+		u64 index = order[i];
+		u8 *p = (u8*)pointers[index];
+		assert(p[0] == (u8)index && p[sizes[index]-1] == (u8)index, "Heap memory was corrupted");
+		dealloc_proc(p);
+	}
+}
+void test_heap_speed() {
+	const u64 num_samples = 20;
+	const u64 count = 10000;
+	
+	void **pointers = alloc(get_heap_allocator(), count*sizeof(void*));
+	u64 *sizes = alloc(get_heap_allocator(), count*sizeof(u64));
+	u64 *order = alloc(get_heap_allocator(), count*sizeof(u64));
+	
+	for (u64 i = 0; i < count; i++) {
+		sizes[i] = get_random_int_in_range(8, 1024);
+		order[i] = i;
+	}
+	for (u64 i = count-1; i > 0; i--) {
+		u64 j = get_random_int_in_range(0, i);
+		swap(order[i], order[j], u64);
+	}
+	
+	// Warm up, so both sides have their memory reserved up front
+	test_heap_workload(heap_alloc, heap_dealloc, pointers, sizes, count, order);
+	test_heap_workload(heap_free_list_alloc, heap_free_list_dealloc, pointers, sizes, count, order);
+	
+	f64 seconds = 0;
+	u64 cycles = 0;
+	for (u64 a = 0; a < num_samples; a++) {
+		float64 start_seconds = os_get_elapsed_seconds();
+		u64 start_cycles = rdtsc();
+		test_heap_workload(heap_alloc, heap_dealloc, pointers, sizes, count, order);
+		cycles += rdtsc() - start_cycles;
+		seconds += os_get_elapsed_seconds() - start_seconds;
+	}
+	print("Size class heap took on average %llu cycles and %.2f ms\n", cycles / num_samples, (seconds * 1000.0) / (float64)num_samples);
+	
+	seconds = 0;
+	cycles = 0;
+	for (u64 a = 0; a < num_samples; a++) {
+		float64 start_seconds = os_get_elapsed_seconds();
+		u64 start_cycles = rdtsc();
+		test_heap_workload(heap_free_list_alloc, heap_free_list_dealloc, pointers, sizes, count, order);
+		cycles += rdtsc() - start_cycles;
+		seconds += os_get_elapsed_seconds() - start_seconds;
+	}
+	print("Best fit free list heap took on average %llu cycles and %.2f ms\n", cycles / num_samples, (seconds * 1000.0) / (float64)num_samples);
+	
+	dealloc(get_heap_allocator(), pointers);
+	dealloc(get_heap_allocator(), sizes);
+	dealloc(get_heap_allocator(), order);
+}
+
+void test_heap_realloc() {
+	Allocator heap = get_heap_allocator();
+	
+	// Small allocation that still fits in its slot
+	u8 *a = (u8*)alloc(heap, 40);
+	memset(a, 7, 40);
+	u8 *a2 = (u8*)reallocate(heap, a, 40, 44);
+	assert(a2 == a, "Small realloc that fits in slot should not move");
+	for (u64 i = 0; i < 40; i++) assert(a2[i] == 7, "Realloc lost data");
+	
+	// Small to large has to move
+	u8 *a3 = (u8*)reallocate(heap, a2, 44, KB(32));
+	assert(a3 != a2, "Small to large realloc should move");
+	for (u64 i = 0; i < 40; i++) assert(a3[i] == 7, "Realloc lost data");
+	dealloc(heap, a3);
+	
+	// Grow into the free space after
+	u8 *big = (u8*)alloc(heap, KB(64));
+	u8 *after = (u8*)alloc(heap, KB(64));
+	for (u64 i = 0; i < KB(64); i++) big[i] = (u8)i;
+	
+	Heap_Allocation_Metadata *meta = (Heap_Allocation_Metadata*)(big-sizeof(Heap_Allocation_Metadata));
+	bool is_adjacent = after-sizeof(Heap_Allocation_Metadata) == (u8*)meta + meta->size;
+	dealloc(heap, after);
+	
+	u8 *grown = (u8*)reallocate(heap, big, KB(64), KB(96));
+	if (is_adjacent) assert(grown == big, "Realloc should have grown in place");
+	for (u64 i = 0; i < KB(64); i++) assert(grown[i] == (u8)i, "Realloc lost data");
+#if DO_ZERO_INITIALIZATION
+	for (u64 i = KB(64); i < KB(96); i++) assert(grown[i] == 0, "Realloc did not zero initialize new memory");
+#endif
+	
+	// Shrink in place
+	u8 *shrunk = (u8*)reallocate(heap, grown, KB(96), KB(32));
+	assert(shrunk == grown, "Shrinking realloc should not move");
+	for (u64 i = 0; i < KB(32); i++) assert(shrunk[i] == (u8)i, "Realloc lost data");
+	dealloc(heap, shrunk);
+	
+	// Third party code reallocating with an allocator that can't do it in place
+	third_party_allocator = get_temporary_allocator();
+	u8 *tp = (u8*)third_party_malloc(64);
+	for (u64 i = 0; i < 64; i++) tp[i] = (u8)i;
+	third_party_malloc(16); // tp is no longer last in the arena
+	u8 *tp_grown = (u8*)third_party_realloc(tp, 64, 256);
+	assert(tp_grown && tp_grown != tp, "Third party realloc did not fall back to copying");
+	for (u64 i = 0; i < 64; i++) assert(tp_grown[i] == (u8)i, "Third party realloc lost data");
+	third_party_allocator = ZERO(Allocator);
+	
+	// Grow a buffer like a growing array with 150k quads would, with realloc vs alloc+copy+dealloc
+	const u64 item_size = 128;
+	const u64 item_count = 150000;
+	
+	float64 start_seconds = os_get_elapsed_seconds();
+	u64 capacity = 8;
+	u8 *buffer = (u8*)alloc(heap, capacity*item_size);
+	u64 moves = 0;
+	while (capacity < item_count) {
+		u8 *new_buffer = (u8*)reallocate(heap, buffer, capacity*item_size, capacity*2*item_size);
+		if (new_buffer != buffer) moves += 1;
+		buffer = new_buffer;
+		capacity *= 2;
+	}
+	dealloc(heap, buffer);
+	float64 realloc_seconds = os_get_elapsed_seconds()-start_seconds;
+	
+	start_seconds = os_get_elapsed_seconds();
+	capacity = 8;
+	buffer = (u8*)alloc(heap, capacity*item_size);
+	while (capacity < item_count) {
+		u8 *new_buffer = (u8*)alloc(heap, capacity*2*item_size);
+		memcpy(new_buffer, buffer, capacity*item_size);
+		dealloc(heap, buffer);
+		buffer = new_buffer;
+		capacity *= 2;
+	}
+	dealloc(heap, buffer);
+	float64 copy_seconds = os_get_elapsed_seconds()-start_seconds;
+	
+	print("Growing to %llu items with realloc took %.2f ms (%llu moves), with alloc+copy %.2f ms\n", item_count, realloc_seconds*1000.0, moves, copy_seconds*1000.0);
+}
+
+void test_arena() {
+	Arena arena = make_arena(KB(64));
+	
+	// Alignment
+	u8 *a = (u8*)arena_push(&arena, 3);
+	u8 *b = (u8*)arena_push_aligned(&arena, 64, 64);
+	assert((u64)b % 64 == 0, "Arena push is not aligned");
+	assert(b > a, "Arena goof");
+	memset(b, 0xAB, 64);
+	
+	// Grow past the first chunk
+	Arena_Chunk *first_chunk = arena.chunk;
+	u8 *big = (u8*)arena_push(&arena, KB(200));
+	memset(big, 1, KB(200));
+	assert(arena.chunk != first_chunk, "Arena should have grown into a new chunk");
+	assert(arena.chunk->previous == first_chunk, "Arena chunks are not chained");
+	for (u64 i = 0; i < 64; i++) assert(b[i] == 0xAB, "Arena memory was corrupted when growing");
+	
+	// Markers
+	Arena_Marker marker = arena_save(&arena);
+	u8 *scratch = (u8*)arena_push(&arena, KB(512));
+	memset(scratch, 2, KB(512));
+	arena_restore(&arena, marker);
+	assert(arena.next == marker.next, "Arena restore goof");
+	u8 *after_restore = (u8*)arena_push(&arena, 16);
+	
+	u64 used = arena_get_used_bytes(&arena);
+	arena_scratch_scope(&arena) {
+		arena_push(&arena, KB(300));
+		arena_scratch_scope(&arena) {
+			arena_push(&arena, KB(300));
+		}
+	}
+	assert(arena_get_used_bytes(&arena) == used, "Arena scratch scope did not restore");
+	arena_restore(&arena, marker);
+	(void)after_restore;
+	
+	// Realloc last allocation in place
+	Allocator allocator = make_arena_allocator_from_arena(&arena);
+	u8 *last = (u8*)alloc(allocator, 100);
+	memset(last, 3, 100);
+	u8 *grown = (u8*)reallocate(allocator, last, 100, 1000);
+	assert(grown == last, "Arena realloc of last allocation should be in place");
+	u8 *other = (u8*)alloc(allocator, 8);
+	u8 *moved = (u8*)reallocate(allocator, grown, 1000, 2000);
+	assert(moved != grown, "Arena realloc of allocation that is not the last cannot be in place");
+	for (u64 i = 0; i < 100; i++) assert(moved[i] == 3, "Arena realloc lost data");
+	(void)other;
+	
+	// Growing array on an arena keeps growing in place as long as it's the last allocation
+	u64 *numbers = 0;
+	growing_array_init((void**)&numbers, sizeof(u64), allocator);
+	for (u64 i = 0; i < 10000; i++) growing_array_add((void**)&numbers, &i);
+	for (u64 i = 0; i < 10000; i++) assert(numbers[i] == i, "Growing array on arena is corrupt");
+	
+	// After a reset, the same amount of memory should fit in one chunk and not touch the heap
+	u64 high_water_mark = arena.high_water_mark;
+	arena_reset(&arena);
+	assert(arena.chunk->previous == 0, "Arena reset should leave one chunk");
+	assert(arena.size >= high_water_mark, "Arena reset should make room for the high water mark");
+	
+	Heap_Stats before = heap_get_stats();
+	arena_push(&arena, high_water_mark);
+	Heap_Stats after = heap_get_stats();
+	assert(after.global_lock_acquisitions == before.global_lock_acquisitions, "Arena should not need the heap after reset");
+	
+	// Fixed memory arena
+	u8 memory[256];
+	Arena fixed = make_arena_with_memory(256, memory);
+	u8 *f = (u8*)arena_push(&fixed, 200);
+	assert(f == memory, "Fixed arena goof");
+	
+	destroy_arena(&arena);
+}
+
+void test_temporary_storage() {
+	reset_temporary_storage();
+	Temporary_Storage_Stats stats = get_temporary_storage_stats();
+	u64 capacity = stats.capacity;
+	u64 grow_count = stats.grow_count;
+	
+	string first = tprint("Temporary string %i", 1337);
+	
+	// Overflowing should grow, not wrap around and stomp on earlier allocations
+	u64 big_size = capacity + KB(100);
+	u8 *big = (u8*)talloc(big_size);
+	memset(big, 0xCD, big_size);
+	assert(strings_match(first, STR("Temporary string 1337")), "Temporary storage overflow corrupted earlier allocation");
+	assert(get_temporary_storage_stats().grow_count == grow_count+1, "Temporary storage did not grow");
+	
+	// Nested scopes
+	u64 used = get_temporary_storage_stats().used;
+	temporary_storage_scope() {
+		talloc(KB(300));
+		temporary_storage_scope() {
+			talloc(KB(300));
+			tprint("%s", first);
+		}
+	}
+	assert(get_temporary_storage_stats().used == used, "Temporary storage scope did not restore");
+	
+	Arena_Marker marker = temporary_storage_save();
+	talloc(1024);
+	temporary_storage_restore(marker);
+	assert(get_temporary_storage_stats().used == used, "Temporary storage restore goof");
+	
+	u64 peak = get_temporary_storage_stats().peak;
+	assert(peak >= big_size + KB(600), "Temporary storage peak is wrong");
+	
+	// The next frame should fit the peak without growing
+	reset_temporary_storage();
+	stats = get_temporary_storage_stats();
+	assert(stats.last_frame_peak == peak, "Temporary storage last frame peak is wrong");
+	assert(stats.highest_peak >= peak, "Temporary storage highest peak is wrong");
+	assert(stats.used == 0 && stats.peak == 0, "Temporary storage reset goof");
+	assert(stats.capacity >= peak, "Temporary storage did not grow to fit the peak");
+	talloc(peak);
+	assert(get_temporary_storage_stats().grow_count == stats.grow_count, "Temporary storage should fit last peak after reset");
+	
+	// Shrink back down when usage goes down for a while
+	for (u64 i = 0; i < TEMPORARY_STORAGE_SHRINK_DELAY*2; i++) {
+		reset_temporary_storage();
+		talloc(1024);
+	}
+	reset_temporary_storage();
+	assert(get_temporary_storage_stats().capacity < peak, "Temporary storage did not shrink");
+}
+
+typedef struct Test_Heap_Thread_Data {
+	u64 iterations;
+	u64 count;
+	// Allocated by the thread, deallocated by the main thread
+	void **handoff;
+} Test_Heap_Thread_Data;
+void test_heap_thread_proc(Thread *t) {
+	Test_Heap_Thread_Data *data = (Test_Heap_Thread_Data*)t->data;
+	
+	void **pointers = (void**)alloc(get_heap_allocator(), data->count*sizeof(void*));
+	for (u64 i = 0; i < data->iterations; i++) {
+		for (u64 j = 0; j < data->count; j++) {
+			u64 size = 8 + (j*37)%512;
+			pointers[j] = alloc(get_heap_allocator(), size);
+			*(u64*)pointers[j] = j;
+		}
+		for (u64 j = 0; j < data->count; j++) {
+			assert(*(u64*)pointers[j] == j, "Heap memory was corrupted");
+			dealloc(get_heap_allocator(), pointers[j]);
+		}
+	}
+	dealloc(get_heap_allocator(), pointers);
+	
+	for (u64 j = 0; j < data->count; j++) {
+		data->handoff[j] = alloc(get_heap_allocator(), 8 + (j*37)%512);
+		*(u64*)data->handoff[j] = j;
+	}
+}
+void test_heap_threaded() {
+	const u64 thread_count = clamp(os_get_number_of_logical_processors(), 2, 8);
+	const u64 iterations = 100;
+	const u64 count = 1000;
+	
+	Thread *threads = (Thread*)alloc(get_heap_allocator(), thread_count*sizeof(Thread));
+	Test_Heap_Thread_Data *datas = (Test_Heap_Thread_Data*)alloc(get_heap_allocator(), thread_count*sizeof(Test_Heap_Thread_Data));
+	
+	Heap_Stats before = heap_get_stats();
+	float64 start_seconds = os_get_elapsed_seconds();
+	
+	for (u64 i = 0; i < thread_count; i++) {
+		datas[i].iterations = iterations;
+		datas[i].count = count;
+		datas[i].handoff = (void**)alloc(get_heap_allocator(), count*sizeof(void*));
+		os_thread_init(&threads[i], test_heap_thread_proc);
+		threads[i].data = &datas[i];
+		os_thread_start(&threads[i]);
+	}
+	for (u64 i = 0; i < thread_count; i++) {
+		os_thread_join(&threads[i]);
+		os_thread_destroy(&threads[i]);
+	}
+	
+	// Cross-thread deallocation
+	for (u64 i = 0; i < thread_count; i++) {
+		for (u64 j = 0; j < count; j++) {
+			assert(*(u64*)datas[i].handoff[j] == j, "Heap memory was corrupted");
+			dealloc(get_heap_allocator(), datas[i].handoff[j]);
+		}
+		dealloc(get_heap_allocator(), datas[i].handoff);
+	}
+	
+	float64 end_seconds = os_get_elapsed_seconds();
+	Heap_Stats after = heap_get_stats();
+	
+	u64 allocation_count = thread_count*(iterations+1)*count;
+	u64 global_locks = after.global_lock_acquisitions-before.global_lock_acquisitions;
+	u64 class_locks = after.size_class_lock_acquisitions-before.size_class_lock_acquisitions;
+	print("%llu allocations on %llu threads took %.2f ms. Heap lock was taken %llu times and size class locks %llu times\n", allocation_count, thread_count, (end_seconds-start_seconds)*1000.0, global_locks, class_locks);
+	
+	assert(class_locks < allocation_count/8, "Thread caches don't seem to do their job");
+	
+	dealloc(get_heap_allocator(), threads);
+	dealloc(get_heap_allocator(), datas);
+}
+
 void test_thread_proc1(Thread* t) {
 	os_sleep(5);
 	print("Hello from thread %llu\n", t->id);
@@ -487,7 +842,7 @@ void test_file_io() {
     assert(file != OS_INVALID_FILE, "Failed: os_file_open (read)");
     string hello_world_read = talloc_string(hello_world_write.count);
     bool read_result = os_file_read(file, hello_world_read.data, hello_world_read.count, &hello_world_read.count);
-    assert(read_result, "Failed: os_file_read %d", GetLastError());
+    assert(read_result, "Failed: os_file_read");
     assert(strings_match(hello_world_read, hello_world_write), "Failed: os_file_read write/read mismatch");
     os_file_close(file);
 
@@ -1307,6 +1662,68 @@ void test_intmath() {
     assert(v4i_result.x == 1 && v4i_result.y == 2 && v4i_result.z == 3 && v4i_result.w == 4, "v4i_divi incorrect");
 }
 
+typedef struct Test_Sort_Item {
+	u8 padding[3];
+	s32 value; // Deliberately not 8 byte aligned
+	u64 original_index;
+	Vector4 stuff[4];
+} Test_Sort_Item;
+void test_parallel_for_range(u64 first, u64 end, u64 range_index, void *data) {
+	u64 *numbers = (u64*)data;
+	for (u64 i = first; i < end; i++) numbers[i] += i;
+}
+void test_radix_sort_keys() {
+	const u64 count = 300000; // Enough to be split over threads
+	const u64 bits = 21;
+	
+	u64 *numbers = (u64*)alloc(get_heap_allocator(), count*sizeof(u64));
+	memset(numbers, 0, count*sizeof(u64));
+	parallel_for(count, parallel_for_get_thread_count()*4, test_parallel_for_range, numbers);
+	for (u64 i = 0; i < count; i++) assert(numbers[i] == i, "parallel_for missed or repeated a range");
+	dealloc(get_heap_allocator(), numbers);
+	
+	Test_Sort_Item *items = (Test_Sort_Item*)alloc(get_heap_allocator(), count*sizeof(Test_Sort_Item)*2);
+	Test_Sort_Item *sorted = items + count;
+	u64 *keys = (u64*)alloc(get_heap_allocator(), count*2*sizeof(u64));
+	
+	const s32 half_range = 1 << (bits-1);
+	
+	// Full range, lots of equal values to check that it's stable, and only one value
+	// so passes are skipped
+	const s32 value_ranges[] = { half_range, 100, 0 };
+	for (u64 r = 0; r < sizeof(value_ranges)/sizeof(value_ranges[0]); r++) {
+		for (u64 i = 0; i < count; i++) {
+			items[i].value = (s32)get_random_int_in_range(-value_ranges[r], value_ranges[r]);
+			if (value_ranges[r] == half_range) {
+				if (i == 0) items[i].value = -half_range;
+				if (i == 1) items[i].value = half_range;
+			}
+			items[i].original_index = i;
+		}
+		
+		radix_sort_by_s32(items, sorted, keys, count, sizeof(Test_Sort_Item), offsetof(Test_Sort_Item, value), bits);
+		
+		for (u64 i = 1; i < count; i++) {
+			assert(sorted[i].value >= sorted[i-1].value, "Failed: not correctly sorted");
+			if (sorted[i].value == sorted[i-1].value) {
+				assert(sorted[i].original_index > sorted[i-1].original_index, "Failed: sort is not stable");
+			}
+		}
+		for (u64 i = 0; i < count; i++) {
+			assert(items[sorted[i].original_index].value == sorted[i].value, "Failed: sorted item was corrupted");
+		}
+	}
+	
+	// Old radix sort reading z from an odd offset
+	radix_sort(items, sorted, count, sizeof(Test_Sort_Item), offsetof(Test_Sort_Item, value), bits);
+	for (u64 i = 1; i < count; i++) {
+		assert(items[i].value >= items[i-1].value, "Failed: not correctly sorted");
+	}
+	
+	dealloc(get_heap_allocator(), items);
+	dealloc(get_heap_allocator(), keys);
+}
+
 void test_hash_table() {
     Hash_Table table = make_hash_table(string, int, get_heap_allocator());
     
@@ -1338,10 +1755,188 @@ void test_hash_table() {
     found_value = hash_table_find(&table, key1);
     assert(found_value == NULL, "Failed: Hash table should be empty after reset");
 
+    // Keys are compared, not just hashes. Same contents in a different buffer is the same key,
+    // and the table keeps its own copy of the string.
+    string key3 = sprint(get_heap_allocator(), "%s", key1);
+    int value3 = 3;
+    newly_added = hash_table_set(&table, key3, value3);
+    assert(newly_added == true, "Failed: Key should be newly added after reset");
+    memset(key3.data, 'x', key3.count);
+    found_value = hash_table_find(&table, key1);
+    assert(found_value != NULL && *found_value == 3, "Failed: String key should be copied into the table");
+    dealloc_string(get_heap_allocator(), key3);
+    
+    bool removed = hash_table_remove(&table, key1);
+    assert(removed == true, "Failed: Key should have been removed");
+    assert(!hash_table_contains(&table, key1), "Failed: Removed key should not exist");
+    removed = hash_table_remove(&table, key1);
+    assert(removed == false, "Failed: Key was already removed");
+
     hash_table_destroy(&table);
     assert(table.entries == NULL, "Failed: Hash table entries should be NULL after destroy");
     assert(table.count == 0, "Failed: Hash table count should be 0 after destroy");
     assert(table.capacity_count == 0, "Failed: Hash table capacity count should be 0 after destroy");
+    
+    // Throughput
+    const u64 count = 200000;
+    Hash_Table numbers = make_hash_table(u64, u64, get_heap_allocator());
+    
+    float64 start_seconds = os_get_elapsed_seconds();
+    u64 start_cycles = rdtsc();
+    for (u64 i = 0; i < count; i++) {
+        u64 key = i*7919;
+        u64 value = i;
+        hash_table_add(&numbers, key, value);
+    }
+    u64 insert_cycles = rdtsc()-start_cycles;
+    float64 insert_seconds = os_get_elapsed_seconds()-start_seconds;
+    
+    start_seconds = os_get_elapsed_seconds();
+    start_cycles = rdtsc();
+    u64 found_sum = 0;
+    u64 miss_count = 0;
+    for (u64 i = 0; i < count; i++) {
+        u64 key = i*7919;
+        u64 *value = (u64*)hash_table_find(&numbers, key);
+        if (value) found_sum += *value;
+        key += 1;
+        if (!hash_table_contains(&numbers, key)) miss_count += 1;
+    }
+    u64 find_cycles = rdtsc()-start_cycles;
+    float64 find_seconds = os_get_elapsed_seconds()-start_seconds;
+    assert(found_sum == (count*(count-1))/2, "Failed: Hash table lookup returned wrong values");
+    assert(miss_count == count, "Failed: Hash table found key that was never added");
+    
+    start_seconds = os_get_elapsed_seconds();
+    start_cycles = rdtsc();
+    for (u64 i = 0; i < count; i += 2) {
+        u64 key = i*7919;
+        hash_table_remove(&numbers, key);
+    }
+    u64 remove_cycles = rdtsc()-start_cycles;
+    float64 remove_seconds = os_get_elapsed_seconds()-start_seconds;
+    
+    assert(numbers.count == count/2, "Failed: Hash table count is wrong after removing");
+    for (u64 i = 0; i < count; i++) {
+        u64 key = i*7919;
+        u64 *value = (u64*)hash_table_find(&numbers, key);
+        if (i % 2 == 0) {
+            assert(!value, "Failed: Removed key still exists");
+        } else {
+            assert(value && *value == i, "Failed: Hash table lookup after remove returned wrong value");
+        }
+    }
+    u64 sum = 0;
+    for (u64 i = 0; i < numbers.count; i++) sum += *(u64*)hash_table_get_nth_value(&numbers, i);
+    assert(sum == (count/2)*(count/2), "Failed: Hash table iteration goof");
+    
+    // Reinsert after removing, this reuses tombstones
+    for (u64 i = 0; i < count; i += 2) {
+        u64 key = i*7919;
+        u64 value = i;
+        hash_table_set(&numbers, key, value);
+    }
+    assert(numbers.count == count, "Failed: Hash table count is wrong after reinserting");
+    
+    hash_table_destroy(&numbers);
+    
+    print("\n    %llu inserts took %.2f ms (%llu cycles/op)", count, insert_seconds*1000.0, insert_cycles/count);
+    print("\n    %llu hits + %llu misses took %.2f ms (%llu cycles/op)", count, miss_count, find_seconds*1000.0, find_cycles/(count*2));
+    print("\n    %llu removes took %.2f ms (%llu cycles/op)\n", count/2, remove_seconds*1000.0, remove_cycles/(count/2));
+}
+
+void test_hash_speed() {
+	const u64 buffer_size = MB(1);
+	u8 *buffer = (u8*)alloc(get_heap_allocator(), buffer_size);
+	for (u64 i = 0; i < buffer_size; i++) buffer[i] = (u8)get_random_int_in_range(0, 255);
+	
+	// All stripe loops must give the same hash
+	for (u64 count = HASH_LONG_SIZE+1; count < 2000; count += 7) {
+		u64 expected = hash_bytes_long(buffer, count, 0, hash_accumulate_scalar);
+#if COMPILER_CAN_DO_SSE2
+		assert(hash_bytes_long(buffer, count, 0, hash_accumulate_sse2) == expected, "SSE2 hash does not match scalar hash");
+#endif
+#if COMPILER_CAN_TARGET_AVX2
+		if (query_cpu_capabilities().avx2) {
+			assert(hash_bytes_long(buffer, count, 0, hash_accumulate_avx2) == expected, "AVX2 hash does not match scalar hash");
+		}
+#endif
+		assert(hash_bytes(buffer, count, 0) == expected, "Hash does not match");
+	}
+	
+	// Hash depends on every byte, the length and the seed, but not on where the bytes are
+	for (u64 count = 1; count < 600; count += 1) {
+		u64 h = hash_bytes(buffer, count, 0);
+		assert(h == hash_bytes(buffer+buffer_size/2, count, 0) || memcmp(buffer, buffer+buffer_size/2, count) != 0, "Hash goof");
+		assert(h != hash_bytes(buffer, count-1, 0), "Hash does not depend on length");
+		assert(h != hash_bytes(buffer, count, 1), "Hash does not depend on seed");
+		
+		u64 i = get_random_int_in_range(0, count-1);
+		buffer[i] ^= 1;
+		assert(h != hash_bytes(buffer, count, 0), "Hash does not depend on every byte");
+		buffer[i] ^= 1;
+	}
+	string a = STR("Same string");
+	string b = sprint(get_heap_allocator(), "%s", a);
+	assert(string_get_hash(a) == string_get_hash(b), "Equal strings hash differently");
+	dealloc_string(get_heap_allocator(), b);
+	
+	// No collisions in a bunch of similar keys, and the batch api gives the same hashes
+	const u64 key_count = 100000;
+	string *keys = (string*)alloc(get_heap_allocator(), key_count*sizeof(string));
+	u64 *hashes = (u64*)alloc(get_heap_allocator(), key_count*sizeof(u64));
+	for (u64 i = 0; i < key_count; i++) keys[i] = sprint(get_heap_allocator(), "key_%llu", i);
+	
+	hash_strings(keys, key_count, hashes);
+	
+	Hash_Table seen = make_hash_table_reserve(u64, u64, key_count, get_heap_allocator());
+	for (u64 i = 0; i < key_count; i++) {
+		assert(hashes[i] == string_get_hash(keys[i]), "Batch hash does not match");
+		assert(!hash_table_contains(&seen, hashes[i]), "Hash collision");
+		hash_table_add(&seen, hashes[i], i);
+	}
+	hash_table_destroy(&seen);
+	for (u64 i = 0; i < key_count; i++) dealloc_string(get_heap_allocator(), keys[i]);
+	dealloc(get_heap_allocator(), keys);
+	dealloc(get_heap_allocator(), hashes);
+	
+	// Throughput by key length
+	const u64 lengths[] = {4, 8, 16, 32, 64, 256, 1024, 16384};
+	const u64 bytes_per_length = MB(32);
+	
+	print("\n");
+	for (u64 l = 0; l < sizeof(lengths)/sizeof(lengths[0]); l++) {
+		u64 length = lengths[l];
+		u64 hash_count = bytes_per_length/length;
+		u64 sum = 0;
+		
+		float64 start_seconds = os_get_elapsed_seconds();
+		u64 start_cycles = rdtsc();
+		for (u64 i = 0; i < hash_count; i++) {
+			sum += hash_bytes(buffer + (i*length) % (buffer_size-length), length, 0);
+		}
+		u64 cycles = rdtsc()-start_cycles;
+		float64 seconds = os_get_elapsed_seconds()-start_seconds;
+		
+		float64 djb2_start_seconds = os_get_elapsed_seconds();
+		for (u64 i = 0; i < hash_count; i++) {
+			string s = (string){length, buffer + (i*length) % (buffer_size-length)};
+			sum += djb2_hash(s);
+		}
+		float64 djb2_seconds = os_get_elapsed_seconds()-djb2_start_seconds;
+		
+		// So the hashing isn't optimized away
+		volatile u64 sink = sum;
+		(void)sink;
+		
+		print("    %llu byte keys: %.2f GB/s (%llu cycles/hash), djb2 %.2f GB/s\n", 
+			length, 
+			(float64)bytes_per_length/seconds/(1024.0*1024.0*1024.0), 
+			cycles/hash_count, 
+			(float64)bytes_per_length/djb2_seconds/(1024.0*1024.0*1024.0));
+	}
+	
+	dealloc(get_heap_allocator(), buffer);
 }
 
 #define NUM_BINS 100
@@ -1353,6 +1948,7 @@ void test_random_distribution() {
     for (int i = 0; i < NUM_SAMPLES; i++) {
         f32 rand_val = get_random_float32();
         int bin = (int)(rand_val * NUM_BINS);
+        bin = min(bin, NUM_BINS-1); // rand_val can round up to 1.0
         bins[bin]++;
     }
 
@@ -1429,75 +2025,2275 @@ void test_mutex() {
     mutex_destroy(&data.mutex);
 }
 
+void test_gfx_pack() {
+	Allocator heap = get_heap_allocator();
+	
+	const u64 count = 100000; // Enough to be split over threads
+	const u64 image_count = 40; // More than GFX_PACK_MAX_TEXTURES, so we get several batches
+	
+	Gfx_Pack_Image images[40];
+	for (u64 i = 0; i < image_count; i++) {
+		images[i].width = 64;
+		images[i].height = 32;
+		images[i].channels = 4;
+		images[i].gfx_handle = (void*)(0x1000 + i*0x10);
+	}
+	
+	Vector2 *positions = alloc(heap, count*4*sizeof(Vector2));
+	Vector4 *colors = alloc(heap, count*sizeof(Vector4));
+	Vector4 *uvs = alloc(heap, count*sizeof(Vector4));
+	Gfx_Pack_Image **quad_images = alloc(heap, count*sizeof(Gfx_Pack_Image*));
+	u32 *flags = alloc(heap, count*sizeof(u32));
+	s32 *z = alloc(heap, count*sizeof(s32));
+	Vector4 *scissors = alloc(heap, count*sizeof(Vector4));
+	Vector4 *userdata = alloc(heap, count*VERTEX_USER_DATA_COUNT*sizeof(Vector4));
+	
+	for (u64 i = 0; i < count; i++) {
+		for (u64 j = 0; j < 4; j++) {
+			positions[i*4+j] = v2(get_random_float32_in_range(-1, 1), get_random_float32_in_range(-1, 1));
+		}
+		colors[i] = v4(get_random_float32(), get_random_float32(), get_random_float32(), 1);
+		z[i] = (s32)get_random_int_in_range(-1000, 1000);
+		
+		u32 f = (u32)get_random_int_in_range(0, 2) << DRAW_QUAD_FLAG_TYPE_SHIFT;
+		
+		// Mostly runs of the same image like real frames, sometimes no image
+		if (i % 10 == 0) {
+			quad_images[i] = 0;
+		} else {
+			quad_images[i] = &images[(i/7) % image_count];
+			uvs[i] = v4(0, 0, get_random_float32(), get_random_float32());
+			f |= (u32)get_random_int_in_range(0, 3) & DRAW_QUAD_FLAG_FILTER_MASK;
+		}
+		if (i % 8 == 0) {
+			scissors[i] = v4(10, 20, 300, 400);
+			f |= DRAW_QUAD_FLAG_HAS_SCISSOR;
+		}
+		if (i % 4 == 0) {
+			for (u64 j = 0; j < VERTEX_USER_DATA_COUNT; j++) {
+				userdata[i*VERTEX_USER_DATA_COUNT+j] = v4(i, j, 1, 2);
+			}
+			f |= DRAW_QUAD_FLAG_HAS_USERDATA;
+		}
+		flags[i] = f;
+	}
+	
+	Gfx_Pack_Input input = ZERO(Gfx_Pack_Input);
+	input.quad_count = count;
+	input.positions = positions;
+	input.colors = colors;
+	input.uvs = uvs;
+	input.images = quad_images;
+	input.flags = flags;
+	input.z = z;
+	input.scissors = scissors;
+	input.userdata = userdata;
+	input.enable_z_sorting = true;
+	input.window_width = 1280;
+	input.window_height = 720;
+	input.window_pixel_height = 720;
+	
+	// Zeroed so padding doesn't get in the way of memcmp
+	Gfx_Quad_Vertex *vertices = alloc(heap, count*4*sizeof(Gfx_Quad_Vertex));
+	Gfx_Quad_Vertex *single_range_vertices = alloc(heap, count*4*sizeof(Gfx_Quad_Vertex));
+	memset(vertices, 0, count*4*sizeof(Gfx_Quad_Vertex));
+	memset(single_range_vertices, 0, count*4*sizeof(Gfx_Quad_Vertex));
+	
+	assert(sizeof(Gfx_Quad_Instance) == 64, "Gfx_Quad_Instance should be 64 bytes, it's %llu", (u64)sizeof(Gfx_Quad_Instance));
+	Gfx_Quad_Instance *instances = alloc(heap, count*sizeof(Gfx_Quad_Instance));
+	Gfx_Quad_Instance *single_range_instances = alloc(heap, count*sizeof(Gfx_Quad_Instance));
+	Gfx_Quad_Extra *extras = alloc(heap, count*sizeof(Gfx_Quad_Extra));
+	Gfx_Quad_Extra *single_range_extras = alloc(heap, count*sizeof(Gfx_Quad_Extra));
+	
+	Gfx_Pack pack = ZERO(Gfx_Pack);
+	
+	for (u64 sorting = 0; sorting < 2; sorting++) {
+		input.enable_z_sorting = sorting == 1;
+		
+		gfx_pack_quads(&pack, &input, vertices);
+		
+		assert(pack.quad_count == count, "Failed: wrong quad count");
+		assert(pack.batch_count >= 2, "Failed: %d textures should not fit in one batch", image_count);
+		
+		u64 next_quad = 0;
+		for (u64 b = 0; b < pack.batch_count; b++) {
+			Gfx_Pack_Batch *batch = &pack.batches[b];
+			assert(batch->first_quad == next_quad, "Failed: batches are not contiguous");
+			assert(batch->quad_count > 0, "Failed: empty batch");
+			assert(batch->texture_count <= GFX_PACK_MAX_TEXTURES, "Failed: too many textures in batch");
+			for (u64 t = 0; t < batch->texture_count; t++) {
+				for (u64 k = t+1; k < batch->texture_count; k++) {
+					assert(batch->textures[t] != batch->textures[k], "Failed: texture bound twice in a batch");
+				}
+			}
+			
+			for (u64 i = batch->first_quad; i < batch->first_quad+batch->quad_count; i++) {
+				u64 n = sorting ? pack.order[i] : i;
+				Gfx_Quad_Vertex *v = &vertices[i*4];
+				
+				if (sorting && i > 0) {
+					assert(z[n] >= z[pack.order[i-1]], "Failed: quads are not sorted by z");
+				}
+				
+				if (quad_images[n]) {
+					assert(v->texture_index >= 0 && v->texture_index < batch->texture_count, "Failed: bad texture index %d", v->texture_index);
+					assert(batch->textures[v->texture_index] == quad_images[n]->gfx_handle, "Failed: texture index points to the wrong texture");
+					assert(v->sampler == gfx_pack_get_sampler_index(flags[n]), "Failed: wrong sampler");
+					assert(v[2].uv.x == uvs[n].x2 && v[2].uv.y == uvs[n].y2, "Failed: wrong uv");
+				} else {
+					assert(v->texture_index == -1, "Failed: quad without image has a texture index");
+				}
+				
+				for (u64 j = 0; j < 4; j++) {
+					assert(v[j].texture_index == v->texture_index, "Failed: texture index differs between vertices");
+					assert(v[j].position.x == positions[n*4+j].x && v[j].position.y == positions[n*4+j].y, "Failed: wrong position");
+					assert(v[j].position.z == 0 && v[j].position.w == 1, "Failed: wrong position zw");
+					assert(memcmp(&v[j].color, &colors[n], sizeof(Vector4)) == 0, "Failed: wrong color");
+					assert(v[j].type == (u8)(flags[n] >> DRAW_QUAD_FLAG_TYPE_SHIFT), "Failed: wrong type");
+				}
+				
+				if (flags[n] & DRAW_QUAD_FLAG_HAS_SCISSOR) {
+					assert(v->has_scissor, "Failed: scissor lost");
+					assert(v->scissor.y1 == 720-400 && v->scissor.y2 == 720-20, "Failed: scissor y was not flipped");
+				} else {
+					assert(!v->has_scissor, "Failed: quad got a scissor");
+				}
+				if (flags[n] & DRAW_QUAD_FLAG_HAS_USERDATA) {
+					assert(v[3].userdata[0].x == (float32)n, "Failed: wrong userdata");
+				} else {
+					assert(v[3].userdata[0].x == 0 && v[3].userdata[0].w == 0, "Failed: userdata was not cleared");
+				}
+			}
+			
+			next_quad += batch->quad_count;
+		}
+		assert(next_quad == count, "Failed: batches don't cover all quads");
+		
+		// Threading must not change the result
+		Gfx_Pack_Job job = ZERO(Gfx_Pack_Job);
+		job.input = &input;
+		job.order = sorting ? pack.order : 0;
+		job.texture_indices = pack.texture_indices;
+		job.vertices = single_range_vertices;
+		parallel_for(count, 1, gfx_pack_write_vertices_range, &job);
+		assert(memcmp(vertices, single_range_vertices, count*4*sizeof(Gfx_Quad_Vertex)) == 0, "Failed: threaded packing differs from single threaded packing");
+		
+		// Instances must expand to the same vertices
+		u64 expected_extra_count = 0;
+		for (u64 i = 0; i < count; i++) {
+			if (flags[i] & (DRAW_QUAD_FLAG_HAS_SCISSOR | DRAW_QUAD_FLAG_HAS_USERDATA)) expected_extra_count += 1;
+		}
+		assert(pack.extra_count == expected_extra_count, "Failed: wrong extra count");
+		
+		memset(instances, 0, count*sizeof(Gfx_Quad_Instance));
+		gfx_pack_write_instances(&pack, &input, instances, extras);
+		
+		for (u64 i = 0; i < count; i++) {
+			Gfx_Quad_Instance *instance = &instances[i];
+			Gfx_Quad_Vertex *v = &vertices[i*4];
+			u32 instance_flags = instance->flags;
+			
+			for (u64 j = 0; j < 4; j++) {
+				assert(instance->corners[j].x == v[j].position.x && instance->corners[j].y == v[j].position.y, "Failed: instance corner differs");
+			}
+			assert((s8)(instance_flags & GFX_QUAD_INSTANCE_TEXTURE_INDEX_MASK) == v->texture_index, "Failed: instance texture index differs");
+			assert(((instance_flags >> GFX_QUAD_INSTANCE_TYPE_SHIFT) & 0xff) == v->type, "Failed: instance type differs");
+			if (v->texture_index >= 0) {
+				assert(((instance_flags >> GFX_QUAD_INSTANCE_SAMPLER_SHIFT) & 0xff) == v->sampler, "Failed: instance sampler differs");
+				// uv rect corners are the bottom left and top right uvs
+				assert(instance->uv.x1 == v[0].uv.x && instance->uv.y1 == v[0].uv.y, "Failed: instance uv differs");
+				assert(instance->uv.x2 == v[2].uv.x && instance->uv.y2 == v[2].uv.y, "Failed: instance uv differs");
+			}
+			
+			float32 *c = (float32*)&v->color;
+			for (u64 j = 0; j < 4; j++) {
+				float32 unpacked = (float32)((instance->color >> (j*8)) & 0xff)/255.0f;
+				assert(fabs(unpacked - c[j]) <= 0.5f/255.0f + 0.00001f, "Failed: packed color is off by more than rounding");
+			}
+			
+			assert(((instance_flags & GFX_QUAD_INSTANCE_HAS_SCISSOR) != 0) == (v->has_scissor != 0), "Failed: instance scissor flag differs");
+			bool has_userdata = (instance_flags & GFX_QUAD_INSTANCE_HAS_USERDATA) != 0;
+			if (v->has_scissor || has_userdata) {
+				assert(instance->extra_index < pack.extra_count, "Failed: extra index out of range");
+				Gfx_Quad_Extra *extra = &extras[instance->extra_index];
+				if (v->has_scissor) assert(memcmp(&extra->scissor, &v->scissor, sizeof(Vector4)) == 0, "Failed: extra scissor differs");
+				if (has_userdata) assert(memcmp(extra->userdata, v->userdata, sizeof(extra->userdata)) == 0, "Failed: extra userdata differs");
+			} else {
+				assert(v->userdata[0].x == 0, "Failed: quad has userdata but no extra");
+			}
+		}
+		
+		memset(single_range_instances, 0, count*sizeof(Gfx_Quad_Instance));
+		job.vertices = 0;
+		job.extra_indices = pack.extra_indices;
+		job.instances = single_range_instances;
+		job.extras = single_range_extras;
+		parallel_for(count, 1, gfx_pack_write_instances_range, &job);
+		assert(memcmp(instances, single_range_instances, count*sizeof(Gfx_Quad_Instance)) == 0, "Failed: threaded instances differ from single threaded instances");
+		assert(memcmp(extras, single_range_extras, pack.extra_count*sizeof(Gfx_Quad_Extra)) == 0, "Failed: threaded extras differ from single threaded extras");
+	}
+	
+	// Odd window sizes nudge uvs
+	input.window_width = 1281;
+	gfx_pack_quads(&pack, &input, vertices);
+	for (u64 i = 0; i < count; i++) {
+		u64 n = pack.order[i];
+		if (!quad_images[n]) continue;
+		assert(vertices[i*4].uv.x > uvs[n].x1, "Failed: uv was not nudged for odd window width");
+		break;
+	}
+	input.window_width = 1280;
+	
+	// Empty input
+	input.quad_count = 0;
+	gfx_pack_quads(&pack, &input, vertices);
+	assert(pack.batch_count == 0 && pack.quad_count == 0, "Failed: empty input should give no batches");
+	input.quad_count = count;
+	
+	print("\n");
+	const u64 iterations = 20;
+	for (u64 sorting = 0; sorting < 2; sorting++) {
+		input.enable_z_sorting = sorting == 1;
+		
+		float64 start_seconds = os_get_elapsed_seconds();
+		for (u64 i = 0; i < iterations; i++) gfx_pack_quads(&pack, &input, vertices);
+		float64 vertex_seconds = (os_get_elapsed_seconds()-start_seconds)/iterations;
+		
+		start_seconds = os_get_elapsed_seconds();
+		for (u64 i = 0; i < iterations; i++) {
+			gfx_pack_begin(&pack, &input);
+			gfx_pack_write_instances(&pack, &input, instances, extras);
+		}
+		float64 instance_seconds = (os_get_elapsed_seconds()-start_seconds)/iterations;
+		
+		print("    %llu quads%s, %llu batches, %llu threads: vertices %.3f ms, instances %.3f ms\n",
+			count,
+			sorting ? " z sorted" : "",
+			pack.batch_count,
+			parallel_for_get_thread_count(),
+			vertex_seconds*1000.0,
+			instance_seconds*1000.0);
+	}
+	
+	u64 vertex_bytes = count*4*sizeof(Gfx_Quad_Vertex);
+	u64 instance_bytes = count*sizeof(Gfx_Quad_Instance) + pack.extra_count*sizeof(Gfx_Quad_Extra);
+	print("    Upload: vertices %llu bytes per quad (%.2f MB), instances %llu bytes per quad + %llu per extra (%.2f MB, %llu extras)\n",
+		(u64)sizeof(Gfx_Quad_Vertex)*4,
+		(float64)vertex_bytes/(1024.0*1024.0),
+		(u64)sizeof(Gfx_Quad_Instance),
+		(u64)sizeof(Gfx_Quad_Extra),
+		(float64)instance_bytes/(1024.0*1024.0),
+		pack.extra_count);
+	
+	gfx_pack_deinit(&pack);
+	
+	dealloc(heap, positions);
+	dealloc(heap, colors);
+	dealloc(heap, uvs);
+	dealloc(heap, quad_images);
+	dealloc(heap, flags);
+	dealloc(heap, z);
+	dealloc(heap, scissors);
+	dealloc(heap, userdata);
+	dealloc(heap, vertices);
+	dealloc(heap, single_range_vertices);
+	dealloc(heap, instances);
+	dealloc(heap, single_range_instances);
+	dealloc(heap, extras);
+	dealloc(heap, single_range_extras);
+}
+
+Tile test_tilemap_pattern(u32 x, u32 y) {
+	if ((x*y) % 7 == 3) return 0;
+	return (x + y) % 2 ? 1 : 2;
+}
+void test_tilemap() {
+	Allocator heap = get_heap_allocator();
+	
+	const u32 size = 1000;
+	const float32 tile_size = 8.0;
+	Tilemap *map = make_tilemap(size, size, tile_size, heap);
+	map->origin = v2(-(float32)(size/2)*tile_size, -(float32)(size/2)*tile_size);
+	assert(map->chunks_x == 32 && map->chunks_y == 32, "Failed: wrong chunk count");
+	
+	tilemap_set_tile_type(map, 1, 0, v4(0, 0, 1, 1), v4(0.2, 0.2, 0.2, 0.2));
+	tilemap_set_tile_type(map, 2, 0, v4(0, 0, 1, 1), v4(0.5, 0.5, 0.5, 1.0));
+	
+	float64 start = os_get_elapsed_seconds();
+	for (u32 y = 0; y < size; y++) {
+		for (u32 x = 0; x < size; x++) tilemap_set_tile(map, x, y, test_tilemap_pattern(x, y));
+	}
+	float64 fill_seconds = os_get_elapsed_seconds() - start;
+	
+	assert(tilemap_get_tile(map, 999, 998) == test_tilemap_pattern(999, 998), "Failed: wrong tile");
+	u32 tx, ty;
+	assert(tilemap_world_to_tile(map, v2(0.5, -0.5), &tx, &ty) && tx == 500 && ty == 499, "Failed: wrong tile for world position");
+	assert(!tilemap_world_to_tile(map, v2(-4001, 0), &tx, &ty), "Failed: position outside of the map gave a tile");
+	Vector2 corner = tilemap_tile_to_world(map, 500, 499);
+	assert(corner.x == 0 && corner.y == -tile_size, "Failed: wrong world position for tile");
+	
+	// The view of the alchemist camera, 1280x720 zoomed in 6 times
+	Vector2 half_view = v2(1280.0/12.0, 720.0/12.0);
+	Vector2 center = v2(100, 50);
+	Vector2 view_min = v2_sub(center, half_view);
+	Vector2 view_max = v2_add(center, half_view);
+	u64 chunk_count = tilemap_update_visible_chunks(map, view_min, view_max);
+	
+	// Exactly the rows of the chunks that overlap the view
+	u32 x0, y0, x1, y1;
+	tilemap_world_to_tile(map, view_min, &x0, &y0);
+	tilemap_world_to_tile(map, view_max, &x1, &y1);
+	u64 expected_chunk_count = 0;
+	u64 built_chunk_count = 0;
+	for (u32 cy = y0/TILEMAP_CHUNK_SIZE; cy <= y1/TILEMAP_CHUNK_SIZE; cy++) {
+		for (u32 cx = x0/TILEMAP_CHUNK_SIZE; cx <= x1/TILEMAP_CHUNK_SIZE; cx++) {
+			u32 index = cy*map->chunks_x + cx;
+			built_chunk_count += 1;
+			
+			u32 first_row = max(y0, cy*TILEMAP_CHUNK_SIZE);
+			u32 last_row = min(y1, cy*TILEMAP_CHUNK_SIZE + TILEMAP_CHUNK_SIZE-1);
+			u32 tile_count = 0;
+			for (u32 y = first_row; y <= last_row; y++) {
+				for (u32 x = cx*TILEMAP_CHUNK_SIZE; x < (cx+1)*TILEMAP_CHUNK_SIZE; x++) {
+					if (test_tilemap_pattern(x, y)) tile_count += 1;
+				}
+			}
+			if (!tile_count) continue;
+			
+			Tilemap_Visible_Chunk *visible = &map->visible_chunks[expected_chunk_count];
+			Tilemap_Chunk *chunk = &map->chunks[index];
+			assert(visible->chunk_index == index, "Failed: chunk %d should be visible", index);
+			assert(visible->end_quad - visible->first_quad == tile_count, "Failed: chunk %d has %d quads in view, expected %d", index, visible->end_quad - visible->first_quad, tile_count);
+			assert(chunk->positions[visible->first_quad*4].y == tilemap_tile_to_world(map, 0, first_row).y, "Failed: first quad in view is in the wrong row");
+			expected_chunk_count += 1;
+		}
+	}
+	assert(chunk_count == expected_chunk_count, "Failed: %llu chunks visible, expected %llu", chunk_count, expected_chunk_count);
+	assert(map->chunk_build_count == built_chunk_count, "Failed: built chunks that aren't visible");
+	
+	// Only the chunk of a changed tile is built again
+	tilemap_set_tile(map, 512, 512, test_tilemap_pattern(512, 512));
+	tilemap_update_visible_chunks(map, view_min, view_max);
+	assert(map->chunk_build_count == built_chunk_count, "Failed: setting a tile to what it was rebuilt its chunk");
+	
+	u32 x, y;
+	tilemap_world_to_tile(map, center, &x, &y);
+	Tilemap_Chunk *changed_chunk = tilemap_get_chunk(map, x, y);
+	u32 quad_count = changed_chunk->quad_count;
+	tilemap_set_tile(map, x, y, tilemap_get_tile(map, x, y) ? 0 : 1);
+	tilemap_update_visible_chunks(map, view_min, view_max);
+	assert(map->chunk_build_count == built_chunk_count+1, "Failed: changing a tile should rebuild exactly its chunk");
+	assert(changed_chunk->quad_count != quad_count, "Failed: changed tile is not in the rebuilt chunk");
+	
+	// Pan across the whole map, like walking through the world
+	const int frames = 1000;
+	u64 chunk_quads = 0;
+	start = os_get_elapsed_seconds();
+	for (int i = 0; i < frames; i++) {
+		float32 t = (float32)i/(float32)frames;
+		Vector2 c = v2(-3900 + t*7800, -3900 + t*7800);
+		u64 n = tilemap_update_visible_chunks(map, v2_sub(c, half_view), v2_add(c, half_view));
+		for (u64 j = 0; j < n; j++) chunk_quads += map->visible_chunks[j].end_quad - map->visible_chunks[j].first_quad;
+	}
+	float64 pan_seconds = os_get_elapsed_seconds() - start;
+	
+	// What immediate mode has to do instead; look at every tile in the view each frame
+	u64 immediate_quads = 0;
+	start = os_get_elapsed_seconds();
+	for (int i = 0; i < frames; i++) {
+		float32 t = (float32)i/(float32)frames;
+		Vector2 c = v2(-3900 + t*7800, -3900 + t*7800);
+		tilemap_world_to_tile(map, v2_sub(c, half_view), &x0, &y0);
+		tilemap_world_to_tile(map, v2_add(c, half_view), &x1, &y1);
+		for (u32 ty = y0; ty <= y1; ty++) {
+			for (u32 tx = x0; tx <= x1; tx++) {
+				if (tilemap_get_tile(map, tx, ty)) immediate_quads += 1;
+			}
+		}
+	}
+	float64 immediate_seconds = os_get_elapsed_seconds() - start;
+	
+	// Zoomed all the way out, the first time builds every chunk that wasn't seen yet
+	start = os_get_elapsed_seconds();
+	u64 all_chunks = tilemap_update_visible_chunks(map, v2(-1e6, -1e6), v2(1e6, 1e6));
+	float64 build_all_seconds = os_get_elapsed_seconds() - start;
+	assert(all_chunks == map->chunks_x*map->chunks_y, "Failed: whole map view didn't see every chunk");
+	u64 builds = map->chunk_build_count;
+	start = os_get_elapsed_seconds();
+	tilemap_update_visible_chunks(map, v2(-1e6, -1e6), v2(1e6, 1e6));
+	float64 cull_all_seconds = os_get_elapsed_seconds() - start;
+	assert(map->chunk_build_count == builds, "Failed: clean chunks were built again");
+	
+	print("\n    %dx%d tiles: fill %.2f ms, build all %llu chunks %.2f ms, cull clean map %.4f ms\n", size, size, fill_seconds*1000.0, all_chunks, build_all_seconds*1000.0, cull_all_seconds*1000.0);
+	print("    Panning the alchemist view: %.4f ms per frame (%llu quads in visible chunk rows), reading every tile in view %.4f ms per frame (%llu tiles)\n", (pan_seconds*1000.0)/frames, chunk_quads/frames, (immediate_seconds*1000.0)/frames, immediate_quads/frames);
+	
+	destroy_tilemap(map);
+}
+
+typedef struct Test_Target_Pool_Backend {
+	u64 next_handle;
+	u64 live_count;
+} Test_Target_Pool_Backend;
+struct Gfx_Image *test_target_pool_create(u32 width, u32 height, u32 channels, void *userdata) {
+	Test_Target_Pool_Backend *backend = (Test_Target_Pool_Backend*)userdata;
+	backend->next_handle += 1;
+	backend->live_count += 1;
+	// Never dereferenced by the pool
+	return (struct Gfx_Image*)backend->next_handle;
+}
+void test_target_pool_destroy(struct Gfx_Image *target, void *userdata) {
+	Test_Target_Pool_Backend *backend = (Test_Target_Pool_Backend*)userdata;
+	assert(target && (u64)target <= backend->next_handle, "Failed: destroyed a target the pool didn't create");
+	backend->live_count -= 1;
+}
+
+void test_render_target_pool() {
+	Test_Target_Pool_Backend backend = ZERO(Test_Target_Pool_Backend);
+	Render_Target_Pool *pool = make_render_target_pool_with_procs(2, test_target_pool_create, test_target_pool_destroy, &backend, get_heap_allocator());
+	
+	const u64 full = render_target_pool_get_target_bytes(1280, 720, 4);
+	const u64 half = render_target_pool_get_target_bytes(640, 360, 4);
+	
+	// A bloom-ish chain; scene, bright pass & two blur targets at half size
+	struct Gfx_Image *scene = render_target_pool_get(pool, 1280, 720, 4);
+	struct Gfx_Image *bright = render_target_pool_get(pool, 1280, 720, 4);
+	struct Gfx_Image *blur_a = render_target_pool_get(pool, 640, 360, 4);
+	struct Gfx_Image *blur_b = render_target_pool_get(pool, 640, 360, 4);
+	assert(scene != bright && blur_a != blur_b, "Failed: handed out the same target twice in a frame");
+	assert(backend.live_count == 4 && pool->create_count == 4, "Failed: expected 4 targets, got %llu", backend.live_count);
+	assert(render_target_pool_get_live_bytes(pool) == full*2 + half*2, "Failed: wrong live bytes");
+	assert(pool->in_use_count == 4 && pool->in_use_bytes == full*2 + half*2, "Failed: wrong in use stats");
+	
+	// Released early, the next request for that size in the same frame gets it back
+	render_target_pool_release(pool, bright);
+	assert(render_target_pool_get(pool, 1280, 720, 4) == bright, "Failed: released target was not reused");
+	// Different channels is a different key
+	struct Gfx_Image *mask = render_target_pool_get(pool, 1280, 720, 1);
+	assert(mask != scene && mask != bright && backend.live_count == 5, "Failed: 1 channel target should be new");
+	render_target_pool_end_frame(pool);
+	assert(pool->in_use_count == 0 && pool->in_use_bytes == 0, "Failed: targets still in use after end of frame");
+	
+	// Same chain next frame, nothing new is created
+	for (int frame = 0; frame < 10; frame++) {
+		struct Gfx_Image *a = render_target_pool_get(pool, 1280, 720, 4);
+		struct Gfx_Image *b = render_target_pool_get(pool, 1280, 720, 4);
+		struct Gfx_Image *c = render_target_pool_get(pool, 640, 360, 4);
+		struct Gfx_Image *d = render_target_pool_get(pool, 640, 360, 4);
+		assert((a == scene || a == bright) && (b == scene || b == bright) && a != b, "Failed: full size targets were not recycled");
+		assert((c == blur_a || c == blur_b) && (d == blur_a || d == blur_b) && c != d, "Failed: half size targets were not recycled");
+		render_target_pool_end_frame(pool);
+	}
+	assert(pool->create_count == 5, "Failed: recycling created new targets");
+	// The mask wasn't used for more than 2 frames
+	assert(backend.live_count == 4 && pool->destroy_count == 1, "Failed: unused target was not deleted");
+	assert(render_target_pool_get_live_bytes(pool) == full*2 + half*2, "Failed: wrong live bytes after deleting unused target");
+	
+	// Resize; the old sizes hang around for max_unused_frames, then they're gone
+	const u64 resized = render_target_pool_get_target_bytes(1920, 1080, 4);
+	for (int frame = 0; frame < 3; frame++) {
+		render_target_pool_get(pool, 1920, 1080, 4);
+		render_target_pool_get(pool, 1920, 1080, 4);
+		render_target_pool_get(pool, 960, 540, 4);
+		render_target_pool_get(pool, 960, 540, 4);
+		render_target_pool_end_frame(pool);
+		if (frame < 1) assert(backend.live_count == 8, "Failed: old targets deleted too early");
+	}
+	assert(backend.live_count == 4 && pool->create_count == 9, "Failed: expected only the resized targets, got %llu", backend.live_count);
+	assert(render_target_pool_get_live_bytes(pool) == resized*2 + render_target_pool_get_target_bytes(960, 540, 4)*2, "Failed: wrong live bytes after resize");
+	
+	render_target_pool_get(pool, 1920, 1080, 4);
+	render_target_pool_trim(pool);
+	assert(backend.live_count == 1, "Failed: trim deleted a target in use");
+	
+	destroy_render_target_pool(pool);
+	assert(backend.live_count == 0, "Failed: targets leaked after destroying the pool");
+}
+
+void test_shader_cache() {
+	Allocator heap = get_heap_allocator();
+	string dir = STR("test_shader_cache");
+	
+	Shader_Cache cache;
+	bool ok = shader_cache_init(&cache, dir, STR("test compiler 1"), heap);
+	assert(ok && os_is_directory(dir), "Failed: shader cache directory was not made");
+	
+	string source = STR("float4 ps_main(PS_INPUT input) : SV_TARGET { return input.color; }");
+	u64 key = shader_cache_make_key(&cache, source, STR("ps_main ps_5_0"));
+	assert(key == shader_cache_make_key(&cache, source, STR("ps_main ps_5_0")), "Failed: key is not stable");
+	assert(key != shader_cache_make_key(&cache, source, STR("ps_main ps_4_0")), "Failed: key does not depend on defines");
+	assert(key != shader_cache_make_key(&cache, STR("float4 ps_main(PS_INPUT input) : SV_TARGET { return 1; }"), STR("ps_main ps_5_0")), "Failed: key does not depend on source");
+	
+	// Another compiler never sees our blobs
+	Shader_Cache other;
+	shader_cache_init(&other, dir, STR("test compiler 2"), heap);
+	assert(key != shader_cache_make_key(&other, source, STR("ps_main ps_5_0")), "Failed: key does not depend on compiler id");
+	shader_cache_deinit(&other);
+	
+	// Something shaped like bytecode, bigger than HASH_LONG_SIZE
+	const u64 blob_size = KB(16);
+	string blob = alloc_string(heap, blob_size);
+	for (u64 i = 0; i < blob_size; i++) blob.data[i] = (u8)(i*31 + (i >> 8));
+	
+	shader_cache_invalidate(&cache, key);
+	string bytecode;
+	assert(!shader_cache_lookup(&cache, key, &bytecode, heap), "Failed: hit before anything was stored");
+	assert(cache.miss_count == 1 && cache.invalid_count == 0, "Failed: missing file should be a plain miss");
+	
+	assert(shader_cache_store(&cache, key, blob), "Failed: could not store blob");
+	assert(shader_cache_lookup(&cache, key, &bytecode, heap), "Failed: stored blob was not found");
+	assert(strings_match(bytecode, blob), "Failed: cached blob does not match the stored one");
+	assert(cache.hit_count == 1, "Failed: hit was not counted");
+	dealloc_string(heap, bytecode);
+	
+	string path = shader_cache_get_path(&cache, key, get_temporary_allocator());
+	string file;
+	ok = os_read_entire_file(path, &file, heap);
+	assert(ok && file.count == sizeof(Shader_Cache_File_Header) + blob_size, "Failed: wrong cache file size");
+	
+	// Truncated file, like when the program died while writing it
+	os_write_entire_file(path, string_view(file, 0, file.count - 100));
+	assert(!shader_cache_lookup(&cache, key, &bytecode, heap), "Failed: truncated file was a hit");
+	assert(cache.invalid_count == 1 && !os_is_file(path), "Failed: truncated file was not deleted");
+	
+	// Same size but one byte of the blob flipped
+	file.data[sizeof(Shader_Cache_File_Header) + 1234] ^= 0xFF;
+	os_write_entire_file(path, file);
+	assert(!shader_cache_lookup(&cache, key, &bytecode, heap), "Failed: corrupted blob was a hit");
+	assert(cache.invalid_count == 2 && !os_is_file(path), "Failed: corrupted file was not deleted");
+	file.data[sizeof(Shader_Cache_File_Header) + 1234] ^= 0xFF;
+	
+	// Older cache version
+	((Shader_Cache_File_Header*)file.data)->version = SHADER_CACHE_VERSION-1;
+	os_write_entire_file(path, file);
+	assert(!shader_cache_lookup(&cache, key, &bytecode, heap), "Failed: file of an old cache version was a hit");
+	assert(cache.invalid_count == 3, "Failed: old version should be invalid");
+	((Shader_Cache_File_Header*)file.data)->version = SHADER_CACHE_VERSION;
+	dealloc_string(heap, file);
+	
+	// A hit is reading one file, compare this to how long the compiler takes
+	shader_cache_store(&cache, key, blob);
+	const int lookups = 100;
+	float64 start = os_get_elapsed_seconds();
+	for (int i = 0; i < lookups; i++) {
+		ok = shader_cache_lookup(&cache, key, &bytecode, heap);
+		assert(ok, "Failed: lookup missed");
+		dealloc_string(heap, bytecode);
+	}
+	float64 lookup_seconds = (os_get_elapsed_seconds() - start)/lookups;
+	print("\n    Shader cache hit for a %llu KB blob: %.4f ms\n", blob_size/1024, lookup_seconds*1000.0);
+	
+	shader_cache_invalidate(&cache, key);
+	assert(!os_is_file(path), "Failed: invalidate did not delete the file");
+	
+	// Disabled cache
+	Shader_Cache disabled;
+	assert(!shader_cache_init(&disabled, STR(""), STR("test compiler 1"), heap), "Failed: empty directory should disable the cache");
+	assert(!shader_cache_store(&disabled, key, blob), "Failed: disabled cache stored a blob");
+	assert(!shader_cache_lookup(&disabled, key, &bytecode, heap), "Failed: disabled cache had a hit");
+	
+	dealloc_string(heap, blob);
+	shader_cache_deinit(&cache);
+	os_delete_directory(dir, false);
+}
+
 #ifndef OOGABOOGA_HEADLESS
 int compare_draw_quads(const void *a, const void *b) {
     return ((Draw_Quad*)a)->z-((Draw_Quad*)b)->z;
 }
+void test_sort_fill_quads(Draw_Quad *items, u64 item_count, u64 id_bits) {
+    for (u64 i = 0; i < item_count; i++) {
+        if (i % 2 == 0) items[i].z = get_random_int_in_range(0, pow(2, id_bits) / 2);
+        else items[i].z = i % (1 << (id_bits-1));
+    }
+}
 void test_sort() {
     
-    int num_samples = 500;
     u64 id_bits = 21;
-    u64 item_count = 50000;
+    const u64 item_counts[] = {10000, 100000, 1000000};
     
-    f64 seconds = 0;
-    u64 cycles = 0;
-    
-    Draw_Quad *items = alloc(get_heap_allocator(), (item_count * 2) * sizeof(Draw_Quad));
-    Draw_Quad *buffer = items + item_count;
-
-    for (int a = 0; a < num_samples; a++) {
+    for (u64 c = 0; c < sizeof(item_counts)/sizeof(item_counts[0]); c++) {
+        u64 item_count = item_counts[c];
+        int num_samples = (int)max(3, 2000000/item_count);
+        
+        f64 seconds = 0;
+        u64 cycles = 0;
+        
+        Draw_Quad *items = alloc(get_heap_allocator(), (item_count * 2) * sizeof(Draw_Quad));
+        Draw_Quad *buffer = items + item_count;
+        u64 *keys = alloc(get_heap_allocator(), item_count * 2 * sizeof(u64));
         
-        for (u64 i = 0; i < item_count; i++) {
-            if (i % 2 == 0) items[i].z = get_random_int_in_range(0, pow(2, id_bits) / 2);
-            else items[i].z = i;
-        }
-    
         u64 item_size = sizeof(Draw_Quad);
         u64 sort_value_offset_in_item = offsetof(Draw_Quad, z);
+        
+        print("\n    %llu quads:\n", item_count);
     
-        float64 start_seconds = os_get_elapsed_seconds();
-        u64 start_cycles = rdtsc();
-        radix_sort(items, buffer, item_count, item_size, sort_value_offset_in_item, id_bits);
-        u64 end_cycles = rdtsc();
-        float64 end_seconds = os_get_elapsed_seconds();
+        for (int a = 0; a < num_samples; a++) {
+            test_sort_fill_quads(items, item_count, id_bits);
+        
+            float64 start_seconds = os_get_elapsed_seconds();
+            u64 start_cycles = rdtsc();
+            radix_sort(items, buffer, item_count, item_size, sort_value_offset_in_item, id_bits);
+            u64 end_cycles = rdtsc();
+            float64 end_seconds = os_get_elapsed_seconds();
+        
+            for (u64 i = 1; i < item_count; i++) {
+                assert(items[i].z >= items[i-1].z, "Failed: not correctly sorted");
+            }
+            
+            seconds += end_seconds - start_seconds;
+            cycles += end_cycles - start_cycles;
+        }
+        
+        print("    Radix sort took on average %llu cycles and %.2f ms\n", cycles / num_samples, (seconds * 1000.0) / (float64)num_samples);
+        
+        seconds = 0;
+        cycles = 0;
+        for (int a = 0; a < num_samples; a++) {
+            test_sort_fill_quads(items, item_count, id_bits);
+        
+            float64 start_seconds = os_get_elapsed_seconds();
+            u64 start_cycles = rdtsc();
+            radix_sort_by_s32(items, buffer, keys, item_count, item_size, sort_value_offset_in_item, id_bits);
+            u64 end_cycles = rdtsc();
+            float64 end_seconds = os_get_elapsed_seconds();
+        
+            for (u64 i = 1; i < item_count; i++) {
+                assert(buffer[i].z >= buffer[i-1].z, "Failed: not correctly sorted");
+            }
+            
+            seconds += end_seconds - start_seconds;
+            cycles += end_cycles - start_cycles;
+        }
+        
+        print("    Key/index radix sort took on average %llu cycles and %.2f ms\n", cycles / num_samples, (seconds * 1000.0) / (float64)num_samples);
     
-        for (u64 i = 1; i < item_count; i++) {
-            assert(items[i].z >= items[i-1].z, "Failed: not correctly sorted");
+        // Too slow for a million
+        if (item_count <= 100000) {
+            seconds = 0;
+            cycles = 0;
+            for (int a = 0; a < num_samples; a++) {
+                test_sort_fill_quads(items, item_count, id_bits);
+            
+                float64 start_seconds = os_get_elapsed_seconds();
+                u64 start_cycles = rdtsc();
+                merge_sort(items, buffer, item_count, item_size, compare_draw_quads);
+                u64 end_cycles = rdtsc();
+                float64 end_seconds = os_get_elapsed_seconds();
+            
+                for (u64 i = 1; i < item_count; i++) {
+                    assert(items[i].z >= items[i-1].z, "Failed: not correctly sorted");
+                }
+                
+                seconds += end_seconds - start_seconds;
+                cycles += end_cycles - start_cycles;
+            }
+            
+            print("    Merge sort took on average %llu cycles and %.2f ms\n", cycles / num_samples, (seconds * 1000.0) / (float64)num_samples);
         }
         
-        seconds += end_seconds - start_seconds;
-        cycles += end_cycles - start_cycles;
+        dealloc(get_heap_allocator(), items);
+        dealloc(get_heap_allocator(), keys);
+    }
+}
+
+// Draws the same quads as the renderer_stress_test example, plus some z layers, scissors,
+// userdata and retroactive modifications so every stream gets exercised.
+void test_draw_frame_fill(Draw_Frame *frame, Gfx_Image *image, u64 quad_count) {
+    seed_for_random = 69;
+    for (u64 i = 0; i < quad_count; i++) {
+        float x = get_random_float32() * 2.0 - 1.0;
+        float y = get_random_float32() * 2.0 - 1.0;
+        
+        bool layered = i % 7 == 0;
+        bool scissored = i % 11 == 0;
+        if (layered) push_z_layer_in_frame(get_random_int_in_range(-1000, 1000), frame);
+        if (scissored) push_window_scissor_in_frame(v2(10, 10), v2(500, 300), frame);
+        
+        Draw_Quad *q;
+        if (i % 3 == 0) {
+            q = draw_rect_in_frame(v2(x, y), v2(0.1, 0.1), v4(x, y, 0.5, 1.0), frame);
+        } else {
+            q = draw_image_in_frame(image, v2(x, y), v2(0.1, 0.1), COLOR_WHITE, frame);
+        }
+        if (i % 5 == 0) {
+            q->uv = v4(0.25, 0.25, 0.75, 0.75);
+            q->image_min_filter = GFX_FILTER_MODE_LINEAR;
+        }
+        if (i % 13 == 0) q->userdata[0] = v4(1, 2, 3, (float)i);
+        
+        if (scissored) pop_window_scissor_in_frame(frame);
+        if (layered) pop_z_layer_in_frame(frame);
+    }
+}
+void test_draw_frame_quad_layouts() {
+    
+    Gfx_Image image = ZERO(Gfx_Image);
+    image.width = 32;
+    image.height = 32;
+    
+    // Enough to also cover the culled quads
+    const u64 quad_count = 150000;
+    
+    Draw_Frame *aos = alloc(get_heap_allocator(), sizeof(Draw_Frame));
+    Draw_Frame *soa = alloc(get_heap_allocator(), sizeof(Draw_Frame));
+    draw_frame_init(aos);
+    draw_frame_init(soa);
+    draw_frame_reset(aos);
+    draw_frame_reset(soa);
+    draw_frame_set_quad_layout(soa, DRAW_QUAD_LAYOUT_SOA);
+    
+    test_draw_frame_fill(aos, &image, quad_count);
+    test_draw_frame_fill(soa, &image, quad_count);
+    
+    u64 count = draw_frame_get_quad_count(aos);
+    assert(count > 0, "Failed: everything was culled");
+    assert(draw_frame_get_quad_count(soa) == count, "Failed: layouts have different quad counts");
+    
+    draw_frame_flush_pending_quad(soa);
+    Draw_Quad_Streams *streams = &soa->quad_streams;
+    assert(streams->count == count, "Failed: pending quad was not flushed");
+    assert(streams->userdata != 0, "Failed: userdata stream was not allocated");
+    
+    for (u64 i = 0; i < count; i++) {
+        Draw_Quad *q = &aos->quad_buffer[i];
+        u32 flags = streams->flags[i];
+        
+        assert(memcmp(&streams->positions[i*4], &q->bottom_left, sizeof(Vector2)*4) == 0, "Failed: positions differ at %llu", i);
+        assert(memcmp(&streams->colors[i], &q->color, sizeof(Vector4)) == 0, "Failed: colors differ at %llu", i);
+        assert(streams->images[i] == q->image, "Failed: images differ at %llu", i);
+        assert(streams->z[i] == q->z, "Failed: z differs at %llu", i);
+        assert((flags >> DRAW_QUAD_FLAG_TYPE_SHIFT) == q->type, "Failed: type differs at %llu", i);
+        assert(((flags & DRAW_QUAD_FLAG_HAS_SCISSOR) != 0) == q->has_scissor, "Failed: scissor flag differs at %llu", i);
+        if (q->has_scissor) {
+            assert(memcmp(&streams->scissors[i], &q->scissor, sizeof(Vector4)) == 0, "Failed: scissors differ at %llu", i);
+        }
+        if (q->image) {
+            assert(memcmp(&streams->uvs[i], &q->uv, sizeof(Vector4)) == 0, "Failed: uvs differ at %llu", i);
+            assert(((flags & DRAW_QUAD_FLAG_MIN_FILTER_LINEAR) != 0) == (q->image_min_filter == GFX_FILTER_MODE_LINEAR), "Failed: min filter differs at %llu", i);
+            assert(((flags & DRAW_QUAD_FLAG_MAG_FILTER_LINEAR) != 0) == (q->image_mag_filter == GFX_FILTER_MODE_LINEAR), "Failed: mag filter differs at %llu", i);
+        }
+        if (flags & DRAW_QUAD_FLAG_HAS_USERDATA) {
+            assert(memcmp(&streams->userdata[i*VERTEX_USER_DATA_COUNT], q->userdata, sizeof(q->userdata)) == 0, "Failed: userdata differs at %llu", i);
+        } else {
+            for (u64 j = 0; j < VERTEX_USER_DATA_COUNT; j++) {
+                assert(q->userdata[j].x == 0 && q->userdata[j].y == 0 && q->userdata[j].z == 0 && q->userdata[j].w == 0, "Failed: lost userdata at %llu", i);
+            }
+        }
+    }
+    
+    // Sorting the z stream must give the same order as sorting the fat quads
+    Draw_Quad *sorted_quads = alloc(get_heap_allocator(), count*sizeof(Draw_Quad));
+    u32 *order = alloc(get_heap_allocator(), count*sizeof(u32));
+    u64 *keys = alloc(get_heap_allocator(), count*2*sizeof(u64));
+    
+    float64 start = os_get_elapsed_seconds();
+    radix_sort_by_s32(aos->quad_buffer, sorted_quads, keys, count, sizeof(Draw_Quad), offsetof(Draw_Quad, z), MAX_Z_BITS);
+    float64 aos_sort_seconds = os_get_elapsed_seconds() - start;
+    
+    start = os_get_elapsed_seconds();
+    radix_sort_indices_by_s32(streams->z, order, keys, count, MAX_Z_BITS);
+    float64 soa_sort_seconds = os_get_elapsed_seconds() - start;
+    
+    for (u64 i = 0; i < count; i++) {
+        assert(memcmp(&streams->positions[order[i]*4], &sorted_quads[i].bottom_left, sizeof(Vector2)*4) == 0, "Failed: sorted order differs at %llu", i);
     }
     
-    print("Radix sort took on average %llu cycles and %.2f ms\n", cycles / num_samples, (seconds * 1000.0) / (float64)num_samples);
+    // Both layouts must pack to the same vertices
+    aos->enable_z_sorting = true;
+    soa->enable_z_sorting = true;
+    Gfx_Pack_Input aos_input = draw_frame_get_pack_input(aos);
+    Gfx_Pack_Input soa_input = draw_frame_get_pack_input(soa);
+    assert(aos_input.quad_count == count && soa_input.quad_count == count, "Failed: wrong pack input quad count");
+    
+    Gfx_Quad_Vertex *aos_vertices = alloc(get_heap_allocator(), count*4*sizeof(Gfx_Quad_Vertex));
+    Gfx_Quad_Vertex *soa_vertices = alloc(get_heap_allocator(), count*4*sizeof(Gfx_Quad_Vertex));
+    memset(aos_vertices, 0, count*4*sizeof(Gfx_Quad_Vertex));
+    memset(soa_vertices, 0, count*4*sizeof(Gfx_Quad_Vertex));
+    
+    Gfx_Pack pack = ZERO(Gfx_Pack);
+    gfx_pack_quads(&pack, &aos_input, aos_vertices);
+    gfx_pack_quads(&pack, &soa_input, soa_vertices);
+    assert(memcmp(aos_vertices, soa_vertices, count*4*sizeof(Gfx_Quad_Vertex)) == 0, "Failed: layouts packed to different vertices");
+    for (u64 i = 0; i < count; i++) {
+        assert(aos_vertices[i*4].position.x == sorted_quads[i].bottom_left.x, "Failed: packed vertices are not in z order at %llu", i);
+    }
+    
+    gfx_pack_deinit(&pack);
+    dealloc(get_heap_allocator(), aos_vertices);
+    dealloc(get_heap_allocator(), soa_vertices);
+    
+    // The layout is kept through reset and the streams are reused
+    Vector2 *positions = streams->positions;
+    draw_frame_reset(soa);
+    assert(soa->quad_layout == DRAW_QUAD_LAYOUT_SOA, "Failed: layout was not kept through reset");
+    assert(soa->quad_streams.count == 0 && soa->quad_streams.positions == positions, "Failed: streams were not reused");
+    
+    Draw_Quad *q = draw_rect_in_frame(v2(0, 0), v2(0.1, 0.1), COLOR_WHITE, soa);
+    q->z = 5;
+    draw_frame_flush_pending_quad(soa);
+    assert(soa->quad_streams.z[0] == 5, "Failed: retroactive modification was lost");
+    
+    // AoS frames only get a userdata stream once a quad has userdata
+    Draw_Frame *plain = alloc(get_heap_allocator(), sizeof(Draw_Frame));
+    draw_frame_init(plain);
+    draw_frame_reset(plain);
+    draw_rect_in_frame(v2(0, 0), v2(0.1, 0.1), COLOR_WHITE, plain);
+    draw_rect_in_frame(v2(0, 0), v2(0.1, 0.1), COLOR_WHITE, plain);
+    Gfx_Pack_Input plain_input = draw_frame_get_pack_input(plain);
+    assert(!plain_input.userdata, "Failed: userdata stream was allocated without userdata");
+    q = draw_rect_in_frame(v2(0, 0), v2(0.1, 0.1), COLOR_WHITE, plain);
+    q->userdata[0] = v4(1, 2, 3, 4);
+    plain_input = draw_frame_get_pack_input(plain);
+    assert(plain_input.userdata && plain_input.userdata[2*VERTEX_USER_DATA_COUNT].w == 4, "Failed: userdata was lost");
+    assert(!(plain_input.flags[1] & DRAW_QUAD_FLAG_HAS_USERDATA) && (plain_input.flags[2] & DRAW_QUAD_FLAG_HAS_USERDATA), "Failed: wrong userdata flags");
+    growing_array_deinit((void**)&plain->quad_buffer);
+    draw_quad_streams_free(&plain->quad_streams);
+    dealloc(get_heap_allocator(), plain);
+    
+    draw_frame_reset(aos);
+    draw_frame_reset(soa);
+    
+    // Submission throughput
+    const int samples = 5;
+    float64 aos_seconds = 0;
+    float64 soa_seconds = 0;
+    for (int i = 0; i < samples; i++) {
+        start = os_get_elapsed_seconds();
+        test_draw_frame_fill(aos, &image, quad_count);
+        aos_seconds += os_get_elapsed_seconds() - start;
+        
+        start = os_get_elapsed_seconds();
+        test_draw_frame_fill(soa, &image, quad_count);
+        draw_frame_flush_pending_quad(soa);
+        soa_seconds += os_get_elapsed_seconds() - start;
+        
+        draw_frame_reset(aos);
+        draw_frame_reset(soa);
+    }
+    
+    u64 soa_bytes_per_quad = sizeof(Vector2)*4 + sizeof(Vector4)*2 + sizeof(Gfx_Image*) + sizeof(u32) + sizeof(s32);
+    print("\n    %llu quads, AoS %llu bytes per quad, SoA %llu bytes per quad (+ scissor/userdata only when set)\n", count, (u64)sizeof(Draw_Quad), soa_bytes_per_quad);
+    print("    Submit: AoS %.2f ms, SoA %.2f ms\n", (aos_seconds*1000.0)/samples, (soa_seconds*1000.0)/samples);
+    print("    Z sort: AoS %.2f ms, SoA %.2f ms\n", aos_sort_seconds*1000.0, soa_sort_seconds*1000.0);
+    
+    dealloc(get_heap_allocator(), sorted_quads);
+    dealloc(get_heap_allocator(), order);
+    dealloc(get_heap_allocator(), keys);
+    growing_array_deinit((void**)&aos->quad_buffer);
+    growing_array_deinit((void**)&soa->quad_buffer);
+    draw_quad_streams_free(&aos->quad_streams);
+    draw_quad_streams_free(&soa->quad_streams);
+    dealloc(get_heap_allocator(), aos);
+    dealloc(get_heap_allocator(), soa);
+}
 
-	seconds = 0;
-    cycles = 0;
-	for (int a = 0; a < num_samples; a++) {
+// Same quads as test_draw_frame_fill but with z's like a game would have them
+typedef enum Test_Z_Pattern {
+    TEST_Z_IN_ORDER,    // Background, world, ui drawn in that order
+    TEST_Z_FEW_LAYERS,  // A handful of layers, drawn all mixed up
+    TEST_Z_MANY_LAYERS, // More distinct z's than GFX_PACK_MAX_Z_LAYERS
+    TEST_Z_PATTERN_MAX,
+} Test_Z_Pattern;
+s32 test_z_pattern_get_z(Test_Z_Pattern pattern, u64 i, u64 quad_count) {
+    switch (pattern) {
+        case TEST_Z_IN_ORDER:    return (s32)((i*3)/quad_count)*100 - 100;
+        case TEST_Z_FEW_LAYERS:  return (s32)((i*7919) % 5)*10 - 20;
+        case TEST_Z_MANY_LAYERS: return (s32)((i*7919) % 2000) - 1000;
+        default: return 0;
+    }
+}
+void test_draw_frame_fill_z(Draw_Frame *frame, Gfx_Image *image, u64 quad_count, Test_Z_Pattern pattern) {
+    seed_for_random = 69;
+    for (u64 i = 0; i < quad_count; i++) {
+        float x = get_random_float32() * 2.0 - 1.0;
+        float y = get_random_float32() * 2.0 - 1.0;
         
-        for (u64 i = 0; i < item_count; i++) {
-            if (i % 2 == 0) items[i].z = get_random_int_in_range(0, pow(2, id_bits) / 2);
-            else items[i].z = i;
+        push_z_layer_in_frame(test_z_pattern_get_z(pattern, i, quad_count), frame);
+        if (i % 3 == 0) {
+            draw_rect_in_frame(v2(x, y), v2(0.1, 0.1), v4(x, y, 0.5, 1.0), frame);
+        } else {
+            draw_image_in_frame(image, v2(x, y), v2(0.1, 0.1), COLOR_WHITE, frame);
         }
+        pop_z_layer_in_frame(frame);
+    }
+}
+
+void test_draw_frame_z_sorting() {
     
-        u64 item_size = sizeof(Draw_Quad);
-        u64 sort_value_offset_in_item = offsetof(Draw_Quad, z);
+    Gfx_Image image = ZERO(Gfx_Image);
+    image.width = 32;
+    image.height = 32;
+    
+    const u64 quad_count = 100000;
+    
+    Draw_Frame *frame = alloc(get_heap_allocator(), sizeof(Draw_Frame));
+    draw_frame_init(frame);
+    
+    u32 *order = alloc(get_heap_allocator(), quad_count*sizeof(u32));
+    u32 *radix_order = alloc(get_heap_allocator(), quad_count*sizeof(u32));
+    u64 *keys = alloc(get_heap_allocator(), quad_count*2*sizeof(u64));
+    
+    const Gfx_Pack_Sort_Path expected_paths[TEST_Z_PATTERN_MAX] = {
+        GFX_PACK_SORT_ALREADY_SORTED, GFX_PACK_SORT_LAYERS, GFX_PACK_SORT_RADIX
+    };
+    const char *pattern_names[TEST_Z_PATTERN_MAX] = { "in order", "5 layers mixed", "2000 z's mixed" };
+    
+    print("\n");
+    for (u64 layout = 0; layout < 2; layout++) {
+        for (u64 pattern = 0; pattern < TEST_Z_PATTERN_MAX; pattern++) {
+            draw_frame_reset(frame);
+            draw_frame_set_quad_layout(frame, layout ? DRAW_QUAD_LAYOUT_SOA : DRAW_QUAD_LAYOUT_AOS);
+            frame->enable_z_sorting = true;
+            test_draw_frame_fill_z(frame, &image, quad_count, pattern);
+            
+            Gfx_Pack_Input input = draw_frame_get_pack_input(frame);
+            u64 count = input.quad_count;
+            assert(count > 0, "Failed: everything was culled");
+            
+            Gfx_Pack_Input radix_input = input;
+            radix_input.z_layers = 0;
+            
+            // Sorts the same way as before this change, to compare
+            const int samples = 10;
+            float64 start = os_get_elapsed_seconds();
+            for (int i = 0; i < samples; i++) {
+                Gfx_Pack_Sort_Path path = gfx_pack_sort_by_z(&radix_input, radix_order, keys);
+                assert(path == GFX_PACK_SORT_RADIX, "Failed: no z layers should mean radix sort");
+            }
+            float64 radix_seconds = (os_get_elapsed_seconds() - start)/samples;
+            
+            Gfx_Pack_Sort_Path path = GFX_PACK_SORT_NONE;
+            start = os_get_elapsed_seconds();
+            for (int i = 0; i < samples; i++) {
+                path = gfx_pack_sort_by_z(&input, order, keys);
+            }
+            float64 layered_seconds = (os_get_elapsed_seconds() - start)/samples;
+            
+            assert(path == expected_paths[pattern], "Failed: '%cs' sorted with path %d, expected %d", pattern_names[pattern], path, expected_paths[pattern]);
+            
+            // Same stable order as the radix sort
+            for (u64 i = 0; i < count; i++) {
+                u32 n = path == GFX_PACK_SORT_ALREADY_SORTED ? (u32)i : order[i];
+                assert(n == radix_order[i], "Failed: '%cs' sorted differently than radix sort at %llu", pattern_names[pattern], i);
+            }
+            
+            print("    %llu quads %cs, %cs: radix sort %.3f ms, %cs %.3f ms\n",
+                count,
+                layout ? "SoA" : "AoS",
+                pattern_names[pattern],
+                radix_seconds*1000.0,
+                path == GFX_PACK_SORT_ALREADY_SORTED ? "skipped" : (path == GFX_PACK_SORT_LAYERS ? "z layers" : "radix fallback"),
+                layered_seconds*1000.0);
+        }
+    }
+    
+    // Changing z retroactively is still sorted right
+    for (u64 layout = 0; layout < 2; layout++) {
+        draw_frame_reset(frame);
+        draw_frame_set_quad_layout(frame, layout ? DRAW_QUAD_LAYOUT_SOA : DRAW_QUAD_LAYOUT_AOS);
+        frame->enable_z_sorting = true;
+        draw_rect_in_frame(v2(-0.5, 0), v2(0.1, 0.1), COLOR_WHITE, frame);
+        Draw_Quad *q = draw_rect_in_frame(v2(0, 0), v2(0.1, 0.1), COLOR_WHITE, frame);
+        q->z = -1;
+        Gfx_Pack_Input input = draw_frame_get_pack_input(frame);
+        Gfx_Pack_Sort_Path path = gfx_pack_sort_by_z(&input, order, keys);
+        assert(path == GFX_PACK_SORT_LAYERS && order[0] == 1 && order[1] == 0, "Failed: retroactive z change was not sorted");
+    }
+    
+    dealloc(get_heap_allocator(), order);
+    dealloc(get_heap_allocator(), radix_order);
+    dealloc(get_heap_allocator(), keys);
+    growing_array_deinit((void**)&frame->quad_buffer);
+    draw_quad_streams_free(&frame->quad_streams);
+    dealloc(get_heap_allocator(), frame);
+}
+
+void test_draw_pixel_snapping() {
+    
+    // Halves round up everywhere, in the simd paths and the scalar fallback
+    float32 halves[8] = { -3.5, -2.5, -1.5, -0.5, 0.5, 1.5, 2.5, 3.5 };
+    float32 simd_128[8], simd_256[8], basic[8];
+    simd_round_float32_128(halves, simd_128);
+    simd_round_float32_128(halves+4, simd_128+4);
+    simd_round_float32_256(halves, simd_256);
+    basic_round_float32_256(halves, basic);
+    for (int i = 0; i < 8; i++) {
+        float32 expected = halves[i] + 0.5f;
+        assert(simd_128[i] == expected && simd_256[i] == expected && basic[i] == expected, "Failed: %f rounded to %f (128), %f (256), %f (basic), expected %f", halves[i], simd_128[i], simd_256[i], basic[i], expected);
+    }
+    
+    // Power of two size so world -> ndc -> pixels is exact and the corners land on halves
+    Os_Window window_before = window;
+    window.pixel_width = 1024;
+    window.pixel_height = 512;
+    
+    Draw_Frame *frame = alloc(get_heap_allocator(), sizeof(Draw_Frame));
+    draw_frame_init(frame);
+    draw_frame_reset(frame);
+    float32 pixel_width = 2.0/(float32)window.width;
+    float32 pixel_height = 2.0/(float32)window.height;
+    
+    // A 3 pixel wide quad stays 3 pixels wide wherever it is on a half pixel
+    for (s32 n = -6; n <= 6; n++) {
+        Draw_Quad *q = draw_rect_in_frame(v2(n*7 + 0.5, 0.5), v2(3, 5), COLOR_WHITE, frame);
+        float32 width = (q->bottom_right.x - q->bottom_left.x)/pixel_width;
+        float32 height = (q->top_left.y - q->bottom_left.y)/pixel_height;
+        assert(width == 3 && height == 5, "Failed: 3x5 quad at x = %d.5 snapped to %fx%f", n*7, width, height);
+    }
+    
+    growing_array_deinit((void**)&frame->quad_buffer);
+    draw_quad_streams_free(&frame->quad_streams);
+    dealloc(get_heap_allocator(), frame);
+    window = window_before;
+}
+void test_draw_images_xform_batch() {
+    
+    Gfx_Image image = ZERO(Gfx_Image);
+    image.width = 32;
+    image.height = 32;
+    
+    Draw_Frame *single = alloc(get_heap_allocator(), sizeof(Draw_Frame));
+    Draw_Frame *batch = alloc(get_heap_allocator(), sizeof(Draw_Frame));
+    Draw_Frame *batch_soa = alloc(get_heap_allocator(), sizeof(Draw_Frame));
+    draw_frame_init(single);
+    draw_frame_init(batch);
+    draw_frame_init(batch_soa);
+    draw_frame_reset(single);
+    draw_frame_reset(batch);
+    draw_frame_reset(batch_soa);
+    draw_frame_set_quad_layout(batch_soa, DRAW_QUAD_LAYOUT_SOA);
+    
+    // Cached world_to_clip must follow camera_xform and projection
+    for (int i = 0; i < 3; i++) {
+        if (i == 1) single->camera_xform = m4_translate(single->camera_xform, v3(13.5, -7.25, 0));
+        if (i == 2) single->projection = m4_make_orthographic_projection(-300, 300, -200, 200, -1, 10);
+        Matrix4 expected = m4_mul(single->projection, m4_inverse(single->camera_xform));
+        Matrix4 world_to_clip = draw_frame_get_world_to_clip(single);
+        assert(memcmp(&expected, &world_to_clip, sizeof(Matrix4)) == 0, "Failed: cached world_to_clip is stale");
+    }
+    batch->camera_xform = batch_soa->camera_xform = single->camera_xform;
+    batch->projection = batch_soa->projection = single->projection;
+    
+    const u64 count = 150000;
+    Draw_Image_Xform *items = alloc(get_heap_allocator(), count*sizeof(Draw_Image_Xform));
+    
+    seed_for_random = 420;
+    for (u64 i = 0; i < count; i++) {
+        Matrix4 xform = m4_scalar(1.0);
+        xform = m4_translate(xform, v3(get_random_float32_in_range(-500, 500), get_random_float32_in_range(-350, 350), 0));
+        xform = m4_rotate_z(xform, get_random_float32_in_range(0, 6.28));
+        
+        items[i].image = &image;
+        items[i].xform = xform;
+        items[i].size = v2(get_random_float32_in_range(1, 64), get_random_float32_in_range(1, 64));
+        items[i].color = v4(get_random_float32(), get_random_float32(), get_random_float32(), 1.0);
+    }
+    
+    push_z_layer_in_frame(3, single);
+    push_z_layer_in_frame(3, batch);
+    push_z_layer_in_frame(3, batch_soa);
+    
+    float64 start = os_get_elapsed_seconds();
+    for (u64 i = 0; i < count; i++) {
+        draw_image_xform_in_frame(items[i].image, items[i].xform, items[i].size, items[i].color, single);
+    }
+    float64 single_seconds = os_get_elapsed_seconds() - start;
+    
+    start = os_get_elapsed_seconds();
+    u64 drawn_count = draw_images_xform_batch_in_frame(items, count, batch);
+    float64 batch_seconds = os_get_elapsed_seconds() - start;
+    
+    draw_images_xform_batch_in_frame(items, count, batch_soa);
+    
+    u64 quad_count = draw_frame_get_quad_count(single);
+    assert(quad_count > 0 && quad_count < count, "Failed: expected some but not all quads to be culled");
+    assert(drawn_count == quad_count, "Failed: batch culled %llu, expected %llu", count-drawn_count, count-quad_count);
+    assert(draw_frame_get_quad_count(batch) == quad_count, "Failed: wrong quad count in batch frame");
+    assert(draw_frame_get_quad_count(batch_soa) == quad_count, "Failed: wrong quad count in SoA batch frame");
+    
+    Draw_Quad_Streams *streams = &batch_soa->quad_streams;
+    for (u64 i = 0; i < quad_count; i++) {
+        Draw_Quad *a = &single->quad_buffer[i];
+        Draw_Quad *b = &batch->quad_buffer[i];
+        
+        assert(memcmp(&a->bottom_left, &b->bottom_left, sizeof(Vector2)*4) == 0, "Failed: corners differ at %llu", i);
+        assert(memcmp(&a->color, &b->color, sizeof(Vector4)) == 0, "Failed: colors differ at %llu", i);
+        assert(memcmp(&a->uv, &b->uv, sizeof(Vector4)) == 0, "Failed: uvs differ at %llu", i);
+        assert(a->image == b->image, "Failed: images differ at %llu", i);
+        assert(a->z == b->z && b->z == 3, "Failed: z differs at %llu", i);
+        assert(a->type == b->type, "Failed: types differ at %llu", i);
+        assert(a->image_min_filter == b->image_min_filter && a->image_mag_filter == b->image_mag_filter, "Failed: filters differ at %llu", i);
+        assert(a->has_scissor == b->has_scissor, "Failed: scissors differ at %llu", i);
+        
+        assert(memcmp(&streams->positions[i*4], &a->bottom_left, sizeof(Vector2)*4) == 0, "Failed: SoA corners differ at %llu", i);
+        assert(streams->z[i] == 3, "Failed: SoA z differs at %llu", i);
+    }
+    
+    print("\n    %llu images (%llu not culled): draw_image_xform %.2f ms, draw_images_xform_batch %.2f ms\n", count, quad_count, single_seconds*1000.0, batch_seconds*1000.0);
+    
+    dealloc(get_heap_allocator(), items);
+    growing_array_deinit((void**)&single->quad_buffer);
+    growing_array_deinit((void**)&batch->quad_buffer);
+    growing_array_deinit((void**)&batch_soa->quad_buffer);
+    draw_quad_streams_free(&batch_soa->quad_streams);
+    dealloc(get_heap_allocator(), single);
+    dealloc(get_heap_allocator(), batch);
+    dealloc(get_heap_allocator(), batch_soa);
+}
+// Records a checkerboard like the alchemist tiles plus some images with z, scissor and userdata
+void test_draw_list_fill(Draw_Frame *frame, Gfx_Image *image, int radius) {
+    for (int x = -radius; x < radius; x++) {
+        for (int y = -radius; y < radius; y++) {
+            if ((x + (y % 2 == 0)) % 2 != 0) continue;
+            
+            bool special = (x*31 + y*17) % 23 == 0;
+            if (special) {
+                push_z_layer_in_frame(x+y, frame);
+                push_window_scissor_in_frame(v2(10, 10), v2(500, 300), frame);
+                Draw_Quad *q = draw_image_in_frame(image, v2(x*8.0 - 4.0, y*8.0 - 4.0), v2(8, 8), COLOR_WHITE, frame);
+                q->uv = v4(0.25, 0.25, 0.75, 0.75);
+                q->image_mag_filter = GFX_FILTER_MODE_LINEAR;
+                q->userdata[0] = v4(1, 2, 3, (float)x);
+                pop_window_scissor_in_frame(frame);
+                pop_z_layer_in_frame(frame);
+            } else {
+                draw_rect_in_frame(v2(x*8.0 - 4.0, y*8.0 - 4.0), v2(8, 8), v4(0.2, 0.2, 0.2, 0.2), frame);
+            }
+        }
+    }
+}
+void test_draw_list() {
+    
+    Gfx_Image image = ZERO(Gfx_Image);
+    image.width = 32;
+    image.height = 32;
+    
+    Draw_List *list = alloc(get_heap_allocator(), sizeof(Draw_List));
+    draw_list_init(list);
+    Draw_Frame *record = draw_list_begin(list);
+    test_draw_list_fill(record, &image, 200);
+    draw_list_end(list);
+    u64 recorded_count = list->record.quad_streams.count;
+    assert(recorded_count == 200*200*2, "Failed: draw list culled while recording");
+    
+    Draw_Frame *immediate = alloc(get_heap_allocator(), sizeof(Draw_Frame));
+    Draw_Frame *aos = alloc(get_heap_allocator(), sizeof(Draw_Frame));
+    Draw_Frame *soa = alloc(get_heap_allocator(), sizeof(Draw_Frame));
+    draw_frame_init(immediate);
+    draw_frame_init(aos);
+    draw_frame_init(soa);
+    draw_frame_reset(immediate);
+    draw_frame_reset(aos);
+    draw_frame_reset(soa);
+    draw_frame_set_quad_layout(soa, DRAW_QUAD_LAYOUT_SOA);
+    
+    Matrix4 camera = m4_mul(m4_make_translation(v3(123.25, -80.5, 0)), m4_make_scale(v3(1.0/6.0, 1.0/6.0, 1.0)));
+    immediate->camera_xform = aos->camera_xform = soa->camera_xform = camera;
+    
+    // Same camera as immediate mode gives the same quads, in both layouts
+    test_draw_list_fill(immediate, &image, 200);
+    u64 count = draw_frame_get_quad_count(immediate);
+    assert(count > 0 && count < recorded_count, "Failed: test should cull some of the quads");
+    assert(draw_list_submit_in_frame(list, aos) == count, "Failed: draw list drew a different number of quads than immediate mode");
+    assert(draw_list_submit_in_frame(list, soa) == count, "Failed: draw list drew a different number of quads than immediate mode");
+    assert(list->cull_count == 1, "Failed: same camera culled the list again");
+    
+    draw_frame_flush_pending_quad(soa);
+    for (u64 i = 0; i < count; i++) {
+        Draw_Quad *a = &immediate->quad_buffer[i];
+        Draw_Quad *b = &aos->quad_buffer[i];
+        Draw_Quad c;
+        draw_quad_streams_read(&soa->quad_streams, i, &c);
+        
+        Draw_Quad *others[2] = {b, &c};
+        for (int j = 0; j < 2; j++) {
+            Draw_Quad *o = others[j];
+            assert(memcmp(&a->bottom_left, &o->bottom_left, sizeof(Vector2)*4) == 0, "Failed: corners differ at %llu", i);
+            assert(memcmp(&a->color, &o->color, sizeof(Vector4)) == 0, "Failed: colors differ at %llu", i);
+            assert(a->image == o->image && a->z == o->z && a->type == o->type, "Failed: quads differ at %llu", i);
+            assert(a->has_scissor == o->has_scissor, "Failed: scissor differs at %llu", i);
+            if (a->has_scissor) assert(memcmp(&a->scissor, &o->scissor, sizeof(Vector4)) == 0, "Failed: scissor differs at %llu", i);
+            if (a->image) {
+                assert(memcmp(&a->uv, &o->uv, sizeof(Vector4)) == 0, "Failed: uvs differ at %llu", i);
+                assert(a->image_min_filter == o->image_min_filter && a->image_mag_filter == o->image_mag_filter, "Failed: filters differ at %llu", i);
+            }
+            assert(memcmp(a->userdata, o->userdata, sizeof(a->userdata)) == 0, "Failed: userdata differs at %llu", i);
+        }
+    }
+    
+    // Small pans reuse the cache and stay within a pixel of immediate mode
+    float32 pixel_width = 2.0/(float32)window.width;
+    float32 pixel_height = 2.0/(float32)window.height;
+    for (int step = 1; step <= 10; step++) {
+        draw_frame_reset(immediate);
+        draw_frame_reset(soa);
+        immediate->camera_xform = soa->camera_xform = m4_translate(camera, v3(step*0.7, step*-0.3, 0));
+        
+        test_draw_list_fill(immediate, &image, 200);
+        u64 submitted = draw_list_submit_in_frame(list, soa);
+        u64 expected = draw_frame_get_quad_count(immediate);
+        assert(submitted + 100 > expected && expected + 100 > submitted, "Failed: panned draw list drew %llu quads, expected about %llu", submitted, expected);
+        
+        if (submitted == expected) {
+            for (u64 i = 0; i < expected; i++) {
+                Vector2 a = immediate->quad_buffer[i].bottom_left;
+                Vector2 b = soa->quad_streams.positions[i*4];
+                assert(fabs(a.x-b.x) <= pixel_width*1.01 && fabs(a.y-b.y) <= pixel_height*1.01, "Failed: panned quad %llu is off by more than a pixel", i);
+            }
+        }
+    }
+    assert(list->cull_count == 1, "Failed: small pans culled the list again");
+    
+    // Panning further, or zooming, culls it again
+    draw_frame_reset(soa);
+    soa->camera_xform = m4_translate(camera, v3(400, 0, 0));
+    draw_list_submit_in_frame(list, soa);
+    assert(list->cull_count == 2, "Failed: large pan didn't cull the list again");
+    
+    draw_frame_reset(soa);
+    soa->camera_xform = m4_scale(camera, v3(2, 2, 1));
+    draw_list_submit_in_frame(list, soa);
+    assert(list->cull_count == 3, "Failed: zoom didn't cull the list again");
+    
+    // Alchemist's tile rendering, immediate vs replayed
+    draw_list_begin(list);
+    test_draw_list_fill(&list->record, &image, 40);
+    draw_list_end(list);
+    
+    const int samples = 100;
+    float64 immediate_seconds = 0;
+    float64 list_seconds = 0;
+    u64 tile_count = 0;
+    for (int i = 0; i < samples; i++) {
+        draw_frame_reset(immediate);
+        draw_frame_reset(soa);
+        immediate->camera_xform = soa->camera_xform = m4_translate(camera, v3(i*0.1, 0, 0));
+        
+        float64 start = os_get_elapsed_seconds();
+        test_draw_list_fill(immediate, &image, 40);
+        immediate_seconds += os_get_elapsed_seconds() - start;
+        
+        start = os_get_elapsed_seconds();
+        tile_count = draw_list_submit_in_frame(list, soa);
+        list_seconds += os_get_elapsed_seconds() - start;
+    }
+    print("\n    %llu tiles, %llu visible: immediate %.3f ms, draw list %.3f ms (culled %llu times)\n", list->record.quad_streams.count, tile_count, (immediate_seconds*1000.0)/samples, (list_seconds*1000.0)/samples, list->cull_count);
     
-        float64 start_seconds = os_get_elapsed_seconds();
-        u64 start_cycles = rdtsc();
-        merge_sort(items, buffer, item_count, item_size, compare_draw_quads);
-        u64 end_cycles = rdtsc();
-        float64 end_seconds = os_get_elapsed_seconds();
+    draw_list_deinit(list);
+    dealloc(get_heap_allocator(), list);
+    Draw_Frame *frames[3] = {immediate, aos, soa};
+    for (int i = 0; i < 3; i++) {
+        growing_array_deinit((void**)&frames[i]->quad_buffer);
+        draw_quad_streams_free(&frames[i]->quad_streams);
+        dealloc(get_heap_allocator(), frames[i]);
+    }
+}
+void test_draw_tilemap() {
+    
+    Gfx_Image image = ZERO(Gfx_Image);
+    image.width = 32;
+    image.height = 32;
     
-        for (u64 i = 1; i < item_count; i++) {
-            assert(items[i].z >= items[i-1].z, "Failed: not correctly sorted");
+    const u32 size = 200;
+    Tilemap *map = make_tilemap(size, size, 8.0, get_heap_allocator());
+    map->origin = v2(-(float32)(size/2)*8.0, -(float32)(size/2)*8.0);
+    tilemap_set_tile_type(map, 1, 0, v4(0, 0, 1, 1), v4(0.2, 0.2, 0.2, 0.2));
+    tilemap_set_tile_type(map, 2, &image, v4(0.25, 0.25, 0.75, 0.75), COLOR_WHITE);
+    for (u32 y = 0; y < size; y++) {
+        for (u32 x = 0; x < size; x++) tilemap_set_tile(map, x, y, test_tilemap_pattern(x, y));
+    }
+    
+    Draw_Frame *immediate = alloc(get_heap_allocator(), sizeof(Draw_Frame));
+    Draw_Frame *aos = alloc(get_heap_allocator(), sizeof(Draw_Frame));
+    Draw_Frame *soa = alloc(get_heap_allocator(), sizeof(Draw_Frame));
+    draw_frame_init(immediate);
+    draw_frame_init(aos);
+    draw_frame_init(soa);
+    draw_frame_set_quad_layout(soa, DRAW_QUAD_LAYOUT_SOA);
+    
+    // Same quads as drawing every tile in chunk order, in both layouts
+    Matrix4 cameras[3] = {
+        m4_mul(m4_make_translation(v3(123.25, -80.5, 0)), m4_make_scale(v3(1.0/6.0, 1.0/6.0, 1.0))),
+        m4_make_translation(v3(790, 790, 0)),
+        m4_mul(m4_make_rotation_z(0.3), m4_make_scale(v3(0.5, 0.5, 1.0))),
+    };
+    for (int c = 0; c < 3; c++) {
+        draw_frame_reset(immediate);
+        draw_frame_reset(aos);
+        draw_frame_reset(soa);
+        immediate->camera_xform = aos->camera_xform = soa->camera_xform = cameras[c];
+        
+        for (u32 cy = 0; cy < map->chunks_y; cy++) {
+            for (u32 cx = 0; cx < map->chunks_x; cx++) {
+                for (u32 y = cy*TILEMAP_CHUNK_SIZE; y < min((cy+1)*TILEMAP_CHUNK_SIZE, size); y++) {
+                    for (u32 x = cx*TILEMAP_CHUNK_SIZE; x < min((cx+1)*TILEMAP_CHUNK_SIZE, size); x++) {
+                        Tile tile = tilemap_get_tile(map, x, y);
+                        if (!tile) continue;
+                        Tilemap_Tile_Type *type = &map->tile_types[tile];
+                        Draw_Quad *q = draw_rect_in_frame(tilemap_tile_to_world(map, x, y), v2(8, 8), type->color, immediate);
+                        q->image = type->image;
+                        q->uv = type->uv;
+                    }
+                }
+            }
         }
         
-        seconds += end_seconds - start_seconds;
-        cycles += end_cycles - start_cycles;
+        u64 count = draw_frame_get_quad_count(immediate);
+        assert(count > 0, "Failed: everything was culled");
+        assert(draw_tilemap_in_frame(map, aos) == count, "Failed: tilemap drew a different number of quads than immediate mode");
+        assert(draw_tilemap_in_frame(map, soa) == count, "Failed: tilemap drew a different number of quads than immediate mode");
+        
+        draw_frame_flush_pending_quad(soa);
+        for (u64 i = 0; i < count; i++) {
+            Draw_Quad *a = &immediate->quad_buffer[i];
+            Draw_Quad *b = &aos->quad_buffer[i];
+            assert(memcmp(&a->bottom_left, &b->bottom_left, sizeof(Vector2)*4) == 0, "Failed: corners differ at %llu", i);
+            assert(memcmp(&a->bottom_left, &soa->quad_streams.positions[i*4], sizeof(Vector2)*4) == 0, "Failed: SoA corners differ at %llu", i);
+            assert(memcmp(&a->color, &b->color, sizeof(Vector4)) == 0 && a->image == b->image, "Failed: quads differ at %llu", i);
+            assert(a->image == soa->quad_streams.images[i], "Failed: SoA images differ at %llu", i);
+            if (a->image) assert(memcmp(&a->uv, &b->uv, sizeof(Vector4)) == 0, "Failed: uvs differ at %llu", i);
+        }
     }
     
-    print("Merge sort took on average %llu cycles and %.2f ms\n", cycles / num_samples, (seconds * 1000.0) / (float64)num_samples);
+    // Alchemist's view, immediate vs tilemap
+    const int samples = 100;
+    float64 immediate_seconds = 0;
+    float64 tilemap_seconds = 0;
+    u64 tile_count = 0;
+    for (int i = 0; i < samples; i++) {
+        draw_frame_reset(immediate);
+        draw_frame_reset(soa);
+        immediate->camera_xform = soa->camera_xform = m4_translate(cameras[0], v3(i*0.5, i*0.25, 0));
+        
+        float64 start = os_get_elapsed_seconds();
+        test_draw_list_fill(immediate, &image, 40);
+        immediate_seconds += os_get_elapsed_seconds() - start;
+        
+        start = os_get_elapsed_seconds();
+        tile_count = draw_tilemap_in_frame(map, soa);
+        tilemap_seconds += os_get_elapsed_seconds() - start;
+    }
+    print("\n    %llu visible tiles: immediate %.3f ms, tilemap %.3f ms\n", tile_count, (immediate_seconds*1000.0)/samples, (tilemap_seconds*1000.0)/samples);
+    
+    destroy_tilemap(map);
+    Draw_Frame *frames[3] = {immediate, aos, soa};
+    for (int i = 0; i < 3; i++) {
+        growing_array_deinit((void**)&frames[i]->quad_buffer);
+        draw_quad_streams_free(&frames[i]->quad_streams);
+        dealloc(get_heap_allocator(), frames[i]);
+    }
+}
+void test_atlas_fill_pixels(u8 *pixels, u32 width, u32 height, u32 k) {
+    for (u32 y = 0; y < height; y++) {
+        for (u32 x = 0; x < width; x++) {
+            u8 *p = pixels + (y*width + x)*4;
+            p[0] = (u8)(k*7 + x);
+            p[1] = (u8)(k*13 + y);
+            p[2] = (u8)k;
+            p[3] = 255;
+        }
+    }
+}
+// Checks that the image, and the edge pixels extruded into its padding, are where atlas_uv says
+void test_atlas_check_image(Gfx_Atlas *atlas, Gfx_Image *image, u32 k) {
+    Gfx_Atlas_Page *page = 0;
+    u32 page_count = growing_array_get_valid_count(atlas->pages);
+    for (u32 i = 0; i < page_count; i++) {
+        if (atlas->pages[i].image == image->atlas_page) page = &atlas->pages[i];
+    }
+    assert(page, "Failed: atlas image points to a page which is not in the atlas");
+    assert(image->gfx_handle == image->atlas_page->gfx_handle, "Failed: atlas image does not share its page's gfx handle");
+    
+    s64 x0 = (s64)(image->atlas_uv.x*atlas->page_width + 0.5f);
+    s64 y0 = (s64)(image->atlas_uv.y*atlas->page_height + 0.5f);
+    s64 x1 = (s64)(image->atlas_uv.z*atlas->page_width + 0.5f);
+    s64 y1 = (s64)(image->atlas_uv.w*atlas->page_height + 0.5f);
+    assert(x1-x0 == image->width && y1-y0 == image->height, "Failed: atlas uv's don't match the image size");
+    
+    s64 padding = atlas->padding;
+    assert(x0 >= padding && y0 >= padding && x1 + padding <= atlas->page_width && y1 + padding <= atlas->page_height, "Failed: atlas image padding is out of page bounds");
+    
+    for (s64 y = y0-padding; y < y1+padding; y++) {
+        for (s64 x = x0-padding; x < x1+padding; x++) {
+            u32 src_x = (u32)clamp(x-x0, 0, (s64)image->width-1);
+            u32 src_y = (u32)clamp(y-y0, 0, (s64)image->height-1);
+            u8 *p = page->pixels + (y*atlas->page_width + x)*4;
+            assert(p[0] == (u8)(k*7 + src_x) && p[1] == (u8)(k*13 + src_y) && p[2] == (u8)k && p[3] == 255, "Failed: wrong atlas pixel for image %d at %lld, %lld", k, x, y);
+        }
+    }
+}
+void test_sprite_atlas() {
+    
+    // Skyline packer never overlaps and stays in bounds
+    const u32 size = 256;
+    Rect_Packer packer;
+    rect_packer_init(&packer, size, size, get_heap_allocator());
+    u8 *taken = alloc(get_heap_allocator(), size*size);
+    memset(taken, 0, size*size);
+    
+    seed_for_random = 1337;
+    u64 packed_area = 0;
+    for (u32 i = 0; i < 3000; i++) {
+        u32 w = (u32)get_random_int_in_range(1, 24);
+        u32 h = (u32)get_random_int_in_range(1, 24);
+        u32 x, y;
+        if (!rect_packer_insert(&packer, w, h, &x, &y)) continue;
+        
+        assert(x + w <= size && y + h <= size, "Failed: packed rect is out of bounds");
+        for (u32 py = y; py < y+h; py++) {
+            for (u32 px = x; px < x+w; px++) {
+                assert(!taken[py*size + px], "Failed: packed rects overlap at %d, %d", px, py);
+                taken[py*size + px] = 1;
+            }
+        }
+        packed_area += w*h;
+    }
+    float64 fill = (float64)packed_area/(float64)(size*size);
+    assert(fill > 0.8, "Failed: packer only filled %.2f of the area", fill);
+    assert(!rect_packer_insert(&packer, size+1, 1, &(u32){0}, &(u32){0}), "Failed: packed a rect wider than the packer");
+    
+    rect_packer_reset(&packer);
+    u32 x, y;
+    assert(rect_packer_insert(&packer, size, size, &x, &y) && x == 0 && y == 0, "Failed: reset packer is not empty");
+    rect_packer_deinit(&packer);
+    dealloc(get_heap_allocator(), taken);
+    
+    // Atlas
+    Gfx_Atlas *atlas = make_atlas(128, 128, get_heap_allocator());
+    
+    const u32 image_count = 60;
+    Gfx_Image *images[60];
+    u32 keys[60];
+    u8 *pixels = alloc(get_heap_allocator(), 40*40*4);
+    for (u32 k = 0; k < image_count; k++) {
+        u32 w = (u32)get_random_int_in_range(4, 40);
+        u32 h = (u32)get_random_int_in_range(4, 40);
+        test_atlas_fill_pixels(pixels, w, h, k);
+        images[k] = atlas_add_image(atlas, w, h, pixels);
+        keys[k] = k;
+        assert(images[k]->width == w && images[k]->height == h && images[k]->atlas_page, "Failed: bad atlas image");
+    }
+    u32 page_count = growing_array_get_valid_count(atlas->pages);
+    u32 first_page_count = page_count;
+    assert(page_count > 1, "Failed: test should need more than one page");
+    for (u32 k = 0; k < image_count; k++) test_atlas_check_image(atlas, images[k], k);
+    
+    // Drawing atlas images draws their pages, so everything goes in one batch
+    Draw_Frame *frame = alloc(get_heap_allocator(), sizeof(Draw_Frame));
+    draw_frame_init(frame);
+    draw_frame_reset(frame);
+    for (u32 k = 0; k < image_count; k++) {
+        Draw_Quad *q = draw_image_in_frame(images[k], v2(0, 0), v2(0.1, 0.1), COLOR_WHITE, frame);
+        if (k == 0) q->uv = v4(0.5, 0, 1, 0.5);
+    }
+    Gfx_Pack_Input input = draw_frame_get_pack_input(frame);
+    for (u32 k = 0; k < image_count; k++) {
+        Vector4 r = images[k]->atlas_uv;
+        Vector4 uv = frame->quad_streams.uvs[k];
+        assert((Gfx_Image*)input.images[k] == images[k]->atlas_page, "Failed: atlas image was not drawn from its page");
+        if (k == 0) {
+            assert(uv.x == r.x + (r.z-r.x)*0.5f && uv.y == r.y && uv.z == r.z && uv.w == r.y + (r.w-r.y)*0.5f, "Failed: uv was not remapped into the atlas");
+        } else {
+            assert(memcmp(&uv, &r, sizeof(Vector4)) == 0, "Failed: uv was not remapped into the atlas");
+        }
+    }
+    Gfx_Pack pack = ZERO(Gfx_Pack);
+    gfx_pack_begin(&pack, &input);
+    assert(pack.batch_count == 1 && pack.batches[0].texture_count == page_count, "Failed: atlas images did not batch by page");
+    gfx_pack_deinit(&pack);
+    draw_quad_streams_free(&frame->quad_streams);
+    
+    // A retained draw list and a SoA frame with the images that are kept, recorded before the
+    // repack below moves them
+    Draw_List *list = alloc(get_heap_allocator(), sizeof(Draw_List));
+    draw_list_init(list);
+    Draw_Frame *record = draw_list_begin(list);
+    draw_frame_reset(frame);
+    draw_frame_set_quad_layout(frame, DRAW_QUAD_LAYOUT_SOA);
+    for (u32 k = 1; k < image_count; k += 2) {
+        Draw_Quad *q = draw_image_in_frame(images[k], v2(0, 0), v2(0.1, 0.1), COLOR_WHITE, record);
+        q->uv = v4(0.5, 0, 1, 0.5);
+        q = draw_image_in_frame(images[k], v2(0, 0), v2(0.1, 0.1), COLOR_WHITE, frame);
+        q->uv = v4(0.5, 0, 1, 0.5);
+    }
+    draw_list_end(list);
+    
+    // Evict every other image, the rest keep their pointers and pixels through a repack
+    u32 kept = 0;
+    for (u32 k = 0; k < image_count; k++) {
+        if (k % 2 == 0) {
+            atlas_remove_image(atlas, images[k]);
+        } else {
+            images[kept] = images[k];
+            keys[kept] = k;
+            kept += 1;
+        }
+    }
+    assert(growing_array_get_valid_count(atlas->entries) == kept, "Failed: images were not removed");
+    assert(atlas_get_wasted_area(atlas) > 0, "Failed: removed images didn't leave wasted area");
+    
+    atlas_repack(atlas);
+    assert(atlas->repack_count == 1, "Failed: atlas was not repacked");
+    assert(atlas_get_wasted_area(atlas) == 0, "Failed: repacked atlas has wasted area");
+    assert(growing_array_get_valid_count(atlas->pages) < page_count, "Failed: repacking half the images didn't free a page");
+    for (u32 i = 0; i < kept; i++) test_atlas_check_image(atlas, images[i], keys[i]);
+    
+    // Both still draw from where the images are now
+    Draw_Frame *aos = alloc(get_heap_allocator(), sizeof(Draw_Frame));
+    draw_frame_init(aos);
+    draw_frame_reset(aos);
+    u64 submitted = draw_list_submit_in_frame(list, aos);
+    assert(submitted == kept, "Failed: draw list culled atlas images");
+    // The SoA frame is packed twice, which must not resolve twice
+    for (int pass = 0; pass < 3; pass++) {
+        input = draw_frame_get_pack_input(pass < 2 ? frame : aos);
+        assert(input.quad_count == kept, "Failed: wrong quad count");
+        for (u32 i = 0; i < kept; i++) {
+            Vector4 r = images[i]->atlas_uv;
+            Vector4 uv = input.uvs[i];
+            assert((Gfx_Image*)input.images[i] == images[i]->atlas_page, "Failed: atlas image drew from its old page after a repack");
+            assert(uv.x == r.x + (r.z-r.x)*0.5f && uv.y == r.y && uv.z == r.z && uv.w == r.y + (r.w-r.y)*0.5f, "Failed: atlas image drew from its old uv's after a repack");
+        }
+    }
+    draw_list_deinit(list);
+    dealloc(get_heap_allocator(), list);
+    growing_array_deinit((void**)&aos->quad_buffer);
+    draw_quad_streams_free(&aos->quad_streams);
+    dealloc(get_heap_allocator(), aos);
+    growing_array_deinit((void**)&frame->quad_buffer);
+    draw_quad_streams_free(&frame->quad_streams);
+    dealloc(get_heap_allocator(), frame);
+    
+    // Filling the atlas back up fills the holes left by evicted images before making new pages
+    page_count = growing_array_get_valid_count(atlas->pages);
+    for (u32 i = 0; i < kept; i++) {
+        if (i % 2 == 0) atlas_remove_image(atlas, images[i]);
+    }
+    u32 refill = 0;
+    while (growing_array_get_valid_count(atlas->pages) == page_count && refill < 100) {
+        test_atlas_fill_pixels(pixels, 16, 16, 200 + refill);
+        atlas_add_image(atlas, 16, 16, pixels);
+        refill += 1;
+    }
+    assert(atlas->repack_count == 2, "Failed: atlas did not repack itself before making a new page");
+    
+    print("\n    %d images in %d pages, skyline packer filled %.1f%% of a %dx%d page\n", image_count, first_page_count, fill*100.0, size, size);
+    
+    dealloc(get_heap_allocator(), pixels);
+    destroy_atlas(atlas);
+}
+
+// y is up like the drawing, row 0 of a render target is its top
+u32 test_render_get_pixel(u32 *pixels, u32 size, u32 x, u32 y) {
+    return pixels[(size-1-y)*size + x];
+}
+void test_render_check_pixel(u32 *pixels, u32 size, u32 x, u32 y, u32 r, u32 g, u32 b, u32 a) {
+    u32 p = test_render_get_pixel(pixels, size, x, y);
+    s32 got[4] = { p & 0xff, (p >> 8) & 0xff, (p >> 16) & 0xff, p >> 24 };
+    s32 expected[4] = { r, g, b, a };
+    for (int i = 0; i < 4; i++) {
+        // Rounding is allowed to differ a little between renderers
+        assert(abs(got[i] - expected[i]) <= 2, "Failed: pixel %d, %d is %d %d %d %d, expected %d %d %d %d", x, y, got[0], got[1], got[2], got[3], r, g, b, a);
+    }
+}
+void test_render_to_image() {
+    
+    const u32 size = 64;
+    Gfx_Image *target = make_image_render_target(size, size, 4, 0, get_heap_allocator());
+    u32 *pixels = alloc(get_heap_allocator(), size*size*sizeof(u32));
+    
+    Draw_Frame *frame = alloc(get_heap_allocator(), sizeof(Draw_Frame));
+    draw_frame_init(frame);
+    draw_frame_reset(frame);
+    // One unit per pixel. Edges are kept on multiples of 4 so snapping to the window's pixels
+    // doesn't move them.
+    frame->projection = m4_make_orthographic_projection(0, size, 0, size, -1, 10);
+    frame->enable_z_sorting = true;
+    
+    gfx_clear_render_target(target, v4(0, 0, 0, 1));
+    
+    // Laid out in 16x16 cells
+    
+    // Opaque, and half transparent on top
+    draw_rect_in_frame(v2(0, 0), v2(32, 16), COLOR_RED, frame);
+    draw_rect_in_frame(v2(16, 0), v2(16, 16), v4(0, 0, 1, 0.5), frame);
+    
+    // Two half transparent rects sharing an edge through pixel centers. The column on the
+    // shared edge should only be blended once.
+    draw_rect_in_frame(v2(32.5, 4), v2(16, 8), v4(1, 1, 1, 0.5), frame);
+    draw_rect_in_frame(v2(48.5, 4), v2(15, 8), v4(1, 1, 1, 0.5), frame);
+    
+    draw_circle_in_frame(v2(0, 16), v2(32, 32), COLOR_GREEN, frame);
+    
+    // Drawn first but on top
+    push_z_layer_in_frame(10, frame);
+    draw_rect_in_frame(v2(32, 16), v2(16, 16), v4(1, 1, 0, 1), frame);
+    pop_z_layer_in_frame(frame);
+    draw_rect_in_frame(v2(32, 16), v2(16, 16), COLOR_BLUE, frame);
+    
+    // Scissors are in window pixels with y up, so this is x 52-60 and y 20-28
+    float32 window_top = (float32)window.pixel_height;
+    push_window_scissor_in_frame(v2(52, window_top-44), v2(60, window_top-36), frame);
+    draw_rect_in_frame(v2(48, 16), v2(16, 16), COLOR_WHITE, frame);
+    pop_window_scissor_in_frame(frame);
+    
+    // 2x2 image, nearest. Row 0 is the bottom.
+    u32 texels[4] = { 0xff0000ff, 0xff00ff00, 0xffff0000, 0xffffffff };
+    Gfx_Image *image = make_image(2, 2, 4, texels, get_heap_allocator());
+    draw_image_in_frame(image, v2(32, 32), v2(16, 16), COLOR_WHITE, frame);
+    
+    // Text quads take the alpha from the first channel
+    u8 coverage = 128;
+    Gfx_Image *glyph = make_image(1, 1, 1, &coverage, get_heap_allocator());
+    Draw_Quad *text = draw_image_in_frame(glyph, v2(48, 32), v2(16, 16), COLOR_WHITE, frame);
+    text->type = QUAD_TYPE_TEXT;
+    
+    // A trapezoid, which isn't drawn as a parallelogram
+    Draw_Quad *trapezoid = draw_rect_in_frame(v2(0, 0), v2(1, 1), v4(0, 1, 1, 1), frame);
+    float32 ndc = 2.0f/size;
+    trapezoid->bottom_left  = v2(-1 + 4*ndc,  -1 + 52*ndc);
+    trapezoid->top_left     = v2(-1 + 12*ndc, -1 + 60*ndc);
+    trapezoid->top_right    = v2(-1 + 20*ndc, -1 + 60*ndc);
+    trapezoid->bottom_right = v2(-1 + 28*ndc, -1 + 52*ndc);
+    
+    // Black to white, stretched with linear filtering
+    u32 gradient[2] = { 0xff000000, 0xffffffff };
+    Gfx_Image *gradient_image = make_image(2, 1, 4, gradient, get_heap_allocator());
+    Draw_Quad *stretched = draw_image_in_frame(gradient_image, v2(32, 48), v2(32, 16), COLOR_WHITE, frame);
+    stretched->image_mag_filter = GFX_FILTER_MODE_LINEAR;
+    
+    gfx_render_draw_frame(frame, target);
+    gfx_read_image_data(target, 0, 0, size, size, pixels);
+    
+    test_render_check_pixel(pixels, size, 8,  8,  255, 0,   0,   255);
+    test_render_check_pixel(pixels, size, 24, 8,  128, 0,   128, 255);
+    
+    for (u32 x = 32; x < 63; x++) {
+        test_render_check_pixel(pixels, size, x, 8, 128, 128, 128, 255);
+    }
+    test_render_check_pixel(pixels, size, 31, 8,  128, 0,   128, 255);
+    test_render_check_pixel(pixels, size, 63, 8,  0,   0,   0,   255);
+    test_render_check_pixel(pixels, size, 40, 3,  0,   0,   0,   255);
+    test_render_check_pixel(pixels, size, 40, 12, 0,   0,   0,   255);
+    
+    test_render_check_pixel(pixels, size, 16, 32, 0,   255, 0,   255);
+    test_render_check_pixel(pixels, size, 16, 46, 0,   255, 0,   255);
+    // In the circle's quad but not in the circle
+    test_render_check_pixel(pixels, size, 2,  18, 0,   0,   0,   255);
+    test_render_check_pixel(pixels, size, 29, 45, 0,   0,   0,   255);
+    
+    test_render_check_pixel(pixels, size, 40, 24, 255, 255, 0,   255);
+    
+    test_render_check_pixel(pixels, size, 56, 24, 255, 255, 255, 255);
+    test_render_check_pixel(pixels, size, 52, 20, 255, 255, 255, 255);
+    test_render_check_pixel(pixels, size, 59, 27, 255, 255, 255, 255);
+    test_render_check_pixel(pixels, size, 51, 24, 0,   0,   0,   255);
+    test_render_check_pixel(pixels, size, 60, 24, 0,   0,   0,   255);
+    test_render_check_pixel(pixels, size, 56, 19, 0,   0,   0,   255);
+    test_render_check_pixel(pixels, size, 56, 28, 0,   0,   0,   255);
+    
+    test_render_check_pixel(pixels, size, 36, 36, 255, 0,   0,   255);
+    test_render_check_pixel(pixels, size, 44, 36, 0,   255, 0,   255);
+    test_render_check_pixel(pixels, size, 36, 44, 0,   0,   255, 255);
+    test_render_check_pixel(pixels, size, 44, 44, 255, 255, 255, 255);
+    
+    test_render_check_pixel(pixels, size, 56, 40, 128, 128, 128, 255);
+    
+    test_render_check_pixel(pixels, size, 16, 56, 0,   255, 255, 255);
+    test_render_check_pixel(pixels, size, 14, 53, 0,   255, 255, 255);
+    test_render_check_pixel(pixels, size, 5,  59, 0,   0,   0,   255);
+    test_render_check_pixel(pixels, size, 26, 59, 0,   0,   0,   255);
+    
+    test_render_check_pixel(pixels, size, 36, 56, 0,   0,   0,   255);
+    test_render_check_pixel(pixels, size, 47, 56, 120, 120, 120, 255);
+    test_render_check_pixel(pixels, size, 48, 56, 135, 135, 135, 255);
+    test_render_check_pixel(pixels, size, 60, 56, 255, 255, 255, 255);
+    
+#if GFX_RENDERER == GFX_RENDERER_SOFTWARE
+    // Stress test sized frame
+    const u32 bench_width = 1280;
+    const u32 bench_height = 720;
+    const u64 quad_count = 100000;
+    Gfx_Image *bench_target = make_image_render_target(bench_width, bench_height, 4, 0, get_heap_allocator());
+    Gfx_Image *sprite = make_image(2, 2, 4, texels, get_heap_allocator());
+    draw_frame_reset(frame);
+    test_draw_frame_fill(frame, sprite, quad_count);
+    
+    const int samples = 10;
+    float64 start = os_get_elapsed_seconds();
+    for (int i = 0; i < samples; i++) gfx_render_draw_frame(frame, bench_target);
+    float64 seconds = (os_get_elapsed_seconds() - start)/samples;
+    print("\n    Software rendered %llu quads to %dx%d in %.3f ms (%d lanes, %llu threads)\n", quad_count, bench_width, bench_height, seconds*1000.0, SOFTWARE_LANES, parallel_for_get_thread_count());
+    
+    delete_image(sprite);
+    delete_image(bench_target);
+#endif
+    
+    delete_image(image);
+    delete_image(glyph);
+    delete_image(gradient_image);
+    delete_image(target);
+    dealloc(get_heap_allocator(), pixels);
+    growing_array_deinit((void**)&frame->quad_buffer);
+    draw_quad_streams_free(&frame->quad_streams);
+    dealloc(get_heap_allocator(), frame);
+}
+
+// Latin, Greek and Cyrillic subset of DejaVu Sans, with its kerning. See dejavu_sans_license.txt
+// next to it. Relative to the project root like the other test files.
+#define TEST_FONT_PATH "oogabooga/examples/dejavu_sans.ttf"
+Gfx_Font *test_load_font() {
+    Gfx_Font *font = load_font_from_disk(STR(TEST_FONT_PATH), get_heap_allocator());
+    assert(font, "Failed loading %s, tests need to run from the project root", STR(TEST_FONT_PATH));
+    return font;
+}
+
+void test_font_glyph_atlas() {
+    
+    Gfx_Font *font = test_load_font();
+    
+    // Nothing is rasterized until it's used
+    Gfx_Font_Atlas_Stats stats = get_font_atlas_stats(font);
+    assert(stats.atlas_count == 0 && stats.glyph_count == 0, "Failed: font has glyphs before any were used");
+    
+    // Glyphs of all heights go in the same atlas
+    u32 heights[3] = { 16, 32, 64 };
+    for (int i = 0; i < 3; i++) {
+        Gfx_Glyph *a = font_get_glyph(font, heights[i], 'A');
+        assert(a->has_pixels && a->atlas_index == 0, "Failed: 'A' at height %d is not in the first atlas", heights[i]);
+        Gfx_Glyph *space = font_get_glyph(font, heights[i], ' ');
+        assert(!space->has_pixels && space->advance > 0, "Failed: space at height %d", heights[i]);
+    }
+    stats = get_font_atlas_stats(font);
+    assert(stats.atlas_count == 1, "Failed: expected 1 atlas, got %llu", stats.atlas_count);
+    assert(stats.glyph_count == 3, "Failed: expected 3 glyphs, got %llu", stats.glyph_count);
+    
+    // Using it again doesn't rasterize it again
+    Gfx_Glyph *a16 = font_get_glyph(font, 16, 'A');
+    Gfx_Glyph *a16_again = font_get_glyph(font, 16, 'A');
+    assert(a16 == a16_again, "Failed: glyph lookup is not stable");
+    assert(get_font_atlas_stats(font).glyph_count == 3, "Failed: glyph was rasterized twice");
+    
+    // Codepoints outside the direct range go in the hash table
+    Gfx_Glyph *euro = font_get_glyph(font, 32, 0x20AC);
+    assert(euro->codepoint == 0x20AC, "Failed: wrong glyph for U+20AC");
+    
+    // Drawing text rasterizes what's missing, and rendering the frame uploads it once per atlas
+    u64 uploads_before = font->upload_count;
+    const u32 size = 64;
+    Gfx_Image *target = make_image_render_target(size, size, 4, 0, get_heap_allocator());
+    Draw_Frame *frame = alloc(get_heap_allocator(), sizeof(Draw_Frame));
+    draw_frame_init(frame);
+    draw_frame_reset(frame);
+    frame->projection = m4_make_orthographic_projection(0, size, 0, size, -1, 10);
+    draw_text_in_frame(font, STR("The quick brown fox jumps over the lazy dog"), 24, v2(0, 0), v2(1, 1), COLOR_WHITE, frame);
+    gfx_render_draw_frame(frame, target);
+    
+    stats = get_font_atlas_stats(font);
+    assert(stats.upload_count - uploads_before == stats.atlas_count, "Failed: expected %llu uploads, got %llu", stats.atlas_count, stats.upload_count - uploads_before);
+    
+    // Nothing new, nothing to upload
+    draw_frame_reset(frame);
+    draw_text_in_frame(font, STR("the lazy dog"), 24, v2(0, 0), v2(1, 1), COLOR_WHITE, frame);
+    gfx_render_draw_frame(frame, target);
+    assert(font->upload_count == stats.upload_count, "Failed: clean atlas was uploaded");
+    
+    // The atlas has what was rasterized
+    Gfx_Font_Atlas *atlas = &font->atlases[0];
+    u8 *gpu_pixels = alloc(get_heap_allocator(), FONT_ATLAS_WIDTH*FONT_ATLAS_HEIGHT);
+    gfx_read_image_data(atlas->image, 0, 0, FONT_ATLAS_WIDTH, FONT_ATLAS_HEIGHT, gpu_pixels);
+    assert(bytes_match(gpu_pixels, atlas->pixels, FONT_ATLAS_WIDTH*FONT_ATLAS_HEIGHT), "Failed: atlas image does not match the rasterized glyphs");
+    
+    // Rasterizing lots of glyphs, at lots of heights
+    float64 start = os_get_elapsed_seconds();
+    for (u32 height = 8; height <= 48; height += 4) {
+        for (u32 c = 32; c < 383; c++) font_get_glyph(font, height, c);
+    }
+    float64 seconds = os_get_elapsed_seconds() - start;
+    font_upload_dirty_atlases();
+    
+    stats = get_font_atlas_stats(font);
+    print("\n    Rasterized %llu glyphs in %.3f ms, %llu atlases at %.1f%% occupancy, %llu uploads of %llu pixels\n", stats.glyph_count, seconds*1000.0, stats.atlas_count, stats.occupancy*100.0, stats.upload_count, stats.uploaded_pixels);
+    assert(stats.occupancy > 0.25, "Failed: atlases are only %.1f%% full", stats.occupancy*100.0);
+    assert(stats.used_pixels <= stats.total_pixels, "Failed: more pixels used than there are");
+    
+    dealloc(get_heap_allocator(), gpu_pixels);
+    delete_image(target);
+    growing_array_deinit((void**)&frame->quad_buffer);
+    draw_quad_streams_free(&frame->quad_streams);
+    dealloc(get_heap_allocator(), frame);
+    destroy_font(font);
+}
+
+// Pixels where the text is more than half covered
+u64 test_font_count_covered_pixels(Gfx_Font *font, string text, u32 raster_height, Gfx_Image *target, u32 *pixels) {
+    Draw_Frame *frame = alloc(get_heap_allocator(), sizeof(Draw_Frame));
+    draw_frame_init(frame);
+    draw_frame_reset(frame);
+    frame->projection = m4_make_orthographic_projection(0, target->width, 0, target->height, -1, 10);
+    
+    gfx_clear_render_target(target, v4(0, 0, 0, 1));
+    draw_text_in_frame(font, text, raster_height, v2(4, 16), v2(1, 1), COLOR_WHITE, frame);
+    gfx_render_draw_frame(frame, target);
+    gfx_read_image_data(target, 0, 0, target->width, target->height, pixels);
+    
+    u64 covered = 0;
+    for (u64 i = 0; i < (u64)target->width*target->height; i++) {
+        if ((pixels[i] & 0xff) > 128) covered += 1;
+    }
+    
+    growing_array_deinit((void**)&frame->quad_buffer);
+    draw_quad_streams_free(&frame->quad_streams);
+    dealloc(get_heap_allocator(), frame);
+    return covered;
+}
+void test_font_sdf() {
+    
+    Gfx_Font *font = test_load_font();
+    Gfx_Font *sdf_font = test_load_font();
+    font_enable_sdf(sdf_font, FONT_SDF_DEFAULT_REFERENCE_HEIGHT);
+    
+    const u32 width = 512;
+    const u32 height = 128;
+    Gfx_Image *target = make_image_render_target(width, height, 4, 0, get_heap_allocator());
+    u32 *pixels = alloc(get_heap_allocator(), width*height*sizeof(u32));
+    
+    string text = STR("Hello, Sailor!");
+    
+    // Every height is drawn from the same glyphs
+    u32 heights[4] = { 24, 48, 64, 96 };
+    u64 glyph_count = 0;
+    for (int i = 0; i < 4; i++) {
+        u64 covered     = test_font_count_covered_pixels(font, text, heights[i], target, pixels);
+        u64 sdf_covered = test_font_count_covered_pixels(sdf_font, text, heights[i], target, pixels);
+        
+        // Same text, about the same amount of ink
+        float64 ratio = (float64)sdf_covered/(float64)covered;
+        assert(ratio > 0.85 && ratio < 1.15, "Failed: SDF text at height %d covers %llu pixels, normal text covers %llu", heights[i], sdf_covered, covered);
+        
+        Gfx_Font_Atlas_Stats stats = get_font_atlas_stats(sdf_font);
+        if (i == 0) glyph_count = stats.glyph_count;
+        assert(stats.glyph_count == glyph_count, "Failed: SDF font rasterized glyphs for height %d", heights[i]);
+    }
+    assert(sdf_font->variations[FONT_SDF_DEFAULT_REFERENCE_HEIGHT].initted, "Failed: SDF glyphs are not at the reference height");
+    
+    // Metrics are the same as the normal font's
+    Gfx_Text_Metrics m = measure_text(font, text, 64, v2(1, 1));
+    Gfx_Text_Metrics sdf_m = measure_text(sdf_font, text, 64, v2(1, 1));
+    float32 advance = m.functional_size.x;
+    float32 sdf_advance = sdf_m.functional_size.x;
+    assert(fabs(advance - sdf_advance) < advance*0.05f, "Failed: SDF text is %f wide, normal text is %f", sdf_advance, advance);
+    
+    // Glyphs made on parallel_for threads are the same as ones made one by one
+    u32 codepoints[351];
+    for (u32 i = 0; i < 351; i++) codepoints[i] = 32 + i;
+    Gfx_Font *serial_font = test_load_font();
+    Gfx_Font *parallel_font = test_load_font();
+    font_enable_sdf(serial_font, FONT_SDF_DEFAULT_REFERENCE_HEIGHT);
+    font_enable_sdf(parallel_font, FONT_SDF_DEFAULT_REFERENCE_HEIGHT);
+    
+    float64 start = os_get_elapsed_seconds();
+    for (u32 i = 0; i < 351; i++) font_get_glyph(serial_font, 32, codepoints[i]);
+    float64 serial_seconds = os_get_elapsed_seconds() - start;
+    
+    start = os_get_elapsed_seconds();
+    font_rasterize_glyphs(parallel_font, 32, codepoints, 351);
+    float64 parallel_seconds = os_get_elapsed_seconds() - start;
+    
+    for (u32 i = 0; i < 351; i++) {
+        Gfx_Glyph a = *font_get_glyph(serial_font, 32, codepoints[i]);
+        Gfx_Glyph b = *font_get_glyph(parallel_font, 32, codepoints[i]);
+        assert(bytes_match(&a, &b, sizeof(Gfx_Glyph)), "Failed: glyph %d differs when made in parallel", codepoints[i]);
+    }
+    assert(bytes_match(serial_font->atlases[0].pixels, parallel_font->atlases[0].pixels, FONT_ATLAS_WIDTH*FONT_ATLAS_HEIGHT), "Failed: atlas differs when made in parallel");
+    
+    print("\n    %d SDF glyphs one by one in %.3f ms, with font_rasterize_glyphs in %.3f ms (%llu threads)\n", 351, serial_seconds*1000.0, parallel_seconds*1000.0, parallel_for_get_thread_count());
+    
+    destroy_font(serial_font);
+    destroy_font(parallel_font);
+    dealloc(get_heap_allocator(), pixels);
+    delete_image(target);
+    destroy_font(font);
+    destroy_font(sdf_font);
+}
+
+void test_text_layout_cache() {
+    
+    Gfx_Font *font = test_load_font();
+    
+    text_layout_cache_clear();
+    
+    // Like the tooltips in alchemist
+    string text = STR("Philosopher's Stone\nTurns lead into gold. Handle with care.");
+    u32 raster_height = 32;
+    Vector2 scale = v2(0.1, 0.1);
+    
+    u64 hits = text_layout_cache.hit_count;
+    u64 misses = text_layout_cache.miss_count;
+    
+    Gfx_Text_Metrics m = measure_text(font, text, raster_height, scale);
+    Gfx_Text_Metrics uncached_m = measure_text_uncached(font, text, raster_height, scale);
+    assert(bytes_match(&m, &uncached_m, sizeof(Gfx_Text_Metrics)), "Failed: cached metrics differ from walked metrics");
+    assert(text_layout_cache.miss_count == misses+1 && text_layout_cache.hit_count == hits, "Failed: first measure should miss");
+    
+    // Same quads as walking the glyphs
+    Draw_Frame *cached = alloc(get_heap_allocator(), sizeof(Draw_Frame));
+    Draw_Frame *walked = alloc(get_heap_allocator(), sizeof(Draw_Frame));
+    draw_frame_init(cached);
+    draw_frame_init(walked);
+    draw_frame_reset(cached);
+    draw_frame_reset(walked);
+    
+    Vector2 position = v2(-50, 10);
+    draw_text_in_frame(font, text, raster_height, position, scale, COLOR_WHITE, cached);
+    assert(text_layout_cache.hit_count == hits+1, "Failed: drawing measured text should hit");
+    
+    Draw_Text_Callback_Params p = ZERO(Draw_Text_Callback_Params);
+    p.font = font;
+    p.text = text;
+    p.raster_height = raster_height;
+    p.xform = m4_translate(m4_scalar(1.0), v3(position.x, position.y, 0));
+    p.scale = scale;
+    p.color = COLOR_WHITE;
+    p.frame = walked;
+    walk_glyphs((Walk_Glyphs_Spec){font, text, raster_height, scale, true, &p, 0}, draw_text_callback);
+    
+    u64 count = draw_frame_get_quad_count(walked);
+    assert(count > 0, "Failed: no text quads");
+    assert(draw_frame_get_quad_count(cached) == count, "Failed: cached text has %llu quads, expected %llu", draw_frame_get_quad_count(cached), count);
+    draw_frame_flush_pending_quad(cached);
+    draw_frame_flush_pending_quad(walked);
+    for (u64 i = 0; i < count; i++) {
+        Draw_Quad *a = &cached->quad_buffer[i];
+        Draw_Quad *b = &walked->quad_buffer[i];
+        assert(memcmp(&a->bottom_left, &b->bottom_left, sizeof(Vector2)*4) == 0, "Failed: corners differ at %llu", i);
+        assert(memcmp(&a->uv, &b->uv, sizeof(Vector4)) == 0, "Failed: uvs differ at %llu", i);
+        assert(a->image == b->image && a->type == b->type, "Failed: quads differ at %llu", i);
+    }
+    
+    // Anything else in the key is another layout
+    measure_text(font, text, raster_height+1, scale);
+    measure_text(font, text, raster_height, v2(0.2, 0.1));
+    measure_text(font, STR("Philosopher's Stone"), raster_height, scale);
+    assert(text_layout_cache.miss_count == misses+4, "Failed: expected 4 misses, got %llu", text_layout_cache.miss_count-misses);
+    
+    // Least recently used layouts are thrown out when the cache is full
+    measure_text(font, text, raster_height, scale);
+    u64 evictions = text_layout_cache.eviction_count;
+    for (u64 i = 0; i < TEXT_LAYOUT_CACHE_CAPACITY; i++) {
+        measure_text(font, tprint("Potion #%llu", i), raster_height, scale);
+    }
+    assert(text_layout_cache.count == TEXT_LAYOUT_CACHE_CAPACITY, "Failed: cache has %llu layouts", text_layout_cache.count);
+    assert(text_layout_cache.eviction_count - evictions == 4, "Failed: expected 4 evictions, got %llu", text_layout_cache.eviction_count - evictions);
+    u64 misses_before = text_layout_cache.miss_count;
+    measure_text(font, tprint("Potion #%llu", TEXT_LAYOUT_CACHE_CAPACITY-1), raster_height, scale);
+    assert(text_layout_cache.miss_count == misses_before, "Failed: recently used layout was thrown out");
+    measure_text(font, text, raster_height, scale);
+    assert(text_layout_cache.miss_count == misses_before+1, "Failed: least recently used layout was kept");
+    
+    // Measure & draw every frame, like a tooltip
+    const u64 frames = 2000;
+    draw_frame_reset(cached);
+    float64 start = os_get_elapsed_seconds();
+    for (u64 i = 0; i < frames; i++) {
+        draw_frame_reset(walked);
+        measure_text_uncached(font, text, raster_height, scale);
+        walk_glyphs((Walk_Glyphs_Spec){font, text, raster_height, scale, true, &p, 0}, draw_text_callback);
+    }
+    float64 walked_seconds = os_get_elapsed_seconds() - start;
+    start = os_get_elapsed_seconds();
+    for (u64 i = 0; i < frames; i++) {
+        draw_frame_reset(cached);
+        measure_text(font, text, raster_height, scale);
+        draw_text_in_frame(font, text, raster_height, position, scale, COLOR_WHITE, cached);
+    }
+    float64 cached_seconds = os_get_elapsed_seconds() - start;
+    print("\n    Measure & draw %llu chars: walked %.2f us, cached %.2f us\n", text.count, walked_seconds*1000000.0/frames, cached_seconds*1000000.0/frames);
+    
+    // Destroying the font throws out its layouts
+    destroy_font(font);
+    assert(text_layout_cache.count == 0, "Failed: %llu layouts left after destroy_font", text_layout_cache.count);
+    
+    growing_array_deinit((void**)&cached->quad_buffer);
+    growing_array_deinit((void**)&walked->quad_buffer);
+    draw_quad_streams_free(&cached->quad_streams);
+    draw_quad_streams_free(&walked->quad_streams);
+    dealloc(get_heap_allocator(), cached);
+    dealloc(get_heap_allocator(), walked);
+}
+
+bool test_font_count_glyph_callback(Gfx_Glyph glyph, Gfx_Font_Atlas *atlas, float glyph_x, float glyph_y, void *ud) {
+    return true;
+}
+void test_font_kerning() {
+    
+    Gfx_Font *font = test_load_font();
+    
+    // Same as asking stbtt, for latin pairs and others, twice so the remembered ones are checked
+    u32 codepoints[] = { 'A', 'V', 'T', 'o', 'y', '.', ',', 'W', 'a', 0xC5, 0xE9, 0x0416, 0x03A9, 0x20AC, 'L', '\'' };
+    u64 codepoint_count = sizeof(codepoints)/sizeof(codepoints[0]);
+    bool any_kerning = false;
+    for (int pass = 0; pass < 2; pass++) {
+        for (u64 i = 0; i < codepoint_count; i++) {
+            for (u64 j = 0; j < codepoint_count; j++) {
+                s32 expected = stbtt_GetCodepointKernAdvance(&font->stbtt_handle, codepoints[i], codepoints[j]);
+                s32 got = font_get_kerning(font, codepoints[i], codepoints[j]);
+                assert(got == expected, "Failed: kerning of %d, %d is %d, expected %d", codepoints[i], codepoints[j], got, expected);
+                if (got != 0) any_kerning = true;
+            }
+        }
+    }
+    if (font->has_kerning) assert(any_kerning, "Failed: font has kerning but no pair was kerned");
+    
+    // About 100 KB of paragraphs
+    string paragraph = STR("The alchemist ground the powder, poured it into the flask and waited. \"AVAST! To work,\" said Walter, eyeing the yellow fumes. Voilà, café au lait, naïve façade.\n");
+    u64 paragraph_count = 102400/paragraph.count + 1;
+    string text = alloc_string(get_heap_allocator(), paragraph.count*paragraph_count);
+    for (u64 i = 0; i < paragraph_count; i++) memcpy(text.data + i*paragraph.count, paragraph.data, paragraph.count);
+    
+    u64 pair_count = 0;
+    float64 start = os_get_elapsed_seconds();
+    {
+        string s = text;
+        u32 last_c = 0;
+        u32 c = next_utf8(&s);
+        while (c != 0) {
+            if (last_c != 0) {
+                stbtt_GetCodepointKernAdvance(&font->stbtt_handle, last_c, c);
+                pair_count += 1;
+            }
+            last_c = c;
+            c = next_utf8(&s);
+        }
+    }
+    float64 stbtt_seconds = os_get_elapsed_seconds() - start;
+    
+    // First time looks up and remembers every pair
+    Gfx_Font *fresh_font = test_load_font();
+    start = os_get_elapsed_seconds();
+    walk_glyphs((Walk_Glyphs_Spec){fresh_font, text, 20, v2(1, 1), false, 0, 0}, test_font_count_glyph_callback);
+    float64 cold_walk_seconds = os_get_elapsed_seconds() - start;
+    start = os_get_elapsed_seconds();
+    walk_glyphs((Walk_Glyphs_Spec){fresh_font, text, 20, v2(1, 1), false, 0, 0}, test_font_count_glyph_callback);
+    float64 warm_walk_seconds = os_get_elapsed_seconds() - start;
+    
+    reset_temporary_storage();
+    start = os_get_elapsed_seconds();
+    string *cold_lines = split_text_to_lines_with_wrapping(text, 400, fresh_font, 20, v2(1, 1), true);
+    float64 cold_seconds = os_get_elapsed_seconds() - start;
+    u64 line_count = growing_array_get_valid_count(cold_lines);
+    
+    reset_temporary_storage();
+    start = os_get_elapsed_seconds();
+    string *warm_lines = split_text_to_lines_with_wrapping(text, 400, fresh_font, 20, v2(1, 1), true);
+    float64 warm_seconds = os_get_elapsed_seconds() - start;
+    assert(growing_array_get_valid_count(warm_lines) == line_count, "Failed: wrapping changed after kerning was remembered");
+    assert(line_count > paragraph_count, "Failed: expected the paragraphs to wrap, got %llu lines", line_count);
+    reset_temporary_storage();
+    
+    print("\n    %llu bytes, %llu pairs. stbtt kerning %.2f ms. walk_glyphs: first time %.2f ms, after %.2f ms\n", text.count, pair_count, stbtt_seconds*1000.0, cold_walk_seconds*1000.0, warm_walk_seconds*1000.0);
+    print("    split_text_to_lines_with_wrapping to %llu lines: first time %.2f ms, after %.2f ms\n", line_count, cold_seconds*1000.0, warm_seconds*1000.0);
+    
+    dealloc_string(get_heap_allocator(), text);
+    destroy_font(fresh_font);
+    destroy_font(font);
+}
+
+void test_text_wrapping() {
+    
+    Gfx_Font *font = test_load_font();
+    
+    reset_temporary_storage();
+    
+    string *lines = split_text_to_lines_with_wrapping(STR("abc\n"), 1000, font, 20, v2(1, 1), false);
+    assert(growing_array_get_valid_count(lines) == 2, "Failed: expected 2 lines, got %d", growing_array_get_valid_count(lines));
+    assert(strings_match(lines[0], STR("abc")) && lines[1].count == 0, "Failed: wrong lines for 'abc\\n'");
+    
+    lines = split_text_to_lines_with_wrapping(STR(""), 1000, font, 20, v2(1, 1), false);
+    assert(growing_array_get_valid_count(lines) == 0, "Failed: empty text has lines");
+    
+    // Breaks at the last space, or in the word if there is no space
+    float32 word_width = measure_text(font, STR("transmutation"), 20, v2(1, 1)).functional_size.x;
+    lines = split_text_to_lines_with_wrapping(STR("lead gold transmutation"), word_width*1.1, font, 20, v2(1, 1), true);
+    assert(growing_array_get_valid_count(lines) == 2, "Failed: expected 2 lines, got %d", growing_array_get_valid_count(lines));
+    assert(strings_match(lines[0], STR("lead gold")) && strings_match(lines[1], STR("transmutation")), "Failed: wrong break");
+    lines = split_text_to_lines_with_wrapping(STR("transmutation"), word_width*0.5, font, 20, v2(1, 1), true);
+    assert(growing_array_get_valid_count(lines) >= 2, "Failed: long word was not broken");
+    
+    // About 100 KB of paragraphs, some of it not ascii
+    string paragraph = STR("The alchemist ground the powder, poured it into the flask and waited. Voilà, café au lait, naïve façade, Ωμέγα. A_very_long_word_without_any_spaces_that_has_to_be_broken_somewhere_in_the_middle.\n");
+    u64 paragraph_count = 102400/paragraph.count + 1;
+    string text = alloc_string(get_heap_allocator(), paragraph.count*paragraph_count);
+    for (u64 i = 0; i < paragraph_count; i++) memcpy(text.data + i*paragraph.count, paragraph.data, paragraph.count);
+    
+    float32 width = 300;
+    float64 start = os_get_elapsed_seconds();
+    lines = split_text_to_lines_with_wrapping(text, width, font, 20, v2(1, 1), false);
+    float64 split_seconds = os_get_elapsed_seconds() - start;
+    u64 line_count = growing_array_get_valid_count(lines);
+    assert(line_count > paragraph_count*2, "Failed: expected the paragraphs to wrap, got %llu lines", line_count);
+    
+    for (u64 i = 0; i < line_count; i++) {
+        assert(lines[i].count == 0 || (lines[i].data[0] & 0xC0) != 0x80, "Failed: line %llu starts in the middle of a character", i);
+    }
+    
+    // Wrapping as lines are needed gives the same lines
+    Wrapped_Text *wrapped = make_wrapped_text(font, 20, v2(1, 1), width, get_heap_allocator());
+    wrapped_text_set_text(wrapped, text);
+    
+    const u64 visible_line_count = 40;
+    u64 first_line = line_count/2;
+    start = os_get_elapsed_seconds();
+    for (u64 i = first_line; i < first_line+visible_line_count; i++) wrapped_text_get_line(wrapped, i);
+    float64 first_view_seconds = os_get_elapsed_seconds() - start;
+    assert(wrapped_text_get_line_count_so_far(wrapped) < line_count, "Failed: wrapped all text to get the middle lines");
+    
+    const u64 scroll_count = 1000;
+    start = os_get_elapsed_seconds();
+    for (u64 scroll = 0; scroll < scroll_count; scroll++) {
+        u64 first = (first_line*scroll)/scroll_count;
+        for (u64 i = first; i < first+visible_line_count; i++) wrapped_text_get_line(wrapped, i);
+    }
+    float64 scroll_seconds = (os_get_elapsed_seconds() - start)/scroll_count;
+    
+    assert(wrapped_text_get_line_count(wrapped) == line_count, "Failed: Wrapped_Text has %llu lines, expected %llu", wrapped_text_get_line_count(wrapped), line_count);
+    for (u64 i = 0; i < line_count; i++) {
+        assert(strings_match(wrapped_text_get_line(wrapped, i), lines[i]), "Failed: line %llu differs", i);
+    }
+    assert(!wrapped_text_wrap_lines(wrapped, line_count+1), "Failed: wrapped past the end");
+    
+    // Appended to, like a chat log
+    string first_half = string_view(text, 0, text.count/2 + 7);
+    wrapped_text_set_text(wrapped, first_half);
+    wrapped_text_get_line_count(wrapped);
+    wrapped_text_set_text_appended(wrapped, text);
+    assert(wrapped_text_get_line_count(wrapped) == line_count, "Failed: appended Wrapped_Text has %llu lines, expected %llu", wrapped_text_get_line_count(wrapped), line_count);
+    for (u64 i = 0; i < line_count; i++) {
+        assert(strings_match(wrapped_text_get_line(wrapped, i), lines[i]), "Failed: appended line %llu differs", i);
+    }
+    
+    print("\n    Wrapped %llu bytes to %llu lines in %.2f ms. Wrapped_Text: %llu lines in the middle %.2f ms, scrolling %.2f us\n", text.count, line_count, split_seconds*1000.0, visible_line_count, first_view_seconds*1000.0, scroll_seconds*1000000.0);
+    
+    reset_temporary_storage();
+    destroy_wrapped_text(wrapped);
+    dealloc_string(get_heap_allocator(), text);
+    destroy_font(font);
+}
+void test_font_baking() {
+    
+    Gfx_Font *font = test_load_font();
+    Gfx_Font *background_font = test_load_font();
+    font_enable_background_baking(background_font);
+    
+    const u32 width = 512;
+    const u32 height = 128;
+    Gfx_Image *target = make_image_render_target(width, height, 4, 0, get_heap_allocator());
+    u32 *pixels = alloc(get_heap_allocator(), width*height*sizeof(u32));
+    
+    string text = STR("Hello, Sailor!");
+    
+    // Not drawn until the glyphs are baked, but laid out like they're there
+    Gfx_Text_Metrics m = measure_text(font, text, 32, v2(1, 1));
+    Gfx_Text_Metrics background_m = measure_text(background_font, text, 32, v2(1, 1));
+    assert(bytes_match(&m, &background_m, sizeof(Gfx_Text_Metrics)), "Failed: text with pending glyphs is measured differently");
+    assert(font_get_glyph(background_font, 32, 'H')->is_pending, "Failed: glyph was not baked in the background");
+    
+    u64 covered = test_font_count_covered_pixels(font, text, 32, target, pixels);
+    u64 pending_covered = test_font_count_covered_pixels(background_font, text, 32, target, pixels);
+    assert(pending_covered == 0, "Failed: %llu pixels drawn with glyphs that are not baked yet", pending_covered);
+    
+    font_wait_for_background_glyphs(background_font);
+    Gfx_Glyph *glyph = font_get_glyph(background_font, 32, 'H');
+    assert(!glyph->is_pending && glyph->has_pixels, "Failed: glyph was not baked after waiting");
+    
+    // The cached layout with pending glyphs is made again
+    u64 baked_covered = test_font_count_covered_pixels(background_font, text, 32, target, pixels);
+    assert(baked_covered == covered, "Failed: baked in the background covers %llu pixels, expected %llu", baked_covered, covered);
+    
+    // Destroying a font while its glyphs are baking
+    Gfx_Font *destroyed_font = test_load_font();
+    font_enable_background_baking(destroyed_font);
+    render_atlas_if_not_yet_rendered(destroyed_font, 64, 'A');
+    destroy_font(destroyed_font);
+    font_finish_background_glyphs();
+    
+    // Baked font file has the same glyphs, and loading it doesn't rasterize anything
+    u32 codepoints[351];
+    for (u32 i = 0; i < 351; i++) codepoints[i] = 32 + i;
+    u32 heights[3] = { 16, 32, 64 };
+    
+    float64 start = os_get_elapsed_seconds();
+    Gfx_Font *ttf_font = test_load_font();
+    for (int i = 0; i < 3; i++) font_rasterize_glyphs(ttf_font, heights[i], codepoints, 351);
+    float64 ttf_seconds = os_get_elapsed_seconds() - start;
+    
+    string baked_path = STR("oogabooga_test_font.ogbfont");
+    bool saved = save_baked_font(ttf_font, baked_path);
+    assert(saved, "Failed: could not save baked font");
+    
+    start = os_get_elapsed_seconds();
+    Gfx_Font *baked_font = load_font_from_disk(baked_path, get_heap_allocator());
+    float64 baked_seconds = os_get_elapsed_seconds() - start;
+    assert(baked_font, "Failed: could not load baked font");
+    
+    Gfx_Font_Atlas_Stats stats = get_font_atlas_stats(ttf_font);
+    Gfx_Font_Atlas_Stats baked_stats = get_font_atlas_stats(baked_font);
+    assert(baked_stats.atlas_count == stats.atlas_count && baked_stats.glyph_count == stats.glyph_count, "Failed: baked font has %llu glyphs in %llu atlases, expected %llu in %llu", baked_stats.glyph_count, baked_stats.atlas_count, stats.glyph_count, stats.atlas_count);
+    
+    for (int i = 0; i < 3; i++) {
+        for (u32 j = 0; j < 351; j++) {
+            Gfx_Glyph a = *font_get_glyph(ttf_font, heights[i], codepoints[j]);
+            Gfx_Glyph b = *font_get_glyph(baked_font, heights[i], codepoints[j]);
+            assert(bytes_match(&a, &b, sizeof(Gfx_Glyph)), "Failed: baked glyph %d at height %d differs", codepoints[j], heights[i]);
+        }
+    }
+    baked_stats = get_font_atlas_stats(baked_font);
+    assert(baked_stats.glyph_count == stats.glyph_count, "Failed: baked font rasterized glyphs");
+    for (u64 i = 0; i < stats.atlas_count; i++) {
+        assert(bytes_match(ttf_font->atlases[i].pixels, baked_font->atlases[i].pixels, FONT_ATLAS_WIDTH*FONT_ATLAS_HEIGHT), "Failed: baked atlas %llu differs", i);
+    }
+    
+    u64 ttf_covered = test_font_count_covered_pixels(ttf_font, text, 32, target, pixels);
+    u64 baked_font_covered = test_font_count_covered_pixels(baked_font, text, 32, target, pixels);
+    assert(ttf_covered == baked_font_covered, "Failed: baked font covers %llu pixels, expected %llu", baked_font_covered, ttf_covered);
+    
+    // Glyphs that are not in the file are rasterized like normal
+    Gfx_Glyph *new_glyph = font_get_glyph(baked_font, 20, 'A');
+    assert(new_glyph->has_pixels, "Failed: glyph not in the baked font was not rasterized");
+    
+    print("\n    %d glyphs at %d heights: loading the .ttf and rasterizing %.3f ms, loading the baked font %.3f ms\n", 351, 3, ttf_seconds*1000.0, baked_seconds*1000.0);
+    
+    // Corrupt SDF reference heights are rejected instead of indexing out of the variations
+    string baked_file;
+    bool read = os_read_entire_file(baked_path, &baked_file, get_heap_allocator());
+    assert(read, "Failed: could not read baked font");
+    Baked_Font_Header *baked_header = (Baked_Font_Header*)baked_file.data;
+    u32 bad_heights[2] = { MAX_FONT_HEIGHT, FONT_SDF_DEFAULT_REFERENCE_HEIGHT }; // Too big, not the height of the glyphs
+    for (int i = 0; i < 2; i++) {
+        baked_header->sdf_reference_height = bad_heights[i];
+        bool wrote = os_write_entire_file(baked_path, baked_file);
+        assert(wrote, "Failed: could not write corrupt baked font");
+        assert(!load_font_from_disk(baked_path, get_heap_allocator()), "Failed: loaded a baked font with SDF reference height %d", bad_heights[i]);
+    }
+    dealloc_string(get_heap_allocator(), baked_file);
+    os_file_delete(baked_path);
+    
+    // Not a baked font
+    string broken = alloc_string(get_heap_allocator(), 64);
+    memset(broken.data, 0, broken.count);
+    *(u32*)broken.data = BAKED_FONT_MAGIC;
+    bool wrote = os_write_entire_file(baked_path, broken);
+    assert(wrote, "Failed: could not write broken baked font");
+    assert(!load_font_from_disk(baked_path, get_heap_allocator()), "Failed: loaded a broken baked font");
+    os_file_delete(baked_path);
+    dealloc_string(get_heap_allocator(), broken);
+    
+    destroy_font(ttf_font);
+    destroy_font(baked_font);
+    dealloc(get_heap_allocator(), pixels);
+    delete_image(target);
+    destroy_font(font);
+    destroy_font(background_font);
 }
 #endif /* OOGABOOGA_HEADLESS */
 
@@ -1570,7 +4366,7 @@ void test_growing_array() {
 
 typedef struct {
     Binary_Semaphore *sem;
-    volatile LONG *counter;
+    volatile u32 *counter;
     int increments;
 } Test_Args;
 
@@ -1578,7 +4374,10 @@ void increment_thread_proc(Thread *t) {
     Test_Args *test_args = (Test_Args *)t->data;
     for (int i = 0; i < test_args->increments; i++) {
         os_binary_semaphore_wait(test_args->sem);
-        InterlockedIncrement(test_args->counter);
+        u32 old;
+        do {
+            old = *test_args->counter;
+        } while (!compare_and_swap_32(test_args->counter, old+1, old));
         os_binary_semaphore_signal(test_args->sem);
     }
 }
@@ -1591,7 +4390,7 @@ void test_os_binary_semaphore() {
         Binary_Semaphore sem;
         os_binary_semaphore_init(&sem, true);
 
-        LONG counter = 0;
+        u32 counter = 0;
         Thread threads[num_threads];
         Test_Args args = { &sem, &counter, increments_per_thread };
 
@@ -1616,7 +4415,7 @@ void test_os_binary_semaphore() {
         Binary_Semaphore sem;
         os_binary_semaphore_init(&sem, false);
 
-        LONG counter = 0;
+        u32 counter = 0;
 
         Thread thread;
         Test_Args args = { &sem, &counter, 1 };
@@ -1625,7 +4424,7 @@ void test_os_binary_semaphore() {
         os_thread_start(&thread);
 
         // Signal the semaphore after a delay
-        Sleep(100);
+        os_sleep(100);
         os_binary_semaphore_signal(&sem);
 
         os_thread_join(&thread);
@@ -1644,7 +4443,7 @@ void test_os_binary_semaphore() {
         Binary_Semaphore sem;
         os_binary_semaphore_init(&sem, true);
 
-        LONG counter = 0;
+        u32 counter = 0;
         Thread threads[num_threads];
         Test_Args args = { &sem, &counter, increments_per_thread };
 
@@ -1669,7 +4468,7 @@ void test_os_binary_semaphore() {
         Binary_Semaphore sem;
         os_binary_semaphore_init(&sem, false);
 
-        LONG counter = 0;
+        u32 counter = 0;
 
         Thread thread1, thread2;
         Test_Args args1 = { &sem, &counter, 1 };
@@ -1708,6 +4507,26 @@ void oogabooga_run_tests() {
 	test_allocator(true);
 	print("OK!\n");
 	
+	print("Testing heap speed... ");
+	test_heap_speed();
+	print("OK!\n");
+	
+	print("Testing heap realloc... ");
+	test_heap_realloc();
+	print("OK!\n");
+	
+	print("Testing arena... ");
+	test_arena();
+	print("OK!\n");
+	
+	print("Testing temporary storage... ");
+	test_temporary_storage();
+	print("OK!\n");
+	
+	print("Testing threaded heap... ");
+	test_heap_threaded();
+	print("OK!\n");
+	
 	print("Testing threads... ");
 	test_threads();
 	print("OK!\n");
@@ -1732,10 +4551,18 @@ void oogabooga_run_tests() {
 	test_simd();
 	print("OK!\n");
 	
+	print("Testing radix sort keys... ");
+	test_radix_sort_keys();
+	print("OK!\n");
+	
 	print("Testing hash table... ");
 	test_hash_table();
 	print("OK!\n");
 	
+	print("Testing hash speed... ");
+	test_hash_speed();
+	print("OK!\n");
+	
 	print("Testing random distribution... ");
 	test_random_distribution();
 	print("OK!\n");
@@ -1747,11 +4574,91 @@ void oogabooga_run_tests() {
 	print("Testing binary semaphore... ");
 	test_os_binary_semaphore();
 	print("OK!\n");
+	
+	print("Testing quad packing... ");
+	test_gfx_pack();
+	print("OK!\n");
+	
+	print("Testing tilemap... ");
+	test_tilemap();
+	print("OK!\n");
+	
+	print("Testing render target pool... ");
+	test_render_target_pool();
+	print("OK!\n");
+	
+	print("Testing shader cache... ");
+	test_shader_cache();
+	print("OK!\n");
 
 #ifndef OOGABOOGA_HEADLESS
+	// The drawing tests cull and snap against the window, which has no size until the first
+	// os_update. Give them one and put the window back after so entry still sets it up.
+	Os_Window window_before_tests = window;
+	window.pixel_width = 1280;
+	window.pixel_height = 720;
+	
 	print("Testing radix sort... ");
 	test_sort();
 	print("OK!\n");
+	
+	print("Testing draw frame quad layouts... ");
+	test_draw_frame_quad_layouts();
+	print("OK!\n");
+	
+	print("Testing draw frame z sorting... ");
+	test_draw_frame_z_sorting();
+	print("OK!\n");
+	
+	print("Testing pixel snapping... ");
+	test_draw_pixel_snapping();
+	print("OK!\n");
+	
+	print("Testing batched image drawing... ");
+	test_draw_images_xform_batch();
+	print("OK!\n");
+	
+	print("Testing draw lists... ");
+	test_draw_list();
+	print("OK!\n");
+	
+	print("Testing tilemap drawing... ");
+	test_draw_tilemap();
+	print("OK!\n");
+	
+	print("Testing sprite atlas... ");
+	test_sprite_atlas();
+	print("OK!\n");
+	
+	print("Testing rendering to image... ");
+	test_render_to_image();
+	print("OK!\n");
+	
+	print("Testing font glyph atlas... ");
+	test_font_glyph_atlas();
+	print("OK!\n");
+	
+	print("Testing SDF fonts... ");
+	test_font_sdf();
+	print("OK!\n");
+	
+	print("Testing text layout cache... ");
+	test_text_layout_cache();
+	print("OK!\n");
+	
+	print("Testing font kerning... ");
+	test_font_kerning();
+	print("OK!\n");
+	
+	print("Testing text wrapping... ");
+	test_text_wrapping();
+	print("OK!\n");
+	
+	print("Testing font baking... ");
+	test_font_baking();
+	print("OK!\n");
+	
+	window = window_before_tests;
 #endif
 
 	
@@ -4413,7 +4413,7 @@ static void vorbis_init(stb_vorbis *p, const stb_vorbis_alloc *z)
    p->page_crc_tests = -1;
    #ifndef STB_VORBIS_NO_STDIO
    p->close_on_free = FALSE;
-   p->f = NULL;
+   p->f = (File)0; // File is an int fd on linux
    #endif
 }
 
@@ -5487,7 +5487,7 @@ int stb_vorbis_decode_filename(const char *filename, int *channels, int *sample_
       if (offset + limit > total) {
          short *data2;
          total *= 2;
-         data2 = (short *) third_party_realloc(data, total * sizeof(*data)); // #Modified (realloc -> third_party_realloc) Charlie Malmqvist 2024-07-14
+         data2 = (short *) third_party_realloc(data, (total/2) * sizeof(*data), total * sizeof(*data)); // #Modified (realloc -> third_party_realloc) Charlie Malmqvist 2024-07-14, old size passed for allocators that can't reallocate
          if (data2 == NULL) {
             third_party_free(data); // #Modified (free -> third_party_free) Charlie Malmqvist 2024-07-14
             stb_vorbis_close(v);
@@ -5527,7 +5527,7 @@ int stb_vorbis_decode_memory(const uint8 *mem, int len, int *channels, int *samp
       if (offset + limit > total) {
          short *data2;
          total *= 2;
-         data2 = (short *) third_party_realloc(data, total * sizeof(*data)); // #Modified (realloc -> third_party_realloc) Charlie Malmqvist 2024-07-14
+         data2 = (short *) third_party_realloc(data, (total/2) * sizeof(*data), total * sizeof(*data)); // #Modified (realloc -> third_party_realloc) Charlie Malmqvist 2024-07-14, old size passed for allocators that can't reallocate
          if (data2 == NULL) {
             third_party_free(data); // #Modified (free -> third_party_free) Charlie Malmqvist 2024-07-14
             stb_vorbis_close(v);
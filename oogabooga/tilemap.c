@@ -0,0 +1,272 @@
+/*
+	Tilemaps
+
+	A grid of tiles stored in chunks of TILEMAP_CHUNK_SIZE*TILEMAP_CHUNK_SIZE tiles. Each chunk
+	keeps the quads of its non-empty tiles prebuilt in world space, and only builds them again
+	when one of its tiles changes. Drawing a tilemap only looks at the chunks that overlap the
+	camera, so the size of the map doesn't matter, only how much of it is on screen.
+
+	Tile 0 is empty. Other tile values index Tilemap.tile_types which decide what a tile looks
+	like; an image with uv's, or just a colored rect if image is null.
+
+	This part doesn't need a renderer, so it's in OOGABOOGA_HEADLESS builds too. The drawing is
+	draw_tilemap_in_frame in drawing.c.
+
+	Usage:
+
+		Tilemap *map = make_tilemap(1000, 1000, 8.0, get_heap_allocator());
+		map->origin = v2(-500*8.0, -500*8.0); // World position of the bottom-left corner of tile 0, 0
+
+		tilemap_set_tile_type(map, 1, 0,           v4(0, 0, 1, 1), v4(0.2, 0.2, 0.2, 0.2));
+		tilemap_set_tile_type(map, 2, grass_image, v4(0, 0, 1, 1), COLOR_WHITE);
+
+		tilemap_set_tile(map, x, y, 2);
+
+		while (...) {
+			...
+			draw_tilemap(map);
+			...
+		}
+
+	Changing a tile or a tile type just marks chunks as dirty, so it's fine to do a lot of it
+	in one frame. Dirty chunks are built the next time they're visible.
+*/
+
+#define TILEMAP_CHUNK_SIZE 32
+#define TILEMAP_CHUNK_TILE_COUNT (TILEMAP_CHUNK_SIZE*TILEMAP_CHUNK_SIZE)
+#define TILEMAP_MAX_TILE_TYPES 1024
+
+typedef u16 Tile;
+
+typedef struct Tilemap_Tile_Type {
+	// Null for a plain colored rect
+	struct Gfx_Image *image;
+	// x1, y1, x2, y2
+	Vector4 uv;
+	Vector4 color;
+} Tilemap_Tile_Type;
+
+typedef struct Tilemap_Chunk {
+	Tile tiles[TILEMAP_CHUNK_TILE_COUNT];
+	bool dirty;
+
+	// The quads of the non-empty tiles, in world space, row by row from the bottom.
+	// Only valid when not dirty.
+	u32 quad_count;
+	u32 quad_capacity;
+	// The quads of row y are [row_first_quad[y], row_first_quad[y+1])
+	u16 row_first_quad[TILEMAP_CHUNK_SIZE+1];
+	// 4 per quad; bottom_left, top_left, top_right, bottom_right
+	Vector2 *positions;
+	Vector4 *colors;
+	Vector4 *uvs;
+	struct Gfx_Image **images;
+} Tilemap_Chunk;
+
+// The quads of a chunk that are in rows overlapping the view
+typedef struct Tilemap_Visible_Chunk {
+	u32 chunk_index;
+	u32 first_quad;
+	u32 end_quad;
+} Tilemap_Visible_Chunk;
+
+typedef struct Tilemap {
+	// In tiles
+	u32 width, height;
+	u32 chunks_x, chunks_y;
+	float32 tile_size;
+	// World position of the bottom-left corner of tile 0, 0
+	Vector2 origin;
+
+	Tilemap_Chunk *chunks;
+	Tilemap_Tile_Type tile_types[TILEMAP_MAX_TILE_TYPES];
+
+	// Filled by tilemap_update_visible_chunks. Growing array.
+	Tilemap_Visible_Chunk *visible_chunks;
+
+	Allocator allocator;
+
+	u64 chunk_build_count;
+} Tilemap;
+
+Tilemap *make_tilemap(u32 width, u32 height, float32 tile_size, Allocator allocator) {
+	assert(width > 0 && height > 0 && tile_size > 0, "Bad parameters passed to make_tilemap");
+
+	Tilemap *map = alloc(allocator, sizeof(Tilemap));
+	*map = ZERO(Tilemap);
+
+	map->width = width;
+	map->height = height;
+	map->chunks_x = (width + TILEMAP_CHUNK_SIZE-1) / TILEMAP_CHUNK_SIZE;
+	map->chunks_y = (height + TILEMAP_CHUNK_SIZE-1) / TILEMAP_CHUNK_SIZE;
+	map->tile_size = tile_size;
+	map->allocator = allocator;
+
+	// Zeroed chunks are empty and clean
+	u64 chunks_size = (u64)map->chunks_x*map->chunks_y*sizeof(Tilemap_Chunk);
+	map->chunks = alloc(allocator, chunks_size);
+	memset(map->chunks, 0, chunks_size);
+
+	growing_array_init((void**)&map->visible_chunks, sizeof(Tilemap_Visible_Chunk), allocator);
+
+	return map;
+}
+
+void tilemap_chunk_free_quads(Tilemap *map, Tilemap_Chunk *chunk) {
+	if (!chunk->quad_capacity) return;
+
+	// All streams are in the one allocation starting at positions
+	dealloc(map->allocator, chunk->positions);
+	chunk->quad_count = 0;
+	chunk->quad_capacity = 0;
+}
+
+void destroy_tilemap(Tilemap *map) {
+	u64 chunk_count = (u64)map->chunks_x*map->chunks_y;
+	for (u64 i = 0; i < chunk_count; i++) {
+		tilemap_chunk_free_quads(map, &map->chunks[i]);
+	}
+	dealloc(map->allocator, map->chunks);
+	growing_array_deinit((void**)&map->visible_chunks);
+	dealloc(map->allocator, map);
+}
+
+inline Tilemap_Chunk *tilemap_get_chunk(Tilemap *map, u32 x, u32 y) {
+	return &map->chunks[(y/TILEMAP_CHUNK_SIZE)*map->chunks_x + x/TILEMAP_CHUNK_SIZE];
+}
+inline u32 tilemap_get_index_in_chunk(u32 x, u32 y) {
+	return (y%TILEMAP_CHUNK_SIZE)*TILEMAP_CHUNK_SIZE + x%TILEMAP_CHUNK_SIZE;
+}
+
+Tile tilemap_get_tile(Tilemap *map, u32 x, u32 y) {
+	assert(x < map->width && y < map->height, "Tile %d, %d is outside of the tilemap", x, y);
+	return tilemap_get_chunk(map, x, y)->tiles[tilemap_get_index_in_chunk(x, y)];
+}
+void tilemap_set_tile(Tilemap *map, u32 x, u32 y, Tile tile) {
+	assert(x < map->width && y < map->height, "Tile %d, %d is outside of the tilemap", x, y);
+	assert(tile < TILEMAP_MAX_TILE_TYPES, "Tile %d is not below TILEMAP_MAX_TILE_TYPES", tile);
+
+	Tilemap_Chunk *chunk = tilemap_get_chunk(map, x, y);
+	Tile *t = &chunk->tiles[tilemap_get_index_in_chunk(x, y)];
+	if (*t == tile) return;
+
+	*t = tile;
+	chunk->dirty = true;
+}
+
+// Every chunk is built again since we don't keep track of which tiles are used where
+void tilemap_set_tile_type(Tilemap *map, Tile tile, struct Gfx_Image *image, Vector4 uv, Vector4 color) {
+	assert(tile > 0 && tile < TILEMAP_MAX_TILE_TYPES, "Tile types go from 1 to TILEMAP_MAX_TILE_TYPES-1, got %d", tile);
+
+	map->tile_types[tile] = (Tilemap_Tile_Type){image, uv, color};
+
+	u64 chunk_count = (u64)map->chunks_x*map->chunks_y;
+	for (u64 i = 0; i < chunk_count; i++) map->chunks[i].dirty = true;
+}
+
+// Returns false if the position is outside of the map
+bool tilemap_world_to_tile(Tilemap *map, Vector2 world_pos, u32 *x, u32 *y) {
+	float64 tx = floor((world_pos.x - map->origin.x) / map->tile_size);
+	float64 ty = floor((world_pos.y - map->origin.y) / map->tile_size);
+	if (tx < 0 || ty < 0 || tx >= map->width || ty >= map->height) return false;
+	*x = (u32)tx;
+	*y = (u32)ty;
+	return true;
+}
+// Bottom-left corner of the tile
+Vector2 tilemap_tile_to_world(Tilemap *map, u32 x, u32 y) {
+	return v2(map->origin.x + x*map->tile_size, map->origin.y + y*map->tile_size);
+}
+
+void tilemap_build_chunk(Tilemap *map, u32 chunk_x, u32 chunk_y) {
+	Tilemap_Chunk *chunk = &map->chunks[chunk_y*map->chunks_x + chunk_x];
+
+	u32 quad_count = 0;
+	for (u32 i = 0; i < TILEMAP_CHUNK_TILE_COUNT; i++) {
+		if (chunk->tiles[i]) quad_count += 1;
+	}
+
+	if (quad_count > chunk->quad_capacity) {
+		// Grow straight to a full chunk so painting tiles doesn't reallocate over and over
+		u32 capacity = quad_count > TILEMAP_CHUNK_TILE_COUNT/2 ? TILEMAP_CHUNK_TILE_COUNT : quad_count*2;
+		tilemap_chunk_free_quads(map, chunk);
+		u8 *memory = alloc(map->allocator, capacity*(sizeof(Vector2)*4 + sizeof(Vector4)*2 + sizeof(struct Gfx_Image*)));
+		chunk->positions = (Vector2*)memory;
+		chunk->colors    = (Vector4*)(memory + capacity*sizeof(Vector2)*4);
+		chunk->uvs       = chunk->colors + capacity;
+		chunk->images    = (struct Gfx_Image**)(chunk->uvs + capacity);
+		chunk->quad_capacity = capacity;
+	}
+
+	float32 size = map->tile_size;
+	u32 n = 0;
+	for (u32 y = 0; y < TILEMAP_CHUNK_SIZE; y++) {
+		chunk->row_first_quad[y] = (u16)n;
+		float32 bottom = map->origin.y + (chunk_y*TILEMAP_CHUNK_SIZE + y)*size;
+		float32 top = bottom + size;
+		for (u32 x = 0; x < TILEMAP_CHUNK_SIZE; x++) {
+			Tile tile = chunk->tiles[y*TILEMAP_CHUNK_SIZE + x];
+			if (!tile) continue;
+
+			const Tilemap_Tile_Type *type = &map->tile_types[tile];
+			float32 left = map->origin.x + (chunk_x*TILEMAP_CHUNK_SIZE + x)*size;
+			float32 right = left + size;
+
+			// #Volatile same corners as draw_rect_in_frame
+			Vector2 *p = &chunk->positions[n*4];
+			p[0] = v2(left,  bottom);
+			p[1] = v2(left,  top);
+			p[2] = v2(right, top);
+			p[3] = v2(right, bottom);
+			chunk->colors[n] = type->color;
+			chunk->uvs[n]    = type->uv;
+			chunk->images[n] = type->image;
+			n += 1;
+		}
+	}
+
+	chunk->row_first_quad[TILEMAP_CHUNK_SIZE] = (u16)n;
+	chunk->quad_count = quad_count;
+	chunk->dirty = false;
+	map->chunk_build_count += 1;
+}
+
+// Finds the chunks that overlap the world space rectangle, builds the dirty ones and puts the
+// quads of their rows that overlap the rectangle in map->visible_chunks, bottom row first.
+// Returns the number of chunks put there.
+u64 tilemap_update_visible_chunks(Tilemap *map, Vector2 min, Vector2 max) {
+	growing_array_clear((void**)&map->visible_chunks);
+
+	// In tiles
+	s64 x0 = (s64)floor((min.x - map->origin.x) / map->tile_size);
+	s64 y0 = (s64)floor((min.y - map->origin.y) / map->tile_size);
+	s64 x1 = (s64)floor((max.x - map->origin.x) / map->tile_size);
+	s64 y1 = (s64)floor((max.y - map->origin.y) / map->tile_size);
+	x0 = max(x0, 0);
+	y0 = max(y0, 0);
+	x1 = min(x1, (s64)map->width-1);
+	y1 = min(y1, (s64)map->height-1);
+	if (x0 > x1 || y0 > y1) return 0;
+
+	for (s64 cy = y0/TILEMAP_CHUNK_SIZE; cy <= y1/TILEMAP_CHUNK_SIZE; cy++) {
+		// Rows of this chunk that are in view
+		s64 first_row = max(y0 - cy*TILEMAP_CHUNK_SIZE, 0);
+		s64 last_row = min(y1 - cy*TILEMAP_CHUNK_SIZE, TILEMAP_CHUNK_SIZE-1);
+
+		for (s64 cx = x0/TILEMAP_CHUNK_SIZE; cx <= x1/TILEMAP_CHUNK_SIZE; cx++) {
+			u32 index = (u32)(cy*map->chunks_x + cx);
+			Tilemap_Chunk *chunk = &map->chunks[index];
+			if (chunk->dirty) tilemap_build_chunk(map, (u32)cx, (u32)cy);
+
+			Tilemap_Visible_Chunk visible;
+			visible.chunk_index = index;
+			visible.first_quad = chunk->row_first_quad[first_row];
+			visible.end_quad = chunk->row_first_quad[last_row+1];
+			if (visible.first_quad == visible.end_quad) continue;
+
+			growing_array_add((void**)&map->visible_chunks, &visible);
+		}
+	}
+
+	return growing_array_get_valid_count(map->visible_chunks);
+}